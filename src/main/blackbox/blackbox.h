@@ -26,6 +26,8 @@ typedef struct blackboxConfig_s {
     uint8_t rate_denom;
     uint8_t device;
     uint8_t invertedCardDetection;
+    uint8_t compression;
+    uint8_t flashRing;
 } blackboxConfig_t;
 
 PG_DECLARE(blackboxConfig_t, blackboxConfig);
@@ -0,0 +1,858 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+
+#include "blackbox/blackbox_decode.h"
+#include "blackbox/blackbox_fielddefs.h"
+
+#include "common/encoding.h"
+#include "common/utils.h"
+
+static const char frameMarkers[BLACKBOX_DECODE_FRAME_TYPE_COUNT] = { 'I', 'P', 'S', 'G', 'H' };
+
+static uint8_t readByte(blackboxDecoder_t *decoder)
+{
+    if (decoder->pos >= decoder->size) {
+        decoder->eof = true;
+        return 0;
+    }
+    return decoder->data[decoder->pos++];
+}
+
+static int32_t signExtend(uint32_t value, int bits)
+{
+    const uint32_t signBit = 1U << (bits - 1);
+    value &= (1U << bits) - 1;
+    return (int32_t)(value ^ signBit) - (int32_t)signBit;
+}
+
+/*
+ * The readers below are the inverse of the writers in blackbox_encoding.c
+ */
+
+static uint32_t readUnsignedVB(blackboxDecoder_t *decoder)
+{
+    uint32_t result = 0;
+
+    // Most values are a single byte
+    if (decoder->pos < decoder->size && decoder->data[decoder->pos] < 0x80) {
+        return decoder->data[decoder->pos++];
+    }
+
+    // 32 bits take at most 5 bytes
+    for (int shift = 0; shift < 35; shift += 7) {
+        const uint8_t b = readByte(decoder);
+        result |= (uint32_t)(b & 0x7F) << shift;
+        if (b < 0x80) {
+            return result;
+        }
+    }
+
+    decoder->frameError = true;
+    return 0;
+}
+
+static int32_t readSignedVB(blackboxDecoder_t *decoder)
+{
+    return zigzagDecode(readUnsignedVB(decoder));
+}
+
+static void readTag2_3S32(blackboxDecoder_t *decoder, int32_t *values)
+{
+    const uint8_t leadByte = readByte(decoder);
+    uint8_t b;
+
+    switch (leadByte >> 6) {
+    case 0: // 2 bits per field
+        values[0] = signExtend(leadByte >> 4, 2);
+        values[1] = signExtend(leadByte >> 2, 2);
+        values[2] = signExtend(leadByte, 2);
+        break;
+    case 1: // 4 bits per field
+        values[0] = signExtend(leadByte, 4);
+        b = readByte(decoder);
+        values[1] = signExtend(b >> 4, 4);
+        values[2] = signExtend(b, 4);
+        break;
+    case 2: // 6 bits per field
+        values[0] = signExtend(leadByte, 6);
+        values[1] = signExtend(readByte(decoder), 6);
+        values[2] = signExtend(readByte(decoder), 6);
+        break;
+    case 3: // 1 to 4 little endian bytes per field, first field in the low bits of the selector
+        {
+            uint8_t selector = leadByte;
+            for (int i = 0; i < 3; i++, selector >>= 2) {
+                const int byteCount = (selector & 0x03) + 1;
+                uint32_t value = 0;
+                for (int n = 0; n < byteCount; n++) {
+                    value |= (uint32_t)readByte(decoder) << (8 * n);
+                }
+                values[i] = byteCount == 4 ? (int32_t)value : signExtend(value, 8 * byteCount);
+            }
+        }
+        break;
+    }
+}
+
+static void readTag8_4S16(blackboxDecoder_t *decoder, int32_t *values)
+{
+    uint8_t selector = readByte(decoder);
+    bool haveNibble = false;    // low nibble of buffer is still unread
+    uint8_t buffer = 0;
+
+    for (int i = 0; i < 4; i++, selector >>= 2) {
+        switch (selector & 0x03) {
+        case 0: // zero
+            values[i] = 0;
+            break;
+        case 1: // 4 bits, high nibble first
+            if (haveNibble) {
+                values[i] = signExtend(buffer, 4);
+                haveNibble = false;
+            } else {
+                buffer = readByte(decoder);
+                values[i] = signExtend(buffer >> 4, 4);
+                haveNibble = true;
+            }
+            break;
+        case 2: // 8 bits
+            if (haveNibble) {
+                uint8_t value = buffer << 4;
+                buffer = readByte(decoder);
+                value |= buffer >> 4;
+                values[i] = (int8_t)value;
+            } else {
+                values[i] = (int8_t)readByte(decoder);
+            }
+            break;
+        case 3: // 16 bits, big endian
+            if (haveNibble) {
+                const uint8_t b1 = readByte(decoder);
+                const uint8_t b2 = readByte(decoder);
+                values[i] = (int16_t)(((buffer & 0x0F) << 12) | (b1 << 4) | (b2 >> 4));
+                buffer = b2;
+            } else {
+                const uint8_t b1 = readByte(decoder);
+                const uint8_t b2 = readByte(decoder);
+                values[i] = (int16_t)((b1 << 8) | b2);
+            }
+            break;
+        }
+    }
+}
+
+static void readTag8_8SVB(blackboxDecoder_t *decoder, int32_t *values, int valueCount)
+{
+    if (valueCount == 1) {
+        // A single field is written without the header byte
+        values[0] = readSignedVB(decoder);
+        return;
+    }
+
+    uint8_t header = readByte(decoder);
+    for (int i = 0; i < valueCount; i++, header >>= 1) {
+        values[i] = (header & 0x01) ? readSignedVB(decoder) : 0;
+    }
+}
+
+// Reads the bits of a Rice group MSB first, whatever is left of the last byte is padding
+typedef struct bitReader_s {
+    uint32_t buffer;
+    int count;
+} bitReader_t;
+
+// Up to 24 bits
+static uint32_t readBits(blackboxDecoder_t *decoder, bitReader_t *reader, int count)
+{
+    while (reader->count < count) {
+        reader->buffer = (reader->buffer << 8) | readByte(decoder);
+        reader->count += 8;
+    }
+    reader->count -= count;
+    return (reader->buffer >> reader->count) & ((1U << count) - 1);
+}
+
+static uint32_t readEliasGamma(blackboxDecoder_t *decoder, bitReader_t *reader)
+{
+    int zeros = 0;
+    while (readBits(decoder, reader, 1) == 0) {
+        if (++zeros > 31 || decoder->eof) {
+            decoder->frameError = true;
+            return 1;
+        }
+    }
+
+    uint32_t value = 1;
+    if (zeros > 16) {
+        value = (value << (zeros - 16)) | readBits(decoder, reader, zeros - 16);
+        zeros = 16;
+    }
+    return (value << zeros) | readBits(decoder, reader, zeros);
+}
+
+static void readRiceGroup(blackboxDecoder_t *decoder, int32_t *values, int valueCount)
+{
+    bitReader_t reader = { 0, 0 };
+
+    const uint32_t k = readEliasGamma(decoder, &reader) - 1;
+    if (k > FLIGHT_LOG_RICE_MAX_PARAMETER) {
+        decoder->frameError = true;
+        return;
+    }
+
+    for (int i = 0; i < valueCount; i++) {
+        uint32_t q = 0;
+        while (q < FLIGHT_LOG_RICE_ESCAPE_QUOTIENT && readBits(decoder, &reader, 1)) {
+            q++;
+        }
+        if (q == FLIGHT_LOG_RICE_ESCAPE_QUOTIENT) {
+            q += readEliasGamma(decoder, &reader) - 1;
+        }
+        values[i] = zigzagDecode((q << k) | readBits(decoder, &reader, k));
+    }
+}
+
+/*
+ * Read the raw (unpredicted) values of all fields of a frame. Fields sharing a grouped encoding are
+ * consecutive in the header, the same way the writers in blackbox.c emit them.
+ */
+static void readFrameFields(blackboxDecoder_t *decoder, const blackboxDecodeFrameDef_t *def, int32_t *values)
+{
+    int32_t group[8];
+
+    for (int i = 0; i < def->fieldCount && !decoder->frameError;) {
+        int groupCount;
+
+        switch (def->encoding[i]) {
+        case FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB:
+            values[i++] = readSignedVB(decoder);
+            break;
+        case FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB:
+            values[i++] = (int32_t)readUnsignedVB(decoder);
+            break;
+        case FLIGHT_LOG_FIELD_ENCODING_NEG_14BIT:
+            values[i++] = -signExtend(readUnsignedVB(decoder), 14);
+            break;
+        case FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB:
+            groupCount = 1;
+            while (groupCount < 8 && i + groupCount < def->fieldCount && def->encoding[i + groupCount] == FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB) {
+                groupCount++;
+            }
+            readTag8_8SVB(decoder, values + i, groupCount);
+            i += groupCount;
+            break;
+        case FLIGHT_LOG_FIELD_ENCODING_RICE_GROUP:
+            groupCount = 1;
+            while (groupCount < FLIGHT_LOG_RICE_GROUP_MAX_VALUES && i + groupCount < def->fieldCount && def->encoding[i + groupCount] == FLIGHT_LOG_FIELD_ENCODING_RICE_GROUP) {
+                groupCount++;
+            }
+            readRiceGroup(decoder, values + i, groupCount);
+            i += groupCount;
+            break;
+        case FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32:
+            readTag2_3S32(decoder, group);
+            for (int n = 0; n < 3 && i < def->fieldCount; n++) {
+                values[i++] = group[n];
+            }
+            break;
+        case FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16:
+            readTag8_4S16(decoder, group);
+            for (int n = 0; n < 4 && i < def->fieldCount; n++) {
+                values[i++] = group[n];
+            }
+            break;
+        case FLIGHT_LOG_FIELD_ENCODING_NULL:
+            values[i++] = 0;
+            break;
+        default:
+            decoder->frameError = true;
+            break;
+        }
+    }
+}
+
+static bool shouldHaveFrame(const blackboxDecoder_t *decoder, uint32_t iteration)
+{
+    // Same as blackboxShouldLogPFrame(), the I frame index is always logged
+    return (iteration % decoder->frameIntervalI + decoder->frameIntervalPNum - 1) % decoder->frameIntervalPDenom < decoder->frameIntervalPNum;
+}
+
+// Loop iterations the logger left out on purpose between the previous main frame and this one
+static uint32_t countSkippedFrames(const blackboxDecoder_t *decoder)
+{
+    if (decoder->iterationFieldIndex < 0) {
+        return 0;
+    }
+
+    uint32_t iteration = (uint32_t)decoder->mainPrevious[decoder->iterationFieldIndex] + 1;
+    if (decoder->frameIntervalI <= BLACKBOX_DECODE_MAX_I_INTERVAL) {
+        return decoder->skippedFrames[iteration % decoder->frameIntervalI];
+    }
+
+    uint32_t skipped = 0;
+    while (!shouldHaveFrame(decoder, iteration) && skipped < decoder->frameIntervalI) {
+        iteration++;
+        skipped++;
+    }
+    return skipped;
+}
+
+// The logging pattern repeats every I interval, so the skip count of every position in it can be looked up
+static void initSkippedFrames(blackboxDecoder_t *decoder)
+{
+    if (decoder->frameIntervalI > BLACKBOX_DECODE_MAX_I_INTERVAL) {
+        return;
+    }
+
+    for (uint32_t index = 0; index < decoder->frameIntervalI; index++) {
+        uint32_t skipped = 0;
+        while (!shouldHaveFrame(decoder, index + skipped) && skipped < decoder->frameIntervalI - 1) {
+            skipped++;
+        }
+        decoder->skippedFrames[index] = skipped;
+    }
+}
+
+static int32_t predictMainField(const blackboxDecoder_t *decoder, const blackboxDecodeFrameDef_t *def, int fieldIndex,
+        const int32_t *current, const int32_t *previous, const int32_t *previous2)
+{
+    switch (def->predictor[fieldIndex]) {
+    case FLIGHT_LOG_FIELD_PREDICTOR_0:
+        return 0;
+    case FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS:
+        return previous ? previous[fieldIndex] : 0;
+    case FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE:
+        return previous ? (int32_t)(2 * (uint32_t)previous[fieldIndex] - (uint32_t)previous2[fieldIndex]) : 0;
+    case FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2:
+        if (!previous) {
+            return 0;
+        }
+        if (def->isSigned[fieldIndex]) {
+            return (int32_t)(((int64_t)previous[fieldIndex] + previous2[fieldIndex]) / 2);
+        }
+        return (int32_t)(((uint64_t)(uint32_t)previous[fieldIndex] + (uint32_t)previous2[fieldIndex]) / 2);
+    case FLIGHT_LOG_FIELD_PREDICTOR_MINTHROTTLE:
+        return decoder->minthrottle;
+    case FLIGHT_LOG_FIELD_PREDICTOR_MOTOR_0:
+        return decoder->motor0FieldIndex >= 0 && decoder->motor0FieldIndex < fieldIndex ? current[decoder->motor0FieldIndex] : 0;
+    case FLIGHT_LOG_FIELD_PREDICTOR_INC:
+        return previous ? (int32_t)((uint32_t)previous[fieldIndex] + 1 + countSkippedFrames(decoder)) : 0;
+    case FLIGHT_LOG_FIELD_PREDICTOR_1500:
+        return 1500;
+    case FLIGHT_LOG_FIELD_PREDICTOR_VBATREF:
+        return decoder->vbatref;
+    default:
+        return 0;
+    }
+}
+
+static void readMainFrame(blackboxDecoder_t *decoder, blackboxDecodeFrameType_e frameType)
+{
+    const blackboxDecodeFrameDef_t *def = &decoder->frameDef[frameType];
+    int32_t *current = decoder->mainCurrent;
+    const int32_t *previous = frameType == BLACKBOX_DECODE_FRAME_INTRA ? NULL : decoder->mainPrevious;
+    const int32_t *previous2 = frameType == BLACKBOX_DECODE_FRAME_INTRA ? NULL : decoder->mainPrevious2;
+
+    readFrameFields(decoder, def, current);
+
+    // In field order, the motor[0] prediction of the other motors needs the final motor[0]
+    for (int i = 0; i < def->fieldCount; i++) {
+        current[i] = (int32_t)((uint32_t)current[i] + (uint32_t)predictMainField(decoder, def, i, current, previous, previous2));
+    }
+}
+
+static void rotateMainHistory(blackboxDecoder_t *decoder, blackboxDecodeFrameType_e frameType)
+{
+    int32_t *decoded = decoder->mainCurrent;
+
+    if (frameType == BLACKBOX_DECODE_FRAME_INTRA) {
+        // No other history, the I frame is used for both generations
+        decoder->mainPrevious2 = decoded;
+    } else {
+        decoder->mainPrevious2 = decoder->mainPrevious;
+    }
+    decoder->mainPrevious = decoded;
+    decoder->mainCurrent = decoder->mainHistory[((decoded - decoder->mainHistory[0]) / BLACKBOX_DECODE_MAX_FIELDS + 1) % 3];
+
+    decoder->mainFrame = decoded;
+}
+
+/*
+ * Fields of the S, G and H frames only depend on the previous frame of the same type (or the GPS home), not
+ * on the main frame history
+ */
+static void readOtherFrame(blackboxDecoder_t *decoder, blackboxDecodeFrameType_e frameType, int32_t *values)
+{
+    const blackboxDecodeFrameDef_t *def = &decoder->frameDef[frameType];
+    int homeCoordIndex = 0;
+
+    readFrameFields(decoder, def, values);
+
+    for (int i = 0; i < def->fieldCount; i++) {
+        switch (def->predictor[i]) {
+        case FLIGHT_LOG_FIELD_PREDICTOR_0:
+            break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD:
+            // GPS_coord[0] and [1] are relative to GPS_home[0] and [1]
+            if (homeCoordIndex < 2) {
+                values[i] = (int32_t)((uint32_t)values[i] + (uint32_t)decoder->gpsHomeFrame[homeCoordIndex++]);
+            }
+            break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_LAST_MAIN_FRAME_TIME:
+            if (decoder->mainFrame && decoder->timeFieldIndex >= 0) {
+                values[i] = (int32_t)((uint32_t)values[i] + (uint32_t)decoder->mainFrame[decoder->timeFieldIndex]);
+            }
+            break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_MINTHROTTLE:
+            values[i] += decoder->minthrottle;
+            break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_1500:
+            values[i] += 1500;
+            break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_VBATREF:
+            values[i] += decoder->vbatref;
+            break;
+        default:
+            decoder->frameError = true;
+            break;
+        }
+    }
+}
+
+static void readEventFrame(blackboxDecoder_t *decoder)
+{
+    static const char endOfLog[] = "End of log";
+    static const char disarmReason[] = " (disarm reason:";
+    const uint8_t event = readByte(decoder);
+
+    decoder->event = event;
+    decoder->eventData[0] = 0;
+    decoder->eventData[1] = 0;
+
+    switch (event) {
+    case FLIGHT_LOG_EVENT_SYNC_BEEP:
+        decoder->eventData[0] = (int32_t)readUnsignedVB(decoder);
+        break;
+    case FLIGHT_LOG_EVENT_INFLIGHT_ADJUSTMENT:
+        // Adjustment function, then the new value. A float value is returned as its bit pattern.
+        decoder->eventData[0] = readByte(decoder);
+        if (decoder->eventData[0] & FLIGHT_LOG_EVENT_INFLIGHT_ADJUSTMENT_FUNCTION_FLOAT_VALUE_FLAG) {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; i++) {
+                value |= (uint32_t)readByte(decoder) << (8 * i);
+            }
+            decoder->eventData[1] = (int32_t)value;
+        } else {
+            decoder->eventData[1] = readSignedVB(decoder);
+        }
+        break;
+    case FLIGHT_LOG_EVENT_LOGGING_RESUME:
+        decoder->eventData[0] = (int32_t)readUnsignedVB(decoder);
+        decoder->eventData[1] = (int32_t)readUnsignedVB(decoder);
+        // Logging restarts with an I frame
+        decoder->mainHistoryValid = false;
+        break;
+    case FLIGHT_LOG_EVENT_FLIGHTMODE:
+        decoder->eventData[0] = (int32_t)readUnsignedVB(decoder);
+        decoder->eventData[1] = (int32_t)readUnsignedVB(decoder);
+        break;
+    case FLIGHT_LOG_EVENT_IMU_FAILURE:
+        decoder->eventData[0] = readByte(decoder);
+        break;
+    case FLIGHT_LOG_EVENT_LOG_END:
+        // "End of log (disarm reason:%d)" followed by a zero byte
+        if (decoder->size - decoder->pos < sizeof(endOfLog) - 1 || memcmp(decoder->data + decoder->pos, endOfLog, sizeof(endOfLog) - 1)) {
+            decoder->frameError = true;
+            break;
+        }
+        decoder->pos += sizeof(endOfLog) - 1;
+        if (decoder->size - decoder->pos >= sizeof(disarmReason) - 1 && !memcmp(decoder->data + decoder->pos, disarmReason, sizeof(disarmReason) - 1)) {
+            decoder->pos += sizeof(disarmReason) - 1;
+            while (decoder->pos < decoder->size && decoder->data[decoder->pos] >= '0' && decoder->data[decoder->pos] <= '9') {
+                decoder->eventData[0] = decoder->eventData[0] * 10 + (decoder->data[decoder->pos++] - '0');
+            }
+        }
+        while (readByte(decoder) != 0 && !decoder->eof);
+        decoder->logEnded = true;
+        break;
+    default:
+        decoder->frameError = true;
+        break;
+    }
+}
+
+static bool isFrameMarker(uint8_t b)
+{
+    return b == 'E' || memchr(frameMarkers, b, sizeof(frameMarkers)) != NULL;
+}
+
+// A log written after this one without a LOG_END event in between, e.g. after a power loss
+static bool isLogStart(const blackboxDecoder_t *decoder, size_t pos)
+{
+    static const char logStart[] = "H Product:";
+
+    return decoder->data[pos] == 'H' && decoder->size - pos >= sizeof(logStart) - 1
+        && !memcmp(decoder->data + pos, logStart, sizeof(logStart) - 1);
+}
+
+/*
+ * Decode the next frame of the log and return its marker ('I', 'P', 'S', 'G', 'H' or 'E'), or
+ * BLACKBOX_DECODE_END_OF_LOG at the end of the log. The frame values are in decoder->frame, the event in
+ * decoder->event and decoder->eventData.
+ *
+ * A frame is only accepted when the byte after it starts another frame, otherwise the decoder skips ahead
+ * to the next I frame and drops the main frame history. P frames that have no history to be predicted from
+ * are dropped.
+ */
+char blackboxDecodeNextFrame(blackboxDecoder_t *decoder)
+{
+    while (!decoder->logEnded && decoder->pos < decoder->size) {
+        const size_t frameStart = decoder->pos;
+
+        if (isLogStart(decoder, frameStart)) {
+            decoder->logEnded = true;
+            break;
+        }
+
+        const uint8_t marker = readByte(decoder);
+        int32_t *values = NULL;
+        int frameType = -1;
+
+        decoder->frameError = false;
+
+        switch (marker) {
+        case 'I':
+            frameType = BLACKBOX_DECODE_FRAME_INTRA;
+            values = decoder->mainCurrent;
+            readMainFrame(decoder, BLACKBOX_DECODE_FRAME_INTRA);
+            break;
+        case 'P':
+            frameType = BLACKBOX_DECODE_FRAME_INTER;
+            values = decoder->mainCurrent;
+            readMainFrame(decoder, BLACKBOX_DECODE_FRAME_INTER);
+            break;
+        case 'S':
+            frameType = BLACKBOX_DECODE_FRAME_SLOW;
+            values = decoder->slowFrame;
+            readOtherFrame(decoder, BLACKBOX_DECODE_FRAME_SLOW, values);
+            break;
+        case 'G':
+            frameType = BLACKBOX_DECODE_FRAME_GPS;
+            values = decoder->gpsFrame;
+            readOtherFrame(decoder, BLACKBOX_DECODE_FRAME_GPS, values);
+            break;
+        case 'H':
+            frameType = BLACKBOX_DECODE_FRAME_GPS_HOME;
+            values = decoder->gpsHomeFrame;
+            readOtherFrame(decoder, BLACKBOX_DECODE_FRAME_GPS_HOME, values);
+            break;
+        case 'E':
+            readEventFrame(decoder);
+            break;
+        default:
+            decoder->frameError = true;
+            break;
+        }
+
+        if (decoder->eof) {
+            // Log was cut off in the middle of this frame
+            decoder->logEnded = true;
+            break;
+        }
+
+        if (decoder->frameError || (decoder->pos < decoder->size && !decoder->logEnded && !isFrameMarker(decoder->data[decoder->pos]))) {
+            decoder->corruptFrameCount++;
+            decoder->mainHistoryValid = false;
+            decoder->logEnded = false;
+            if (frameType == BLACKBOX_DECODE_FRAME_GPS_HOME) {
+                decoder->gpsHomeValid = false;
+            }
+            decoder->pos = frameStart + 1;
+            while (decoder->pos < decoder->size && decoder->data[decoder->pos] != 'I' && !isLogStart(decoder, decoder->pos)) {
+                decoder->pos++;
+            }
+            continue;
+        }
+
+        switch (frameType) {
+        case BLACKBOX_DECODE_FRAME_INTRA:
+            decoder->intraFrameCount++;
+            decoder->mainHistoryValid = true;
+            rotateMainHistory(decoder, frameType);
+            decoder->mainFrameType = marker;
+            break;
+        case BLACKBOX_DECODE_FRAME_INTER:
+            if (!decoder->mainHistoryValid) {
+                // Nothing to predict from until the next I frame
+                continue;
+            }
+            decoder->interFrameCount++;
+            rotateMainHistory(decoder, frameType);
+            decoder->mainFrameType = marker;
+            break;
+        case BLACKBOX_DECODE_FRAME_SLOW:
+            decoder->slowFrameCount++;
+            break;
+        case BLACKBOX_DECODE_FRAME_GPS:
+            decoder->gpsFrameCount++;
+            break;
+        case BLACKBOX_DECODE_FRAME_GPS_HOME:
+            decoder->gpsHomeFrameCount++;
+            decoder->gpsHomeValid = true;
+            break;
+        default:
+            decoder->eventCount++;
+            break;
+        }
+
+        decoder->frame = values;
+        decoder->frameFieldCount = frameType >= 0 ? decoder->frameDef[frameType].fieldCount : 0;
+        return (char)marker;
+    }
+
+    decoder->frame = NULL;
+    decoder->frameFieldCount = 0;
+    return BLACKBOX_DECODE_END_OF_LOG;
+}
+
+// Skip everything but the I and P frames
+bool blackboxDecodeNextMainFrame(blackboxDecoder_t *decoder)
+{
+    char marker;
+
+    while ((marker = blackboxDecodeNextFrame(decoder)) != BLACKBOX_DECODE_END_OF_LOG) {
+        if (marker == 'I' || marker == 'P') {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Return the offset of the first log header at or after offset, or size if there is none
+ */
+size_t blackboxDecodeFindLog(const uint8_t *data, size_t size, size_t offset)
+{
+    static const char logStart[] = "H Product:";
+
+    while (offset + sizeof(logStart) - 1 <= size) {
+        const uint8_t *candidate = memchr(data + offset, 'H', size - offset);
+        if (!candidate) {
+            break;
+        }
+        offset = candidate - data;
+        if (size - offset >= sizeof(logStart) - 1 && !memcmp(candidate, logStart, sizeof(logStart) - 1)) {
+            return offset;
+        }
+        offset++;
+    }
+    return size;
+}
+
+int blackboxDecodeFieldIndex(const blackboxDecoder_t *decoder, blackboxDecodeFrameType_e frameType, const char *name)
+{
+    const blackboxDecodeFrameDef_t *def = &decoder->frameDef[frameType];
+
+    for (int i = 0; i < def->fieldCount; i++) {
+        if (!strcmp(def->name[i], name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Parse the comma (or slash) separated integers of the "H name:value" header line. Returns the number of
+ * values parsed, 0 if the line is not present.
+ */
+int blackboxDecodeHeaderInts(const blackboxDecoder_t *decoder, const char *name, int32_t *values, int maxCount)
+{
+    const size_t nameLength = strlen(name);
+    const char *header = (const char *)decoder->data;
+    size_t pos = 0;
+
+    while (pos < decoder->headerSize) {
+        const char *line = header + pos;
+        const char *lineEnd = memchr(line, '\n', decoder->headerSize - pos);
+        pos = lineEnd - header + 1;
+
+        if ((size_t)(lineEnd - line) < nameLength + 3 || memcmp(line + 2, name, nameLength) || line[nameLength + 2] != ':') {
+            continue;
+        }
+
+        int count = 0;
+        const char *p = line + nameLength + 3;
+        while (p < lineEnd && count < maxCount) {
+            bool negative = false;
+            if (*p == '-') {
+                negative = true;
+                p++;
+            }
+            if (p >= lineEnd || *p < '0' || *p > '9') {
+                break;
+            }
+            int32_t value = 0;
+            while (p < lineEnd && *p >= '0' && *p <= '9') {
+                value = value * 10 + (*p++ - '0');
+            }
+            values[count++] = negative ? -value : value;
+            if (p < lineEnd && (*p == ',' || *p == '/')) {
+                p++;
+            }
+        }
+        return count;
+    }
+
+    return 0;
+}
+
+static int headerFrameType(char marker)
+{
+    const char *type = memchr(frameMarkers, marker, sizeof(frameMarkers));
+    return type ? type - frameMarkers : -1;
+}
+
+// "H Field X property:a,b,c"
+static bool parseFieldHeaderLine(blackboxDecoder_t *decoder, const char *line, const char *lineEnd)
+{
+    static const char fieldPrefix[] = "Field ";
+    const size_t prefixLength = sizeof(fieldPrefix) - 1;
+
+    if ((size_t)(lineEnd - line) < prefixLength + 2 || memcmp(line, fieldPrefix, prefixLength) || line[prefixLength + 1] != ' ') {
+        return true;
+    }
+
+    const int frameType = headerFrameType(line[prefixLength]);
+    const char *property = line + prefixLength + 2;
+    const char *colon = memchr(property, ':', lineEnd - property);
+    if (frameType < 0 || !colon) {
+        return true;
+    }
+
+    blackboxDecodeFrameDef_t *def = &decoder->frameDef[frameType];
+    const size_t propertyLength = colon - property;
+    const char *value = colon + 1;
+    int count = 0;
+
+    if (propertyLength == 4 && !memcmp(property, "name", 4)) {
+        while (value < lineEnd) {
+            const char *comma = memchr(value, ',', lineEnd - value);
+            const char *nameEnd = comma ? comma : lineEnd;
+            if (count >= BLACKBOX_DECODE_MAX_FIELDS || nameEnd - value >= BLACKBOX_DECODE_MAX_FIELD_NAME) {
+                return false;
+            }
+            memcpy(def->name[count], value, nameEnd - value);
+            def->name[count][nameEnd - value] = '\0';
+            count++;
+            value = nameEnd + 1;
+        }
+        def->fieldCount = count;
+        return true;
+    }
+
+    uint8_t *target;
+    if (propertyLength == 6 && !memcmp(property, "signed", 6)) {
+        target = def->isSigned;
+    } else if (propertyLength == 9 && !memcmp(property, "predictor", 9)) {
+        target = def->predictor;
+    } else if (propertyLength == 8 && !memcmp(property, "encoding", 8)) {
+        target = def->encoding;
+    } else {
+        return true;
+    }
+
+    while (value < lineEnd && count < BLACKBOX_DECODE_MAX_FIELDS) {
+        target[count++] = (uint8_t)strtol(value, NULL, 10);
+        const char *comma = memchr(value, ',', lineEnd - value);
+        if (!comma) {
+            break;
+        }
+        value = comma + 1;
+    }
+    return true;
+}
+
+bool blackboxDecodeInit(blackboxDecoder_t *decoder, const uint8_t *data, size_t size)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->data = data;
+    decoder->size = size;
+
+    // The header is every line up to the first frame, the first frame after it is always an I frame
+    while (decoder->pos + 1 < size && data[decoder->pos] == 'H' && data[decoder->pos + 1] == ' ') {
+        const char *line = (const char *)data + decoder->pos;
+        const char *lineEnd = memchr(line, '\n', size - decoder->pos);
+        if (!lineEnd) {
+            return false;
+        }
+        if (!parseFieldHeaderLine(decoder, line + 2, lineEnd)) {
+            return false;
+        }
+        decoder->pos = lineEnd - (const char *)data + 1;
+    }
+    decoder->headerSize = decoder->pos;
+
+    blackboxDecodeFrameDef_t *intraDef = &decoder->frameDef[BLACKBOX_DECODE_FRAME_INTRA];
+    blackboxDecodeFrameDef_t *interDef = &decoder->frameDef[BLACKBOX_DECODE_FRAME_INTER];
+    if (intraDef->fieldCount == 0) {
+        return false;
+    }
+
+    // P frames share the field names and signedness of the I frames
+    interDef->fieldCount = intraDef->fieldCount;
+    memcpy(interDef->name, intraDef->name, sizeof(interDef->name));
+    memcpy(interDef->isSigned, intraDef->isSigned, sizeof(interDef->isSigned));
+
+    int32_t values[2];
+    decoder->minthrottle = blackboxDecodeHeaderInts(decoder, "minthrottle", values, 1) ? values[0] : 0;
+    decoder->vbatref = blackboxDecodeHeaderInts(decoder, "vbatref", values, 1) ? values[0] : 0;
+
+    if (blackboxDecodeHeaderInts(decoder, "P interval", values, 2) == 2 && values[0] > 0 && values[1] >= values[0]) {
+        decoder->frameIntervalPNum = values[0];
+        decoder->frameIntervalPDenom = values[1];
+    } else {
+        decoder->frameIntervalPNum = 1;
+        decoder->frameIntervalPDenom = 1;
+    }
+
+    if (blackboxDecodeHeaderInts(decoder, "I interval", values, 1) && values[0] > 0) {
+        decoder->frameIntervalI = values[0];
+    } else {
+        // Not in the header, derived from the P interval like blackboxInit() does
+        const uint32_t denom = decoder->frameIntervalPDenom;
+        decoder->frameIntervalI = denom <= 32 ? 32 : denom <= 64 ? 64 : denom <= 128 ? 128 : 256;
+    }
+
+    initSkippedFrames(decoder);
+
+    decoder->iterationFieldIndex = blackboxDecodeFieldIndex(decoder, BLACKBOX_DECODE_FRAME_INTRA, "loopIteration");
+    decoder->timeFieldIndex = blackboxDecodeFieldIndex(decoder, BLACKBOX_DECODE_FRAME_INTRA, "time");
+    decoder->motor0FieldIndex = blackboxDecodeFieldIndex(decoder, BLACKBOX_DECODE_FRAME_INTRA, "motor[0]");
+
+    decoder->mainCurrent = decoder->mainHistory[0];
+    decoder->mainPrevious = decoder->mainHistory[1];
+    decoder->mainPrevious2 = decoder->mainHistory[2];
+
+    return true;
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Host side decoder for the logs written by blackbox.c. The field layout is
+ * taken from the "H Field" header lines, so any combination of conditional
+ * fields can be decoded. The log is decoded in place from a memory buffer (typically a memory mapped
+ * file), one frame per call, without copying the frame data.
+ *
+ * A flash dump usually holds several logs back to back, blackboxDecodeFindLog() returns where each one
+ * starts so that a decoder can be initialised on it.
+ */
+
+#define BLACKBOX_DECODE_MAX_FIELDS          128
+#define BLACKBOX_DECODE_MAX_FIELD_NAME      32
+#define BLACKBOX_DECODE_MAX_I_INTERVAL      256
+
+typedef enum {
+    BLACKBOX_DECODE_FRAME_INTRA = 0,    // 'I'
+    BLACKBOX_DECODE_FRAME_INTER,        // 'P'
+    BLACKBOX_DECODE_FRAME_SLOW,         // 'S'
+    BLACKBOX_DECODE_FRAME_GPS,          // 'G'
+    BLACKBOX_DECODE_FRAME_GPS_HOME,     // 'H'
+    BLACKBOX_DECODE_FRAME_TYPE_COUNT
+} blackboxDecodeFrameType_e;
+
+#define BLACKBOX_DECODE_END_OF_LOG          0   // blackboxDecodeNextFrame() result when there are no more frames
+
+typedef struct blackboxDecodeFrameDef_s {
+    int fieldCount;
+    char name[BLACKBOX_DECODE_MAX_FIELDS][BLACKBOX_DECODE_MAX_FIELD_NAME];
+    uint8_t isSigned[BLACKBOX_DECODE_MAX_FIELDS];
+    uint8_t predictor[BLACKBOX_DECODE_MAX_FIELDS];
+    uint8_t encoding[BLACKBOX_DECODE_MAX_FIELDS];
+} blackboxDecodeFrameDef_t;
+
+typedef struct blackboxDecoder_s {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    size_t headerSize;
+    bool eof;           // a read ran past the end of the data
+    bool frameError;    // the frame being decoded is malformed
+    bool logEnded;
+
+    blackboxDecodeFrameDef_t frameDef[BLACKBOX_DECODE_FRAME_TYPE_COUNT];
+
+    // Header values the predictors depend on
+    int32_t minthrottle;
+    int32_t vbatref;
+    uint32_t frameIntervalI;
+    uint32_t frameIntervalPNum;
+    uint32_t frameIntervalPDenom;
+    uint8_t skippedFrames[BLACKBOX_DECODE_MAX_I_INTERVAL];  // iterations left out from each position of the I interval on
+
+    int iterationFieldIndex;
+    int timeFieldIndex;
+    int motor0FieldIndex;
+
+    // Main frame history, the same rotation as blackboxHistory[] in blackbox.c
+    int32_t mainHistory[3][BLACKBOX_DECODE_MAX_FIELDS];
+    int32_t *mainCurrent;
+    int32_t *mainPrevious;
+    int32_t *mainPrevious2;
+    bool mainHistoryValid;
+
+    // Last successfully decoded main frame, valid after blackboxDecodeNextMainFrame() returns true
+    const int32_t *mainFrame;
+    char mainFrameType;
+
+    // State of the other frame types, the G frame coordinates are relative to the last H frame
+    int32_t slowFrame[BLACKBOX_DECODE_MAX_FIELDS];
+    int32_t gpsFrame[BLACKBOX_DECODE_MAX_FIELDS];
+    int32_t gpsHomeFrame[BLACKBOX_DECODE_MAX_FIELDS];
+    bool gpsHomeValid;
+
+    // Values of the frame returned by blackboxDecodeNextFrame(), not valid for events
+    const int32_t *frame;
+    int frameFieldCount;
+
+    // Last decoded event, valid when blackboxDecodeNextFrame() returns 'E'
+    uint8_t event;
+    int32_t eventData[2];
+
+    uint32_t intraFrameCount;
+    uint32_t interFrameCount;
+    uint32_t slowFrameCount;
+    uint32_t gpsFrameCount;
+    uint32_t gpsHomeFrameCount;
+    uint32_t eventCount;
+    uint32_t corruptFrameCount;
+} blackboxDecoder_t;
+
+bool blackboxDecodeInit(blackboxDecoder_t *decoder, const uint8_t *data, size_t size);
+char blackboxDecodeNextFrame(blackboxDecoder_t *decoder);
+bool blackboxDecodeNextMainFrame(blackboxDecoder_t *decoder);
+size_t blackboxDecodeFindLog(const uint8_t *data, size_t size, size_t offset);
+
+int blackboxDecodeFieldIndex(const blackboxDecoder_t *decoder, blackboxDecodeFrameType_e frameType, const char *name);
+int blackboxDecodeHeaderInts(const blackboxDecoder_t *decoder, const char *name, int32_t *values, int maxCount);
@@ -15,6 +15,7 @@
  * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
@@ -24,9 +25,11 @@
 #ifdef USE_BLACKBOX
 
 #include "blackbox_encoding.h"
+#include "blackbox_fielddefs.h"
 #include "blackbox_io.h"
 
 #include "common/encoding.h"
+#include "common/maths.h"
 #include "common/printf.h"
 
 
@@ -365,6 +368,113 @@ void blackboxWriteTag8_8SVB(int32_t *values, int valueCount)
     }
 }
 
+// Bits of the Rice group being written that don't fill a byte yet
+static uint32_t bitBuffer;
+static uint8_t bitBufferCount;
+
+// Append up to 24 bits MSB first, writing out every byte that gets completed
+static void blackboxWriteBits(uint32_t value, int count)
+{
+    bitBuffer = (bitBuffer << count) | (value & ((1U << count) - 1));
+    bitBufferCount += count;
+
+    while (bitBufferCount >= 8) {
+        bitBufferCount -= 8;
+        blackboxWrite(bitBuffer >> bitBufferCount);
+    }
+}
+
+static int bitLength(uint32_t value)
+{
+    return 32 - __builtin_clz(value);
+}
+
+static int eliasGammaLength(uint32_t value)
+{
+    return 2 * bitLength(value) - 1;
+}
+
+// Value must be at least 1
+static void blackboxWriteEliasGamma(uint32_t value)
+{
+    const int length = bitLength(value);
+
+    // Leading zeros, then the value itself which starts with a one bit
+    for (int zeros = length - 1; zeros > 0; zeros -= 16) {
+        blackboxWriteBits(0, MIN(zeros, 16));
+    }
+    if (length > 16) {
+        blackboxWriteBits(value >> 16, length - 16);
+        blackboxWriteBits(value, 16);
+    } else {
+        blackboxWriteBits(value, length);
+    }
+}
+
+static uint32_t riceGroupLength(const uint32_t *values, int valueCount, int k)
+{
+    uint32_t length = eliasGammaLength(k + 1);
+
+    for (int i = 0; i < valueCount; i++) {
+        const uint32_t q = values[i] >> k;
+
+        if (q < FLIGHT_LOG_RICE_ESCAPE_QUOTIENT) {
+            length += q + 1 + k;
+        } else {
+            length += FLIGHT_LOG_RICE_ESCAPE_QUOTIENT + eliasGammaLength(q - FLIGHT_LOG_RICE_ESCAPE_QUOTIENT + 1) + k;
+        }
+    }
+
+    return length;
+}
+
+/**
+ * Write up to 8 signed values as a FLIGHT_LOG_FIELD_ENCODING_RICE_GROUP, see blackbox_fielddefs.h for the layout.
+ *
+ * Residuals of well predicted fields are small and of similar magnitude, so one Rice parameter per group codes them
+ * in fewer bits than the variable-byte encodings, which never use less than a byte per value.
+ */
+void blackboxWriteRiceGroup(const int32_t *values, int valueCount)
+{
+    uint32_t zigzag[FLIGHT_LOG_RICE_GROUP_MAX_VALUES];
+
+    for (int i = 0; i < valueCount; i++) {
+        zigzag[i] = zigzagEncode(values[i]);
+    }
+
+    // The group length is convex in k, so stop at the first k that doesn't shorten it
+    int k = 0;
+    uint32_t length = riceGroupLength(zigzag, valueCount, 0);
+    while (k < FLIGHT_LOG_RICE_MAX_PARAMETER) {
+        const uint32_t nextLength = riceGroupLength(zigzag, valueCount, k + 1);
+        if (nextLength >= length) {
+            break;
+        }
+        length = nextLength;
+        k++;
+    }
+
+    blackboxWriteEliasGamma(k + 1);
+
+    for (int i = 0; i < valueCount; i++) {
+        const uint32_t q = zigzag[i] >> k;
+
+        if (q < FLIGHT_LOG_RICE_ESCAPE_QUOTIENT) {
+            // q one bits terminated by a zero
+            blackboxWriteBits(((1U << q) - 1) << 1, q + 1);
+        } else {
+            blackboxWriteBits((1U << FLIGHT_LOG_RICE_ESCAPE_QUOTIENT) - 1, FLIGHT_LOG_RICE_ESCAPE_QUOTIENT);
+            blackboxWriteEliasGamma(q - FLIGHT_LOG_RICE_ESCAPE_QUOTIENT + 1);
+        }
+        blackboxWriteBits(zigzag[i], k);
+    }
+
+    // Pad to a byte boundary so the next field starts on one
+    if (bitBufferCount > 0) {
+        blackboxWriteBits(0, 8 - bitBufferCount);
+    }
+}
+
 /** Write unsigned integer **/
 void blackboxWriteU32(int32_t value)
 {
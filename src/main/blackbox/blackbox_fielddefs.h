@@ -50,6 +50,8 @@ typedef enum FlightLogFieldCondition {
 
     FLIGHT_LOG_FIELD_CONDITION_DEBUG,
 
+    FLIGHT_LOG_FIELD_CONDITION_COMPRESSED,
+
     FLIGHT_LOG_FIELD_CONDITION_NEVER,
 
     FLIGHT_LOG_FIELD_CONDITION_FIRST = FLIGHT_LOG_FIELD_CONDITION_ALWAYS,
@@ -99,9 +101,22 @@ typedef enum FlightLogFieldEncoding {
     FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB       = 6,
     FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32       = 7,
     FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16       = 8,
-    FLIGHT_LOG_FIELD_ENCODING_NULL            = 9 // Nothing is written to the file, take value to be zero
+    FLIGHT_LOG_FIELD_ENCODING_NULL            = 9, // Nothing is written to the file, take value to be zero
+    FLIGHT_LOG_FIELD_ENCODING_RICE_GROUP      = 11 // Up to 8 values Rice coded with a shared parameter, bit packed and padded to a byte
 } FlightLogFieldEncoding;
 
+/*
+ * FLIGHT_LOG_FIELD_ENCODING_RICE_GROUP layout, bits are written MSB first:
+ *  - Elias gamma code of the Rice parameter k plus one
+ *  - for each zigzag encoded value, its quotient q = value >> k in unary (q one bits and a zero bit) followed by
+ *    the k low bits of the value. Quotients of FLIGHT_LOG_RICE_ESCAPE_QUOTIENT or more are written as that many
+ *    one bits followed by the Elias gamma code of q - FLIGHT_LOG_RICE_ESCAPE_QUOTIENT + 1 instead
+ *  - zero bits up to the next byte boundary
+ */
+#define FLIGHT_LOG_RICE_GROUP_MAX_VALUES    8
+#define FLIGHT_LOG_RICE_MAX_PARAMETER       15
+#define FLIGHT_LOG_RICE_ESCAPE_QUOTIENT     16
+
 typedef enum FlightLogFieldSign {
     FLIGHT_LOG_FIELD_UNSIGNED = 0,
     FLIGHT_LOG_FIELD_SIGNED   = 1
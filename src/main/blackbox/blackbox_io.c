@@ -86,58 +86,67 @@ void blackboxOpen(void)
 }
 #endif // UNIT_TEST
 
-void blackboxWrite(uint8_t value)
+/*
+ * The encoders write the frames of a loop iteration into this buffer a byte at a time, and it is handed to the device
+ * in a single write. That keeps the device dispatch and the driver call out of the per byte path.
+ */
+static uint8_t blackboxStagingBuffer[BLACKBOX_STAGING_BUFFER_SIZE];
+static int blackboxStagingLength;
+
+static void blackboxDeviceWrite(const uint8_t *data, int length)
 {
     switch (blackboxConfig()->device) {
 #ifdef USE_FLASHFS
     case BLACKBOX_DEVICE_FLASH:
-        flashfsWriteByte(value); // Write byte asynchronously
+        flashfsWrite(data, length, false); // Write asynchronously
         break;
 #endif
 #ifdef USE_SDCARD
     case BLACKBOX_DEVICE_SDCARD:
-        afatfs_fputc(blackboxSDCard.logFile, value);
+        afatfs_fwrite(blackboxSDCard.logFile, data, length); // Ignore failures due to buffers filling up
         break;
 #endif
     case BLACKBOX_DEVICE_SERIAL:
     default:
-        serialWrite(blackboxPort, value);
+        // Never block waiting for the port, the bytes that don't fit would have overrun the Tx buffer anyway
+        serialWriteBuf(blackboxPort, data, MIN(length, (int)serialTxBytesFree(blackboxPort)));
         break;
     }
 }
 
-// Print the null-terminated string 's' to the blackbox device and return the number of bytes written
-int blackboxPrint(const char *s)
+/**
+ * Hand the bytes written since the last call to the blackbox device.
+ */
+void blackboxDeviceCommit(void)
 {
-    int length;
-    const uint8_t *pos;
-
-    switch (blackboxConfig()->device) {
+    if (blackboxStagingLength > 0) {
+        blackboxDeviceWrite(blackboxStagingBuffer, blackboxStagingLength);
+        blackboxStagingLength = 0;
+    }
+}
 
-#ifdef USE_FLASHFS
-    case BLACKBOX_DEVICE_FLASH:
-        length = strlen(s);
-        flashfsWrite((const uint8_t*) s, length, false); // Write asynchronously
-        break;
-#endif
+void blackboxWrite(uint8_t value)
+{
+    if (blackboxStagingLength >= BLACKBOX_STAGING_BUFFER_SIZE) {
+        blackboxDeviceCommit();
+    }
+    blackboxStagingBuffer[blackboxStagingLength++] = value;
+}
 
-#ifdef USE_SDCARD
-    case BLACKBOX_DEVICE_SDCARD:
-        length = strlen(s);
-        afatfs_fwrite(blackboxSDCard.logFile, (const uint8_t*) s, length); // Ignore failures due to buffers filling up
-        break;
-#endif
+// Print the null-terminated string 's' to the blackbox device and return the number of bytes written
+int blackboxPrint(const char *s)
+{
+    const int length = strlen(s);
 
-    case BLACKBOX_DEVICE_SERIAL:
-    default:
-        pos = (uint8_t*) s;
-        while (*pos) {
-            serialWrite(blackboxPort, *pos);
-            pos++;
-        }
+    if (length > BLACKBOX_STAGING_BUFFER_SIZE - blackboxStagingLength) {
+        blackboxDeviceCommit();
+    }
 
-        length = pos - (uint8_t*) s;
-        break;
+    if (length > BLACKBOX_STAGING_BUFFER_SIZE) {
+        blackboxDeviceWrite((const uint8_t *)s, length);
+    } else {
+        memcpy(blackboxStagingBuffer + blackboxStagingLength, s, length);
+        blackboxStagingLength += length;
     }
 
     return length;
@@ -150,6 +159,8 @@ int blackboxPrint(const char *s)
  */
 void blackboxDeviceFlush(void)
 {
+    blackboxDeviceCommit();
+
     switch (blackboxConfig()->device) {
 #ifdef USE_FLASHFS
         /*
@@ -157,7 +168,7 @@ void blackboxDeviceFlush(void)
          * devices will progressively write in the background without Blackbox calling anything.
          */
     case BLACKBOX_DEVICE_FLASH:
-        flashfsFlushAsync();
+        flashfsFlushPageAsync();
         break;
 #endif
 
@@ -173,6 +184,8 @@ void blackboxDeviceFlush(void)
  */
 bool blackboxDeviceFlushForce(void)
 {
+    blackboxDeviceCommit();
+
     switch (blackboxConfig()->device) {
     case BLACKBOX_DEVICE_SERIAL:
         // Nothing to speed up flushing on serial, as serial is continuously being drained out of its buffer
@@ -202,6 +215,8 @@ bool blackboxDeviceFlushForce(void)
 #ifndef UNIT_TEST
 bool blackboxDeviceOpen(void)
 {
+    blackboxStagingLength = 0;
+
     switch (blackboxConfig()->device) {
     case BLACKBOX_DEVICE_SERIAL:
         {
@@ -278,6 +293,8 @@ bool blackboxDeviceOpen(void)
 #ifndef UNIT_TEST
 void blackboxDeviceClose(void)
 {
+    blackboxStagingLength = 0;
+
     switch (blackboxConfig()->device) {
     case BLACKBOX_DEVICE_SERIAL:
         // Since the serial port could be shared with other processes, we have to give it back here
@@ -351,7 +368,7 @@ static void blackboxCreateLogFile(void)
 
     blackboxSDCard.state = BLACKBOX_SDCARD_WAITING;
 
-    afatfs_fopen(filename, "as", blackboxLogFileCreated);
+    afatfs_fopen(filename, "al", blackboxLogFileCreated);
 }
 
 /**
@@ -459,6 +476,8 @@ bool blackboxDeviceEndLog(bool retainLog)
     (void) retainLog;
 #endif
 
+    blackboxDeviceCommit();
+
     switch (blackboxConfig()->device) {
 #ifdef USE_SDCARD
     case BLACKBOX_DEVICE_SDCARD:
@@ -53,10 +53,19 @@ typedef enum {
  */
 #define BLACKBOX_TARGET_HEADER_BUDGET_PER_ITERATION 64
 
+/*
+ * Bytes written with blackboxWrite() are staged and handed to the device in one write per loop iteration. The buffer
+ * should hold a full iteration (I, S, G and H frames plus events), larger iterations are split into several writes.
+ */
+#ifndef BLACKBOX_STAGING_BUFFER_SIZE
+#define BLACKBOX_STAGING_BUFFER_SIZE 256
+#endif
+
 extern int32_t blackboxHeaderBudget;
 
 void blackboxOpen(void);
 void blackboxWrite(uint8_t value);
+void blackboxDeviceCommit(void);
 
 void blackboxDeviceFlush(void);
 bool blackboxDeviceFlushForce(void);
@@ -20,11 +20,14 @@
 // only set_BASEPRI is implemented in device library. It does always create memory barrier
 // missing versions are implemented here
 
-#ifdef UNIT_TEST
+#if defined(UNIT_TEST)
 static inline void __set_BASEPRI(uint32_t basePri) {(void)basePri;}
 static inline void __set_BASEPRI_MAX(uint32_t basePri) {(void)basePri;}
 static inline void __set_BASEPRI_nb(uint32_t basePri) {(void)basePri;}
 static inline void __set_BASEPRI_MAX_nb(uint32_t basePri) {(void)basePri;}
+#elif defined(SIMULATOR_BUILD)
+static inline void __set_BASEPRI_nb(uint32_t basePri) {(void)basePri;}
+static inline void __set_BASEPRI_MAX_nb(uint32_t basePri) {(void)basePri;}
 #else
 // set BASEPRI and BASEPRI_MAX register, but do not create memory barrier
 __attribute__( ( always_inline ) ) static inline void __set_BASEPRI_nb(uint32_t basePri)
@@ -66,7 +69,7 @@ static inline uint8_t __basepriSetRetVal(uint8_t prio)
 
 // Run block with elevated BASEPRI (using BASEPRI_MAX), restoring BASEPRI on exit. All exit paths are handled
 // Full memory barrier is placed at start and exit of block
-#ifdef UNIT_TEST
+#if defined(UNIT_TEST) || defined(SIMULATOR_BUILD)
 #define ATOMIC_BLOCK(prio) {}
 #define ATOMIC_BLOCK_NB(prio) {}
 #else
@@ -82,7 +85,7 @@ static inline uint8_t __basepriSetRetVal(uint8_t prio)
 #define ATOMIC_BLOCK_NB(prio) for ( uint8_t __basepri_save __attribute__((__cleanup__(__basepriRestore))) = __get_BASEPRI(), \
                                     __ToDo = __basepriSetRetVal(prio); __ToDo ; __ToDo = 0 ) \
 
-#endif // UNIT_TEST
+#endif // UNIT_TEST || SIMULATOR_BUILD
 
 // ATOMIC_BARRIER
 // Create memory barrier
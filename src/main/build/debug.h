@@ -59,6 +59,7 @@ typedef enum {
     DEBUG_FLOW_RAW,
     DEBUG_SBUS,
     DEBUG_FPORT,
+    DEBUG_FFT,
     DEBUG_ALWAYS,
     DEBUG_COUNT
 } debugType_e;
@@ -62,15 +62,25 @@ float pt1FilterApply3(pt1Filter_t *filter, float input, float dT)
     return filter->state;
 }
 
+// Gain of a PT1 filter, dT / (RC + dT) without computing RC
+float pt1FilterGain(uint16_t f_cut, float dT)
+{
+    const float omega = 2.0f * M_PIf * f_cut * dT;
+    return omega / (omega + 1.0f);
+}
+
 float pt1FilterApply4(pt1Filter_t *filter, float input, uint16_t f_cut, float dT)
 {
-    // Pre calculate and store RC
-    if (!filter->RC) {
-        filter->RC = 1.0f / ( 2.0f * M_PIf * f_cut );
+    // Only the cutoff is cached, dT is measured by most callers and changes on nearly every call
+    if (f_cut != filter->f_cut) {
+        filter->omega = 2.0f * M_PIf * f_cut;
+        filter->f_cut = f_cut;
     }
 
-    filter->dT = dT;    // cache latest dT for possible use in pt1FilterApply
-    filter->state = filter->state + dT / (filter->RC + dT) * (input - filter->state);
+    // dT / (RC + dT) without the divide for RC
+    const float omegaDt = filter->omega * dT;
+    filter->dT = dT;
+    filter->state = filter->state + omegaDt / (omegaDt + 1.0f) * (input - filter->state);
     return filter->state;
 }
 
@@ -117,6 +127,56 @@ void biquadFilterInitLPF(biquadFilter_t *filter, uint16_t filterFreq, uint32_t s
 }
 
 void biquadFilterInit(biquadFilter_t *filter, uint16_t filterFreq, uint32_t samplingIntervalUs, float Q, biquadFilterType_e filterType)
+{
+    biquadFilterUpdate(filter, filterFreq, samplingIntervalUs, Q, filterType);
+
+    // zero initial samples
+    filter->d1 = filter->d2 = 0;
+}
+
+// sn, cs = sin and cos of omega, versine = 1 - cos(omega), passed separately to keep its precision at low frequencies
+static void biquadFilterSetCoefficients(biquadFilter_t *filter, float sn, float cs, float versine, float Q, biquadFilterType_e filterType)
+{
+    const float alpha = sn / (2 * Q);
+
+    float b0, b1, b2;
+    switch (filterType) {
+    case FILTER_NOTCH:
+        b0 =  1;
+        b1 = -2 * cs;
+        b2 =  1;
+        break;
+    case FILTER_LPF:
+    default:
+        b0 = versine / 2;
+        b1 = versine;
+        b2 = versine / 2;
+        break;
+    }
+    const float a0 =  1 + alpha;
+    const float a1 = -2 * cs;
+    const float a2 =  1 - alpha;
+
+    // precompute the coefficients
+    const float a0Inv = 1.0f / a0;
+    filter->b0 = b0 * a0Inv;
+    filter->b1 = b1 * a0Inv;
+    filter->b2 = b2 * a0Inv;
+    filter->a1 = a1 * a0Inv;
+    filter->a2 = a2 * a0Inv;
+}
+
+static void biquadFilterSetPassthrough(biquadFilter_t *filter)
+{
+    filter->b0 = 1.0f;
+    filter->b1 = 0.0f;
+    filter->b2 = 0.0f;
+    filter->a1 = 0.0f;
+    filter->a2 = 0.0f;
+}
+
+// Recomputes the coefficients and keeps the filter state, for retuning a running filter
+void biquadFilterUpdate(biquadFilter_t *filter, uint16_t filterFreq, uint32_t samplingIntervalUs, float Q, biquadFilterType_e filterType)
 {
     // Check for Nyquist frequency and if it's not possible to initialize filter as requested - set to no filtering at all
     if (filterFreq < (1000000 / samplingIntervalUs / 2)) {
@@ -125,43 +185,50 @@ void biquadFilterInit(biquadFilter_t *filter, uint16_t filterFreq, uint32_t samp
         const float omega = 2.0f * M_PIf * ((float)filterFreq) / sampleRate;
         const float sn = sin_approx(omega);
         const float cs = cos_approx(omega);
-        const float alpha = sn / (2 * Q);
-
-        float b0, b1, b2;
-        switch (filterType) {
-        case FILTER_LPF:
-            b0 = (1 - cs) / 2;
-            b1 = 1 - cs;
-            b2 = (1 - cs) / 2;
-            break;
-        case FILTER_NOTCH:
-            b0 =  1;
-            b1 = -2 * cs;
-            b2 =  1;
-            break;
-        }
-        const float a0 =  1 + alpha;
-        const float a1 = -2 * cs;
-        const float a2 =  1 - alpha;
-
-        // precompute the coefficients
-        filter->b0 = b0 / a0;
-        filter->b1 = b1 / a0;
-        filter->b2 = b2 / a0;
-        filter->a1 = a1 / a0;
-        filter->a2 = a2 / a0;
+
+        biquadFilterSetCoefficients(filter, sn, cs, 1 - cs, Q, filterType);
     }
     else {
         // Not possible to filter frequencies above Nyquist frequency - passthrough
-        filter->b0 = 1.0f;
-        filter->b1 = 0.0f;
-        filter->b2 = 0.0f;
-        filter->a1 = 0.0f;
-        filter->a2 = 0.0f;
+        biquadFilterSetPassthrough(filter);
     }
+}
 
-    // zero initial samples
-    filter->d1 = filter->d2 = 0;
+/*
+ * Coefficient table for retuning filters every loop. It holds sin and cos
+ * of omega / 2 over 0 .. Nyquist, where both are smooth enough for linear
+ * interpolation. The full angle values follow from the double angle
+ * formulas, 1 - cos(omega) = 2 * sin^2(omega / 2) stays accurate for the
+ * low cutoffs where 1 - cos(omega) itself would be lost in rounding.
+ */
+void filterCoeffTableInit(filterCoeffTable_t *table, uint32_t samplingIntervalUs)
+{
+    table->samplingIntervalUs = samplingIntervalUs;
+    // Nyquist frequency maps to the last entry
+    table->freqToIndex = (FILTER_COEFF_TABLE_SIZE - 1) * 2.0f * samplingIntervalUs * 1e-6f;
+
+    for (int i = 0; i < FILTER_COEFF_TABLE_SIZE; i++) {
+        const float halfOmega = (M_PIf / 2) * i / (FILTER_COEFF_TABLE_SIZE - 1);
+        table->halfSin[i] = sinf(halfOmega);
+        table->halfCos[i] = cosf(halfOmega);
+    }
+}
+
+void biquadFilterUpdateFromTable(biquadFilter_t *filter, const filterCoeffTable_t *table, float filterFreq, float Q, biquadFilterType_e filterType)
+{
+    const float position = filterFreq * table->freqToIndex;
+    if (position < 0 || position >= FILTER_COEFF_TABLE_SIZE - 1) {
+        biquadFilterSetPassthrough(filter);
+        return;
+    }
+
+    const int index = (int)position;
+    const float fraction = position - index;
+    const float halfSin = table->halfSin[index] + fraction * (table->halfSin[index + 1] - table->halfSin[index]);
+    const float halfCos = table->halfCos[index] + fraction * (table->halfCos[index + 1] - table->halfCos[index]);
+
+    const float versine = 2 * halfSin * halfSin;
+    biquadFilterSetCoefficients(filter, 2 * halfSin * halfCos, 1 - versine, versine, Q, filterType);
 }
 
 // Computes a biquad_t filter on a sample
@@ -173,6 +240,59 @@ float biquadFilterApply(biquadFilter_t *filter, float input)
     return result;
 }
 
+void biquadCascadeXYZInit(biquadCascadeXYZ_t *cascade)
+{
+    memset(cascade, 0, sizeof(*cascade));
+}
+
+// Appends a stage with the coefficients of filter, returns false when the cascade is full
+bool biquadCascadeXYZAddStage(biquadCascadeXYZ_t *cascade, const biquadFilter_t *filter)
+{
+    if (cascade->stageCount >= BIQUAD_CASCADE_MAX_STAGES) {
+        return false;
+    }
+
+    float *coeffs = &cascade->coeffs[cascade->stageCount * 5];
+    coeffs[0] = filter->b0;
+    coeffs[1] = filter->b1;
+    coeffs[2] = filter->b2;
+    coeffs[3] = -filter->a1;
+    coeffs[4] = -filter->a2;
+    cascade->stageCount++;
+
+    memset(cascade->state, 0, sizeof(cascade->state));
+
+    return true;
+}
+
+void biquadCascadeXYZApply(biquadCascadeXYZ_t *cascade, float values[XYZ_AXIS_COUNT])
+{
+    // Stage by stage with the axes innermost, the coefficients stay in
+    // registers while the same arithmetic runs over the three axes
+    for (int stage = 0; stage < cascade->stageCount; stage++) {
+        const float *coeffs = &cascade->coeffs[stage * 5];
+        float *x1 = cascade->state[stage][0];
+        float *x2 = cascade->state[stage][1];
+        float *y1 = cascade->state[stage][2];
+        float *y2 = cascade->state[stage][3];
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            const float input = values[axis];
+            const float result = coeffs[0] * input + coeffs[1] * x1[axis] + coeffs[2] * x2[axis] + coeffs[3] * y1[axis] + coeffs[4] * y2[axis];
+            x2[axis] = x1[axis];
+            x1[axis] = input;
+            y2[axis] = y1[axis];
+            y1[axis] = result;
+            values[axis] = result;
+        }
+    }
+}
+
+// Latest output of a single stage, taken from its state
+float biquadCascadeXYZStageOutput(const biquadCascadeXYZ_t *cascade, int stage, int axis)
+{
+    return cascade->state[stage][2][axis];
+}
+
 /*
  * FIR filter
  */
@@ -17,6 +17,11 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common/axis.h"
+
 typedef struct rateLimitFilter_s {
     float state;
 } rateLimitFilter_t;
@@ -25,6 +30,8 @@ typedef struct pt1Filter_s {
     float state;
     float RC;
     float dT;
+    float omega;        // 2 * PI * f_cut, cached by pt1FilterApply4()
+    uint16_t f_cut;
 } pt1Filter_t;
 
 /* this holds the data required to update samples thru a filter */
@@ -33,6 +40,29 @@ typedef struct biquadFilter_s {
     float d1, d2;
 } biquadFilter_t;
 
+/*
+ * Chain of biquads run over the three axes in one call. The stages share
+ * their coefficients between axes, each axis keeps its own direct form I
+ * state. The state is stored axis innermost, so each stage is a loop over
+ * three contiguous floats the compiler can unroll or vectorize.
+ */
+#define BIQUAD_CASCADE_MAX_STAGES   3
+
+typedef struct biquadCascadeXYZ_s {
+    uint8_t stageCount;
+    float coeffs[BIQUAD_CASCADE_MAX_STAGES * 5];                    // b0, b1, b2, -a1, -a2 per stage
+    float state[BIQUAD_CASCADE_MAX_STAGES][4][XYZ_AXIS_COUNT];      // x[n-1], x[n-2], y[n-1], y[n-2] per stage
+} biquadCascadeXYZ_t;
+
+#define FILTER_COEFF_TABLE_SIZE     129
+
+typedef struct filterCoeffTable_s {
+    uint32_t samplingIntervalUs;
+    float freqToIndex;
+    float halfSin[FILTER_COEFF_TABLE_SIZE];     // sin(omega / 2), 0 .. Nyquist
+    float halfCos[FILTER_COEFF_TABLE_SIZE];     // cos(omega / 2), 0 .. Nyquist
+} filterCoeffTable_t;
+
 typedef enum {
     FILTER_PT1 = 0,
     FILTER_BIQUAD,
@@ -60,6 +90,7 @@ void pt1FilterInitRC(pt1Filter_t *filter, float tau, float dT);
 float pt1FilterApply(pt1Filter_t *filter, float input);
 float pt1FilterApply3(pt1Filter_t *filter, float input, float dT);
 float pt1FilterApply4(pt1Filter_t *filter, float input, uint16_t f_cut, float dt);
+float pt1FilterGain(uint16_t f_cut, float dT);
 void pt1FilterReset(pt1Filter_t *filter, float input);
 
 void rateLimitFilterInit(rateLimitFilter_t *filter);
@@ -68,9 +99,18 @@ float rateLimitFilterApply4(rateLimitFilter_t *filter, float input, float rate_l
 void biquadFilterInitNotch(biquadFilter_t *filter, uint32_t samplingIntervalUs, uint16_t filterFreq, uint16_t cutoffHz);
 void biquadFilterInitLPF(biquadFilter_t *filter, uint16_t filterFreq, uint32_t samplingIntervalUs);
 void biquadFilterInit(biquadFilter_t *filter, uint16_t filterFreq, uint32_t samplingIntervalUs, float Q, biquadFilterType_e filterType);
+void biquadFilterUpdate(biquadFilter_t *filter, uint16_t filterFreq, uint32_t samplingIntervalUs, float Q, biquadFilterType_e filterType);
 float biquadFilterApply(biquadFilter_t *filter, float sample);
 float filterGetNotchQ(uint16_t centerFreq, uint16_t cutoff);
 
+void filterCoeffTableInit(filterCoeffTable_t *table, uint32_t samplingIntervalUs);
+void biquadFilterUpdateFromTable(biquadFilter_t *filter, const filterCoeffTable_t *table, float filterFreq, float Q, biquadFilterType_e filterType);
+
+void biquadCascadeXYZInit(biquadCascadeXYZ_t *cascade);
+bool biquadCascadeXYZAddStage(biquadCascadeXYZ_t *cascade, const biquadFilter_t *filter);
+void biquadCascadeXYZApply(biquadCascadeXYZ_t *cascade, float values[XYZ_AXIS_COUNT]);
+float biquadCascadeXYZStageOutput(const biquadCascadeXYZ_t *cascade, int stage, int axis);
+
 void firFilterInit(firFilter_t *filter, float *buf, uint8_t bufLength, const float *coeffs);
 void firFilterInit2(firFilter_t *filter, float *buf, uint8_t bufLength, const float *coeffs, uint8_t coeffsLength);
 void firFilterUpdate(firFilter_t *filter, float input);
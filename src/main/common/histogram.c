@@ -0,0 +1,97 @@
+/*
+ * This file is part of INAV.
+ *
+ * INAV is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * INAV is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with INAV.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common/histogram.h"
+
+static int histogramBinForValue(uint32_t value)
+{
+    if (value < 4) {
+        return value;
+    }
+
+    const int msb = 31 - __builtin_clz(value);
+    const int bin = 2 * msb + ((value >> (msb - 1)) & 1);
+    return (bin < HISTOGRAM_BIN_COUNT) ? bin : HISTOGRAM_BIN_COUNT - 1;
+}
+
+uint32_t histogramBinLowerBound(int bin)
+{
+    if (bin < 4) {
+        return bin;
+    }
+    return (uint32_t)(2 + (bin & 1)) << (bin / 2 - 1);
+}
+
+uint32_t histogramBinUpperBound(int bin)
+{
+    if (bin >= HISTOGRAM_BIN_COUNT - 1) {
+        // Open ended, report where it starts
+        return histogramBinLowerBound(HISTOGRAM_BIN_COUNT - 1);
+    }
+    return histogramBinLowerBound(bin + 1) - 1;
+}
+
+void histogramReset(histogram_t *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+void histogramAdd(histogram_t *histogram, uint32_t value)
+{
+    const int bin = histogramBinForValue(value);
+
+    if (histogram->bins[bin] == UINT16_MAX) {
+        for (int i = 0; i < HISTOGRAM_BIN_COUNT; i++) {
+            histogram->bins[i] /= 2;
+        }
+    }
+
+    histogram->bins[bin]++;
+}
+
+uint32_t histogramSampleCount(const histogram_t *histogram)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < HISTOGRAM_BIN_COUNT; i++) {
+        count += histogram->bins[i];
+    }
+    return count;
+}
+
+uint32_t histogramPercentile(const histogram_t *histogram, uint16_t permille)
+{
+    const uint32_t count = histogramSampleCount(histogram);
+    if (count == 0) {
+        return 0;
+    }
+
+    // Rank of the sample we are looking for, rounded up. Can't overflow,
+    // count is at most HISTOGRAM_BIN_COUNT * UINT16_MAX.
+    const uint32_t rank = (count * permille + 999) / 1000;
+    uint32_t seen = 0;
+    int i;
+    for (i = 0; i < HISTOGRAM_BIN_COUNT - 1; i++) {
+        seen += histogram->bins[i];
+        if (seen >= rank && seen > 0) {
+            break;
+        }
+    }
+    return histogramBinUpperBound(i);
+}
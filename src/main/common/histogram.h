@@ -0,0 +1,47 @@
+/*
+ * This file is part of INAV.
+ *
+ * INAV is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * INAV is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with INAV.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Log-scale histogram with two bins per power of two. Values 0..3 have a
+ * bin of their own, above that the resolution is 25-50% of the value.
+ * The last bin collects everything from 49152 up. When a bin saturates
+ * all the bins are halved, so the histogram slowly forgets old samples
+ * while keeping their distribution.
+ */
+
+#define HISTOGRAM_BIN_COUNT     32
+
+typedef struct histogram_s {
+    uint16_t bins[HISTOGRAM_BIN_COUNT];
+} histogram_t;
+
+void histogramReset(histogram_t *histogram);
+void histogramAdd(histogram_t *histogram, uint32_t value);
+uint32_t histogramSampleCount(const histogram_t *histogram);
+
+// Smallest and largest value that land in a bin. The last bin is open
+// ended, its upper bound is reported as its lower bound.
+uint32_t histogramBinLowerBound(int bin);
+uint32_t histogramBinUpperBound(int bin);
+
+// Upper bound of the bin holding the given percentile, in 1/1000ths
+// (500 = median, 990 = p99, 999 = p99.9). 0 for an empty histogram.
+uint32_t histogramPercentile(const histogram_t *histogram, uint16_t permille);
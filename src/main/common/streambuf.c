@@ -29,7 +29,10 @@ sbuf_t *sbufInit(sbuf_t *sbuf, uint8_t *ptr, uint8_t *end)
 
 void sbufWriteU8(sbuf_t *dst, uint8_t val)
 {
-    *dst->ptr++ = val;
+    if (dst->ptr < dst->end) {
+        *dst->ptr = val;
+    }
+    dst->ptr++;
 }
 
 void sbufWriteU16(sbuf_t *dst, uint16_t val)
@@ -60,15 +63,21 @@ void sbufWriteU32BigEndian(sbuf_t *dst, uint32_t val)
     sbufWriteU8(dst, val >> 0);
 }
 
+static int sbufBytesWritable(const sbuf_t *dst, int len)
+{
+    const int remaining = sbufBytesRemaining(dst);
+    return remaining < 0 ? 0 : (len > remaining ? remaining : len);
+}
+
 void sbufFill(sbuf_t *dst, uint8_t data, int len)
 {
-    memset(dst->ptr, data, len);
+    memset(dst->ptr, data, sbufBytesWritable(dst, len));
     dst->ptr += len;
 }
 
 void sbufWriteData(sbuf_t *dst, const void *data, int len)
 {
-    memcpy(dst->ptr, data, len);
+    memcpy(dst->ptr, data, sbufBytesWritable(dst, len));
     dst->ptr += len;
 }
 
@@ -22,6 +22,8 @@
 
 // simple buffer-based serializer/deserializer without implicit size check
 // little-endian encoding implemneted now
+// writes past the end of the buffer are dropped, but still advance ptr, so
+// an overflowing writer is detected by sbufBytesRemaining() < 0
 
 typedef struct sbuf_s {
     uint8_t *ptr;          // data pointer must be first (sbuff_t* is equivalent to uint8_t **)
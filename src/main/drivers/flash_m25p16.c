@@ -61,7 +61,6 @@
 #define DEFAULT_TIMEOUT_MILLIS       6
 
 // These take sooooo long:
-#define SECTOR_ERASE_TIMEOUT_MILLIS  5000
 #define BULK_ERASE_TIMEOUT_MILLIS    21000
 
 static flashGeometry_t geometry = {.pageSize = M25P16_PAGESIZE};
@@ -251,7 +250,7 @@ void m25p16_eraseSector(uint32_t address)
 
     m25p16_setCommandAddress(&out[1], address, isLargeFlash);
 
-    m25p16_waitForReady(SECTOR_ERASE_TIMEOUT_MILLIS);
+    m25p16_waitForReady(M25P16_SECTOR_ERASE_TIMEOUT_MILLIS);
 
     m25p16_writeEnable();
 
@@ -279,27 +278,57 @@ void m25p16_eraseCompletely(void)
  * Datasheet indicates typical programming time is 0.8ms for 256 bytes, 0.2ms for 64 bytes, 0.05ms for 16 bytes.
  * (Although the maximum possible write time is noted as 5ms).
  *
- * If you want to write multiple buffers (whose sum of sizes is still not more than the page size) then you can
- * break this operation up into one beginProgram call, one or more continueProgram calls, and one finishProgram call.
+ * If you want to write multiple buffers (whose sum of sizes is still not more than the page size) then use
+ * m25p16_pageProgramBuffers() so that they are all programmed in a single operation.
  */
 uint32_t m25p16_pageProgram(uint32_t address, const uint8_t *data, int length)
 {
-    uint8_t command[5] = { M25P16_INSTRUCTION_PAGE_PROGRAM };
+    const uint32_t size = length;
 
-    busTransferDescriptor_t txn[2] = {
-        { NULL, command, isLargeFlash ? 5 : 4 },
-        { NULL, data, length }
-    };
+    return m25p16_pageProgramBuffers(address, &data, &size, 1);
+}
+
+/**
+ * Write several buffers back to back into one flash page with a single program operation. The sum of the buffer
+ * sizes must not cross a page boundary, and at most M25P16_MAX_PROGRAM_BUFFERS buffers may be supplied.
+ *
+ * The whole page is clocked out in one chip-select cycle, so a page split over a wrapped circular buffer doesn't
+ * have to wait for the first part to finish programming before the second part can be sent. The call returns as
+ * soon as the data has been sent, use m25p16_isReady() to find out when the chip has finished programming it.
+ *
+ * Returns the flash address just past the written data.
+ */
+uint32_t m25p16_pageProgramBuffers(uint32_t address, const uint8_t **buffers, const uint32_t *bufferSizes, int bufferCount)
+{
+    uint8_t command[5] = { M25P16_INSTRUCTION_PAGE_PROGRAM };
+    busTransferDescriptor_t txn[1 + M25P16_MAX_PROGRAM_BUFFERS];
+    int txnCount = 0;
 
     m25p16_setCommandAddress(&command[1], address, isLargeFlash);
 
+    txn[txnCount].rxBuf = NULL;
+    txn[txnCount].txBuf = command;
+    txn[txnCount].length = isLargeFlash ? 5 : 4;
+    txnCount++;
+
+    for (int i = 0; i < bufferCount && i < M25P16_MAX_PROGRAM_BUFFERS; i++) {
+        if (bufferSizes[i] > 0) {
+            txn[txnCount].rxBuf = NULL;
+            txn[txnCount].txBuf = buffers[i];
+            txn[txnCount].length = bufferSizes[i];
+            txnCount++;
+
+            address += bufferSizes[i];
+        }
+    }
+
     m25p16_waitForReady(DEFAULT_TIMEOUT_MILLIS);
 
     m25p16_writeEnable();
 
-    busTransferMultiple(busDev, txn, 2);
+    busTransferMultiple(busDev, txn, txnCount);
 
-    return address + length;
+    return address;
 }
 
 /**
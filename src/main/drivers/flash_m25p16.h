@@ -23,12 +23,19 @@
 
 #define M25P16_PAGESIZE 256
 
+// Longest a sector erase can keep the chip busy
+#define M25P16_SECTOR_ERASE_TIMEOUT_MILLIS 5000
+
+// Most buffers that can be gathered into a single page program operation
+#define M25P16_MAX_PROGRAM_BUFFERS 3
+
 bool m25p16_init(int flashNumToUse);
 
 void m25p16_eraseSector(uint32_t address);
 void m25p16_eraseCompletely(void);
 
 uint32_t m25p16_pageProgram(uint32_t address, const uint8_t *data, int length);
+uint32_t m25p16_pageProgramBuffers(uint32_t address, const uint8_t **buffers, const uint32_t *bufferSizes, int bufferCount);
 
 int m25p16_readBytes(uint32_t address, uint8_t *buffer, int length);
 
@@ -116,7 +116,7 @@ typedef struct
     GPIO_Speed speed;
 } gpio_config_t;
 
-#ifndef UNIT_TEST
+#if !defined(UNIT_TEST) && !defined(SIMULATOR_BUILD)
 #if defined(USE_HAL_DRIVER)
 static inline void digitalHi(GPIO_TypeDef *p, uint16_t i) { HAL_GPIO_WritePin(p,i,GPIO_PIN_SET); }
 static inline void digitalLo(GPIO_TypeDef *p, uint16_t i) { HAL_GPIO_WritePin(p,i,GPIO_PIN_RESET); }
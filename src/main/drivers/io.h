@@ -79,7 +79,7 @@
 #define IOCFG_IN_FLOATING    IO_CONFIG(GPIO_Mode_IN,  0, 0,             GPIO_PuPd_NOPULL)
 #define IOCFG_IPU_25         IO_CONFIG(GPIO_Mode_IN,  GPIO_Speed_25MHz, 0, GPIO_PuPd_UP)
 
-#elif defined(UNIT_TEST)
+#elif defined(UNIT_TEST) || defined(SIMULATOR_BUILD)
 
 # define IOCFG_OUT_PP         0
 # define IOCFG_OUT_OD         0
@@ -88,6 +88,10 @@
 # define IOCFG_IPD            0
 # define IOCFG_IPU            0
 # define IOCFG_IN_FLOATING    0
+# define IOCFG_OUT_PP_25      0
+# define IOCFG_AF_PP_PD       0
+# define IOCFG_AF_PP_UP       0
+# define IOCFG_IPU_25         0
 
 #else
 # warning "Unknown TARGET"
@@ -103,6 +103,40 @@ void serialEndWrite(serialPort_t *instance)
         instance->vTable->endWrite(instance);
 }
 
+/*
+ * Points buf to the free space after the head of the TX buffer and returns how many bytes can be written there
+ * without wrapping around, or 0 if the port can't be written directly. Nothing is sent until
+ * serialCommitDirectWrite() is called, so the space can also be abandoned.
+ */
+uint32_t serialGetDirectWriteBuffer(serialPort_t *instance, uint8_t **buf)
+{
+    if (!instance->vTable->commitDirectWrite) {
+        return 0;
+    }
+
+    const uint32_t head = instance->txBufferHead;
+    const uint32_t tail = instance->txBufferTail;
+    uint32_t contiguous;
+
+    if (tail > head) {
+        contiguous = tail - head - 1;
+    } else {
+        // Leave the last byte empty if the buffer wraps to a tail at 0, head == tail means empty
+        contiguous = instance->txBufferSize - head - (tail == 0 ? 1 : 0);
+    }
+
+    // The free space might be smaller, e.g. while a DMA transfer still reads from behind the tail
+    const uint32_t bytesFree = serialTxBytesFree(instance);
+
+    *buf = (uint8_t *)&instance->txBuffer[head];
+    return contiguous < bytesFree ? contiguous : bytesFree;
+}
+
+void serialCommitDirectWrite(serialPort_t *instance, uint32_t count)
+{
+    instance->vTable->commitDirectWrite(instance, count);
+}
+
 bool serialIsConnected(const serialPort_t *instance)
 {
     if (instance->vTable->isConnected)
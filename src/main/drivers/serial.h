@@ -91,6 +91,9 @@ struct serialPortVTable {
     // Optional functions used to buffer large writes.
     void (*beginWrite)(serialPort_t *instance);
     void (*endWrite)(serialPort_t *instance);
+
+    // Optional, sends count bytes written directly after txBufferHead. See serialGetDirectWriteBuffer().
+    void (*commitDirectWrite)(serialPort_t *instance, uint32_t count);
 };
 
 void serialWrite(serialPort_t *instance, uint8_t ch);
@@ -109,3 +112,6 @@ bool serialIsConnected(const serialPort_t *instance);
 void serialWriteBufShim(void *instance, const uint8_t *data, int count);
 void serialBeginWrite(serialPort_t *instance);
 void serialEndWrite(serialPort_t *instance);
+
+uint32_t serialGetDirectWriteBuffer(serialPort_t *instance, uint8_t **buf);
+void serialCommitDirectWrite(serialPort_t *instance, uint32_t count);
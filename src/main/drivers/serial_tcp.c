@@ -0,0 +1,301 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "platform.h"
+
+#if defined(SIMULATOR_BUILD)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "common/maths.h"
+#include "common/utils.h"
+
+#include "drivers/serial.h"
+#include "drivers/serial_tcp.h"
+
+#define SERIAL_TCP_BUFFER_MASK  (SERIAL_TCP_BUFFER_SIZE - 1)
+
+static tcpPort_t tcpSerialPorts[SERIAL_PORT_COUNT];
+static const struct serialPortVTable tcpVTable[];
+
+static bool tcpSetNonBlocking(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static bool tcpListen(tcpPort_t *s)
+{
+    s->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (s->listenFd < 0) {
+        return false;
+    }
+
+    const int one = 1;
+    setsockopt(s->listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(s->tcpPort);
+
+    if (bind(s->listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(s->listenFd, 1) < 0 || !tcpSetNonBlocking(s->listenFd)) {
+        fprintf(stderr, "[SITL] UART%d: unable to listen on TCP port %u: %s\n", s->port.identifier + 1, s->tcpPort, strerror(errno));
+        close(s->listenFd);
+        s->listenFd = -1;
+        return false;
+    }
+
+    fprintf(stderr, "[SITL] UART%d bound to TCP port %u\n", s->port.identifier + 1, s->tcpPort);
+    return true;
+}
+
+static void tcpDisconnect(tcpPort_t *s)
+{
+    close(s->clientFd);
+    s->clientFd = -1;
+    s->port.txBufferTail = s->port.txBufferHead;
+}
+
+static void tcpAccept(tcpPort_t *s)
+{
+    const int fd = accept(s->listenFd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+
+    if (s->clientFd >= 0) {
+        // Only one client per port, same as a physical UART
+        close(fd);
+        return;
+    }
+
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    tcpSetNonBlocking(fd);
+    s->clientFd = fd;
+}
+
+static void tcpReceive(tcpPort_t *s)
+{
+    uint8_t buf[256];
+
+    while (true) {
+        const uint32_t used = (s->port.rxBufferHead - s->port.rxBufferTail) & SERIAL_TCP_BUFFER_MASK;
+        const uint32_t space = SERIAL_TCP_BUFFER_SIZE - 1 - used;
+        if (space == 0) {
+            return;
+        }
+
+        const ssize_t count = recv(s->clientFd, buf, MIN(space, sizeof(buf)), 0);
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            tcpDisconnect(s);
+            return;
+        }
+        if (count < 0) {
+            return;
+        }
+
+        for (ssize_t i = 0; i < count; i++) {
+            if (s->port.rxCallback) {
+                // Mimic the UART RX interrupt path, data is not buffered
+                s->port.rxCallback(buf[i], s->port.rxCallbackData);
+            } else {
+                s->port.rxBuffer[s->port.rxBufferHead] = buf[i];
+                s->port.rxBufferHead = (s->port.rxBufferHead + 1) & SERIAL_TCP_BUFFER_MASK;
+            }
+        }
+    }
+}
+
+static void tcpTransmit(tcpPort_t *s)
+{
+    while (s->port.txBufferTail != s->port.txBufferHead) {
+        const uint32_t chunk = (s->port.txBufferHead > s->port.txBufferTail) ?
+            s->port.txBufferHead - s->port.txBufferTail :
+            SERIAL_TCP_BUFFER_SIZE - s->port.txBufferTail;
+
+        const ssize_t count = send(s->clientFd, (const void *)&s->port.txBuffer[s->port.txBufferTail], chunk, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                tcpDisconnect(s);
+            }
+            return;
+        }
+
+        s->port.txBufferTail = (s->port.txBufferTail + count) & SERIAL_TCP_BUFFER_MASK;
+    }
+}
+
+static void tcpPollPort(tcpPort_t *s)
+{
+    if (s->listenFd < 0) {
+        return;
+    }
+
+    tcpAccept(s);
+
+    if (s->clientFd >= 0) {
+        tcpReceive(s);
+    }
+
+    if (s->clientFd >= 0) {
+        tcpTransmit(s);
+    } else {
+        // Nobody is listening, drop output like an unconnected UART would
+        s->port.txBufferTail = s->port.txBufferHead;
+    }
+}
+
+void serTcpPoll(void)
+{
+    for (int i = 0; i < SERIAL_PORT_COUNT; i++) {
+        if (tcpSerialPorts[i].port.vTable) {
+            tcpPollPort(&tcpSerialPorts[i]);
+        }
+    }
+}
+
+serialPort_t *serTcpOpen(int portIndex, serialReceiveCallbackPtr rxCallback, void *rxCallbackData, uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    if (portIndex < 0 || portIndex >= SERIAL_PORT_COUNT) {
+        return NULL;
+    }
+
+    tcpPort_t *s = &tcpSerialPorts[portIndex];
+
+    if (!s->port.vTable) {
+        s->tcpPort = SITL_SERIAL_TCP_BASE_PORT + portIndex;
+        s->clientFd = -1;
+        s->port.identifier = portIndex;
+        if (!tcpListen(s)) {
+            return NULL;
+        }
+    }
+
+    s->port.vTable = tcpVTable;
+
+    s->port.rxBuffer = s->rxBuffer;
+    s->port.txBuffer = s->txBuffer;
+    s->port.rxBufferSize = SERIAL_TCP_BUFFER_SIZE;
+    s->port.txBufferSize = SERIAL_TCP_BUFFER_SIZE;
+    s->port.rxBufferHead = s->port.rxBufferTail = 0;
+    s->port.txBufferHead = s->port.txBufferTail = 0;
+
+    s->port.rxCallback = rxCallback;
+    s->port.rxCallbackData = rxCallbackData;
+    s->port.mode = mode;
+    s->port.options = options;
+    s->port.baudRate = baudRate;
+
+    return &s->port;
+}
+
+static void tcpWrite(serialPort_t *instance, uint8_t ch)
+{
+    instance->txBuffer[instance->txBufferHead] = ch;
+    instance->txBufferHead = (instance->txBufferHead + 1) & SERIAL_TCP_BUFFER_MASK;
+}
+
+static void tcpWriteBuf(serialPort_t *instance, const void *data, int count)
+{
+    const uint8_t *p = data;
+    while (count--) {
+        tcpWrite(instance, *p++);
+    }
+}
+
+static uint32_t tcpTotalRxBytesWaiting(const serialPort_t *instance)
+{
+    return (instance->rxBufferHead - instance->rxBufferTail) & SERIAL_TCP_BUFFER_MASK;
+}
+
+static uint32_t tcpTotalTxBytesFree(const serialPort_t *instance)
+{
+    const uint32_t used = (instance->txBufferHead - instance->txBufferTail) & SERIAL_TCP_BUFFER_MASK;
+    return SERIAL_TCP_BUFFER_SIZE - 1 - used;
+}
+
+static uint8_t tcpRead(serialPort_t *instance)
+{
+    const uint8_t ch = instance->rxBuffer[instance->rxBufferTail];
+    instance->rxBufferTail = (instance->rxBufferTail + 1) & SERIAL_TCP_BUFFER_MASK;
+    return ch;
+}
+
+static void tcpSetBaudRate(serialPort_t *instance, uint32_t baudRate)
+{
+    instance->baudRate = baudRate;
+}
+
+static bool isTcpTransmitBufferEmpty(const serialPort_t *instance)
+{
+    // Callers spin on this while draining, keep the socket moving
+    tcpPollPort((tcpPort_t *)instance);
+    return instance->txBufferHead == instance->txBufferTail;
+}
+
+static void tcpSetMode(serialPort_t *instance, portMode_t mode)
+{
+    instance->mode = mode;
+}
+
+static bool tcpIsConnected(const serialPort_t *instance)
+{
+    return ((const tcpPort_t *)instance)->clientFd >= 0;
+}
+
+static void tcpEndWrite(serialPort_t *instance)
+{
+    tcpPollPort((tcpPort_t *)instance);
+}
+
+static void tcpCommitDirectWrite(serialPort_t *instance, uint32_t count)
+{
+    instance->txBufferHead = (instance->txBufferHead + count) & SERIAL_TCP_BUFFER_MASK;
+    tcpPollPort((tcpPort_t *)instance);
+}
+
+static const struct serialPortVTable tcpVTable[] = {
+    {
+        .serialWrite = tcpWrite,
+        .serialTotalRxWaiting = tcpTotalRxBytesWaiting,
+        .serialTotalTxFree = tcpTotalTxBytesFree,
+        .serialRead = tcpRead,
+        .serialSetBaudRate = tcpSetBaudRate,
+        .isSerialTransmitBufferEmpty = isTcpTransmitBufferEmpty,
+        .setMode = tcpSetMode,
+        .isConnected = tcpIsConnected,
+        .writeBuf = tcpWriteBuf,
+        .beginWrite = NULL,
+        .endWrite = tcpEndWrite,
+        .commitDirectWrite = tcpCommitDirectWrite,
+    }
+};
+
+#endif // SIMULATOR_BUILD
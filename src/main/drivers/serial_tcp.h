@@ -0,0 +1,39 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Serial port emulation over TCP sockets for the SITL target.
+// Each port listens on its own TCP port and accepts a single client.
+
+#define SERIAL_TCP_BUFFER_SIZE  4096    // must be a power of two
+
+typedef struct {
+    serialPort_t port;
+
+    uint8_t rxBuffer[SERIAL_TCP_BUFFER_SIZE];
+    uint8_t txBuffer[SERIAL_TCP_BUFFER_SIZE];
+
+    uint16_t tcpPort;
+    int listenFd;
+    int clientFd;
+} tcpPort_t;
+
+serialPort_t *serTcpOpen(int portIndex, serialReceiveCallbackPtr rxCallback, void *rxCallbackData, uint32_t baudRate, portMode_t mode, portOptions_t options);
+
+// Moves data between the sockets and the port buffers, invokes rx callbacks
+void serTcpPoll(void);
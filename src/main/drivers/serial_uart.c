@@ -416,16 +416,8 @@ uint8_t uartRead(serialPort_t *instance)
     return ch;
 }
 
-void uartWrite(serialPort_t *instance, uint8_t ch)
+static void uartStartTx(uartPort_t *s)
 {
-    uartPort_t *s = (uartPort_t *)instance;
-    s->port.txBuffer[s->port.txBufferHead] = ch;
-    if (s->port.txBufferHead + 1 >= s->port.txBufferSize) {
-        s->port.txBufferHead = 0;
-    } else {
-        s->port.txBufferHead++;
-    }
-
 #ifdef STM32F4
     if (s->txDMAStream) {
         if (!(s->txDMAStream->CR & 1))
@@ -439,6 +431,28 @@ void uartWrite(serialPort_t *instance, uint8_t ch)
     }
 }
 
+void uartWrite(serialPort_t *instance, uint8_t ch)
+{
+    uartPort_t *s = (uartPort_t *)instance;
+    s->port.txBuffer[s->port.txBufferHead] = ch;
+    if (s->port.txBufferHead + 1 >= s->port.txBufferSize) {
+        s->port.txBufferHead = 0;
+    } else {
+        s->port.txBufferHead++;
+    }
+
+    uartStartTx(s);
+}
+
+static void uartCommitDirectWrite(serialPort_t *instance, uint32_t count)
+{
+    uartPort_t *s = (uartPort_t *)instance;
+    const uint32_t head = s->port.txBufferHead + count;
+    s->port.txBufferHead = (head >= s->port.txBufferSize) ? head - s->port.txBufferSize : head;
+
+    uartStartTx(s);
+}
+
 const struct serialPortVTable uartVTable[] = {
     {
         .serialWrite = uartWrite,
@@ -452,5 +466,6 @@ const struct serialPortVTable uartVTable[] = {
         .writeBuf = NULL,
         .beginWrite = NULL,
         .endWrite = NULL,
+        .commitDirectWrite = uartCommitDirectWrite,
     }
 };
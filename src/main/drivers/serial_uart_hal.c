@@ -361,6 +361,16 @@ uint8_t uartRead(serialPort_t *instance)
     return ch;
 }
 
+static void uartStartTx(uartPort_t *s)
+{
+    if (s->txDMAStream) {
+        if (!(s->txDMAStream->CR & 1))
+            uartStartTxDMA(s);
+    } else {
+        __HAL_UART_ENABLE_IT(&s->Handle, UART_IT_TXE);
+    }
+}
+
 void uartWrite(serialPort_t *instance, uint8_t ch)
 {
     uartPort_t *s = (uartPort_t *)instance;
@@ -371,12 +381,16 @@ void uartWrite(serialPort_t *instance, uint8_t ch)
         s->port.txBufferHead++;
     }
 
-    if (s->txDMAStream) {
-        if (!(s->txDMAStream->CR & 1))
-            uartStartTxDMA(s);
-    } else {
-        __HAL_UART_ENABLE_IT(&s->Handle, UART_IT_TXE);
-    }
+    uartStartTx(s);
+}
+
+static void uartCommitDirectWrite(serialPort_t *instance, uint32_t count)
+{
+    uartPort_t *s = (uartPort_t *)instance;
+    const uint32_t head = s->port.txBufferHead + count;
+    s->port.txBufferHead = (head >= s->port.txBufferSize) ? head - s->port.txBufferSize : head;
+
+    uartStartTx(s);
 }
 
 const struct serialPortVTable uartVTable[] = {
@@ -392,5 +406,6 @@ const struct serialPortVTable uartVTable[] = {
         .writeBuf = NULL,
         .beginWrite = NULL,
         .endWrite = NULL,
+        .commitDirectWrite = uartCommitDirectWrite,
     }
 };
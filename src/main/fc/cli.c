@@ -2260,61 +2260,59 @@ static void cliSet(char *cmdline)
             eqptr++;
         }
 
-        for (uint32_t i = 0; i < SETTINGS_TABLE_COUNT; i++) {
-            val = &settingsTable[i];
-            // ensure exact match when setting to prevent setting variables with shorter names
-            if (setting_name_exact_match(val, name, cmdline, variableNameLength)) {
-                bool changeValue = false;
-                int_float_value_t tmp = {0};
-                const int mode = SETTING_MODE(val);
-                const int type = SETTING_TYPE(val);
-                switch (mode) {
-                case MODE_DIRECT: {
-                        if (*eqptr != 0 && strspn(eqptr, "0123456789.+-") == strlen(eqptr)) {
-                            float valuef = fastA2F(eqptr);
-                            // note: compare float values
-                            if (valuef >= (float)setting_get_min(val) && valuef <= (float)setting_get_max(val)) {
-
-                                if (type == VAR_FLOAT)
-                                    tmp.float_value = valuef;
-                                else if (type == VAR_UINT32)
-                                    tmp.uint_value = fastA2UL(eqptr);
-                                else
-                                    tmp.int_value = fastA2I(eqptr);
-
-                                changeValue = true;
-                            }
+        // ensure exact match when setting to prevent setting variables with shorter names
+        val = setting_find_case_insensitive(cmdline, variableNameLength, name);
+        if (val) {
+            bool changeValue = false;
+            int_float_value_t tmp = {0};
+            const int mode = SETTING_MODE(val);
+            const int type = SETTING_TYPE(val);
+            switch (mode) {
+            case MODE_DIRECT: {
+                    if (*eqptr != 0 && strspn(eqptr, "0123456789.+-") == strlen(eqptr)) {
+                        float valuef = fastA2F(eqptr);
+                        // note: compare float values
+                        if (valuef >= (float)setting_get_min(val) && valuef <= (float)setting_get_max(val)) {
+
+                            if (type == VAR_FLOAT)
+                                tmp.float_value = valuef;
+                            else if (type == VAR_UINT32)
+                                tmp.uint_value = fastA2UL(eqptr);
+                            else
+                                tmp.int_value = fastA2I(eqptr);
+
+                            changeValue = true;
                         }
                     }
-                    break;
-                case MODE_LOOKUP: {
-                        const lookupTableEntry_t *tableEntry = &settingLookupTables[settingsTable[i].config.lookup.tableIndex];
-                        bool matched = false;
-                        for (uint32_t tableValueIndex = 0; tableValueIndex < tableEntry->valueCount && !matched; tableValueIndex++) {
-                            matched = sl_strcasecmp(tableEntry->values[tableValueIndex], eqptr) == 0;
-
-                            if (matched) {
-                                tmp.int_value = tableValueIndex;
-                                changeValue = true;
-                            }
+                }
+                break;
+            case MODE_LOOKUP: {
+                    const lookupTableEntry_t *tableEntry = &settingLookupTables[val->config.lookup.tableIndex];
+                    bool matched = false;
+                    for (uint32_t tableValueIndex = 0; tableValueIndex < tableEntry->valueCount && !matched; tableValueIndex++) {
+                        matched = sl_strcasecmp(tableEntry->values[tableValueIndex], eqptr) == 0;
+
+                        if (matched) {
+                            tmp.int_value = tableValueIndex;
+                            changeValue = true;
                         }
                     }
-                    break;
                 }
+                break;
+            }
 
-                if (changeValue) {
-                    cliSetVar(val, tmp);
-
-                    cliPrintf("%s set to ", name);
-                    cliPrintVar(val, 0);
-                } else {
-                    cliPrint("Invalid value.");
-                    cliPrintVarRange(val);
-                    cliPrintLinefeed();
-                }
+            if (changeValue) {
+                cliSetVar(val, tmp);
 
-                return;
+                cliPrintf("%s set to ", name);
+                cliPrintVar(val, 0);
+            } else {
+                cliPrint("Invalid value.");
+                cliPrintVarRange(val);
+                cliPrintLinefeed();
             }
+
+            return;
         }
         cliPrintLine("Invalid name");
     } else {
@@ -2478,6 +2476,21 @@ static void cliTasks(char *cmdline)
     getCheckFuncInfo(&checkFuncInfo);
     cliPrintLinef("Task check function %13d %7d %25d", (uint32_t)checkFuncInfo.maxExecutionTime, (uint32_t)checkFuncInfo.averageExecutionTime, (uint32_t)checkFuncInfo.totalExecutionTime / 1000);
     cliPrintLinef("Total (excluding SERIAL) %21d.%1d%% %4d.%1d%%", maxLoadSum/10, maxLoadSum%10, averageLoadSum/10, averageLoadSum%10);
+#ifdef USE_TASK_HISTOGRAMS
+    cliPrintLinefeed();
+    cliPrintLinef("Task latency/us   exec p50   p99  p999  jitter p50   p99  p999");
+    for (cfTaskId_e taskId = 0; taskId < TASK_COUNT; taskId++) {
+        cfTaskInfo_t taskInfo;
+        cfTaskLatencyInfo_t latencyInfo;
+        getTaskInfo(taskId, &taskInfo);
+        if (taskInfo.isEnabled && getTaskLatencyInfo(taskId, &latencyInfo)) {
+            cliPrintLinef("%2d - %12s %6d %5d %5d  %10d %5d %5d",
+                    taskId, taskInfo.taskName,
+                    latencyInfo.executionTime.p50, latencyInfo.executionTime.p99, latencyInfo.executionTime.p999,
+                    latencyInfo.startJitter.p50, latencyInfo.startJitter.p99, latencyInfo.startJitter.p999);
+        }
+    }
+#endif
 }
 #endif
 
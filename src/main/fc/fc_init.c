@@ -639,6 +639,9 @@ void init(void)
     m25p16_init(0);
 #endif
 
+#ifdef USE_BLACKBOX
+    flashfsSetRingMode(blackboxConfig()->flashRing);
+#endif
     flashfsInit();
 #endif
 
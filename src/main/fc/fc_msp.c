@@ -50,11 +50,12 @@
 #include "fc/controlrate_profile.h"
 #include "fc/fc_msp.h"
 #include "fc/fc_msp_box.h"
+#include "fc/fc_msp_dataflash.h"
+#include "fc/fc_msp_settings.h"
 #include "fc/rc_adjustments.h"
 #include "fc/rc_controls.h"
 #include "fc/rc_modes.h"
 #include "fc/runtime_config.h"
-#include "fc/settings.h"
 
 #include "flight/failsafe.h"
 #include "flight/imu.h"
@@ -96,6 +97,7 @@
 #include "sensors/pitotmeter.h"
 #include "sensors/compass.h"
 #include "sensors/gyro.h"
+#include "sensors/gyroanalyse.h"
 #include "sensors/opflow.h"
 
 #include "telemetry/telemetry.h"
@@ -147,6 +149,16 @@ typedef enum {
 static uint8_t escMode;
 static uint8_t escPortIndex;
 
+static void mspFc4wayProcessFn(serialPort_t *serialPort)
+{
+    // Passthrough takes over the port, let the reply to the command get out first
+    if (serialPort) {
+        waitForSerialPortToFinishTransmitting(serialPort);
+    }
+
+    esc4wayProcess(serialPort);
+}
+
 static void mspFc4waySerialCommand(sbuf_t *dst, sbuf_t *src, mspPostProcessFnPtr *mspPostProcessFn)
 {
     const unsigned int dataSize = sbufBytesRemaining(src);
@@ -167,7 +179,7 @@ static void mspFc4waySerialCommand(sbuf_t *dst, sbuf_t *src, mspPostProcessFnPtr
         sbufWriteU8(dst, esc4wayInit());
 
         if (mspPostProcessFn) {
-            *mspPostProcessFn = esc4wayProcess;
+            *mspPostProcessFn = mspFc4wayProcessFn;
         }
         break;
 
@@ -180,7 +192,10 @@ static void mspFc4waySerialCommand(sbuf_t *dst, sbuf_t *src, mspPostProcessFnPtr
 
 static void mspRebootFn(serialPort_t *serialPort)
 {
-    UNUSED(serialPort);
+    // Let the reply to the reboot command get out before the port goes away
+    if (serialPort) {
+        waitForSerialPortToFinishTransmitting(serialPort);
+    }
 
     stopMotors();
     stopPwmAllMotors();
@@ -246,7 +261,7 @@ static void serializeDataflashSummaryReply(sbuf_t *dst)
     const flashGeometry_t *geometry = flashfsGetGeometry();
     sbufWriteU8(dst, flashfsIsReady() ? 1 : 0);
     sbufWriteU32(dst, geometry->sectors);
-    sbufWriteU32(dst, geometry->totalSize);
+    sbufWriteU32(dst, flashfsGetSize()); // Space for logs, the last sector holds the flashfs journal
     sbufWriteU32(dst, flashfsGetOffset()); // Effectively the current number of bytes stored on the volume
 #else
     sbufWriteU8(dst, 0);
@@ -2395,132 +2410,61 @@ static mspResult_e mspFcProcessInCommand(uint16_t cmdMSP, sbuf_t *src)
     return MSP_RESULT_ACK;
 }
 
-static const setting_t *mspReadSettingName(sbuf_t *src)
+static void mspWriteLatencyPercentiles(sbuf_t *dst, const cfLatencyPercentiles_t *percentiles)
 {
-    char name[SETTING_MAX_NAME_LENGTH];
-    uint8_t c;
-    size_t s = 0;
-    while (1) {
-        if (!sbufReadU8Safe(&c, src)) {
-            return NULL;
-        }
-        name[s++] = c;
-        if (c == '\0') {
-            break;
-        }
-        if (s == SETTING_MAX_NAME_LENGTH) {
-            // Name is too long
-            return NULL;
-        }
-    }
-    return setting_find(name);
+    sbufWriteU32(dst, percentiles->samples);
+    sbufWriteU32(dst, percentiles->p50);
+    sbufWriteU32(dst, percentiles->p99);
+    sbufWriteU32(dst, percentiles->p999);
 }
 
-static bool mspSettingCommand(sbuf_t *dst, sbuf_t *src)
+static bool mspTaskLatencyCommand(sbuf_t *dst, sbuf_t *src)
 {
-    const setting_t *setting = mspReadSettingName(src);
-    if (!setting) {
+    uint8_t taskId;
+    cfTaskLatencyInfo_t latencyInfo;
+
+    if (!sbufReadU8Safe(&taskId, src) || !getTaskLatencyInfo(taskId, &latencyInfo)) {
         return false;
     }
 
-    const void *ptr = setting_get_value_pointer(setting);
-    size_t size = setting_get_value_size(setting);
-    sbufWriteDataSafe(dst, ptr, size);
+    sbufWriteU8(dst, taskId);
+    sbufWriteU32(dst, cfTasks[taskId].desiredPeriod);
+    mspWriteLatencyPercentiles(dst, &latencyInfo.executionTime);
+    mspWriteLatencyPercentiles(dst, &latencyInfo.startJitter);
     return true;
 }
 
-static bool mspSetSettingCommand(sbuf_t *dst, sbuf_t *src)
+#ifdef USE_DYNAMIC_FILTERS
+/*
+ * Dynamic notch center frequencies and the latest spectrum of one axis,
+ * the axis is an optional request byte defaulting to roll.
+ */
+static bool mspGyroSpectrumCommand(sbuf_t *dst, sbuf_t *src)
 {
-    UNUSED(dst);
+    uint8_t axis;
 
-    const setting_t *setting = mspReadSettingName(src);
-    if (!setting) {
+    if (!sbufReadU8Safe(&axis, src)) {
+        axis = FD_ROLL;
+    }
+    if (axis >= XYZ_AXIS_COUNT) {
         return false;
     }
 
-    setting_min_t min = setting_get_min(setting);
-    setting_max_t max = setting_get_max(setting);
-
-    void *ptr = setting_get_value_pointer(setting);
-    switch (SETTING_TYPE(setting)) {
-        case VAR_UINT8:
-            {
-                uint8_t val;
-                if (!sbufReadU8Safe(&val, src)) {
-                    return false;
-                }
-                if (val > max) {
-                    return false;
-                }
-                *((uint8_t*)ptr) = val;
-            }
-            break;
-        case VAR_INT8:
-            {
-                int8_t val;
-                if (!sbufReadI8Safe(&val, src)) {
-                    return false;
-                }
-                if (val < min || val > (int8_t)max) {
-                    return false;
-                }
-                *((int8_t*)ptr) = val;
-            }
-            break;
-        case VAR_UINT16:
-            {
-                uint16_t val;
-                if (!sbufReadU16Safe(&val, src)) {
-                    return false;
-                }
-                if (val > max) {
-                    return false;
-                }
-                *((uint16_t*)ptr) = val;
-            }
-            break;
-        case VAR_INT16:
-            {
-                int16_t val;
-                if (!sbufReadI16Safe(&val, src)) {
-                    return false;
-                }
-                if (val < min || val > (int16_t)max) {
-                    return false;
-                }
-                *((int16_t*)ptr) = val;
-            }
-            break;
-        case VAR_UINT32:
-            {
-                uint32_t val;
-                if (!sbufReadU32Safe(&val, src)) {
-                    return false;
-                }
-                if (val > max) {
-                    return false;
-                }
-                *((uint32_t*)ptr) = val;
-            }
-            break;
-        case VAR_FLOAT:
-            {
-                float val;
-                if (!sbufReadDataSafe(src, &val, sizeof(float))) {
-                    return false;
-                }
-                if (val < (float)min || val > (float)max) {
-                    return false;
-                }
-                *((float*)ptr) = val;
-            }
-            break;
+    sbufWriteU8(dst, gyroConfig()->dynamicGyroNotchEnabled);
+    sbufWriteU16(dst, gyroDataAnalyseSampleRateHz());
+    sbufWriteU8(dst, GYRO_ANALYSE_FFT_BIN_COUNT);
+    for (int i = 0; i < XYZ_AXIS_COUNT; i++) {
+        sbufWriteU16(dst, gyroDataAnalyseCenterFrequency(i));
+    }
+    for (int bin = 0; bin < GYRO_ANALYSE_FFT_BIN_COUNT; bin++) {
+        sbufWriteU16(dst, constrain(lrintf(gyroDataAnalyseBinMagnitude(axis, bin)), 0, UINT16_MAX));
     }
-
     return true;
 }
+#endif
+
 /*
- * Returns MSP_RESULT_ACK, MSP_RESULT_ERROR or MSP_RESULT_NO_REPLY
+ * Returns MSP_RESULT_ACK, MSP_RESULT_ERROR, MSP_RESULT_NO_REPLY or MSP_RESULT_RETRY
  */
 mspResult_e mspFcProcessCommand(mspPacket_t *cmd, mspPacket_t *reply, mspPostProcessFnPtr *mspPostProcessFn)
 {
@@ -2533,11 +2477,6 @@ mspResult_e mspFcProcessCommand(mspPacket_t *cmd, mspPacket_t *reply, mspPostPro
 
     if (mspFcProcessOutCommand(cmdMSP, dst, mspPostProcessFn)) {
         ret = MSP_RESULT_ACK;
-#ifdef USE_SERIAL_4WAY_BLHELI_INTERFACE
-    } else if (cmdMSP == MSP_SET_4WAY_IF) {
-        mspFc4waySerialCommand(dst, src, mspPostProcessFn);
-        ret = MSP_RESULT_ACK;
-#endif
 #ifdef USE_NAV
     } else if (cmdMSP == MSP_WP) {
         mspFcWaypointOutCommand(dst, src);
@@ -2549,9 +2488,33 @@ mspResult_e mspFcProcessCommand(mspPacket_t *cmd, mspPacket_t *reply, mspPostPro
         ret = MSP_RESULT_ACK;
 #endif
     } else if (cmdMSP == MSP2_COMMON_SETTING) {
-        ret = mspSettingCommand(dst, src) ? MSP_RESULT_ACK : MSP_RESULT_ERROR;
+        ret = mspFcSettingCommand(dst, src) ? MSP_RESULT_ACK : MSP_RESULT_ERROR;
+    } else if (cmdMSP == MSP2_COMMON_SETTING_INFO) {
+        ret = mspFcSettingInfoCommand(dst, src);
+    } else if (cmdMSP == MSP2_COMMON_SETTINGS) {
+        ret = mspFcSettingsCommand(dst, src);
+    } else if (cmdMSP == MSP2_INAV_TASK_LATENCY) {
+        ret = mspTaskLatencyCommand(dst, src) ? MSP_RESULT_ACK : MSP_RESULT_ERROR;
+#ifdef USE_DYNAMIC_FILTERS
+    } else if (cmdMSP == MSP2_INAV_GYRO_SPECTRUM) {
+        ret = mspGyroSpectrumCommand(dst, src) ? MSP_RESULT_ACK : MSP_RESULT_ERROR;
+#endif
+    } else if (cmd->flags & MSP_FLAG_MAY_RETRY) {
+        // Everything below changes something, so it must not run twice
+        ret = MSP_RESULT_RETRY;
+#ifdef USE_SERIAL_4WAY_BLHELI_INTERFACE
+    } else if (cmdMSP == MSP_SET_4WAY_IF) {
+        mspFc4waySerialCommand(dst, src, mspPostProcessFn);
+        ret = MSP_RESULT_ACK;
+#endif
+#ifdef USE_FLASHFS
+    } else if (cmdMSP == MSP2_INAV_DATAFLASH_STREAM) {
+        ret = mspFcDataflashStreamCommand(dst, src, cmd->flags, mspPostProcessFn) ? MSP_RESULT_ACK : MSP_RESULT_ERROR;
+#endif
     } else if (cmdMSP == MSP2_COMMON_SET_SETTING) {
-        ret = mspSetSettingCommand(dst, src) ? MSP_RESULT_ACK : MSP_RESULT_ERROR;
+        ret = mspFcSetSettingCommand(dst, src) ? MSP_RESULT_ACK : MSP_RESULT_ERROR;
+    } else if (cmdMSP == MSP2_COMMON_SET_SETTINGS) {
+        ret = mspFcSetSettingsCommand(dst, src) ? MSP_RESULT_ACK : MSP_RESULT_ERROR;
     } else {
         ret = mspFcProcessInCommand(cmdMSP, src);
     }
@@ -0,0 +1,131 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "platform.h"
+
+#ifdef USE_FLASHFS
+
+#include "common/crc.h"
+#include "common/maths.h"
+#include "common/streambuf.h"
+
+#include "drivers/serial.h"
+
+#include "fc/fc_msp_dataflash.h"
+
+#include "io/flashfs.h"
+
+#include "msp/msp.h"
+#include "msp/msp_protocol_v2_inav.h"
+#include "msp/msp_serial.h"
+
+static struct {
+    uint32_t address;
+    uint32_t endAddress;
+    uint16_t chunkSize;
+    uint8_t flags;
+} dataflashStream;
+
+/*
+ * Chunk payload:
+ *  uint32_t    - address of the chunk
+ *  uint8_t[]   - data, as much as fits in the TX buffer up to the chunk size. No data marks the end of the stream
+ *  uint16_t    - CRC16-CCITT of the data, only when requested
+ */
+static bool mspFcDataflashStreamFn(mspPacket_t *packet)
+{
+    sbuf_t *dst = &packet->buf;
+    const int crcSize = (dataflashStream.flags & DATAFLASH_STREAM_FLAG_CRC) ? sizeof(uint16_t) : 0;
+    const int bytesFree = sbufBytesRemaining(dst) - (int)sizeof(uint32_t) - crcSize;
+
+    if (bytesFree <= 0) {
+        return true;
+    }
+
+    const uint32_t readLength = MIN(MIN((uint32_t)bytesFree, dataflashStream.chunkSize), dataflashStream.endAddress - dataflashStream.address);
+
+    sbufWriteU32(dst, dataflashStream.address);
+
+    // A failed read ends the stream early, the client can resume from the address of the last chunk
+    const int bytesRead = readLength > 0 ? flashfsReadAbs(dataflashStream.address, sbufPtr(dst), readLength) : 0;
+
+    if (crcSize > 0) {
+        const uint16_t crc = crc16_ccitt_update(0, sbufPtr(dst), bytesRead);
+        sbufAdvance(dst, bytesRead);
+        sbufWriteU16(dst, crc);
+    } else {
+        sbufAdvance(dst, bytesRead);
+    }
+
+    dataflashStream.address += bytesRead;
+
+    return bytesRead > 0;
+}
+
+static void mspFcDataflashStreamStart(serialPort_t *serialPort)
+{
+    mspSerialStartStream(serialPort, MSP2_INAV_DATAFLASH_STREAM, mspFcDataflashStreamFn);
+}
+
+/*
+ * Returns false if the stream can't be started: the command didn't arrive on a port that can stream (e.g. MSP over
+ * telemetry), or the flash is in ring mode, where the data from the start of the device up to the tail isn't in the
+ * order it was logged once the log has wrapped around.
+ */
+bool mspFcDataflashStreamCommand(sbuf_t *dst, sbuf_t *src, uint8_t cmdFlags, mspPostProcessFnPtr *mspPostProcessFn)
+{
+    // Request payload (an empty request just stops the stream):
+    //  uint32_t    - address to start from, to resume an interrupted download
+    //  uint32_t    - number of bytes to send, 0 to send everything up to the end of the data
+    //  uint16_t    - largest chunk to send in one frame (optional)
+    //  uint8_t     - flags, DATAFLASH_STREAM_FLAG_CRC to append a CRC to each chunk (optional)
+    if (sbufBytesRemaining(src) < (int)(sizeof(uint32_t) * 2)) {
+        return true;
+    }
+
+    if (!(cmdFlags & MSP_FLAG_CAN_STREAM) || !mspPostProcessFn || flashfsIsRingMode()) {
+        return false;
+    }
+
+    const uint32_t dataEnd = flashfsGetOffset();
+    const uint32_t address = MIN(sbufReadU32(src), dataEnd);
+    const uint32_t length = sbufReadU32(src);
+
+    dataflashStream.address = address;
+    dataflashStream.endAddress = (length == 0 || length > dataEnd - address) ? dataEnd : address + length;
+    dataflashStream.chunkSize = sbufBytesRemaining(src) >= (int)sizeof(uint16_t) ? sbufReadU16(src) : DATAFLASH_STREAM_DEFAULT_CHUNK_SIZE;
+    dataflashStream.flags = sbufBytesRemaining(src) >= (int)sizeof(uint8_t) ? sbufReadU8(src) : 0;
+
+    if (dataflashStream.chunkSize == 0) {
+        dataflashStream.chunkSize = DATAFLASH_STREAM_DEFAULT_CHUNK_SIZE;
+    }
+
+    // Reply with what will be sent, the chunks follow without further requests
+    sbufWriteU32(dst, dataflashStream.address);
+    sbufWriteU32(dst, dataflashStream.endAddress);
+    sbufWriteU16(dst, dataflashStream.chunkSize);
+    sbufWriteU8(dst, dataflashStream.flags);
+
+    *mspPostProcessFn = mspFcDataflashStreamStart;
+
+    return true;
+}
+
+#endif
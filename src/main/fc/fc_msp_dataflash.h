@@ -0,0 +1,27 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/streambuf.h"
+
+#include "msp/msp.h"
+
+#define DATAFLASH_STREAM_FLAG_CRC           (1 << 0)
+#define DATAFLASH_STREAM_DEFAULT_CHUNK_SIZE 1024
+
+bool mspFcDataflashStreamCommand(sbuf_t *dst, sbuf_t *src, uint8_t cmdFlags, mspPostProcessFnPtr *mspPostProcessFn);
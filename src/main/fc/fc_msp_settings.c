@@ -0,0 +1,266 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+
+#include "common/streambuf.h"
+#include "common/utils.h"
+
+#include "fc/fc_msp_settings.h"
+#include "fc/settings.h"
+
+static const setting_t *mspReadSettingName(sbuf_t *src)
+{
+    char name[SETTING_MAX_NAME_LENGTH];
+    uint8_t c;
+    size_t s = 0;
+    while (1) {
+        if (!sbufReadU8Safe(&c, src)) {
+            return NULL;
+        }
+        name[s++] = c;
+        if (c == '\0') {
+            break;
+        }
+        if (s == SETTING_MAX_NAME_LENGTH) {
+            // Name is too long
+            return NULL;
+        }
+    }
+    return setting_find(name);
+}
+
+bool mspFcSettingCommand(sbuf_t *dst, sbuf_t *src)
+{
+    const setting_t *setting = mspReadSettingName(src);
+    if (!setting) {
+        return false;
+    }
+
+    const void *ptr = setting_get_value_pointer(setting);
+    size_t size = setting_get_value_size(setting);
+    sbufWriteDataSafe(dst, ptr, size);
+    return true;
+}
+
+/*
+ * Reads a value for the given setting from src and stores it at ptr,
+ * which must have room for setting_get_value_size() bytes. Returns
+ * false, without storing anything, if the value is missing or out of range.
+ */
+static bool mspReadSettingValue(const setting_t *setting, sbuf_t *src, void *ptr)
+{
+    setting_min_t min = setting_get_min(setting);
+    setting_max_t max = setting_get_max(setting);
+
+    switch (SETTING_TYPE(setting)) {
+        case VAR_UINT8:
+            {
+                uint8_t val;
+                if (!sbufReadU8Safe(&val, src)) {
+                    return false;
+                }
+                if (val > max) {
+                    return false;
+                }
+                *((uint8_t*)ptr) = val;
+            }
+            break;
+        case VAR_INT8:
+            {
+                int8_t val;
+                if (!sbufReadI8Safe(&val, src)) {
+                    return false;
+                }
+                if (val < min || val > (int8_t)max) {
+                    return false;
+                }
+                *((int8_t*)ptr) = val;
+            }
+            break;
+        case VAR_UINT16:
+            {
+                uint16_t val;
+                if (!sbufReadU16Safe(&val, src)) {
+                    return false;
+                }
+                if (val > max) {
+                    return false;
+                }
+                *((uint16_t*)ptr) = val;
+            }
+            break;
+        case VAR_INT16:
+            {
+                int16_t val;
+                if (!sbufReadI16Safe(&val, src)) {
+                    return false;
+                }
+                if (val < min || val > (int16_t)max) {
+                    return false;
+                }
+                *((int16_t*)ptr) = val;
+            }
+            break;
+        case VAR_UINT32:
+            {
+                uint32_t val;
+                if (!sbufReadU32Safe(&val, src)) {
+                    return false;
+                }
+                if (val > max) {
+                    return false;
+                }
+                *((uint32_t*)ptr) = val;
+            }
+            break;
+        case VAR_FLOAT:
+            {
+                float val;
+                if (!sbufReadDataSafe(src, &val, sizeof(float))) {
+                    return false;
+                }
+                // sbufReadData() doesn't advance, the next index of a batch follows the value
+                sbufAdvance(src, sizeof(float));
+                if (val < (float)min || val > (float)max) {
+                    return false;
+                }
+                *((float*)ptr) = val;
+            }
+            break;
+    }
+
+    return true;
+}
+
+bool mspFcSetSettingCommand(sbuf_t *dst, sbuf_t *src)
+{
+    UNUSED(dst);
+
+    const setting_t *setting = mspReadSettingName(src);
+    if (!setting) {
+        return false;
+    }
+
+    return mspReadSettingValue(setting, src, setting_get_value_pointer(setting));
+}
+
+static const setting_t *mspReadSettingIndex(sbuf_t *src)
+{
+    uint16_t index;
+    if (!sbufReadU16Safe(&index, src)) {
+        return NULL;
+    }
+    return setting_get_by_index(index);
+}
+
+/*
+ * Request payload:
+ *  uint16_t    - index of the first setting to return (optional, 0 by default)
+ *
+ * Reply payload:
+ *  uint16_t    - number of settings
+ * and then, for as many settings as fit in the reply:
+ *  uint16_t    - index of the setting, used to address it in MSP2_COMMON_SETTINGS and MSP2_COMMON_SET_SETTINGS
+ *  char[]      - name, '\0' terminated
+ *  uint8_t     - setting_type_e | setting_section_e | setting_mode_e
+ *  int32_t     - minimum value
+ *  uint32_t    - maximum value, the number of values minus 1 for MODE_LOOKUP
+ *
+ * Clients request again from the index after the last returned one until they have all settings.
+ * Returns MSP_RESULT_RETRY when not even the first requested setting fits in dst.
+ */
+mspResult_e mspFcSettingInfoCommand(sbuf_t *dst, sbuf_t *src)
+{
+    uint16_t index;
+    if (!sbufReadU16Safe(&index, src)) {
+        index = 0;
+    }
+    const uint16_t firstIndex = index;
+
+    sbufWriteU16(dst, SETTINGS_TABLE_COUNT);
+
+    char name[SETTING_MAX_NAME_LENGTH];
+    for (const setting_t *setting; (setting = setting_get_by_index(index)) != NULL; index++) {
+        setting_get_name(setting, name);
+        const int nameSize = strlen(name) + 1;
+        if (sbufBytesRemaining(dst) < (int)sizeof(uint16_t) + nameSize + (int)(sizeof(uint8_t) + sizeof(int32_t) + sizeof(uint32_t))) {
+            return index == firstIndex ? MSP_RESULT_RETRY : MSP_RESULT_ACK;
+        }
+        sbufWriteU16(dst, index);
+        sbufWriteData(dst, name, nameSize);
+        sbufWriteU8(dst, setting->type);
+        sbufWriteU32(dst, (int32_t)setting_get_min(setting));
+        sbufWriteU32(dst, setting_get_max(setting));
+    }
+    return MSP_RESULT_ACK;
+}
+
+/*
+ * Request payload: uint16_t indexes of the settings to read
+ * Reply payload: the value of each setting, setting_get_value_size() bytes each
+ *
+ * Returns MSP_RESULT_RETRY when the values don't fit in dst, so the caller can
+ * run it again with a larger buffer.
+ */
+mspResult_e mspFcSettingsCommand(sbuf_t *dst, sbuf_t *src)
+{
+    while (sbufBytesRemaining(src) > 0) {
+        const setting_t *setting = mspReadSettingIndex(src);
+        if (!setting) {
+            return MSP_RESULT_ERROR;
+        }
+        const size_t size = setting_get_value_size(setting);
+        if (sbufBytesRemaining(dst) < (int)size) {
+            return MSP_RESULT_RETRY;
+        }
+        sbufWriteData(dst, setting_get_value_pointer(setting), size);
+    }
+    return MSP_RESULT_ACK;
+}
+
+/*
+ * Request payload: a uint16_t setting index followed by its value, for each setting to change.
+ * Either all the values are valid and set, or none is.
+ */
+bool mspFcSetSettingsCommand(sbuf_t *dst, sbuf_t *src)
+{
+    UNUSED(dst);
+
+    uint8_t * const start = sbufPtr(src);
+
+    // Validate every value before changing any of them
+    while (sbufBytesRemaining(src) > 0) {
+        const setting_t *setting = mspReadSettingIndex(src);
+        uint32_t value;
+        if (!setting || !mspReadSettingValue(setting, src, &value)) {
+            return false;
+        }
+    }
+
+    src->ptr = start;
+
+    while (sbufBytesRemaining(src) > 0) {
+        const setting_t *setting = mspReadSettingIndex(src);
+        mspReadSettingValue(setting, src, setting_get_value_pointer(setting));
+    }
+    return true;
+}
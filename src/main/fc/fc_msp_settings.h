@@ -0,0 +1,30 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/streambuf.h"
+
+#include "msp/msp.h"
+
+// MSP2_COMMON_SETTING and MSP2_COMMON_SET_SETTING, which address a setting by name
+bool mspFcSettingCommand(sbuf_t *dst, sbuf_t *src);
+bool mspFcSetSettingCommand(sbuf_t *dst, sbuf_t *src);
+// MSP2_COMMON_SETTING_INFO, MSP2_COMMON_SETTINGS and MSP2_COMMON_SET_SETTINGS, which address settings by index
+mspResult_e mspFcSettingInfoCommand(sbuf_t *dst, sbuf_t *src);
+mspResult_e mspFcSettingsCommand(sbuf_t *dst, sbuf_t *src);
+bool mspFcSetSettingsCommand(sbuf_t *dst, sbuf_t *src);
@@ -51,6 +51,7 @@
 #include "io/beeper.h"
 #include "io/lights.h"
 #include "io/dashboard.h"
+#include "io/flashfs.h"
 #include "io/gps.h"
 #include "io/ledstrip.h"
 #include "io/osd.h"
@@ -316,6 +317,7 @@ void fcTasksInit(void)
     setTaskEnabled(TASK_BATTERY, feature(FEATURE_VBAT) || feature(FEATURE_CURRENT_METER));
     setTaskEnabled(TASK_TEMPERATURE, true);
     setTaskEnabled(TASK_RX, true);
+    setTaskSignalDriven(TASK_RX, rxIsFrameSignalled());
 #ifdef USE_GPS
     setTaskEnabled(TASK_GPS, feature(FEATURE_GPS));
 #endif
@@ -374,6 +376,9 @@ void fcTasksInit(void)
 #ifdef USE_RCDEVICE
     setTaskEnabled(TASK_RCDEVICE, rcdeviceIsEnabled());
 #endif
+#ifdef USE_FLASHFS
+    setTaskEnabled(TASK_FLASHFS, flashfsGetSize() > 0);
+#endif
 }
 
 cfTask_t cfTasks[TASK_COUNT] = {
@@ -618,4 +623,13 @@ cfTask_t cfTasks[TASK_COUNT] = {
         .staticPriority = TASK_PRIORITY_IDLE,
     },
 #endif
+
+#ifdef USE_FLASHFS
+    [TASK_FLASHFS] = {
+        .taskName = "FLASHFS",
+        .taskFunc = flashfsUpdate,
+        .desiredPeriod = TASK_PERIOD_HZ(20),         // 20 Hz, erases ahead of the log while the flash is idle
+        .staticPriority = TASK_PRIORITY_IDLE,
+    },
+#endif
 };
@@ -57,25 +57,71 @@ bool setting_name_contains(const setting_t *val, char *buf, const char *cmdline)
 	return strstr(buf, cmdline) != NULL;
 }
 
-bool setting_name_exact_match(const setting_t *val, char *buf, const char *cmdline, uint8_t var_name_length)
+// FNV-1a of the lowercase name. Must match NameHasher.hash_name in utils/settings.rb
+static uint32_t setting_name_hash(const char *name, size_t length)
 {
-	setting_get_name(val, buf);
-	return sl_strncasecmp(cmdline, buf, strlen(buf)) == 0 && var_name_length == strlen(buf);
+	uint32_t hash = 2166136261u;
+	for (size_t ii = 0; ii < length; ii++) {
+		hash ^= (uint8_t)sl_tolower(name[ii]);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Must match NameHasher.slot in utils/settings.rb
+static unsigned setting_name_hash_slot(uint32_t hash, uint8_t displacement)
+{
+	uint32_t k = hash + displacement * 0x9E3779B9u;
+	k ^= k >> 16;
+	k *= 0x85EBCA6Bu;
+	k ^= k >> 13;
+	k *= 0xC2B2AE35u;
+	k ^= k >> 16;
+	return k % ARRAYLEN(settingNamesHashSlots);
+}
+
+// Returns the only setting that might be named name (ignoring case),
+// using the perfect hash emitted by the settings generator. The caller
+// must still compare the names, since any string maps to some setting.
+static const setting_t *setting_find_candidate(const char *name, size_t length, char *buf)
+{
+	if (length == 0 || length >= SETTING_MAX_NAME_LENGTH) {
+		return NULL;
+	}
+	const uint32_t hash = setting_name_hash(name, length);
+	const uint8_t displacement = settingNamesHashDisplacements[hash % ARRAYLEN(settingNamesHashDisplacements)];
+	const setting_t *setting = &settingsTable[settingNamesHashSlots[setting_name_hash_slot(hash, displacement)]];
+	setting_get_name(setting, buf);
+	return setting;
 }
 
 const setting_t *setting_find(const char *name)
 {
 	char buf[SETTING_MAX_NAME_LENGTH];
-	for (int ii = 0; ii < SETTINGS_TABLE_COUNT; ii++) {
-		const setting_t *setting = &settingsTable[ii];
-		setting_get_name(setting, buf);
-		if (strcmp(buf, name) == 0) {
-			return setting;
-		}
+	const setting_t *setting = setting_find_candidate(name, strlen(name), buf);
+	if (setting && strcmp(buf, name) == 0) {
+		return setting;
 	}
 	return NULL;
 }
 
+const setting_t *setting_find_case_insensitive(const char *name, size_t length, char *buf)
+{
+	const setting_t *setting = setting_find_candidate(name, length, buf);
+	if (setting && strlen(buf) == length && sl_strncasecmp(name, buf, length) == 0) {
+		return setting;
+	}
+	return NULL;
+}
+
+const setting_t *setting_get_by_index(unsigned index)
+{
+	if (index >= SETTINGS_TABLE_COUNT) {
+		return NULL;
+	}
+	return &settingsTable[index];
+}
+
 size_t setting_get_value_size(const setting_t *val)
 {
 	switch (SETTING_TYPE(val)) {
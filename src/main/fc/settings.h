@@ -69,16 +69,24 @@ typedef struct {
 
 extern const setting_t settingsTable[];
 
-static inline setting_type_e SETTING_TYPE(const setting_t *s) { return s->type &  SETTING_TYPE_MASK; }
-static inline setting_section_e SETTING_SECTION(const setting_t *s) { return s->type & SETTING_SECTION_MASK; }
-static inline setting_mode_e SETTING_MODE(const setting_t *s) { return s->type & SETTING_MODE_MASK; }
+static inline setting_type_e SETTING_TYPE(const setting_t *s) { return (setting_type_e)(s->type & SETTING_TYPE_MASK); }
+static inline setting_section_e SETTING_SECTION(const setting_t *s) { return (setting_section_e)(s->type & SETTING_SECTION_MASK); }
+static inline setting_mode_e SETTING_MODE(const setting_t *s) { return (setting_mode_e)(s->type & SETTING_MODE_MASK); }
 
 void setting_get_name(const setting_t *val, char *buf);
 bool setting_name_contains(const setting_t *val, char *buf, const char *cmdline);
-bool setting_name_exact_match(const setting_t *val, char *buf, const char *cmdline, uint8_t var_name_length);
 // Returns a setting_t with the exact name (case sensitive), or
 // NULL if no setting with that name exists.
 const setting_t *setting_find(const char *name);
+// Returns a setting_t whose name matches the first length characters
+// of name ignoring case, or NULL if no setting with that name exists.
+// buf must be at least SETTING_MAX_NAME_LENGTH bytes and receives the
+// name of the setting.
+const setting_t *setting_find_case_insensitive(const char *name, size_t length, char *buf);
+// Returns the setting_t at the given index in settingsTable, or NULL
+// if index is out of range. Indexes don't change while the firmware
+// runs, but might change between builds.
+const setting_t *setting_get_by_index(unsigned index);
 // Returns the size in bytes of the setting value.
 size_t setting_get_value_size(const setting_t *val);
 pgn_t setting_get_pgn(const setting_t *val);
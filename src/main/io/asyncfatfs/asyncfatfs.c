@@ -38,7 +38,12 @@
     #define ONLY_EXPOSE_FOR_TESTING static
 #endif
 
+#ifndef AFATFS_NUM_CACHE_SECTORS
 #define AFATFS_NUM_CACHE_SECTORS 8
+#endif
+
+// Hash buckets used to look up cached sectors by their physical sector index
+#define AFATFS_CACHE_HASH_BUCKETS (AFATFS_NUM_CACHE_SECTORS * 2)
 
 // FAT filesystems are allowed to differ from these parameters, but we choose not to support those weird filesystems:
 #define AFATFS_SECTOR_SIZE  512
@@ -55,6 +60,15 @@
  */
 #define AFATFS_MIN_MULTIPLE_BLOCK_WRITE_COUNT 4
 
+// The SD card's pre-erase count (ACMD23) is a 23-bit field
+#define AFATFS_MAX_MULTIPLE_BLOCK_WRITE_COUNT 0x7FFFFF
+
+/*
+ * How many superclusters a preallocated file takes from the freefile at once. The FAT and directory are only touched
+ * when a new run is taken, so the file's data is streamed to the card as one long multi-block write in between.
+ */
+#define AFATFS_PREALLOCATE_SUPERCLUSTERS 4
+
 #define AFATFS_FILES_PER_DIRECTORY_SECTOR (AFATFS_SECTOR_SIZE / sizeof(fatDirectoryEntry_t))
 
 #define AFATFS_FAT32_FAT_ENTRIES_PER_SECTOR  (AFATFS_SECTOR_SIZE / sizeof(uint32_t))
@@ -72,6 +86,8 @@
 #define AFATFS_FILE_MODE_CREATE           16
 // The file's directory entry should be locked in cache so we can read it with no latency:
 #define AFATFS_FILE_MODE_RETAIN_DIRECTORY 32
+// Contiguous file takes several superclusters at a time and gives back the unused ones on close (only valid with contiguous):
+#define AFATFS_FILE_MODE_PREALLOCATE      64
 
 // Open the cache sector for read access (it will be read from disk)
 #define AFATFS_CACHE_READ         1
@@ -83,6 +99,8 @@
 #define AFATFS_CACHE_DISCARDABLE  8
 // Increase the retain counter of the cache sector to prevent it from being discarded when in the in-sync state
 #define AFATFS_CACHE_RETAIN       16
+// The sector holds filesystem metadata (FAT or directory), so evict file data sectors before it
+#define AFATFS_CACHE_METADATA     32
 
 // Turn the largest free block on the disk into one contiguous file for efficient fragment-free allocation
 #define AFATFS_USE_FREEFILE
@@ -168,7 +186,7 @@ typedef struct afatfsCacheBlockDescriptor_t {
      * This counter only needs to be set on the first block of a consecutive write (though setting it, appropriately
      * decreased, on the subsequent blocks won't hurt).
      */
-    uint16_t consecutiveEraseBlockCount;
+    uint32_t consecutiveEraseBlockCount;
 
     afatfsCacheBlockState_e state;
 
@@ -194,6 +212,12 @@ typedef struct afatfsCacheBlockDescriptor_t {
      * is overridden by the locked and retainCount flags.
      */
     unsigned discardable:1;
+
+    /*
+     * This block holds FAT or directory contents. In the In Sync state, file data blocks are evicted before it so that
+     * streaming a file through the cache doesn't push out the metadata we need to keep extending it.
+     */
+    unsigned metadata:1;
 } afatfsCacheBlockDescriptor_t;
 
 typedef enum {
@@ -237,6 +261,7 @@ typedef enum {
     AFATFS_APPEND_SUPERCLUSTER_PHASE_INIT = 0,
     AFATFS_APPEND_SUPERCLUSTER_PHASE_UPDATE_FREEFILE_DIRECTORY,
     AFATFS_APPEND_SUPERCLUSTER_PHASE_UPDATE_FAT,
+    AFATFS_APPEND_SUPERCLUSTER_PHASE_LINK_FAT,
     AFATFS_APPEND_SUPERCLUSTER_PHASE_UPDATE_FILE_DIRECTORY,
 } afatfsAppendSuperclusterPhase_e;
 
@@ -244,6 +269,9 @@ typedef struct afatfsAppendSupercluster_t {
     uint32_t previousCluster;
     uint32_t fatRewriteStartCluster;
     uint32_t fatRewriteEndCluster;
+    // The supercluster that used to end a preallocated file, to be relinked onto its new run (start is 0 if none)
+    uint32_t fatLinkStartCluster;
+    uint32_t fatLinkEndCluster;
     afatfsAppendSuperclusterPhase_e phase;
 } afatfsAppendSupercluster_t;
 
@@ -310,8 +338,23 @@ typedef struct afatfsDeleteFile_t {
     afatfsCallback_t callback;
 } afatfsUnlinkFile_t;
 
+typedef enum {
+    AFATFS_CLOSE_FILE_PHASE_INITIAL = 0,
+    AFATFS_CLOSE_FILE_PHASE_TERMINATE_CHAIN,
+    AFATFS_CLOSE_FILE_PHASE_RETURN_CLUSTERS,
+    AFATFS_CLOSE_FILE_PHASE_UPDATE_FREEFILE_DIRECTORY,
+    AFATFS_CLOSE_FILE_PHASE_SAVE_DIRECTORY,
+} afatfsCloseFilePhase_e;
+
 typedef struct afatfsCloseFile_t {
     afatfsCallback_t callback;
+
+    afatfsCloseFilePhase_e phase;
+
+    // Preallocated clusters past the end of the file's data are handed back to the freefile:
+    uint32_t fatRewriteStartCluster;
+    uint32_t fatRewriteEndCluster;
+    uint32_t returnEndCluster;
 } afatfsCloseFile_t;
 
 typedef enum {
@@ -401,6 +444,11 @@ typedef struct afatfsFile_t {
     // The first cluster number of the file, or 0 if this file is empty
     uint32_t firstCluster;
 
+#ifdef AFATFS_USE_FREEFILE
+    // For preallocated files, the cluster after the last one we took from the freefile, or 0 if we haven't taken any
+    uint32_t preallocatedEndCluster;
+#endif
+
     // State for a queued operation on the file
     struct afatfsFileOperation_t operation;
 } afatfsFile_t;
@@ -444,9 +492,22 @@ typedef struct afatfs_t {
     afatfsCacheBlockDescriptor_t cacheDescriptor[AFATFS_NUM_CACHE_SECTORS];
     uint32_t cacheTimer;
 
+    /*
+     * Chained hash of cache entries by sector index. Entries are stored as cache index + 1 so that zero (the state after
+     * a memset) is the end of a chain. Entries which have never been initialised aren't in the index.
+     */
+    uint8_t cacheHashHead[AFATFS_CACHE_HASH_BUCKETS];
+    uint8_t cacheHashNext[AFATFS_NUM_CACHE_SECTORS];
+
     int cacheDirtyEntries; // The number of cache entries in the AFATFS_CACHE_STATE_DIRTY state
     bool cacheFlushInProgress;
 
+#ifdef AFATFS_DEBUG
+    // Cache lookups which found the sector ready in the cache, and ones which had to allocate a new cache entry
+    uint32_t cacheHits;
+    uint32_t cacheMisses;
+#endif
+
     afatfsFile_t openFiles[AFATFS_MAX_OPEN_FILES];
 
 #ifdef AFATFS_USE_FREEFILE
@@ -558,6 +619,17 @@ uint32_t afatfs_clusterSize(void)
     return afatfs.sectorsPerCluster * AFATFS_SECTOR_SIZE;
 }
 
+#ifdef AFATFS_DEBUG
+/**
+ * Get the number of cache lookups which hit and missed since the filesystem was initialised.
+ */
+void afatfs_getCacheStatistics(uint32_t *hits, uint32_t *misses)
+{
+    *hits = afatfs.cacheHits;
+    *misses = afatfs.cacheMisses;
+}
+#endif
+
 /**
  * Given a byte offset within a file, return the byte offset of that position within the cluster it belongs to.
  */
@@ -605,9 +677,51 @@ static void afatfs_cacheSectorMarkDirty(afatfsCacheBlockDescriptor_t *descriptor
     }
 }
 
+/**
+ * Find the index of the cache entry which holds the given physical sector index, or -1 if the sector isn't cached. Note
+ * that the cached sector could be in any state including completely empty.
+ */
+static int afatfs_findCacheSectorIndex(uint32_t sectorIndex)
+{
+    for (int entry = afatfs.cacheHashHead[sectorIndex % AFATFS_CACHE_HASH_BUCKETS]; entry; entry = afatfs.cacheHashNext[entry - 1]) {
+        if (afatfs.cacheDescriptor[entry - 1].sectorIndex == sectorIndex) {
+            return entry - 1;
+        }
+    }
+
+    return -1;
+}
+
+static void afatfs_cacheHashRemove(int cacheIndex)
+{
+    uint8_t *link = &afatfs.cacheHashHead[afatfs.cacheDescriptor[cacheIndex].sectorIndex % AFATFS_CACHE_HASH_BUCKETS];
+
+    while (*link) {
+        if (*link == cacheIndex + 1) {
+            *link = afatfs.cacheHashNext[cacheIndex];
+            afatfs.cacheHashNext[cacheIndex] = 0;
+            return;
+        }
+
+        link = &afatfs.cacheHashNext[*link - 1];
+    }
+}
+
+static void afatfs_cacheHashInsert(int cacheIndex)
+{
+    uint8_t *head = &afatfs.cacheHashHead[afatfs.cacheDescriptor[cacheIndex].sectorIndex % AFATFS_CACHE_HASH_BUCKETS];
+
+    afatfs.cacheHashNext[cacheIndex] = *head;
+    *head = cacheIndex + 1;
+}
+
 static void afatfs_cacheSectorInit(afatfsCacheBlockDescriptor_t *descriptor, uint32_t sectorIndex, bool locked)
 {
+    const int cacheIndex = descriptor - afatfs.cacheDescriptor;
+
+    afatfs_cacheHashRemove(cacheIndex);
     descriptor->sectorIndex = sectorIndex;
+    afatfs_cacheHashInsert(cacheIndex);
 
     descriptor->accessTimestamp = descriptor->writeTimestamp = ++afatfs.cacheTimer;
 
@@ -618,6 +732,7 @@ static void afatfs_cacheSectorInit(afatfsCacheBlockDescriptor_t *descriptor, uin
     descriptor->locked = locked;
     descriptor->retainCount = 0;
     descriptor->discardable = 0;
+    descriptor->metadata = 0;
 }
 
 /**
@@ -628,20 +743,16 @@ static void afatfs_sdcardReadComplete(sdcardBlockOperation_e operation, uint32_t
     (void) operation;
     (void) callbackData;
 
-    for (int i = 0; i < AFATFS_NUM_CACHE_SECTORS; i++) {
-        if (afatfs.cacheDescriptor[i].state != AFATFS_CACHE_STATE_EMPTY
-            && afatfs.cacheDescriptor[i].sectorIndex == sectorIndex
-        ) {
-            if (buffer == NULL) {
-                // Read failed, mark the sector as empty and whoever asked for it will ask for it again later to retry
-                afatfs.cacheDescriptor[i].state = AFATFS_CACHE_STATE_EMPTY;
-            } else {
-                afatfs_assert(afatfs_cacheSectorGetMemory(i) == buffer && afatfs.cacheDescriptor[i].state == AFATFS_CACHE_STATE_READING);
+    const int i = afatfs_findCacheSectorIndex(sectorIndex);
 
-                afatfs.cacheDescriptor[i].state = AFATFS_CACHE_STATE_IN_SYNC;
-            }
+    if (i > -1 && afatfs.cacheDescriptor[i].state != AFATFS_CACHE_STATE_EMPTY) {
+        if (buffer == NULL) {
+            // Read failed, mark the sector as empty and whoever asked for it will ask for it again later to retry
+            afatfs.cacheDescriptor[i].state = AFATFS_CACHE_STATE_EMPTY;
+        } else {
+            afatfs_assert(afatfs_cacheSectorGetMemory(i) == buffer && afatfs.cacheDescriptor[i].state == AFATFS_CACHE_STATE_READING);
 
-            break;
+            afatfs.cacheDescriptor[i].state = AFATFS_CACHE_STATE_IN_SYNC;
         }
     }
 }
@@ -656,23 +767,20 @@ static void afatfs_sdcardWriteComplete(sdcardBlockOperation_e operation, uint32_
 
     afatfs.cacheFlushInProgress = false;
 
-    for (int i = 0; i < AFATFS_NUM_CACHE_SECTORS; i++) {
-        /* Keep in mind that someone may have marked the sector as dirty after writing had already begun. In this case we must leave
-         * it marked as dirty because those modifications may have been made too late to make it to the disk!
-         */
-        if (afatfs.cacheDescriptor[i].sectorIndex == sectorIndex
-            && afatfs.cacheDescriptor[i].state == AFATFS_CACHE_STATE_WRITING
-        ) {
-            if (buffer == NULL) {
-                // Write failed, remark the sector as dirty
-                afatfs.cacheDescriptor[i].state = AFATFS_CACHE_STATE_DIRTY;
-                afatfs.cacheDirtyEntries++;
-            } else {
-                afatfs_assert(afatfs_cacheSectorGetMemory(i) == buffer);
+    const int i = afatfs_findCacheSectorIndex(sectorIndex);
 
-                afatfs.cacheDescriptor[i].state = AFATFS_CACHE_STATE_IN_SYNC;
-            }
-            break;
+    /* Keep in mind that someone may have marked the sector as dirty after writing had already begun. In this case we must leave
+     * it marked as dirty because those modifications may have been made too late to make it to the disk!
+     */
+    if (i > -1 && afatfs.cacheDescriptor[i].state == AFATFS_CACHE_STATE_WRITING) {
+        if (buffer == NULL) {
+            // Write failed, remark the sector as dirty
+            afatfs.cacheDescriptor[i].state = AFATFS_CACHE_STATE_DIRTY;
+            afatfs.cacheDirtyEntries++;
+        } else {
+            afatfs_assert(afatfs_cacheSectorGetMemory(i) == buffer);
+
+            afatfs.cacheDescriptor[i].state = AFATFS_CACHE_STATE_IN_SYNC;
         }
     }
 }
@@ -717,13 +825,9 @@ static void afatfs_cacheFlushSector(int cacheIndex)
  */
 static afatfsCacheBlockDescriptor_t* afatfs_findCacheSector(uint32_t sectorIndex)
 {
-    for (int i = 0; i < AFATFS_NUM_CACHE_SECTORS; i++) {
-        if (afatfs.cacheDescriptor[i].sectorIndex == sectorIndex) {
-            return &afatfs.cacheDescriptor[i];
-        }
-    }
+    const int cacheIndex = afatfs_findCacheSectorIndex(sectorIndex);
 
-    return NULL;
+    return cacheIndex > -1 ? &afatfs.cacheDescriptor[cacheIndex] : NULL;
 }
 
 /**
@@ -733,7 +837,8 @@ static afatfsCacheBlockDescriptor_t* afatfs_findCacheSector(uint32_t sectorIndex
  * - The requested sector that already exists in the cache
  * - The index of an empty sector
  * - The index of a synced discardable sector
- * - The index of the oldest synced sector
+ * - The index of the oldest synced file data sector
+ * - The index of the oldest synced metadata sector
  *
  * Otherwise it returns -1 to signal failure (cache is full!)
  */
@@ -744,6 +849,8 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
 
     uint32_t oldestSyncedSectorLastUse = 0xFFFFFFFF;
     int oldestSyncedSectorIndex = -1;
+    uint32_t oldestSyncedMetadataSectorLastUse = 0xFFFFFFFF;
+    int oldestSyncedMetadataSectorIndex = -1;
 
     if (
         !afatfs_assert(
@@ -754,40 +861,51 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
         return -1;
     }
 
-    for (int i = 0; i < AFATFS_NUM_CACHE_SECTORS; i++) {
-        if (afatfs.cacheDescriptor[i].sectorIndex == sectorIndex) {
-            /*
-             * If the sector is actually empty then do a complete re-init of it just like the standard
-             * empty case. (Sectors marked as empty should be treated as if they don't have a block index assigned)
-             */
-            if (afatfs.cacheDescriptor[i].state == AFATFS_CACHE_STATE_EMPTY) {
-                emptyIndex = i;
-                break;
-            }
+    const int cachedIndex = afatfs_findCacheSectorIndex(sectorIndex);
 
+    if (cachedIndex > -1) {
+        /*
+         * If the sector is actually empty then do a complete re-init of it just like the standard
+         * empty case. (Sectors marked as empty should be treated as if they don't have a block index assigned)
+         */
+        if (afatfs.cacheDescriptor[cachedIndex].state != AFATFS_CACHE_STATE_EMPTY) {
+#ifdef AFATFS_DEBUG
+            if (afatfs.cacheDescriptor[cachedIndex].state != AFATFS_CACHE_STATE_READING) {
+                afatfs.cacheHits++;
+            }
+#endif
             // Bump the last access time
-            afatfs.cacheDescriptor[i].accessTimestamp = ++afatfs.cacheTimer;
-            return i;
+            afatfs.cacheDescriptor[cachedIndex].accessTimestamp = ++afatfs.cacheTimer;
+            return cachedIndex;
         }
 
-        switch (afatfs.cacheDescriptor[i].state) {
-            case AFATFS_CACHE_STATE_EMPTY:
-                emptyIndex = i;
-            break;
-            case AFATFS_CACHE_STATE_IN_SYNC:
-                // Is this a synced sector that we could evict from the cache?
-                if (!afatfs.cacheDescriptor[i].locked && afatfs.cacheDescriptor[i].retainCount == 0) {
-                    if (afatfs.cacheDescriptor[i].discardable) {
-                        discardableIndex = i;
-                    } else if (afatfs.cacheDescriptor[i].accessTimestamp < oldestSyncedSectorLastUse) {
-                        // This is older than last block we decided to evict, so evict this one in preference
-                        oldestSyncedSectorLastUse = afatfs.cacheDescriptor[i].accessTimestamp;
-                        oldestSyncedSectorIndex = i;
+        emptyIndex = cachedIndex;
+    } else {
+        for (int i = 0; i < AFATFS_NUM_CACHE_SECTORS; i++) {
+            switch (afatfs.cacheDescriptor[i].state) {
+                case AFATFS_CACHE_STATE_EMPTY:
+                    emptyIndex = i;
+                break;
+                case AFATFS_CACHE_STATE_IN_SYNC:
+                    // Is this a synced sector that we could evict from the cache?
+                    if (!afatfs.cacheDescriptor[i].locked && afatfs.cacheDescriptor[i].retainCount == 0) {
+                        if (afatfs.cacheDescriptor[i].discardable) {
+                            discardableIndex = i;
+                        } else if (afatfs.cacheDescriptor[i].metadata) {
+                            if (afatfs.cacheDescriptor[i].accessTimestamp < oldestSyncedMetadataSectorLastUse) {
+                                oldestSyncedMetadataSectorLastUse = afatfs.cacheDescriptor[i].accessTimestamp;
+                                oldestSyncedMetadataSectorIndex = i;
+                            }
+                        } else if (afatfs.cacheDescriptor[i].accessTimestamp < oldestSyncedSectorLastUse) {
+                            // This is older than last block we decided to evict, so evict this one in preference
+                            oldestSyncedSectorLastUse = afatfs.cacheDescriptor[i].accessTimestamp;
+                            oldestSyncedSectorIndex = i;
+                        }
                     }
-                }
-            break;
-            default:
-                ;
+                break;
+                default:
+                    ;
+            }
         }
     }
 
@@ -797,17 +915,35 @@ static int afatfs_allocateCacheSector(uint32_t sectorIndex)
         allocateIndex = discardableIndex;
     } else if (oldestSyncedSectorIndex > -1) {
         allocateIndex = oldestSyncedSectorIndex;
+    } else if (oldestSyncedMetadataSectorIndex > -1) {
+        allocateIndex = oldestSyncedMetadataSectorIndex;
     } else {
         allocateIndex = -1;
     }
 
     if (allocateIndex > -1) {
         afatfs_cacheSectorInit(&afatfs.cacheDescriptor[allocateIndex], sectorIndex, false);
+
+#ifdef AFATFS_DEBUG
+        afatfs.cacheMisses++;
+#endif
     }
 
     return allocateIndex;
 }
 
+/**
+ * Get the extra cache flags for sectors which hold the contents of the given file.
+ */
+static uint8_t afatfs_fileCacheFlags(afatfsFilePtr_t file)
+{
+    if (file->type == AFATFS_FILE_TYPE_DIRECTORY || file->type == AFATFS_FILE_TYPE_FAT16_ROOT_DIRECTORY) {
+        return AFATFS_CACHE_METADATA;
+    }
+
+    return 0;
+}
+
 /**
  * Attempt to flush dirty cache pages out to the sdcard, returning true if all flushable data has been flushed.
  */
@@ -933,7 +1069,7 @@ static afatfsOperationStatus_e afatfs_cacheSector(uint32_t physicalSectorIndex,
             if (eraseCount < AFATFS_MIN_MULTIPLE_BLOCK_WRITE_COUNT) {
                 eraseCount = 0;
             } else {
-                eraseCount = MIN(eraseCount, UINT16_MAX); // If caller asked for a longer chain of sectors we silently truncate that here
+                eraseCount = MIN(eraseCount, AFATFS_MAX_MULTIPLE_BLOCK_WRITE_COUNT); // If caller asked for a longer chain of sectors we silently truncate that here
             }
 
             afatfs.cacheDescriptor[cacheSectorIndex].consecutiveEraseBlockCount = eraseCount;
@@ -954,6 +1090,9 @@ static afatfsOperationStatus_e afatfs_cacheSector(uint32_t physicalSectorIndex,
             if ((sectorFlags & AFATFS_CACHE_RETAIN) != 0) {
                 afatfs.cacheDescriptor[cacheSectorIndex].retainCount++;
             }
+            if ((sectorFlags & AFATFS_CACHE_METADATA) != 0) {
+                afatfs.cacheDescriptor[cacheSectorIndex].metadata = 1;
+            }
 
             *buffer = afatfs_cacheSectorGetMemory(cacheSectorIndex);
 
@@ -1097,7 +1236,7 @@ static afatfsOperationStatus_e afatfs_FATGetNextCluster(int fatIndex, uint32_t c
 
     afatfs_getFATPositionForCluster(cluster, &fatSectorIndex, &fatSectorEntryIndex);
 
-    afatfsOperationStatus_e result = afatfs_cacheSector(afatfs_fatSectorToPhysical(fatIndex, fatSectorIndex), &sector.bytes, AFATFS_CACHE_READ, 0);
+    afatfsOperationStatus_e result = afatfs_cacheSector(afatfs_fatSectorToPhysical(fatIndex, fatSectorIndex), &sector.bytes, AFATFS_CACHE_READ | AFATFS_CACHE_METADATA, 0);
 
     if (result == AFATFS_OPERATION_SUCCESS) {
         if (afatfs.filesystemType == FAT_FILESYSTEM_TYPE_FAT16) {
@@ -1132,7 +1271,7 @@ static afatfsOperationStatus_e afatfs_FATSetNextCluster(uint32_t startCluster, u
 
     fatPhysicalSector = afatfs_fatSectorToPhysical(0, fatSectorIndex);
 
-    result = afatfs_cacheSector(fatPhysicalSector, &sector.bytes, AFATFS_CACHE_READ | AFATFS_CACHE_WRITE, 0);
+    result = afatfs_cacheSector(fatPhysicalSector, &sector.bytes, AFATFS_CACHE_READ | AFATFS_CACHE_WRITE | AFATFS_CACHE_METADATA, 0);
 
     if (result == AFATFS_OPERATION_SUCCESS) {
         if (afatfs.filesystemType == FAT_FILESYSTEM_TYPE_FAT16) {
@@ -1438,7 +1577,7 @@ static afatfsOperationStatus_e afatfs_saveDirectoryEntry(afatfsFilePtr_t file, a
         return AFATFS_OPERATION_SUCCESS; // Root directories don't have a directory entry
     }
 
-    result = afatfs_cacheSector(file->directoryEntryPos.sectorNumberPhysical, &sector, AFATFS_CACHE_READ | AFATFS_CACHE_WRITE, 0);
+    result = afatfs_cacheSector(file->directoryEntryPos.sectorNumberPhysical, &sector, AFATFS_CACHE_READ | AFATFS_CACHE_WRITE | AFATFS_CACHE_METADATA, 0);
 
 #ifdef AFATFS_DEBUG_VERBOSE
     fprintf(stderr, "Saving directory entry to sector %u...\n", file->directoryEntryPos.sectorNumberPhysical);
@@ -1642,15 +1781,21 @@ static afatfsOperationStatus_e afatfs_appendSuperclusterContinue(afatfsFile_t *f
     afatfsAppendSupercluster_t *opState = &file->operation.state.appendSupercluster;
 
     afatfsOperationStatus_e status;
+    uint32_t superclusterCount;
 
     doMore:
     switch (opState->phase) {
         case AFATFS_APPEND_SUPERCLUSTER_PHASE_INIT:
-            // Our file steals the first cluster of the freefile
+            // Our file steals the first supercluster of the freefile (or the first few if the file is preallocated)
+            superclusterCount = 1;
+
+            if ((file->mode & AFATFS_FILE_MODE_PREALLOCATE) != 0) {
+                superclusterCount = MIN(AFATFS_PREALLOCATE_SUPERCLUSTERS, afatfs.freeFile.logicalSize / afatfs_superClusterSize());
+            }
 
             // We can go ahead and write to that space before the FAT and directory are updated
             file->cursorCluster = afatfs.freeFile.firstCluster;
-            file->physicalSize += afatfs_superClusterSize();
+            file->physicalSize += superclusterCount * afatfs_superClusterSize();
 
             /* Remove the first supercluster from the freefile
              *
@@ -1660,18 +1805,37 @@ static afatfsOperationStatus_e afatfs_appendSuperclusterContinue(afatfsFile_t *f
              * Note that normally the freefile can't become empty because it is allocated as a non-integer number
              * of superclusters to avoid precisely this situation.
              */
-            afatfs.freeFile.firstCluster += afatfs_fatEntriesPerSector();
-            afatfs.freeFile.logicalSize -= afatfs_superClusterSize();
-            afatfs.freeFile.physicalSize -= afatfs_superClusterSize();
+            afatfs.freeFile.firstCluster += superclusterCount * afatfs_fatEntriesPerSector();
+            afatfs.freeFile.logicalSize -= superclusterCount * afatfs_superClusterSize();
+            afatfs.freeFile.physicalSize -= superclusterCount * afatfs_superClusterSize();
 
-            // The new supercluster needs to have its clusters chained contiguously and marked with a terminator at the end
+            // The new superclusters need to have their clusters chained contiguously and marked with a terminator at the end
             opState->fatRewriteStartCluster = file->cursorCluster;
-            opState->fatRewriteEndCluster = opState->fatRewriteStartCluster + afatfs_fatEntriesPerSector();
+            opState->fatRewriteEndCluster = opState->fatRewriteStartCluster + superclusterCount * afatfs_fatEntriesPerSector();
+            opState->fatLinkStartCluster = 0;
+
+            if ((file->mode & AFATFS_FILE_MODE_PREALLOCATE) != 0) {
+                file->preallocatedEndCluster = opState->fatRewriteEndCluster;
+
+                /*
+                 * The freefile's clusters are already chained contiguously, so only the FAT sector of the last
+                 * supercluster in the run needs a terminator. This keeps the metadata written per run down to what a
+                 * single supercluster append costs, instead of a burst of FAT sectors that competes with the log data
+                 * for the cache.
+                 */
+                opState->fatRewriteStartCluster = opState->fatRewriteEndCluster - afatfs_fatEntriesPerSector();
+
+                if (opState->previousCluster != 0) {
+                    // Once the run is terminated, unterminate the supercluster that used to end the file to link it on
+                    opState->fatLinkStartCluster = file->cursorCluster - afatfs_fatEntriesPerSector();
+                    opState->fatLinkEndCluster = file->cursorCluster;
+                }
+            }
 
             if (opState->previousCluster == 0) {
                 // This is the new first cluster in the file so we need to update the directory entry
                 file->firstCluster = file->cursorCluster;
-            } else {
+            } else if (opState->fatLinkStartCluster == 0) {
                 /*
                  * We also need to update the FAT of the supercluster that used to end the file so that it no longer
                  * terminates there
@@ -1695,10 +1859,24 @@ static afatfsOperationStatus_e afatfs_appendSuperclusterContinue(afatfsFile_t *f
             status = afatfs_FATFillWithPattern(AFATFS_FAT_PATTERN_TERMINATED_CHAIN, &opState->fatRewriteStartCluster, opState->fatRewriteEndCluster);
 
             if (status == AFATFS_OPERATION_SUCCESS) {
-                opState->phase = AFATFS_APPEND_SUPERCLUSTER_PHASE_UPDATE_FILE_DIRECTORY;
+                opState->phase = AFATFS_APPEND_SUPERCLUSTER_PHASE_LINK_FAT;
                 goto doMore;
             }
         break;
+        case AFATFS_APPEND_SUPERCLUSTER_PHASE_LINK_FAT:
+            if (opState->fatLinkStartCluster != 0) {
+                status = afatfs_FATFillWithPattern(AFATFS_FAT_PATTERN_UNTERMINATED_CHAIN, &opState->fatLinkStartCluster, opState->fatLinkEndCluster);
+
+                if (status != AFATFS_OPERATION_SUCCESS) {
+                    break;
+                }
+
+                opState->fatLinkStartCluster = 0;
+            }
+
+            opState->phase = AFATFS_APPEND_SUPERCLUSTER_PHASE_UPDATE_FILE_DIRECTORY;
+            goto doMore;
+        break;
         case AFATFS_APPEND_SUPERCLUSTER_PHASE_UPDATE_FILE_DIRECTORY:
             // Update the fileSize/firstCluster in the directory entry for the file
             status = afatfs_saveDirectoryEntry(file, AFATFS_SAVE_DIRECTORY_NORMAL);
@@ -1817,7 +1995,7 @@ static uint8_t* afatfs_fileRetainCursorSectorForRead(afatfsFilePtr_t file)
         afatfsOperationStatus_e status = afatfs_cacheSector(
             physicalSector,
             &result,
-            AFATFS_CACHE_READ | AFATFS_CACHE_RETAIN,
+            AFATFS_CACHE_READ | AFATFS_CACHE_RETAIN | afatfs_fileCacheFlags(file),
             0
         );
 
@@ -1862,7 +2040,7 @@ static uint8_t* afatfs_fileLockCursorSectorForWrite(afatfsFilePtr_t file)
         }
 
         uint32_t physicalSector = afatfs_fileGetCursorPhysicalSector(file);
-        uint8_t cacheFlags = AFATFS_CACHE_WRITE | AFATFS_CACHE_LOCK;
+        uint8_t cacheFlags = AFATFS_CACHE_WRITE | AFATFS_CACHE_LOCK | afatfs_fileCacheFlags(file);
         uint32_t cursorOffsetInSector = file->cursorOffset % AFATFS_SECTOR_SIZE;
         uint32_t offsetOfStartOfSector = file->cursorOffset & ~((uint32_t) AFATFS_SECTOR_SIZE - 1);
         uint32_t offsetOfEndOfSector = offsetOfStartOfSector + AFATFS_SECTOR_SIZE;
@@ -1878,11 +2056,15 @@ static uint8_t* afatfs_fileLockCursorSectorForWrite(afatfsFilePtr_t file)
             cacheFlags |= AFATFS_CACHE_READ;
         }
 
-        // In contiguous append mode, we'll pre-erase the whole supercluster
+        // In contiguous append mode, we'll pre-erase the whole supercluster (or the whole preallocated run)
         if ((file->mode & (AFATFS_FILE_MODE_APPEND | AFATFS_FILE_MODE_CONTIGUOUS)) == (AFATFS_FILE_MODE_APPEND | AFATFS_FILE_MODE_CONTIGUOUS)) {
-            uint32_t cursorOffsetInSupercluster = file->cursorOffset & (afatfs_superClusterSize() - 1);
+            if ((file->mode & AFATFS_FILE_MODE_PREALLOCATE) != 0) {
+                eraseBlockCount = (file->physicalSize - offsetOfStartOfSector) / AFATFS_SECTOR_SIZE;
+            } else {
+                uint32_t cursorOffsetInSupercluster = file->cursorOffset & (afatfs_superClusterSize() - 1);
 
-            eraseBlockCount = afatfs_fatEntriesPerSector() * afatfs.sectorsPerCluster - cursorOffsetInSupercluster / AFATFS_SECTOR_SIZE;
+                eraseBlockCount = afatfs_fatEntriesPerSector() * afatfs.sectorsPerCluster - cursorOffsetInSupercluster / AFATFS_SECTOR_SIZE;
+            }
         } else {
             eraseBlockCount = 0;
         }
@@ -2218,7 +2400,7 @@ static afatfsOperationStatus_e afatfs_extendSubdirectoryContinue(afatfsFile_t *d
             physicalSector = afatfs_fileGetCursorPhysicalSector(directory);
 
             while (1) {
-                status = afatfs_cacheSector(physicalSector, &sectorBuffer, AFATFS_CACHE_WRITE, 0);
+                status = afatfs_cacheSector(physicalSector, &sectorBuffer, AFATFS_CACHE_WRITE | AFATFS_CACHE_METADATA, 0);
 
                 if (status != AFATFS_OPERATION_SUCCESS) {
                     return status;
@@ -2637,7 +2819,7 @@ static void afatfs_createFileContinue(afatfsFile_t *file)
                 status = afatfs_cacheSector(
                     file->directoryEntryPos.sectorNumberPhysical,
                     &directorySector,
-                    AFATFS_CACHE_READ | AFATFS_CACHE_RETAIN,
+                    AFATFS_CACHE_READ | AFATFS_CACHE_RETAIN | AFATFS_CACHE_METADATA,
                     0
                 );
 
@@ -2664,7 +2846,7 @@ static void afatfs_createFileContinue(afatfsFile_t *file)
 #endif
             } else {
                 // We can't guarantee that the existing file contents are contiguous
-                file->mode &= ~AFATFS_FILE_MODE_CONTIGUOUS;
+                file->mode &= ~(AFATFS_FILE_MODE_CONTIGUOUS | AFATFS_FILE_MODE_PREALLOCATE);
 
                 // Seek to the end of the file if it is in append mode
                 if ((file->mode & AFATFS_FILE_MODE_APPEND) != 0) {
@@ -2804,11 +2986,114 @@ static afatfsFilePtr_t afatfs_createFile(afatfsFilePtr_t file, const char *name,
     return file;
 }
 
+#ifdef AFATFS_USE_FREEFILE
+
+/**
+ * Give the preallocated superclusters that the file didn't use back to the freefile. The file's FAT chain is terminated
+ * first and the freefile's directory entry is updated last, so losing power part way through only leaks clusters and
+ * never cross-links the file with the freefile.
+ *
+ * Returns:
+ *     AFATFS_OPERATION_SUCCESS     - On completion
+ *     AFATFS_OPERATION_IN_PROGRESS - Operation still in progress
+ */
+static afatfsOperationStatus_e afatfs_closeReturnPreallocatedClusters(afatfsFilePtr_t file)
+{
+    afatfsCloseFile_t *opState = &file->operation.state.closeFile;
+    afatfsOperationStatus_e status;
+    uint32_t keepClusters, keepEndCluster, returnedBytes;
+
+    doMore:
+    switch (opState->phase) {
+        case AFATFS_CLOSE_FILE_PHASE_INITIAL:
+            keepClusters = (file->logicalSize + afatfs_superClusterSize() - 1) / afatfs_superClusterSize() * afatfs_fatEntriesPerSector();
+            keepEndCluster = file->firstCluster + keepClusters;
+
+            /*
+             * We can only hand clusters back if our run still ends where the freefile begins. If anything else took
+             * clusters from the freefile since, returning ours would cross-link them, so leave the file's allocation
+             * alone instead.
+             */
+            if (file->firstCluster == 0 || file->preallocatedEndCluster != afatfs.freeFile.firstCluster
+                    || keepEndCluster >= afatfs.freeFile.firstCluster) {
+                opState->phase = AFATFS_CLOSE_FILE_PHASE_SAVE_DIRECTORY;
+                goto doMore;
+            }
+
+            returnedBytes = (afatfs.freeFile.firstCluster - keepEndCluster) * afatfs_clusterSize();
+
+            opState->fatRewriteStartCluster = keepEndCluster - afatfs_fatEntriesPerSector();
+            opState->fatRewriteEndCluster = keepEndCluster;
+            opState->returnEndCluster = afatfs.freeFile.firstCluster;
+
+            afatfs.freeFile.firstCluster = keepEndCluster;
+            afatfs.freeFile.logicalSize += returnedBytes;
+            afatfs.freeFile.physicalSize += returnedBytes;
+
+            file->physicalSize -= returnedBytes;
+
+            if (keepClusters == 0) {
+                // Nothing was written, so the file gives up all of its clusters
+                file->firstCluster = 0;
+
+                opState->fatRewriteStartCluster = keepEndCluster;
+                opState->phase = AFATFS_CLOSE_FILE_PHASE_RETURN_CLUSTERS;
+            } else {
+                opState->phase = AFATFS_CLOSE_FILE_PHASE_TERMINATE_CHAIN;
+            }
+            goto doMore;
+        break;
+        case AFATFS_CLOSE_FILE_PHASE_TERMINATE_CHAIN:
+            status = afatfs_FATFillWithPattern(AFATFS_FAT_PATTERN_TERMINATED_CHAIN, &opState->fatRewriteStartCluster, opState->fatRewriteEndCluster);
+
+            if (status == AFATFS_OPERATION_SUCCESS) {
+                opState->phase = AFATFS_CLOSE_FILE_PHASE_RETURN_CLUSTERS;
+                goto doMore;
+            }
+
+            return status;
+        break;
+        case AFATFS_CLOSE_FILE_PHASE_RETURN_CLUSTERS:
+            // Chain the returned clusters onto the front of the freefile's chain
+            status = afatfs_FATFillWithPattern(AFATFS_FAT_PATTERN_UNTERMINATED_CHAIN, &opState->fatRewriteStartCluster, opState->returnEndCluster);
+
+            if (status == AFATFS_OPERATION_SUCCESS) {
+                opState->phase = AFATFS_CLOSE_FILE_PHASE_UPDATE_FREEFILE_DIRECTORY;
+                goto doMore;
+            }
+
+            return status;
+        break;
+        case AFATFS_CLOSE_FILE_PHASE_UPDATE_FREEFILE_DIRECTORY:
+            status = afatfs_saveDirectoryEntry(&afatfs.freeFile, AFATFS_SAVE_DIRECTORY_NORMAL);
+
+            if (status == AFATFS_OPERATION_SUCCESS) {
+                opState->phase = AFATFS_CLOSE_FILE_PHASE_SAVE_DIRECTORY;
+                goto doMore;
+            }
+
+            return status;
+        break;
+        case AFATFS_CLOSE_FILE_PHASE_SAVE_DIRECTORY:
+        break;
+    }
+
+    return AFATFS_OPERATION_SUCCESS;
+}
+
+#endif
+
 static void afatfs_fcloseContinue(afatfsFilePtr_t file)
 {
     afatfsCacheBlockDescriptor_t *descriptor;
     afatfsCloseFile_t *opState = &file->operation.state.closeFile;
 
+#ifdef AFATFS_USE_FREEFILE
+    if ((file->mode & AFATFS_FILE_MODE_PREALLOCATE) != 0 && afatfs_closeReturnPreallocatedClusters(file) != AFATFS_OPERATION_SUCCESS) {
+        return;
+    }
+#endif
+
     /*
      * Directories don't update their parent directory entries over time, because their fileSize field in the directory
      * never changes (when we add the first cluster to the directory we save the directory entry at that point and it
@@ -2871,6 +3156,7 @@ bool afatfs_fclose(afatfsFilePtr_t file, afatfsCallback_t callback)
 
         file->operation.operation = AFATFS_FILE_OPERATION_CLOSE;
         file->operation.state.closeFile.callback = callback;
+        file->operation.state.closeFile.phase = AFATFS_CLOSE_FILE_PHASE_INITIAL;
         afatfs_fcloseContinue(file);
         return true;
     }
@@ -2960,6 +3246,9 @@ bool afatfs_chdir(afatfsFilePtr_t directory)
  * ws   If the file is already non-empty or freefile support is not compiled in then it will fall back to non-contiguous
  *      operation.
  *
+ * al - Like "as", but for logs: several superclusters are preallocated at a time so that the file can be streamed to
+ *      the card as one long multi-block write, and the superclusters that weren't used are given back on close.
+ *
  * All other mode strings are illegal. In particular, don't add "b" to the end of the mode string.
  *
  * Returns false if the the open failed really early (out of file handles).
@@ -2992,6 +3281,11 @@ bool afatfs_fopen(const char *filename, const char *mode, afatfsFileCallback_t c
         case 's':
 #ifdef AFATFS_USE_FREEFILE
             fileMode |= AFATFS_FILE_MODE_CONTIGUOUS | AFATFS_FILE_MODE_RETAIN_DIRECTORY;
+#endif
+        break;
+        case 'l':
+#ifdef AFATFS_USE_FREEFILE
+            fileMode |= AFATFS_FILE_MODE_CONTIGUOUS | AFATFS_FILE_MODE_RETAIN_DIRECTORY | AFATFS_FILE_MODE_PREALLOCATE;
 #endif
         break;
     }
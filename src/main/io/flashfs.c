@@ -23,7 +23,16 @@
  * flash chip is full.
  *
  * Note that bits can only be set to 0 when writing, not back to 1 from 0. You must erase sectors in order
- * to bring bits back to 1 again.
+ * to bring bits back to 1 again. flashfsUpdate() should be called periodically from a low priority task to erase
+ * sectors ahead of the write position while the flash is otherwise idle, so the chip doesn't have to be wiped before
+ * recording. In ring mode, writing wraps around from the end of the device to the start, and the erase ahead
+ * overwrites the oldest data.
+ *
+ * The last sector of the chip isn't used for data. In ring mode it holds a journal of the sectors the tail has moved
+ * into, so that the end of the wrapped data can be found at boot with a few reads instead of walking every sector. If
+ * that sector holds anything else, such as logs written by firmware that didn't keep a journal, it's never erased
+ * behind the user's back. Every sector is walked at boot instead, until the user erases the flash. Outside ring mode
+ * the data always starts at the beginning of the device, so a binary search finds its end and no journal is kept.
  *
  * In future, we can add support for multiple different flash chips by adding a flash device driver vtable
  * and make calls through that, at the moment flashfs just calls m25p16_* routines explicitly.
@@ -33,9 +42,35 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include "common/maths.h"
+
 #include "drivers/flash_m25p16.h"
 #include "flashfs.h"
 
+// How long after the last write the log is considered to be finished, so that erasing ahead won't stall it
+#define FLASHFS_IDLE_TIMEOUT_US 1000000
+
+enum {
+    /* Erased space is recognised by looking at the start of blocks of this size. We can choose whatever power of 2
+     * size we like, which determines how much wastage of free space we'll have at the end of the last written data.
+     * But smaller blocksizes will require more searching.
+     */
+    FREE_BLOCK_SIZE = 2048,
+
+    /* We don't expect valid data to ever contain this many consecutive uint32_t's of all 1 bits: */
+    FREE_BLOCK_TEST_SIZE_INTS = 4, // i.e. 16 bytes
+    FREE_BLOCK_TEST_SIZE_BYTES = FREE_BLOCK_TEST_SIZE_INTS * sizeof(uint32_t),
+};
+
+/*
+ * An entry is appended to the journal each time the tail moves into a new sector, recording the address of that
+ * sector. Entries are never modified, the journal sector is erased when it fills up.
+ */
+typedef struct flashfsJournalEntry_s {
+    uint32_t address;
+    uint32_t addressComplement; // ~address, so that erased and partially programmed entries can be told apart
+} flashfsJournalEntry_t;
+
 static uint8_t flashWriteBuffer[FLASHFS_WRITE_BUFFER_SIZE];
 
 /* The position of our head and tail in the circular flash write buffer.
@@ -45,11 +80,33 @@ static uint8_t flashWriteBuffer[FLASHFS_WRITE_BUFFER_SIZE];
  *
  * When the circular buffer is empty, head == tail
  */
-static uint8_t bufferHead = 0, bufferTail = 0;
+static uint16_t bufferHead = 0, bufferTail = 0;
 
 // The position of the buffer's tail in the overall flash address space:
 static uint32_t tailAddress = 0;
 
+// The number of bytes starting at the tail address that are known to be erased and ready to be programmed
+static uint32_t erasedBytesAhead = 0;
+
+// True if writing wraps around to the start of the device instead of stopping at the end
+static bool ringMode = false;
+
+// Set when data has been written since the last flashfsUpdate(), i.e. a log is being recorded
+static bool writtenSinceUpdate = false;
+static timeUs_t lastWriteTimeUs = 0;
+
+// Likewise for reads, e.g. a log being downloaded over MSP. Erasing ahead is paused while they go on.
+static bool readSinceUpdate = false;
+static bool readActive = false;
+static timeUs_t lastReadTimeUs = 0;
+
+// Index of the next free journal entry, or -1 if the journal is disabled because its sector holds something else
+static int32_t journalNextEntry = -1;
+
+// Set when the tail has moved into a new sector that hasn't been added to the journal yet
+static bool journalPending = false;
+static uint32_t journalPendingAddress = 0;
+
 static void flashfsClearBuffer(void)
 {
     bufferTail = bufferHead = 0;
@@ -60,9 +117,57 @@ static bool flashfsBufferIsEmpty(void)
     return bufferTail == bufferHead;
 }
 
+/**
+ * Queue the sector the given address lies in to be added to the journal by flashfsUpdate().
+ */
+static void flashfsJournalRecord(uint32_t address)
+{
+    journalPending = true;
+    journalPendingAddress = address - address % m25p16_getGeometry()->sectorSize;
+}
+
+/**
+ * In ring mode, bring an address that ran past the end of the device back around to the start.
+ */
+static uint32_t flashfsWrapAddress(uint32_t address)
+{
+    if (ringMode && address >= flashfsGetSize()) {
+        return address - flashfsGetSize();
+    }
+
+    return address;
+}
+
+/**
+ * Move the tail to an arbitrary address. Only the rest of the sector that address lies in is assumed to be erased.
+ */
 static void flashfsSetTailAddress(uint32_t address)
 {
+    const uint32_t sectorSize = m25p16_getGeometry()->sectorSize;
+
     tailAddress = address;
+
+    if (sectorSize > 0 && address < flashfsGetSize() && address % sectorSize > 0) {
+        erasedBytesAhead = sectorSize - address % sectorSize;
+    } else {
+        erasedBytesAhead = 0;
+    }
+}
+
+/**
+ * Called after bytes have been programmed at the tail address to move the tail past them.
+ */
+static void flashfsAdvanceTailAddress(uint32_t delta)
+{
+    const uint32_t sectorSize = m25p16_getGeometry()->sectorSize;
+    const uint32_t previousSector = tailAddress / sectorSize;
+
+    tailAddress = flashfsWrapAddress(tailAddress + delta);
+    erasedBytesAhead -= delta;
+
+    if (tailAddress / sectorSize != previousSector && tailAddress < flashfsGetSize()) {
+        flashfsJournalRecord(tailAddress);
+    }
 }
 
 void flashfsEraseCompletely(void)
@@ -71,7 +176,14 @@ void flashfsEraseCompletely(void)
 
     flashfsClearBuffer();
 
-    flashfsSetTailAddress(0);
+    tailAddress = 0;
+    erasedBytesAhead = flashfsGetSize();
+
+    // The journal was erased along with everything else
+    if (ringMode) {
+        journalNextEntry = 0;
+        flashfsJournalRecord(0);
+    }
 }
 
 /**
@@ -109,9 +221,14 @@ bool flashfsIsReady(void)
     return m25p16_isReady();
 }
 
+/**
+ * Get the size of the space available for data, which is everything but the journal sector at the end of the chip.
+ */
 uint32_t flashfsGetSize(void)
 {
-    return m25p16_getGeometry()->totalSize;
+    const flashGeometry_t *geometry = m25p16_getGeometry();
+
+    return geometry->totalSize - geometry->sectorSize;
 }
 
 static uint32_t flashfsTransmitBufferUsed(void)
@@ -122,6 +239,14 @@ static uint32_t flashfsTransmitBufferUsed(void)
     return FLASHFS_WRITE_BUFFER_SIZE - bufferTail + bufferHead;
 }
 
+/**
+ * The number of bytes that will complete the flash page the tail is currently in.
+ */
+static uint32_t flashfsPageRemaining(void)
+{
+    return M25P16_PAGESIZE - tailAddress % M25P16_PAGESIZE;
+}
+
 /**
  * Get the size of the largest single write that flashfs could ever accept without blocking or data loss.
  */
@@ -143,6 +268,203 @@ const flashGeometry_t* flashfsGetGeometry(void)
     return m25p16_getGeometry();
 }
 
+/**
+ * Returns true if the block at the given address looks erased (see FREE_BLOCK_TEST_SIZE_INTS). A block that couldn't
+ * be read is reported as not erased.
+ */
+static bool flashfsBlockIsErased(uint32_t address)
+{
+    union {
+        uint8_t bytes[FREE_BLOCK_TEST_SIZE_BYTES];
+        uint32_t ints[FREE_BLOCK_TEST_SIZE_INTS];
+    } testBuffer;
+
+    if (m25p16_readBytes(address, testBuffer.bytes, FREE_BLOCK_TEST_SIZE_BYTES) < FREE_BLOCK_TEST_SIZE_BYTES) {
+        return false;
+    }
+
+    // Checking the buffer 4 bytes at a time like this is probably faster than byte-by-byte, but I didn't benchmark it :)
+    for (int i = 0; i < FREE_BLOCK_TEST_SIZE_INTS; i++) {
+        if (testBuffer.ints[i] != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool flashfsSectorIsErased(uint32_t address)
+{
+    const uint32_t sectorSize = m25p16_getGeometry()->sectorSize;
+
+    for (uint32_t offset = 0; offset < sectorSize; offset += FREE_BLOCK_SIZE) {
+        if (!flashfsBlockIsErased(address + offset)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Extend the erased space ahead of the tail by one sector, starting an erase of that sector if it still holds old
+ * data. The erase runs in the background, the flash won't be ready until it completes.
+ *
+ * Returns false if the flash was busy, or if there is no sector left that can be erased.
+ */
+static bool flashfsEraseAheadStep(void)
+{
+    const flashGeometry_t *geometry = m25p16_getGeometry();
+
+    if (geometry->sectorSize == 0) {
+        return false;
+    }
+
+    if (ringMode) {
+        // Never wrap around far enough to erase the sector the tail is in
+        if (tailAddress % geometry->sectorSize + erasedBytesAhead + geometry->sectorSize > flashfsGetSize()) {
+            return false;
+        }
+    } else if (tailAddress + erasedBytesAhead >= flashfsGetSize()) {
+        return false;
+    }
+
+    if (!m25p16_isReady()) {
+        return false;
+    }
+
+    const uint32_t sectorAddress = flashfsWrapAddress(tailAddress + erasedBytesAhead);
+
+    if (!flashfsSectorIsErased(sectorAddress)) {
+        m25p16_eraseSector(sectorAddress);
+    }
+
+    erasedBytesAhead += geometry->sectorSize;
+
+    return true;
+}
+
+/**
+ * The amount of space flashfsUpdate() keeps erased ahead of the tail while no log is being recorded.
+ */
+static uint32_t flashfsEraseAheadTarget(void)
+{
+    const flashGeometry_t *geometry = m25p16_getGeometry();
+
+    return MAX(geometry->sectorSize, MIN((uint32_t)FLASHFS_ERASE_AHEAD_SIZE, flashfsGetSize() / 4));
+}
+
+static uint32_t flashfsJournalCapacity(void)
+{
+    return m25p16_getGeometry()->sectorSize / sizeof(flashfsJournalEntry_t);
+}
+
+static bool flashfsReadJournalEntry(int index, flashfsJournalEntry_t *entry)
+{
+    return m25p16_readBytes(flashfsGetSize() + index * sizeof(*entry), (uint8_t *) entry, sizeof(*entry)) == sizeof(*entry);
+}
+
+static bool flashfsJournalEntryIsValid(const flashfsJournalEntry_t *entry)
+{
+    return entry->address == ~entry->addressComplement && entry->address < flashfsGetSize()
+        && entry->address % m25p16_getGeometry()->sectorSize == 0;
+}
+
+/**
+ * Find the sector address recorded by the newest entry in the journal, and where the next entry will go.
+ *
+ * Returns false if the journal has no usable entry.
+ */
+static bool flashfsReadJournal(uint32_t *address)
+{
+    flashfsJournalEntry_t entry;
+
+    // Entries are appended in order, so binary search for the first erased one
+    int left = 0;
+    int right = flashfsJournalCapacity();
+    int mid;
+    int firstErased = right;
+
+    while (left < right) {
+        mid = (left + right) / 2;
+
+        if (!flashfsReadJournalEntry(mid, &entry)) {
+            // Unexpected timeout from flash, leave the journal alone until the next boot
+            journalNextEntry = -1;
+            return false;
+        }
+
+        if (entry.address == 0xFFFFFFFF && entry.addressComplement == 0xFFFFFFFF) {
+            firstErased = mid;
+            right = mid;
+        } else {
+            left = mid + 1;
+        }
+    }
+
+    if (firstErased == 0) {
+        // Only start a journal in the sector if it really is empty, it could hold the end of an old log
+        journalNextEntry = flashfsSectorIsErased(flashfsGetSize()) ? 0 : -1;
+        return false;
+    }
+
+    journalNextEntry = firstErased;
+
+    // The newest entry might have been cut short by a power loss, if so the one before it will do
+    for (int i = firstErased - 1; i >= 0 && i >= firstErased - 2; i--) {
+        if (flashfsReadJournalEntry(i, &entry) && flashfsJournalEntryIsValid(&entry)) {
+            *address = entry.address;
+            return true;
+        }
+    }
+
+    // Whatever is in the journal sector isn't a journal, it might be log data so don't touch it
+    journalNextEntry = -1;
+
+    return false;
+}
+
+/**
+ * Append the pending entry to the journal, or erase the journal sector if it's full.
+ */
+static void flashfsJournalUpdate(bool idle)
+{
+    if (journalNextEntry < 0) {
+        journalPending = false;
+        return;
+    }
+
+    if (!m25p16_isReady()) {
+        return;
+    }
+
+    if (journalNextEntry >= (int32_t) flashfsJournalCapacity()) {
+        // Erasing stalls the flash, so wait until the log has been finished
+        if (idle) {
+            m25p16_eraseSector(flashfsGetSize());
+
+            journalNextEntry = 0;
+
+            if (tailAddress < flashfsGetSize()) {
+                flashfsJournalRecord(tailAddress);
+            }
+        }
+        return;
+    }
+
+    if (journalPending) {
+        const flashfsJournalEntry_t entry = {
+            .address = journalPendingAddress,
+            .addressComplement = ~journalPendingAddress,
+        };
+
+        m25p16_pageProgram(flashfsGetSize() + journalNextEntry * sizeof(entry), (const uint8_t *) &entry, sizeof(entry));
+
+        journalNextEntry++;
+        journalPending = false;
+    }
+}
+
 /**
  * Write the given buffers to flash sequentially at the current tail address, advancing the tail address after
  * each write.
@@ -152,9 +474,12 @@ const flashGeometry_t* flashfsGetGeometry(void)
  * In asynchronous mode, if the flash is busy, then the write is aborted and the routine returns immediately.
  * In this case the returned number of bytes written will be less than the total amount requested.
  *
+ * Pages are only programmed once they have been erased. If the erased space ahead of the tail has run out, an erase
+ * of the next sector is started, which an asynchronous write won't wait for.
+ *
  * Modifies the supplied buffer pointers and sizes to reflect how many bytes remain in each of them.
  *
- * bufferCount: the number of buffers provided
+ * bufferCount: the number of buffers provided (at most M25P16_MAX_PROGRAM_BUFFERS)
  * buffers: an array of pointers to the beginning of buffers
  * bufferSizes: an array of the sizes of those buffers
  * sync: true if we should wait for the device to be idle before writes, otherwise if the device is busy the
@@ -172,10 +497,6 @@ static uint32_t flashfsWriteBuffers(uint8_t const **buffers, uint32_t *bufferSiz
         bytesTotal += bufferSizes[i];
     }
 
-    if (!sync && !m25p16_isReady()) {
-        return 0;
-    }
-
     uint32_t bytesTotalRemaining = bytesTotal;
 
     while (bytesTotalRemaining > 0) {
@@ -201,35 +522,51 @@ static uint32_t flashfsWriteBuffers(uint8_t const **buffers, uint32_t *bufferSiz
             break;
         }
 
+        if (erasedBytesAhead < bytesTotalThisIteration) {
+            if (sync) {
+                m25p16_waitForReady(M25P16_SECTOR_ERASE_TIMEOUT_MILLIS);
+            }
+
+            if (!flashfsEraseAheadStep()) {
+                break;
+            }
+        }
+
+        if (sync) {
+            // A background erase can keep the flash busy for much longer than a page program does
+            m25p16_waitForReady(M25P16_SECTOR_ERASE_TIMEOUT_MILLIS);
+        } else if (!m25p16_isReady()) {
+            break;
+        }
+
+        uint8_t const * pageBuffers[M25P16_MAX_PROGRAM_BUFFERS];
+        uint32_t pageBufferSizes[M25P16_MAX_PROGRAM_BUFFERS];
+        int pageBufferCount = 0;
+
         bytesRemainThisIteration = bytesTotalThisIteration;
 
-        for (i = 0; i < bufferCount; i++) {
+        // Gather the pieces of this page from each buffer so the whole page can be programmed in one operation
+        for (i = 0; i < bufferCount && bytesRemainThisIteration > 0; i++) {
             if (bufferSizes[i] > 0) {
-                // Is buffer larger than our write limit? Write our limit out of it
-                if (bufferSizes[i] >= bytesRemainThisIteration) {
-                    currentFlashAddress = m25p16_pageProgram(currentFlashAddress, buffers[i], bytesRemainThisIteration);
-
-                    buffers[i] += bytesRemainThisIteration;
-                    bufferSizes[i] -= bytesRemainThisIteration;
+                uint32_t bytesFromBuffer = bufferSizes[i] < bytesRemainThisIteration ? bufferSizes[i] : bytesRemainThisIteration;
 
-                    bytesRemainThisIteration = 0;
-                    break;
-                } else {
-                    // We'll still have more to write after finishing this buffer off
-                    currentFlashAddress = m25p16_pageProgram(currentFlashAddress, buffers[i], bufferSizes[i]);
+                pageBuffers[pageBufferCount] = buffers[i];
+                pageBufferSizes[pageBufferCount] = bytesFromBuffer;
+                pageBufferCount++;
 
-                    bytesRemainThisIteration -= bufferSizes[i];
+                buffers[i] += bytesFromBuffer;
+                bufferSizes[i] -= bytesFromBuffer;
 
-                    buffers[i] += bufferSizes[i];
-                    bufferSizes[i] = 0;
-                }
+                bytesRemainThisIteration -= bytesFromBuffer;
             }
         }
 
+        m25p16_pageProgramBuffers(currentFlashAddress, pageBuffers, pageBufferSizes, pageBufferCount);
+
         bytesTotalRemaining -= bytesTotalThisIteration;
 
         // Advance the cursor in the file system to match the bytes we wrote
-        flashfsSetTailAddress(tailAddress + bytesTotalThisIteration);
+        flashfsAdvanceTailAddress(bytesTotalThisIteration);
 
         /*
          * We'll have to wait for that write to complete before we can issue the next one, so if
@@ -274,7 +611,7 @@ uint32_t flashfsGetOffset(void)
 
     flashfsGetDirtyDataBuffers(buffers, bufferSizes);
 
-    return tailAddress + bufferSizes[0] + bufferSizes[1];
+    return flashfsWrapAddress(tailAddress + bufferSizes[0] + bufferSizes[1]);
 }
 
 /**
@@ -317,6 +654,19 @@ bool flashfsFlushAsync(void)
     return flashfsBufferIsEmpty();
 }
 
+/**
+ * If a complete flash page is waiting in the buffer and the flash is ready to accept writes, program that page.
+ *
+ * Partially filled pages are left in the buffer to be completed, so that each page is written in one program
+ * operation while the next page is being filled.
+ */
+void flashfsFlushPageAsync(void)
+{
+    if (flashfsTransmitBufferUsed() >= flashfsPageRemaining()) {
+        flashfsFlushAsync();
+    }
+}
+
 /**
  * Wait for the flash to become ready and begin flushing any buffered data to flash.
  *
@@ -350,7 +700,7 @@ void flashfsSeekRel(int32_t offset)
 {
     flashfsFlushSync();
 
-    flashfsSetTailAddress(tailAddress + offset);
+    flashfsSetTailAddress(flashfsWrapAddress(tailAddress + offset));
 }
 
 /**
@@ -358,13 +708,15 @@ void flashfsSeekRel(int32_t offset)
  */
 void flashfsWriteByte(uint8_t byte)
 {
+    writtenSinceUpdate = true;
+
     flashWriteBuffer[bufferHead++] = byte;
 
     if (bufferHead >= FLASHFS_WRITE_BUFFER_SIZE) {
         bufferHead = 0;
     }
 
-    if (flashfsTransmitBufferUsed() >= FLASHFS_WRITE_BUFFER_AUTO_FLUSH_LEN) {
+    if (flashfsTransmitBufferUsed() >= flashfsPageRemaining()) {
         flashfsFlushAsync();
     }
 }
@@ -380,6 +732,8 @@ void flashfsWrite(const uint8_t *data, unsigned int len, bool sync)
     uint8_t const * buffers[3];
     uint32_t bufferSizes[3];
 
+    writtenSinceUpdate = true;
+
     // There could be two dirty buffers to write out already:
     flashfsGetDirtyDataBuffers(buffers, bufferSizes);
 
@@ -388,10 +742,10 @@ void flashfsWrite(const uint8_t *data, unsigned int len, bool sync)
     bufferSizes[2] = len;
 
     /*
-     * Would writing this data to our buffer cause our buffer to reach the flush threshold? If so try to write through
+     * Would writing this data to our buffer complete the current flash page? If so try to write the page through
      * to the flash now
      */
-    if (bufferSizes[0] + bufferSizes[1] + bufferSizes[2] >= FLASHFS_WRITE_BUFFER_AUTO_FLUSH_LEN) {
+    if (bufferSizes[0] + bufferSizes[1] + bufferSizes[2] >= flashfsPageRemaining()) {
         uint32_t bytesWritten;
 
         // Attempt to write all three buffers through to the flash asynchronously
@@ -471,67 +825,31 @@ int flashfsReadAbs(uint32_t address, uint8_t *buffer, unsigned int len)
     // Since the read could overlap data in our dirty buffers, force a sync to clear those first
     flashfsFlushSync();
 
+    // Wait out an erase ahead that was already running, flashfsUpdate() won't start another until the reads stop
+    readSinceUpdate = true;
+    m25p16_waitForReady(M25P16_SECTOR_ERASE_TIMEOUT_MILLIS);
+
     bytesRead = m25p16_readBytes(address, buffer, len);
 
     return bytesRead;
 }
 
 /**
- * Find the offset of the start of the free space on the device (or the size of the device if it is full).
+ * Binary search the `blockCount` blocks starting at `address` for the first erased one, assuming that everything
+ * after it is erased too. Returns the address of that block, or of the end of the range if none are erased.
  */
-int flashfsIdentifyStartOfFreeSpace(void)
+static uint32_t flashfsFindFirstErasedBlock(uint32_t address, int blockCount)
 {
-    /* Find the start of the free space on the device by examining the beginning of blocks with a binary search,
-     * looking for ones that appear to be erased. We can achieve this with good accuracy because an erased block
-     * is all bits set to 1, which pretty much never appears in reasonable size substrings of blackbox logs.
-     *
-     * To do better we might write a volume header instead, which would mark how much free space remains. But keeping
-     * a header up to date while logging would incur more writes to the flash, which would consume precious write
-     * bandwidth and block more often.
-     */
-
-    enum {
-        /* We can choose whatever power of 2 size we like, which determines how much wastage of free space we'll have
-         * at the end of the last written data. But smaller blocksizes will require more searching.
-         */
-        FREE_BLOCK_SIZE = 2048,
-
-        /* We don't expect valid data to ever contain this many consecutive uint32_t's of all 1 bits: */
-        FREE_BLOCK_TEST_SIZE_INTS = 4, // i.e. 16 bytes
-        FREE_BLOCK_TEST_SIZE_BYTES = FREE_BLOCK_TEST_SIZE_INTS * sizeof(uint32_t),
-    };
-
-    union {
-        uint8_t bytes[FREE_BLOCK_TEST_SIZE_BYTES];
-        uint32_t ints[FREE_BLOCK_TEST_SIZE_INTS];
-    } testBuffer;
-
     int left = 0; // Smallest block index in the search region
-    int right = flashfsGetSize() / FREE_BLOCK_SIZE; // One past the largest block index in the search region
+    int right = blockCount; // One past the largest block index in the search region
     int mid;
     int result = right;
-    int i;
-    bool blockErased;
 
     while (left < right) {
         mid = (left + right) / 2;
 
-        if (m25p16_readBytes(mid * FREE_BLOCK_SIZE, testBuffer.bytes, FREE_BLOCK_TEST_SIZE_BYTES) < FREE_BLOCK_TEST_SIZE_BYTES) {
-            // Unexpected timeout from flash, so bail early (reporting the device fuller than it really is)
-            break;
-        }
-
-        // Checking the buffer 4 bytes at a time like this is probably faster than byte-by-byte, but I didn't benchmark it :)
-        blockErased = true;
-        for (i = 0; i < FREE_BLOCK_TEST_SIZE_INTS; i++) {
-            if (testBuffer.ints[i] != 0xFFFFFFFF) {
-                blockErased = false;
-                break;
-            }
-        }
-
-        if (blockErased) {
-            /* This erased block might be the leftmost erased block in the volume, but we'll need to continue the
+        if (flashfsBlockIsErased(address + mid * FREE_BLOCK_SIZE)) {
+            /* This erased block might be the leftmost erased block in the range, but we'll need to continue the
              * search leftwards to find out:
              */
             result = mid;
@@ -542,7 +860,111 @@ int flashfsIdentifyStartOfFreeSpace(void)
         }
     }
 
-    return result * FREE_BLOCK_SIZE;
+    return address + result * FREE_BLOCK_SIZE;
+}
+
+/**
+ * Look at the first and last block of each sector, starting from the given one, for the end of the written data.
+ */
+static uint32_t flashfsFindEndOfData(int firstSector)
+{
+    const flashGeometry_t *geometry = m25p16_getGeometry();
+    const int sectors = flashfsGetSize() / geometry->sectorSize;
+    const int blocksPerSector = geometry->sectorSize / FREE_BLOCK_SIZE;
+    const uint32_t lastBlockOffset = geometry->sectorSize - FREE_BLOCK_SIZE;
+
+    const int previousSector = firstSector > 0 ? firstSector - 1 : sectors - 1;
+    bool previousEndErased = flashfsBlockIsErased(previousSector * geometry->sectorSize + lastBlockOffset);
+    bool allErased = true;
+
+    for (int i = 0; i < sectors; i++) {
+        const uint32_t sectorAddress = ((firstSector + i) % sectors) * geometry->sectorSize;
+        const bool startErased = flashfsBlockIsErased(sectorAddress);
+        const bool endErased = flashfsBlockIsErased(sectorAddress + lastBlockOffset);
+
+        if (!startErased && endErased) {
+            return flashfsFindFirstErasedBlock(sectorAddress, blocksPerSector);
+        }
+
+        if (startErased && !previousEndErased) {
+            return sectorAddress;
+        }
+
+        previousEndErased = endErased;
+        allErased = allErased && startErased && endErased;
+    }
+
+    if (allErased) {
+        return 0;
+    }
+
+    // No end was found, the device is full
+    return flashfsGetSize();
+}
+
+/**
+ * Find the offset of the start of the free space on the device (or the size of the device if it is full).
+ */
+int flashfsIdentifyStartOfFreeSpace(void)
+{
+    /* We can recognise erased blocks with good accuracy because an erased block is all bits set to 1, which pretty
+     * much never appears in reasonable size substrings of blackbox logs.
+     *
+     * Outside ring mode, the data starts at the beginning of the device and is followed by erased space up to the
+     * end, so a binary search for the first erased block finds the end of it.
+     *
+     * In ring mode the stream of written data can wrap around the end of the device, and be followed by erased space
+     * and then older data that hasn't been erased yet. The stream ends either in a sector that begins with data and
+     * ends erased, or at the start of an erased sector that follows a written one. The journal tells us which sector
+     * the stream had reached, so normally only that sector needs to be searched. The sectors after it are checked in
+     * turn in case the tail moved on before the journal caught up, and without a journal entry, every sector is
+     * checked.
+     */
+    const flashGeometry_t *geometry = m25p16_getGeometry();
+
+    if (flashfsGetSize() == 0) {
+        return 0;
+    }
+
+    if (!ringMode) {
+        journalNextEntry = -1;
+
+        return flashfsFindFirstErasedBlock(0, flashfsGetSize() / FREE_BLOCK_SIZE);
+    }
+
+    uint32_t journalAddress;
+    uint32_t result;
+    const bool haveJournal = flashfsReadJournal(&journalAddress);
+
+    if (haveJournal) {
+        if (flashfsBlockIsErased(journalAddress)) {
+            // Nothing has been written to the sector since the tail moved into it
+            return journalAddress;
+        }
+
+        result = flashfsFindEndOfData(journalAddress / geometry->sectorSize);
+
+        if (result / geometry->sectorSize == journalAddress / geometry->sectorSize) {
+            return result;
+        }
+    } else {
+        result = flashfsFindEndOfData(0);
+    }
+
+    if (result >= flashfsGetSize()) {
+        /*
+         * The device is full of old data, or the log stopped on a sector boundary before the next sector was erased,
+         * so there's no erased gap to find. The journal has the sector the tail had moved into, or the one before if
+         * it hadn't caught up. Resuming after it never overwrites the newest data, at worst we give up a sector of the
+         * oldest. Without a journal there's nothing to go on, so start again from the beginning.
+         */
+        result = haveJournal ? flashfsWrapAddress(journalAddress + geometry->sectorSize) : 0;
+    }
+
+    // Bring the journal up to date so the next boot doesn't have to search as far
+    flashfsJournalRecord(result);
+
+    return result;
 }
 
 /**
@@ -553,6 +975,19 @@ bool flashfsIsEOF(void)
     return tailAddress >= flashfsGetSize();
 }
 
+/**
+ * Enable or disable wrapping around to the start of the device once the end is reached. Call before flashfsInit().
+ */
+void flashfsSetRingMode(bool enabled)
+{
+    ringMode = enabled;
+}
+
+bool flashfsIsRingMode(void)
+{
+    return ringMode;
+}
+
 /**
  * Call after initializing the flash chip in order to set up the filesystem.
  */
@@ -564,3 +999,42 @@ void flashfsInit(void)
         flashfsSeekAbs(flashfsIdentifyStartOfFreeSpace());
     }
 }
+
+/**
+ * Erase ahead of the tail while the flash isn't busy. Call periodically from a low priority task.
+ *
+ * An erase stalls page programming for a long time, so while a log is being recorded only one sector is kept erased
+ * ahead of the tail. Once nothing has been written for FLASHFS_IDLE_TIMEOUT_US, the erased space is extended up to
+ * flashfsEraseAheadTarget().
+ *
+ * Also appends the sector the tail has moved into to the journal. Nothing is done until FLASHFS_IDLE_TIMEOUT_US after
+ * the last flashfsReadAbs(), so that reads don't have to wait for sector erases.
+ */
+void flashfsUpdate(timeUs_t currentTimeUs)
+{
+    if (writtenSinceUpdate) {
+        writtenSinceUpdate = false;
+        lastWriteTimeUs = currentTimeUs;
+    }
+
+    if (readSinceUpdate) {
+        readSinceUpdate = false;
+        readActive = true;
+        lastReadTimeUs = currentTimeUs;
+    } else if (readActive && cmpTimeUs(currentTimeUs, lastReadTimeUs) > FLASHFS_IDLE_TIMEOUT_US) {
+        readActive = false;
+    }
+
+    if (readActive) {
+        return;
+    }
+
+    const bool idle = cmpTimeUs(currentTimeUs, lastWriteTimeUs) > FLASHFS_IDLE_TIMEOUT_US;
+    const uint32_t target = idle ? flashfsEraseAheadTarget() : m25p16_getGeometry()->sectorSize;
+
+    flashfsJournalUpdate(idle);
+
+    if (erasedBytesAhead < target) {
+        flashfsEraseAheadStep();
+    }
+}
@@ -19,13 +19,27 @@
 
 #include <stdint.h>
 
+#include "common/time.h"
+
 #include "drivers/flash.h"
+#include "drivers/flash_m25p16.h"
 
-#define FLASHFS_WRITE_BUFFER_SIZE 128
+/*
+ * Room for two flash pages, so that one page can be filled while the previous one is being programmed. Pages are
+ * flushed as soon as they're complete.
+ */
+#ifndef FLASHFS_WRITE_BUFFER_SIZE
+#define FLASHFS_WRITE_BUFFER_SIZE (2 * M25P16_PAGESIZE)
+#endif
 #define FLASHFS_WRITE_BUFFER_USABLE (FLASHFS_WRITE_BUFFER_SIZE - 1)
 
-// Automatically trigger a flush when this much data is in the buffer
-#define FLASHFS_WRITE_BUFFER_AUTO_FLUSH_LEN 64
+/*
+ * How much space ahead of the write position to keep erased while nothing is being written, so that a log can be
+ * recorded without waiting for sector erases. Limited to a quarter of the device.
+ */
+#ifndef FLASHFS_ERASE_AHEAD_SIZE
+#define FLASHFS_ERASE_AHEAD_SIZE (1024 * 1024)
+#endif
 
 void flashfsEraseCompletely(void);
 void flashfsEraseRange(uint32_t start, uint32_t end);
@@ -46,9 +60,13 @@ void flashfsWrite(const uint8_t *data, unsigned int len, bool sync);
 int flashfsReadAbs(uint32_t offset, uint8_t *data, unsigned int len);
 
 bool flashfsFlushAsync(void);
+void flashfsFlushPageAsync(void);
 void flashfsFlushSync(void);
 
+void flashfsSetRingMode(bool ringMode);
+bool flashfsIsRingMode(void);
 void flashfsInit(void);
+void flashfsUpdate(timeUs_t currentTimeUs);
 
 bool flashfsIsReady(void);
 bool flashfsIsEOF(void);
@@ -117,6 +117,7 @@ typedef struct serialPortConfig_s {
 typedef struct serialConfig_s {
     serialPortConfig_t portConfigs[SERIAL_PORT_COUNT];
     uint8_t reboot_character;               // which byte is used to reboot. Default 'R', could be changed carefully to something else.
+    uint16_t msp_process_budget_us;         // time MSP may spend answering further pipelined commands on a port per call, 0 answers one at a time
 } serialConfig_t;
 
 PG_DECLARE(serialConfig_t, serialConfig);
@@ -27,6 +27,10 @@
 
 #include "scheduler/scheduler.h"
 
+#ifdef SIMULATOR_BUILD
+#include "target/SITL/sitl.h"
+#endif
+
 #ifdef SOFTSERIAL_LOOPBACK
 serialPort_t *loopbackPort;
 #endif
@@ -53,12 +57,21 @@ static void processLoopback(void)
 #endif
 }
 
+#ifdef SIMULATOR_BUILD
+int main(int argc, char *argv[])
+{
+    sitlInit(argc, argv);
+#else
 int main(void)
 {
+#endif
     init();
     loopbackInit();
 
     while (true) {
+#ifdef SIMULATOR_BUILD
+        sitlLoop();
+#endif
         scheduler();
         processLoopback();
     }
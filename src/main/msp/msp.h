@@ -34,7 +34,8 @@ typedef enum {
 typedef enum {
     MSP_RESULT_ACK = 1,
     MSP_RESULT_ERROR = -1,
-    MSP_RESULT_NO_REPLY = 0
+    MSP_RESULT_NO_REPLY = 0,
+    MSP_RESULT_RETRY = -2,      // Nothing was changed: the reply didn't fit or the command can't run with MSP_FLAG_MAY_RETRY. An error unless the caller runs it again
 } mspResult_e;
 
 typedef struct mspPacket_s {
@@ -46,8 +47,11 @@ typedef struct mspPacket_s {
 
 typedef enum {
     MSP_FLAG_DONT_REPLY           = (1 << 0),
+    MSP_FLAG_CAN_STREAM           = (1 << 1),   // Set by msp_serial, the command arrived on a port that can stream replies
+    MSP_FLAG_MAY_RETRY            = (1 << 2),   // Set by msp_serial, the reply buffer might be too small. Only commands without side effects run
 } mspFlags_e;
 
 struct serialPort_s;
 typedef void (*mspPostProcessFnPtr)(struct serialPort_s *port); // msp post process function, used for gracefully handling reboots, etc.
 typedef mspResult_e (*mspProcessCommandFnPtr)(mspPacket_t *cmd, mspPacket_t *reply, mspPostProcessFnPtr *mspPostProcessFn);
+typedef bool (*mspStreamFnPtr)(mspPacket_t *packet); // fills the next frame of a stream, returns false after the last one
@@ -22,3 +22,7 @@
 
 #define MSP2_COMMON_MOTOR_MIXER     0x1005
 #define MSP2_COMMON_SET_MOTOR_MIXER 0x1006
+
+#define MSP2_COMMON_SETTING_INFO    0x1007  //in/out message   Enumerates settings from an index with their names, types and ranges
+#define MSP2_COMMON_SETTINGS        0x1008  //in/out message   Returns the values for a list of setting indexes
+#define MSP2_COMMON_SET_SETTINGS    0x1009  //in message    Sets the values for a list of setting indexes
@@ -28,3 +28,6 @@
 #define MSP2_INAV_RATE_PROFILE                  0x2007
 #define MSP2_INAV_SET_RATE_PROFILE              0x2008
 #define MSP2_INAV_AIR_SPEED                     0x2009
+#define MSP2_INAV_TASK_LATENCY                  0x200A
+#define MSP2_INAV_GYRO_SPECTRUM                 0x200B
+#define MSP2_INAV_DATAFLASH_STREAM              0x200C
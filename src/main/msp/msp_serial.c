@@ -27,9 +27,11 @@
 #include "common/utils.h"
 #include "common/maths.h"
 #include "common/crc.h"
+#include "common/time.h"
 
 #include "drivers/system.h"
 #include "drivers/serial.h"
+#include "drivers/time.h"
 
 #include "io/serial.h"
 #include "fc/cli.h"
@@ -266,6 +268,20 @@ static uint8_t mspSerialChecksumBuf(uint8_t checksum, const uint8_t *data, int l
 }
 
 #define JUMBO_FRAME_SIZE_LIMIT 255
+
+// Largest header and checksum mspSerialEncode() adds to a payload
+#define MSP_MAX_FRAME_OVERHEAD (16 + 2)
+
+// Don't bother sending stream frames with less payload than this, wait for the TX buffer to drain instead
+#define MSP_STREAM_MIN_PAYLOAD 64
+
+// Least contiguous TX space for a reply to be written into the TX buffer directly
+#define MSP_DIRECT_MIN_PAYLOAD 32
+
+// Don't answer another pipelined command unless a typical reply still fits in the TX buffer, as
+// mspSerialSendFrame() drops replies that don't
+#define MSP_PIPELINE_MIN_TX_FREE (64 + MSP_MAX_FRAME_OVERHEAD)
+
 static int mspSerialSendFrame(mspPort_t *msp, const uint8_t * hdr, int hdrLen, const uint8_t * data, int dataLen, const uint8_t * crc, int crcLen)
 {
     // We are allowed to send out the response if
@@ -286,16 +302,18 @@ static int mspSerialSendFrame(mspPort_t *msp, const uint8_t * hdr, int hdrLen, c
     return totalFrameLength;
 }
 
-static int mspSerialEncode(mspPort_t *msp, mspPacket_t *packet, mspVersion_e mspVersion)
+/*
+ * Fills hdrBuf with the header of a frame carrying dataLen bytes of payload and returns its length.
+ */
+static int mspSerialEncodeHeader(uint8_t *hdrBuf, const mspPacket_t *packet, mspVersion_e mspVersion, int dataLen)
 {
     static const uint8_t mspMagic[MSP_VERSION_COUNT] = MSP_VERSION_MAGIC_INITIALIZER;
-    const int dataLen = sbufBytesRemaining(&packet->buf);
-    uint8_t hdrBuf[16] = { '$', mspMagic[mspVersion], packet->result == MSP_RESULT_ERROR ? '!' : '>'};
-    uint8_t crcBuf[2];
     int hdrLen = 3;
-    int crcLen = 0;
 
-    #define V1_CHECKSUM_STARTPOS 3
+    hdrBuf[0] = '$';
+    hdrBuf[1] = mspMagic[mspVersion];
+    hdrBuf[2] = packet->result == MSP_RESULT_ERROR ? '!' : '>';
+
     if (mspVersion == MSP_V1) {
         mspHeaderV1_t * hdrV1 = (mspHeaderV1_t *)&hdrBuf[hdrLen];
         hdrLen += sizeof(mspHeaderV1_t);
@@ -312,20 +330,11 @@ static int mspSerialEncode(mspPort_t *msp, mspPacket_t *packet, mspVersion_e msp
         else {
             hdrV1->size = dataLen;
         }
-
-        // Pre-calculate CRC
-        crcBuf[crcLen] = mspSerialChecksumBuf(0, hdrBuf + V1_CHECKSUM_STARTPOS, hdrLen - V1_CHECKSUM_STARTPOS);
-        crcBuf[crcLen] = mspSerialChecksumBuf(crcBuf[crcLen], sbufPtr(&packet->buf), dataLen);
-        crcLen++;
     }
     else if (mspVersion == MSP_V2_OVER_V1) {
         mspHeaderV1_t * hdrV1 = (mspHeaderV1_t *)&hdrBuf[hdrLen];
-
         hdrLen += sizeof(mspHeaderV1_t);
 
-        mspHeaderV2_t * hdrV2 = (mspHeaderV2_t *)&hdrBuf[hdrLen];
-        hdrLen += sizeof(mspHeaderV2_t);
-
         const int v1PayloadSize = sizeof(mspHeaderV2_t) + dataLen + 1;  // MSPv2 header + data payload + MSPv2 checksum
         hdrV1->cmd = MSP_V2_FRAME_ID;
 
@@ -342,20 +351,11 @@ static int mspSerialEncode(mspPort_t *msp, mspPacket_t *packet, mspVersion_e msp
         }
 
         // Fill V2 header
+        mspHeaderV2_t * hdrV2 = (mspHeaderV2_t *)&hdrBuf[hdrLen];
+        hdrLen += sizeof(mspHeaderV2_t);
         hdrV2->flags = packet->flags;
         hdrV2->cmd = packet->cmd;
         hdrV2->size = dataLen;
-
-        // V2 CRC: only V2 header + data payload
-        crcBuf[crcLen] = crc8_dvb_s2_update(0, (uint8_t *)hdrV2, sizeof(mspHeaderV2_t));
-        crcBuf[crcLen] = crc8_dvb_s2_update(crcBuf[crcLen], sbufPtr(&packet->buf), dataLen);
-        crcLen++;
-
-        // V1 CRC: All headers + data payload + V2 CRC byte
-        crcBuf[crcLen] = mspSerialChecksumBuf(0, hdrBuf + V1_CHECKSUM_STARTPOS, hdrLen - V1_CHECKSUM_STARTPOS);
-        crcBuf[crcLen] = mspSerialChecksumBuf(crcBuf[crcLen], sbufPtr(&packet->buf), dataLen);
-        crcBuf[crcLen] = mspSerialChecksumBuf(crcBuf[crcLen], crcBuf, crcLen);
-        crcLen++;
     }
     else if (mspVersion == MSP_V2_NATIVE) {
         mspHeaderV2_t * hdrV2 = (mspHeaderV2_t *)&hdrBuf[hdrLen];
@@ -364,51 +364,202 @@ static int mspSerialEncode(mspPort_t *msp, mspPacket_t *packet, mspVersion_e msp
         hdrV2->flags = packet->flags;
         hdrV2->cmd = packet->cmd;
         hdrV2->size = dataLen;
-
-        crcBuf[crcLen] = crc8_dvb_s2_update(0, (uint8_t *)hdrV2, sizeof(mspHeaderV2_t));
-        crcBuf[crcLen] = crc8_dvb_s2_update(crcBuf[crcLen], sbufPtr(&packet->buf), dataLen);
-        crcLen++;
     }
     else {
         // Shouldn't get here
         return 0;
     }
 
+    return hdrLen;
+}
+
+/*
+ * Fills crcBuf with the checksums of a frame with the given header and payload and returns their length.
+ * The MSPv2 header is always the last part of the header.
+ */
+static int mspSerialEncodeChecksum(uint8_t *crcBuf, const uint8_t *hdrBuf, int hdrLen, const uint8_t *data, int dataLen, mspVersion_e mspVersion)
+{
+    int crcLen = 0;
+
+    #define V1_CHECKSUM_STARTPOS 3
+    if (mspVersion == MSP_V2_OVER_V1 || mspVersion == MSP_V2_NATIVE) {
+        // V2 CRC: only V2 header + data payload
+        crcBuf[crcLen] = crc8_dvb_s2_update(0, hdrBuf + hdrLen - sizeof(mspHeaderV2_t), sizeof(mspHeaderV2_t));
+        crcBuf[crcLen] = crc8_dvb_s2_update(crcBuf[crcLen], data, dataLen);
+        crcLen++;
+    }
+
+    if (mspVersion == MSP_V1 || mspVersion == MSP_V2_OVER_V1) {
+        // V1 CRC: All headers + data payload + V2 CRC byte
+        crcBuf[crcLen] = mspSerialChecksumBuf(0, hdrBuf + V1_CHECKSUM_STARTPOS, hdrLen - V1_CHECKSUM_STARTPOS);
+        crcBuf[crcLen] = mspSerialChecksumBuf(crcBuf[crcLen], data, dataLen);
+        crcBuf[crcLen] = mspSerialChecksumBuf(crcBuf[crcLen], crcBuf, crcLen);
+        crcLen++;
+    }
+
+    return crcLen;
+}
+
+static int mspSerialEncode(mspPort_t *msp, mspPacket_t *packet, mspVersion_e mspVersion)
+{
+    const int dataLen = sbufBytesRemaining(&packet->buf);
+    uint8_t hdrBuf[16];
+    uint8_t crcBuf[2];
+
+    const int hdrLen = mspSerialEncodeHeader(hdrBuf, packet, mspVersion, dataLen);
+    if (hdrLen == 0) {
+        return 0;
+    }
+    const int crcLen = mspSerialEncodeChecksum(crcBuf, hdrBuf, hdrLen, sbufPtr(&packet->buf), dataLen, mspVersion);
+
     // Send the frame
     return mspSerialSendFrame(msp, hdrBuf, hdrLen, sbufPtr(&packet->buf), dataLen, crcBuf, crcLen);
 }
 
-static mspPostProcessFnPtr mspSerialProcessReceivedCommand(mspPort_t *msp, mspProcessCommandFnPtr mspProcessCommandFn)
+/*
+ * Runs the command with the reply written straight into the free space of the port's TX buffer, then fills
+ * in the header and checksums around it and hands the frame to the driver, without copying the payload.
+ *
+ * The command runs with MSP_FLAG_MAY_RETRY, so only commands without side effects run here, the others
+ * return MSP_RESULT_RETRY without doing anything. Returns false when the port can't take direct writes, there
+ * isn't enough contiguous TX space, the command returned MSP_RESULT_RETRY or the reply didn't fit. Nothing has
+ * been sent then and the caller runs the command again with a reply buffer of its own. Error replies are sent
+ * from here, a command that failed is never run again.
+ *
+ * Only drivers that queue from the port's own TX buffer implement serialCommitDirectWrite(). USB VCP always
+ * takes the copying path, CDC_Send_DATA() copies into the USB stack's buffer anyway.
+ */
+static bool mspSerialProcessCommandDirect(mspPort_t *msp, mspPacket_t *command, mspProcessCommandFnPtr mspProcessCommandFn, mspPostProcessFnPtr *mspPostProcessFn)
 {
-    uint8_t outBuf[MSP_PORT_OUTBUF_SIZE];
+    uint8_t *txBuf;
+    const int txSpace = serialGetDirectWriteBuffer(msp->port, &txBuf);
 
     mspPacket_t reply = {
-        .buf = { .ptr = outBuf, .end = ARRAYEND(outBuf), },
         .cmd = -1,
         .flags = 0,
         .result = 0,
     };
-    uint8_t *outBufHead = reply.buf.ptr;
 
+    // Direct replies never use JUMBO frames, so the header length doesn't depend on the payload
+    uint8_t hdrBuf[16];
+    const int hdrLen = mspSerialEncodeHeader(hdrBuf, &reply, msp->mspVersion, 0);
+    const int crcLen = msp->mspVersion == MSP_V2_OVER_V1 ? 2 : 1;
+    int maxPayload = txSpace - hdrLen - crcLen;
+    if (msp->mspVersion == MSP_V1) {
+        maxPayload = MIN(maxPayload, JUMBO_FRAME_SIZE_LIMIT - 1);
+    } else if (msp->mspVersion == MSP_V2_OVER_V1) {
+        maxPayload = MIN(maxPayload, JUMBO_FRAME_SIZE_LIMIT - 1 - (int)sizeof(mspHeaderV2_t) - 1);
+    }
+
+    if (hdrLen == 0 || maxPayload < MSP_DIRECT_MIN_PAYLOAD) {
+        return false;
+    }
+
+    uint8_t * const payload = txBuf + hdrLen;
+    reply.buf.ptr = payload;
+    reply.buf.end = payload + maxPayload;
+
+    command->flags |= MSP_FLAG_MAY_RETRY;
+    const mspResult_e status = mspProcessCommandFn(command, &reply, mspPostProcessFn);
+    command->flags &= ~MSP_FLAG_MAY_RETRY;
+
+    // Only a reply that didn't fit in the space is thrown away, errors are answered from here like any other reply
+    if (status == MSP_RESULT_RETRY || sbufBytesRemaining(&reply.buf) < 0) {
+        // Rewind the command so it can be run again
+        command->buf.ptr = msp->inBuf;
+        *mspPostProcessFn = NULL;
+        return false;
+    }
+
+    if (status != MSP_RESULT_NO_REPLY) {
+        const int dataLen = reply.buf.ptr - payload;
+        mspSerialEncodeHeader(txBuf, &reply, msp->mspVersion, dataLen);
+        mspSerialEncodeChecksum(payload + dataLen, txBuf, hdrLen, payload, dataLen, msp->mspVersion);
+        serialCommitDirectWrite(msp->port, hdrLen + dataLen + crcLen);
+    }
+
+    return true;
+}
+
+static mspPostProcessFnPtr mspSerialProcessReceivedCommand(mspPort_t *msp, mspProcessCommandFnPtr mspProcessCommandFn)
+{
     mspPacket_t command = {
         .buf = { .ptr = msp->inBuf, .end = msp->inBuf + msp->dataSize, },
         .cmd = msp->cmdMSP,
-        .flags = msp->cmdFlags,
+        .flags = msp->cmdFlags | MSP_FLAG_CAN_STREAM,
         .result = 0,
     };
 
+    // A new command ends any stream the port was sending, the command can start another one
+    msp->streamFn = NULL;
+
     mspPostProcessFnPtr mspPostProcessFn = NULL;
-    const mspResult_e status = mspProcessCommandFn(&command, &reply, &mspPostProcessFn);
 
-    if (status != MSP_RESULT_NO_REPLY) {
-        sbufSwitchToReader(&reply.buf, outBufHead); // change streambuf direction
-        mspSerialEncode(msp, &reply, msp->mspVersion);
+    if (!mspSerialProcessCommandDirect(msp, &command, mspProcessCommandFn, &mspPostProcessFn)) {
+        uint8_t outBuf[MSP_PORT_OUTBUF_SIZE];
+
+        mspPacket_t reply = {
+            .buf = { .ptr = outBuf, .end = ARRAYEND(outBuf), },
+            .cmd = -1,
+            .flags = 0,
+            .result = 0,
+        };
+        uint8_t *outBufHead = reply.buf.ptr;
+
+        const mspResult_e status = mspProcessCommandFn(&command, &reply, &mspPostProcessFn);
+
+        if (status == MSP_RESULT_RETRY) {
+            // There's no larger buffer to run it with
+            reply.buf.ptr = outBufHead;
+            reply.result = MSP_RESULT_ERROR;
+        }
+
+        if (status != MSP_RESULT_NO_REPLY) {
+            sbufSwitchToReader(&reply.buf, outBufHead); // change streambuf direction
+            mspSerialEncode(msp, &reply, msp->mspVersion);
+        }
     }
 
     msp->c_state = MSP_IDLE;
     return mspPostProcessFn;
 }
 
+/*
+ * Send as many frames of the port's stream as fit in the TX buffer without blocking.
+ */
+static void mspSerialProcessStream(mspPort_t *msp)
+{
+    uint8_t outBuf[MSP_PORT_OUTBUF_SIZE];
+
+    while (msp->streamFn) {
+        const int payloadFree = (int)serialTxBytesFree(msp->port) - MSP_MAX_FRAME_OVERHEAD;
+
+        if (payloadFree < MSP_STREAM_MIN_PAYLOAD) {
+            break;
+        }
+
+        mspPacket_t packet = {
+            .buf = { .ptr = outBuf, .end = outBuf + MIN(payloadFree, (int)sizeof(outBuf)), },
+            .cmd = msp->streamCmd,
+            .flags = 0,
+            .result = MSP_RESULT_ACK,
+        };
+        uint8_t *outBufHead = packet.buf.ptr;
+
+        if (!msp->streamFn(&packet)) {
+            msp->streamFn = NULL;
+        }
+
+        if (packet.buf.ptr == outBufHead) {
+            // Nothing to send right now
+            break;
+        }
+
+        sbufSwitchToReader(&packet.buf, outBufHead);
+        mspSerialEncode(msp, &packet, msp->streamVersion);
+    }
+}
+
 static void mspEvaluateNonMspData(mspPort_t * mspPort, uint8_t receivedChar)
 {
 #ifdef USE_CLI
@@ -445,10 +596,24 @@ static void mspProcessPendingRequest(mspPort_t * mspPort)
     }
 }
 
+/*
+ * Returns true if another command received on the port can be answered in this call: it's still within
+ * msp_process_budget_us since processing started and the TX buffer has room for the reply.
+ */
+static bool mspSerialCanProcessNextCommand(mspPort_t *mspPort, timeUs_t startTimeUs)
+{
+    const uint16_t budgetUs = serialConfig()->msp_process_budget_us;
+
+    return budgetUs > 0 &&
+        cmpTimeUs(micros(), startTimeUs) < budgetUs &&
+        serialTxBytesFree(mspPort->port) >= MSP_PIPELINE_MIN_TX_FREE;
+}
+
 /*
  * Process MSP commands from serial ports configured as MSP ports.
  *
- * Called periodically by the scheduler.
+ * Answers one command per port, or as many as msp_process_budget_us allows for ground stations
+ * pipelining their requests. Called periodically by the scheduler.
  */
 void mspSerialProcess(mspEvaluateNonMspData_e evaluateNonMspData, mspProcessCommandFnPtr mspProcessCommandFn)
 {
@@ -465,6 +630,8 @@ void mspSerialProcess(mspEvaluateNonMspData_e evaluateNonMspData, mspProcessComm
             mspPort->lastActivityMs = millis();
             mspPort->pendingRequest = MSP_PENDING_NONE;
 
+            const timeUs_t startTimeUs = micros();
+
             // Process incoming bytes
             while (serialRxBytesWaiting(mspPort->port)) {
                 const uint8_t c = serialRead(mspPort->port);
@@ -476,18 +643,27 @@ void mspSerialProcess(mspEvaluateNonMspData_e evaluateNonMspData, mspProcessComm
 
                 if (mspPort->c_state == MSP_COMMAND_RECEIVED) {
                     mspPostProcessFn = mspSerialProcessReceivedCommand(mspPort, mspProcessCommandFn);
-                    break; // process one command at a time so as not to block.
+
+                    // Process one command at a time so as not to block, unless there's budget left.
+                    // Post processing must run before the next command.
+                    if (mspPostProcessFn || !mspSerialCanProcessNextCommand(mspPort, startTimeUs)) {
+                        break;
+                    }
                 }
             }
 
             if (mspPostProcessFn) {
-                waitForSerialPortToFinishTransmitting(mspPort->port);
+                // Post processing that reboots or takes over the port waits for the reply to go out itself
                 mspPostProcessFn(mspPort->port);
             }
         }
         else {
             mspProcessPendingRequest(mspPort);
         }
+
+        if (mspPort->streamFn) {
+            mspSerialProcessStream(mspPort);
+        }
     }
 }
 
@@ -568,3 +744,32 @@ mspPort_t * mspSerialPortFind(const serialPort_t *serialPort)
     }
     return NULL;
 }
+
+/*
+ * Start sending frames produced by streamFn on the given port, using the MSP version of the command that was just
+ * processed. streamFn is called from mspSerialProcess() whenever the TX buffer has room, until it returns false or
+ * another command arrives on the port. Only one stream runs at a time, so any stream on another port is stopped.
+ */
+bool mspSerialStartStream(const serialPort_t *serialPort, uint16_t cmd, mspStreamFnPtr streamFn)
+{
+    // Commands that didn't arrive on a serial port (e.g. MSP over telemetry) can't stream
+    if (!serialPort) {
+        return false;
+    }
+
+    mspPort_t * const mspPort = mspSerialPortFind(serialPort);
+
+    if (!mspPort) {
+        return false;
+    }
+
+    for (int portIndex = 0; portIndex < MAX_MSP_PORT_COUNT; portIndex++) {
+        mspPorts[portIndex].streamFn = NULL;
+    }
+
+    mspPort->streamCmd = cmd;
+    mspPort->streamVersion = mspPort->mspVersion;
+    mspPort->streamFn = streamFn;
+
+    return true;
+}
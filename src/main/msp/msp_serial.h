@@ -99,6 +99,9 @@ typedef struct mspPort_s {
     uint16_t cmdMSP;
     uint8_t checksum1;
     uint8_t checksum2;
+    mspStreamFnPtr streamFn;     // null when no stream is running on the port
+    uint16_t streamCmd;
+    mspVersion_e streamVersion;
 } mspPort_t;
 
 
@@ -110,3 +113,4 @@ int mspSerialPushPort(uint16_t cmd, const uint8_t *data, int datalen, mspPort_t
 int mspSerialPush(uint8_t cmd, const uint8_t *data, int datalen);
 uint32_t mspSerialTxBytesFree(void);
 mspPort_t * mspSerialPortFind(const struct serialPort_s *serialPort);
+bool mspSerialStartStream(const struct serialPort_s *serialPort, uint16_t cmd, mspStreamFnPtr streamFn);
@@ -1409,7 +1409,6 @@ void navPidReset(pidController_t *pid)
     pid->integrator = 0.0f;
     pid->last_input = 0.0f;
     pid->dterm_filter_state.state = 0.0f;
-    pid->dterm_filter_state.RC = 0.0f;
 }
 
 void navPidInit(pidController_t *pid, float _kP, float _kI, float _kD)
@@ -72,6 +72,11 @@
 #define U_ID_2 (*(uint32_t*)0x1FFFF7F0)
 
 #define STM32F1
+
+#elif defined(SIMULATOR_BUILD)
+
+// Host build, MCU stand-ins are provided by target/SITL/target.h
+
 #endif // STM32F10X
 
 #include "target/common.h"
@@ -39,6 +39,8 @@
 #include "drivers/serial_uart.h"
 #include "io/serial.h"
 
+#include "scheduler/scheduler.h"
+
 #include "telemetry/telemetry.h"
 
 #include "rx/rx.h"
@@ -117,6 +119,7 @@ static void ibusDataReceive(uint16_t c, void *rxCallbackData)
 
     if (ibusFramePosition == ibusFrameSize - 1) {
         ibusFrameDone = true;
+        schedulerSignalTask(TASK_RX);
     } else {
         ibusFramePosition++;
     }
@@ -216,6 +219,7 @@ bool ibusInit(const rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig)
 
     rxRuntimeConfig->rcReadRawFn = ibusReadRawRC;
     rxRuntimeConfig->rcFrameStatusFn = ibusFrameStatus;
+    rxRuntimeConfig->frameSignalled = true;
 
     const serialPortConfig_t *portConfig = findSerialPortConfig(FUNCTION_RX_SERIAL);
     if (!portConfig) {
@@ -241,6 +241,7 @@ void rxInit(void)
     rxRuntimeConfig.rcFrameStatusFn = nullFrameStatus;
     rxRuntimeConfig.rxSignalTimeout = DELAY_10_HZ;
     rxRuntimeConfig.requireFiltering = false;
+    rxRuntimeConfig.frameSignalled = false;
     rcSampleIndex = 0;
 
     for (int i = 0; i < MAX_SUPPORTED_RC_CHANNEL_COUNT; i++) {
@@ -279,6 +280,7 @@ void rxInit(void)
                 rxConfigMutable()->receiverType = RX_TYPE_NONE;
                 rxRuntimeConfig.rcReadRawFn = nullReadRawRC;
                 rxRuntimeConfig.rcFrameStatusFn = nullFrameStatus;
+                rxRuntimeConfig.frameSignalled = false;
             }
             break;
 #endif
@@ -385,6 +387,11 @@ void resumeRxSignal(void)
     failsafeOnRxResume();
 }
 
+bool rxIsFrameSignalled(void)
+{
+    return rxRuntimeConfig.frameSignalled;
+}
+
 bool rxUpdateCheck(timeUs_t currentTimeUs, timeDelta_t currentDeltaTime)
 {
     UNUSED(currentDeltaTime);
@@ -149,6 +149,7 @@ typedef struct rxRuntimeConfig_s {
     rcProcessFrameFnPtr rcProcessFrameFn;
     uint16_t *channelData;
     void *frameData;
+    bool frameSignalled;                   // driver wakes up TASK_RX from its receive ISR when a frame is complete
 } rxRuntimeConfig_t;
 
 typedef enum {
@@ -165,6 +166,7 @@ void rxInit(void);
 void rxUpdateRSSISource(void);
 bool rxUpdateCheck(timeUs_t currentTimeUs, timeDelta_t currentDeltaTime);
 bool rxIsReceivingSignal(void);
+bool rxIsFrameSignalled(void);
 bool rxAreFlightChannelsValid(void);
 void calculateRxChannelsAndUpdateFailsafe(timeUs_t currentTimeUs);
 
@@ -43,6 +43,8 @@
 #include "rx/rx.h"
 #include "rx/spektrum.h"
 
+#include "scheduler/scheduler.h"
+
 // driver for spektrum satellite receiver / sbus
 
 #define SPEKTRUM_MAX_SUPPORTED_CHANNEL_COUNT 12
@@ -104,6 +106,7 @@ static void spektrumDataReceive(uint16_t c, void *rxCallbackData)
         spekFrame[spekFramePosition++] = (uint8_t)c;
         if (spekFramePosition == SPEK_FRAME_SIZE) {
             rcFrameComplete = true;
+            schedulerSignalTask(TASK_RX);
         } else {
             rcFrameComplete = false;
         }
@@ -276,6 +279,7 @@ bool spektrumInit(const rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig
 
     rxRuntimeConfig->rcReadRawFn = spektrumReadRawRC;
     rxRuntimeConfig->rcFrameStatusFn = spektrumFrameStatus;
+    rxRuntimeConfig->frameSignalled = true;
 
     const serialPortConfig_t *portConfig = findSerialPortConfig(FUNCTION_RX_SERIAL);
     if (!portConfig) {
@@ -34,6 +34,8 @@
 #include "rx/rx.h"
 #include "rx/sumd.h"
 
+#include "scheduler/scheduler.h"
+
 #include "telemetry/telemetry.h"
 
 // driver for SUMD receiver using UART2
@@ -103,6 +105,7 @@ static void sumdDataReceive(uint16_t c, void *rxCallbackData)
         if (sumdIndex == sumdChannelCount * 2 + 5) {
             sumdIndex = 0;
             sumdFrameDone = true;
+            schedulerSignalTask(TASK_RX);
         }
 }
 
@@ -171,6 +174,7 @@ bool sumdInit(const rxConfig_t *rxConfig, rxRuntimeConfig_t *rxRuntimeConfig)
 
     rxRuntimeConfig->rcReadRawFn = sumdReadRawRC;
     rxRuntimeConfig->rcFrameStatusFn = sumdFrameStatus;
+    rxRuntimeConfig->frameSignalled = true;
 
     const serialPortConfig_t *portConfig = findSerialPortConfig(FUNCTION_RX_SERIAL);
     if (!portConfig) {
@@ -23,6 +23,7 @@
 
 #include "scheduler.h"
 
+#include "build/atomic.h"
 #include "build/build_config.h"
 #include "build/debug.h"
 
@@ -34,25 +35,178 @@
 
 STATIC_FASTRAM cfTask_t *currentTask = NULL;
 
+#if defined(UNIT_TEST) || defined(SIMULATOR_BUILD)
+// Not FASTRAM, it has to be initialised
+static schedulerTimeSourceFn *schedulerTimeSource = micros;
+#define schedulerMicros() schedulerTimeSource()
+#else
+// Hardware has no other clock, save the indirect call in every scheduler pass
+#define schedulerMicros() micros()
+#endif
+
 STATIC_FASTRAM uint32_t totalWaitingTasks;
 STATIC_FASTRAM uint32_t totalWaitingTasksSamples;
 
 FASTRAM uint16_t averageSystemLoadPercent = 0;
 
 
+// Unit tests can enlarge the queue to benchmark more tasks than a target has
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS TASK_COUNT
+#endif
+
 STATIC_FASTRAM int taskQueuePos = 0;
 STATIC_FASTRAM int taskQueueSize = 0;
 // No need for a linked list for the queue, since items are only inserted at startup
 #ifdef UNIT_TEST
-STATIC_FASTRAM_UNIT_TESTED cfTask_t* taskQueueArray[TASK_COUNT + 2]; // 1 extra space so test code can check for buffer overruns
+STATIC_FASTRAM_UNIT_TESTED cfTask_t* taskQueueArray[SCHEDULER_MAX_TASKS + 2]; // 1 extra space so test code can check for buffer overruns
+#else
+STATIC_FASTRAM cfTask_t* taskQueueArray[SCHEDULER_MAX_TASKS + 1]; // extra item for NULL pointer at end of queue
+#endif
+
+/*
+ * Time-driven tasks are also kept in binary min-heaps ordered by the time
+ * they are next due, so scheduler() only has to look at the tasks which are
+ * actually due. Realtime tasks have a heap of their own, which makes the
+ * realtime guard interval a single lookup. Event driven tasks are kept in a
+ * plain list since their checkFunc has to be polled anyway.
+ */
+typedef struct {
+    cfTask_t *tasks[SCHEDULER_MAX_TASKS];
+    int size;
+} taskHeap_t;
+
+// Event driven tasks signalled from ISRs, one bit per task id
+static volatile uint32_t pendingTaskSignals;
+STATIC_ASSERT(TASK_COUNT <= 32, too_many_tasks_for_signal_mask);
+
+STATIC_FASTRAM taskHeap_t realtimeTaskHeap;
+STATIC_FASTRAM taskHeap_t timedTaskHeap;
+STATIC_FASTRAM cfTask_t *eventTaskArray[SCHEDULER_MAX_TASKS];
+STATIC_FASTRAM int eventTaskCount;
+
+static inline timeUs_t taskNextExecuteAt(const cfTask_t *task)
+{
+    return task->lastExecutedAt + task->desiredPeriod;
+}
+
+static inline bool timeIsBefore(timeUs_t a, timeUs_t b)
+{
+#ifdef USE_64BIT_TIME
+    return a < b;
 #else
-STATIC_FASTRAM cfTask_t* taskQueueArray[TASK_COUNT + 1]; // extra item for NULL pointer at end of queue
+    return cmpTimeUs(a, b) < 0;
 #endif
+}
+
+static inline taskHeap_t *taskHeapFor(const cfTask_t *task)
+{
+    return (task->staticPriority >= TASK_PRIORITY_REALTIME) ? &realtimeTaskHeap : &timedTaskHeap;
+}
+
+static inline void heapSet(taskHeap_t *heap, int index, cfTask_t *task)
+{
+    heap->tasks[index] = task;
+    task->heapIndex = index;
+}
+
+static void heapSiftUp(taskHeap_t *heap, int index)
+{
+    cfTask_t *task = heap->tasks[index];
+    const timeUs_t nextExecuteAt = taskNextExecuteAt(task);
+    while (index > 0) {
+        const int parent = (index - 1) / 2;
+        if (!timeIsBefore(nextExecuteAt, taskNextExecuteAt(heap->tasks[parent]))) {
+            break;
+        }
+        heapSet(heap, index, heap->tasks[parent]);
+        index = parent;
+    }
+    heapSet(heap, index, task);
+}
+
+static void heapSiftDown(taskHeap_t *heap, int index)
+{
+    cfTask_t *task = heap->tasks[index];
+    const timeUs_t nextExecuteAt = taskNextExecuteAt(task);
+    while (true) {
+        int child = 2 * index + 1;
+        if (child >= heap->size) {
+            break;
+        }
+        if (child + 1 < heap->size && timeIsBefore(taskNextExecuteAt(heap->tasks[child + 1]), taskNextExecuteAt(heap->tasks[child]))) {
+            child++;
+        }
+        if (!timeIsBefore(taskNextExecuteAt(heap->tasks[child]), nextExecuteAt)) {
+            break;
+        }
+        heapSet(heap, index, heap->tasks[child]);
+        index = child;
+    }
+    heapSet(heap, index, task);
+}
+
+static bool heapContains(const taskHeap_t *heap, const cfTask_t *task)
+{
+    return task->heapIndex < heap->size && heap->tasks[task->heapIndex] == task;
+}
+
+static void heapInsert(taskHeap_t *heap, cfTask_t *task)
+{
+    heapSet(heap, heap->size++, task);
+    heapSiftUp(heap, task->heapIndex);
+}
+
+static void heapRemove(taskHeap_t *heap, cfTask_t *task)
+{
+    const int index = task->heapIndex;
+    cfTask_t *last = heap->tasks[--heap->size];
+    if (last != task) {
+        heapSet(heap, index, last);
+        heapSiftUp(heap, index);
+        heapSiftDown(heap, last->heapIndex);
+    }
+}
+
+// Re-establishes the heap order after the deadline of a task has changed
+static void heapUpdate(taskHeap_t *heap, cfTask_t *task)
+{
+    heapSiftUp(heap, task->heapIndex);
+    heapSiftDown(heap, task->heapIndex);
+}
+
+static void scheduleTask(cfTask_t *task)
+{
+    if (task->checkFunc) {
+        eventTaskArray[eventTaskCount++] = task;
+    } else {
+        heapInsert(taskHeapFor(task), task);
+    }
+}
+
+static void unscheduleTask(cfTask_t *task)
+{
+    if (task->checkFunc) {
+        for (int ii = 0; ii < eventTaskCount; ++ii) {
+            if (eventTaskArray[ii] == task) {
+                memmove(&eventTaskArray[ii], &eventTaskArray[ii+1], sizeof(task) * (eventTaskCount - ii - 1));
+                --eventTaskCount;
+                return;
+            }
+        }
+    } else {
+        heapRemove(taskHeapFor(task), task);
+    }
+}
+
 STATIC_UNIT_TESTED void queueClear(void)
 {
     memset(taskQueueArray, 0, sizeof(taskQueueArray));
     taskQueuePos = 0;
     taskQueueSize = 0;
+    realtimeTaskHeap.size = 0;
+    timedTaskHeap.size = 0;
+    eventTaskCount = 0;
 }
 
 #ifdef UNIT_TEST
@@ -74,7 +228,7 @@ STATIC_UNIT_TESTED bool queueContains(cfTask_t *task)
 
 STATIC_UNIT_TESTED bool queueAdd(cfTask_t *task)
 {
-    if ((taskQueueSize >= TASK_COUNT) || queueContains(task)) {
+    if ((taskQueueSize >= SCHEDULER_MAX_TASKS) || queueContains(task)) {
         return false;
     }
     for (int ii = 0; ii <= taskQueueSize; ++ii) {
@@ -82,6 +236,7 @@ STATIC_UNIT_TESTED bool queueAdd(cfTask_t *task)
             memmove(&taskQueueArray[ii+1], &taskQueueArray[ii], sizeof(task) * (taskQueueSize - ii));
             taskQueueArray[ii] = task;
             ++taskQueueSize;
+            scheduleTask(task);
             return true;
         }
     }
@@ -94,6 +249,7 @@ STATIC_UNIT_TESTED bool queueRemove(cfTask_t *task)
         if (taskQueueArray[ii] == task) {
             memmove(&taskQueueArray[ii], &taskQueueArray[ii+1], sizeof(task) * (taskQueueSize - ii));
             --taskQueueSize;
+            unscheduleTask(task);
             return true;
         }
     }
@@ -155,14 +311,41 @@ void getTaskInfo(cfTaskId_e taskId, cfTaskInfo_t * taskInfo)
 }
 #endif
 
+#ifdef USE_TASK_HISTOGRAMS
+static void getLatencyPercentiles(const histogram_t *histogram, cfLatencyPercentiles_t *percentiles)
+{
+    percentiles->samples = histogramSampleCount(histogram);
+    percentiles->p50 = histogramPercentile(histogram, 500);
+    percentiles->p99 = histogramPercentile(histogram, 990);
+    percentiles->p999 = histogramPercentile(histogram, 999);
+}
+#endif
+
+bool getTaskLatencyInfo(cfTaskId_e taskId, cfTaskLatencyInfo_t *latencyInfo)
+{
+#ifdef USE_TASK_HISTOGRAMS
+    if (taskId < TASK_COUNT) {
+        getLatencyPercentiles(&cfTasks[taskId].executionTimeHistogram, &latencyInfo->executionTime);
+        getLatencyPercentiles(&cfTasks[taskId].startJitterHistogram, &latencyInfo->startJitter);
+        return true;
+    }
+#else
+    UNUSED(taskId);
+    UNUSED(latencyInfo);
+#endif
+    return false;
+}
+
 void rescheduleTask(cfTaskId_e taskId, timeDelta_t newPeriodUs)
 {
-    if (taskId == TASK_SELF) {
-        cfTask_t *task = currentTask;
-        task->desiredPeriod = MAX(SCHEDULER_DELAY_LIMIT, newPeriodUs);  // Limit delay to 100us (10 kHz) to prevent scheduler clogging
-    } else if (taskId < TASK_COUNT) {
-        cfTask_t *task = &cfTasks[taskId];
+    if (taskId == TASK_SELF || taskId < TASK_COUNT) {
+        cfTask_t *task = taskId == TASK_SELF ? currentTask : &cfTasks[taskId];
         task->desiredPeriod = MAX(SCHEDULER_DELAY_LIMIT, newPeriodUs);  // Limit delay to 100us (10 kHz) to prevent scheduler clogging
+        // Deadline has moved
+        taskHeap_t *heap = taskHeapFor(task);
+        if (!task->checkFunc && heapContains(heap, task)) {
+            heapUpdate(heap, task);
+        }
     }
 }
 
@@ -178,6 +361,46 @@ void setTaskEnabled(cfTaskId_e taskId, bool enabled)
     }
 }
 
+/*
+ * Signal driven tasks don't get their checkFunc polled on every scheduler
+ * pass. Instead the ISR that produces their data calls schedulerSignalTask()
+ * and the checkFunc is called on the next pass. The checkFunc is still
+ * called once per desiredPeriod without a signal, so timeouts are handled.
+ */
+void setTaskSignalDriven(cfTaskId_e taskId, bool signalDriven)
+{
+    if (taskId == TASK_SELF || taskId < TASK_COUNT) {
+        cfTask_t *task = taskId == TASK_SELF ? currentTask : &cfTasks[taskId];
+        task->signalDriven = signalDriven && task->checkFunc;
+    }
+}
+
+// Safe to call from an ISR
+void schedulerSignalTask(cfTaskId_e taskId)
+{
+    if (taskId < TASK_COUNT) {
+        ATOMIC_OR(&pendingTaskSignals, 1U << taskId);
+    }
+}
+
+static bool taskNeedsCheck(cfTask_t *task, timeUs_t currentTimeUs)
+{
+    if (!task->signalDriven) {
+        return true;
+    }
+
+    const uint32_t taskSignalBit = 1U << (task - cfTasks);
+    if (pendingTaskSignals & taskSignalBit) {
+        // Clear before calling checkFunc, so a signal raised meanwhile is not lost
+        ATOMIC_AND(&pendingTaskSignals, ~taskSignalBit);
+    } else if ((timeUs_t)(currentTimeUs - task->lastCheckedAt) < (timeUs_t)task->desiredPeriod) {
+        return false;
+    }
+
+    task->lastCheckedAt = currentTimeUs;
+    return true;
+}
+
 timeDelta_t getTaskDeltaTime(cfTaskId_e taskId)
 {
     if (taskId == TASK_SELF) {
@@ -194,95 +417,185 @@ void schedulerResetTaskStatistics(cfTaskId_e taskId)
 #ifdef SKIP_TASK_STATISTICS
     UNUSED(taskId);
 #else
-    if (taskId == TASK_SELF) {
-        currentTask->movingSumExecutionTime = 0;
-        currentTask->totalExecutionTime = 0;
-        currentTask->maxExecutionTime = 0;
-    } else if (taskId < TASK_COUNT) {
-        cfTasks[taskId].movingSumExecutionTime = 0;
-        cfTasks[taskId].totalExecutionTime = 0;
-        cfTasks[taskId].totalExecutionTime = 0;
+    if (taskId == TASK_SELF || taskId < TASK_COUNT) {
+        cfTask_t *task = taskId == TASK_SELF ? currentTask : &cfTasks[taskId];
+        task->movingSumExecutionTime = 0;
+        task->totalExecutionTime = 0;
+        task->maxExecutionTime = 0;
+#ifdef USE_TASK_HISTOGRAMS
+        histogramReset(&task->executionTimeHistogram);
+        histogramReset(&task->startJitterHistogram);
+#endif
     }
 #endif
 }
 
+#if defined(UNIT_TEST) || defined(SIMULATOR_BUILD)
+void schedulerSetTimeSource(schedulerTimeSourceFn *timeSource)
+{
+    schedulerTimeSource = timeSource ? timeSource : micros;
+}
+#endif
+
+/*
+ * Time until the earliest time-driven task becomes due, 0 if one is already
+ * due or TIMEUS_MAX if there are none. Event driven tasks are not included,
+ * their checkFunc is polled on every scheduler() call instead.
+ */
+timeUs_t schedulerGetTimeToNextTask(timeUs_t currentTimeUs)
+{
+    // Signalled or already triggered event driven tasks are waiting to run
+    if (pendingTaskSignals) {
+        return 0;
+    }
+    for (int ii = 0; ii < eventTaskCount; ++ii) {
+        if (eventTaskArray[ii]->dynamicPriority > 0) {
+            return 0;
+        }
+    }
+
+    timeUs_t timeToNextTask = TIMEUS_MAX;
+    const taskHeap_t *heaps[] = { &realtimeTaskHeap, &timedTaskHeap };
+    for (unsigned ii = 0; ii < ARRAYLEN(heaps); ++ii) {
+        if (heaps[ii]->size > 0) {
+            const timeUs_t nextExecuteAt = taskNextExecuteAt(heaps[ii]->tasks[0]);
+            if (!timeIsBefore(currentTimeUs, nextExecuteAt)) {
+                return 0;
+            }
+            timeToNextTask = MIN(timeToNextTask, nextExecuteAt - currentTimeUs);
+        }
+    }
+    return timeToNextTask;
+}
+
 void schedulerInit(void)
 {
     queueClear();
     queueAdd(&cfTasks[TASK_SYSTEM]);
 }
 
+typedef struct {
+    cfTask_t *task;
+    uint16_t waitingTasks;
+    bool outsideRealtimeGuardInterval;
+} taskSelection_t;
+
+static inline void considerTask(taskSelection_t *selection, cfTask_t *task)
+{
+    const cfTask_t *selectedTask = selection->task;
+    if (selectedTask) {
+        // Ties go to the higher static priority, then to the task declared first
+        if (task->dynamicPriority < selectedTask->dynamicPriority) {
+            return;
+        }
+        if (task->dynamicPriority == selectedTask->dynamicPriority &&
+            (task->staticPriority < selectedTask->staticPriority || (task->staticPriority == selectedTask->staticPriority && task > selectedTask))) {
+            return;
+        }
+    } else if (task->dynamicPriority == 0) {
+        return;
+    }
+
+    const bool taskCanBeChosenForScheduling =
+        (selection->outsideRealtimeGuardInterval) ||
+        (task->taskAgeCycles > 1) ||
+        (task->staticPriority == TASK_PRIORITY_REALTIME);
+    if (taskCanBeChosenForScheduling) {
+        selection->task = task;
+    }
+}
+
+/*
+ * Updates the dynamic priority of the due tasks in a heap. The tree is only
+ * descended below tasks which are due, since their children are due later.
+ */
+static void considerDueTasks(taskSelection_t *selection, taskHeap_t *heap, timeUs_t currentTimeUs)
+{
+    int stack[SCHEDULER_MAX_TASKS];
+    int stackSize = 0;
+
+    if (heap->size > 0) {
+        stack[stackSize++] = 0;
+    }
+
+    while (stackSize > 0) {
+        const int index = stack[--stackSize];
+        cfTask_t *task = heap->tasks[index];
+        if (timeIsBefore(currentTimeUs, taskNextExecuteAt(task))) {
+            continue;
+        }
+
+        // Task is time-driven, dynamicPriority is last execution age (measured in desiredPeriods)
+        // Task age is calculated from last execution
+        task->taskAgeCycles = ((timeDelta_t)(currentTimeUs - task->lastExecutedAt)) / task->desiredPeriod;
+        task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+        selection->waitingTasks++;
+        considerTask(selection, task);
+
+        const int child = 2 * index + 1;
+        if (child < heap->size) {
+            stack[stackSize++] = child;
+        }
+        if (child + 1 < heap->size) {
+            stack[stackSize++] = child + 1;
+        }
+    }
+}
+
 void scheduler(void)
 {
     // Cache currentTime
-    const timeUs_t currentTimeUs = micros();
+    const timeUs_t currentTimeUs = schedulerMicros();
 
-    // Check for realtime tasks
+    // Check for realtime tasks, the earliest one is at the top of the heap
     timeUs_t timeToNextRealtimeTask = TIMEUS_MAX;
-    for (const cfTask_t *task = queueFirst(); task != NULL && task->staticPriority >= TASK_PRIORITY_REALTIME; task = queueNext()) {
-        const timeUs_t nextExecuteAt = task->lastExecutedAt + task->desiredPeriod;
-        if ((int32_t)(currentTimeUs - nextExecuteAt) >= 0) {
-            timeToNextRealtimeTask = 0;
-        } else {
-            const timeUs_t newTimeInterval = nextExecuteAt - currentTimeUs;
-            timeToNextRealtimeTask = MIN(timeToNextRealtimeTask, newTimeInterval);
-        }
+    if (realtimeTaskHeap.size > 0) {
+        const timeUs_t nextExecuteAt = taskNextExecuteAt(realtimeTaskHeap.tasks[0]);
+        timeToNextRealtimeTask = timeIsBefore(currentTimeUs, nextExecuteAt) ? nextExecuteAt - currentTimeUs : 0;
     }
-    const bool outsideRealtimeGuardInterval = (timeToNextRealtimeTask > 0);
-
-    // The task to be invoked
-    cfTask_t *selectedTask = NULL;
-    uint16_t selectedTaskDynamicPriority = 0;
-
-    // Update task dynamic priorities
-    uint16_t waitingTasks = 0;
-    for (cfTask_t *task = queueFirst(); task != NULL; task = queueNext()) {
-        // Task has checkFunc - event driven
-        if (task->checkFunc) {
-            const timeUs_t currentTimeBeforeCheckFuncCallUs = micros();
-
-            // Increase priority for event driven tasks
-            if (task->dynamicPriority > 0) {
-                task->taskAgeCycles = 1 + ((timeDelta_t)(currentTimeUs - task->lastSignaledAt)) / task->desiredPeriod;
-                task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
-                waitingTasks++;
-            } else if (task->checkFunc(currentTimeBeforeCheckFuncCallUs, currentTimeBeforeCheckFuncCallUs - task->lastExecutedAt)) {
+
+    taskSelection_t selection = {
+        .task = NULL,
+        .waitingTasks = 0,
+        .outsideRealtimeGuardInterval = (timeToNextRealtimeTask > 0),
+    };
+
+    // Update event driven task dynamic priorities
+    for (int ii = 0; ii < eventTaskCount; ++ii) {
+        cfTask_t *task = eventTaskArray[ii];
+        const timeUs_t currentTimeBeforeCheckFuncCallUs = schedulerMicros();
+
+        // Increase priority for event driven tasks
+        if (task->dynamicPriority > 0) {
+            task->taskAgeCycles = 1 + ((timeDelta_t)(currentTimeUs - task->lastSignaledAt)) / task->desiredPeriod;
+            task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+            selection.waitingTasks++;
+        } else if (taskNeedsCheck(task, currentTimeUs) && task->checkFunc(currentTimeBeforeCheckFuncCallUs, currentTimeBeforeCheckFuncCallUs - task->lastExecutedAt)) {
 #ifndef SKIP_TASK_STATISTICS
-                const timeUs_t checkFuncExecutionTime = micros() - currentTimeBeforeCheckFuncCallUs;
-                checkFuncMovingSumExecutionTime -= checkFuncMovingSumExecutionTime / TASK_MOVING_SUM_COUNT;
-                checkFuncMovingSumExecutionTime += checkFuncExecutionTime;
-                checkFuncTotalExecutionTime += checkFuncExecutionTime;   // time consumed by scheduler + task
-                checkFuncMaxExecutionTime = MAX(checkFuncMaxExecutionTime, checkFuncExecutionTime);
+            const timeUs_t checkFuncExecutionTime = schedulerMicros() - currentTimeBeforeCheckFuncCallUs;
+            checkFuncMovingSumExecutionTime -= checkFuncMovingSumExecutionTime / TASK_MOVING_SUM_COUNT;
+            checkFuncMovingSumExecutionTime += checkFuncExecutionTime;
+            checkFuncTotalExecutionTime += checkFuncExecutionTime;   // time consumed by scheduler + task
+            checkFuncMaxExecutionTime = MAX(checkFuncMaxExecutionTime, checkFuncExecutionTime);
 #endif
-                task->lastSignaledAt = currentTimeBeforeCheckFuncCallUs;
-                task->taskAgeCycles = 1;
-                task->dynamicPriority = 1 + task->staticPriority;
-                waitingTasks++;
-            } else {
-                task->taskAgeCycles = 0;
-            }
+            task->lastSignaledAt = currentTimeBeforeCheckFuncCallUs;
+            task->taskAgeCycles = 1;
+            task->dynamicPriority = 1 + task->staticPriority;
+            selection.waitingTasks++;
         } else {
-            // Task is time-driven, dynamicPriority is last execution age (measured in desiredPeriods)
-            // Task age is calculated from last execution
-            task->taskAgeCycles = ((timeDelta_t)(currentTimeUs - task->lastExecutedAt)) / task->desiredPeriod;
-            if (task->taskAgeCycles > 0) {
-                task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
-                waitingTasks++;
-            }
+            task->taskAgeCycles = 0;
         }
 
-        if (task->dynamicPriority > selectedTaskDynamicPriority) {
-            const bool taskCanBeChosenForScheduling =
-                (outsideRealtimeGuardInterval) ||
-                (task->taskAgeCycles > 1) ||
-                (task->staticPriority == TASK_PRIORITY_REALTIME);
-            if (taskCanBeChosenForScheduling) {
-                selectedTaskDynamicPriority = task->dynamicPriority;
-                selectedTask = task;
-            }
-        }
+        considerTask(&selection, task);
     }
 
+    // Time-driven tasks, only the ones which are due are looked at
+    considerDueTasks(&selection, &realtimeTaskHeap, currentTimeUs);
+    considerDueTasks(&selection, &timedTaskHeap, currentTimeUs);
+
+    cfTask_t *selectedTask = selection.task;
+    const uint16_t waitingTasks = selection.waitingTasks;
+
     totalWaitingTasksSamples++;
     totalWaitingTasks += waitingTasks;
 
@@ -291,23 +604,39 @@ void scheduler(void)
     if (selectedTask) {
         // Found a task that should be run
         selectedTask->taskLatestDeltaTime = (timeDelta_t)(currentTimeUs - selectedTask->lastExecutedAt);
+#ifdef USE_TASK_HISTOGRAMS
+        // First run after enabling has no meaningful start time
+        if (selectedTask->lastExecutedAt) {
+            const timeDelta_t startJitter = selectedTask->checkFunc ?
+                (timeDelta_t)(currentTimeUs - selectedTask->lastSignaledAt) :
+                ABS(selectedTask->taskLatestDeltaTime - selectedTask->desiredPeriod);
+            histogramAdd(&selectedTask->startJitterHistogram, startJitter);
+        }
+#endif
         selectedTask->lastExecutedAt = currentTimeUs;
         selectedTask->dynamicPriority = 0;
+        if (!selectedTask->checkFunc) {
+            // Deadline only moves forward
+            heapSiftDown(taskHeapFor(selectedTask), selectedTask->heapIndex);
+        }
 
         // Execute task
-        const timeUs_t currentTimeBeforeTaskCall = micros();
+        const timeUs_t currentTimeBeforeTaskCall = schedulerMicros();
         selectedTask->taskFunc(currentTimeBeforeTaskCall);
 
 #ifndef SKIP_TASK_STATISTICS
-        const timeUs_t taskExecutionTime = micros() - currentTimeBeforeTaskCall;
+        const timeUs_t taskExecutionTime = schedulerMicros() - currentTimeBeforeTaskCall;
         selectedTask->movingSumExecutionTime += taskExecutionTime - selectedTask->movingSumExecutionTime / TASK_MOVING_SUM_COUNT;
         selectedTask->totalExecutionTime += taskExecutionTime;   // time consumed by scheduler + task
         selectedTask->maxExecutionTime = MAX(selectedTask->maxExecutionTime, taskExecutionTime);
+#ifdef USE_TASK_HISTOGRAMS
+        histogramAdd(&selectedTask->executionTimeHistogram, taskExecutionTime);
+#endif
 #endif
 #if defined(SCHEDULER_DEBUG)
-        DEBUG_SET(DEBUG_SCHEDULER, 2, micros() - currentTimeUs - taskExecutionTime); // time spent in scheduler
+        DEBUG_SET(DEBUG_SCHEDULER, 2, schedulerMicros() - currentTimeUs - taskExecutionTime); // time spent in scheduler
     } else {
-        DEBUG_SET(DEBUG_SCHEDULER, 2, micros() - currentTimeUs);
+        DEBUG_SET(DEBUG_SCHEDULER, 2, schedulerMicros() - currentTimeUs);
 #endif
     }
 }
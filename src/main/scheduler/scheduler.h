@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include "common/histogram.h"
 #include "common/time.h"
 
 //#define SCHEDULER_DEBUG
@@ -48,6 +49,20 @@ typedef struct {
     timeDelta_t     latestDeltaTime;
 } cfTaskInfo_t;
 
+typedef struct {
+    uint32_t     samples;
+    uint32_t     p50;
+    uint32_t     p99;
+    uint32_t     p999;
+} cfLatencyPercentiles_t;
+
+typedef struct {
+    cfLatencyPercentiles_t executionTime;
+    // Time-driven tasks: start time deviation from desiredPeriod.
+    // Event driven tasks: time from checkFunc signalling to start.
+    cfLatencyPercentiles_t startJitter;
+} cfTaskLatencyInfo_t;
+
 typedef enum {
     /* Actual tasks */
     TASK_SYSTEM = 0,
@@ -117,6 +132,9 @@ typedef enum {
 #ifdef VTX_CONTROL
     TASK_VTXCTRL,
 #endif
+#ifdef USE_FLASHFS
+    TASK_FLASHFS,
+#endif
 
     /* Count of real tasks */
     TASK_COUNT,
@@ -137,8 +155,11 @@ typedef struct {
     /* Scheduling */
     uint16_t dynamicPriority;       // measurement of how old task was last executed, used to avoid task starvation
     uint16_t taskAgeCycles;
+    uint8_t heapIndex;              // position in the deadline heap, time-driven tasks only
     timeUs_t lastExecutedAt;        // last time of invocation
     timeUs_t lastSignaledAt;        // time of invocation event for event-driven tasks
+    timeUs_t lastCheckedAt;         // last checkFunc call of a signal driven task
+    bool signalDriven;              // checkFunc is only called after schedulerSignalTask() or once per desiredPeriod
     timeDelta_t taskLatestDeltaTime;
 
     /* Statistics */
@@ -147,6 +168,10 @@ typedef struct {
     timeUs_t maxExecutionTime;
     timeUs_t totalExecutionTime;    // total time consumed by task since boot
 #endif
+#ifdef USE_TASK_HISTOGRAMS
+    histogram_t executionTimeHistogram;
+    histogram_t startJitterHistogram;
+#endif
 } cfTask_t;
 
 extern cfTask_t cfTasks[TASK_COUNT];
@@ -154,11 +179,23 @@ extern uint16_t averageSystemLoadPercent;
 
 void getCheckFuncInfo(cfCheckFuncInfo_t *checkFuncInfo);
 void getTaskInfo(cfTaskId_e taskId, cfTaskInfo_t *taskInfo);
+bool getTaskLatencyInfo(cfTaskId_e taskId, cfTaskLatencyInfo_t *latencyInfo);
 void rescheduleTask(cfTaskId_e taskId, timeDelta_t newPeriodUs);
 void setTaskEnabled(cfTaskId_e taskId, bool newEnabledState);
+void setTaskSignalDriven(cfTaskId_e taskId, bool signalDriven);
+void schedulerSignalTask(cfTaskId_e taskId);
 timeDelta_t getTaskDeltaTime(cfTaskId_e taskId);
 void schedulerResetTaskStatistics(cfTaskId_e taskId);
 
+// Clock used by scheduler() for dispatch and task statistics, micros() by default.
+// Host builds can plug in a virtual clock to run faster than real time.
+// schedulerGetTimeToNextTask() is 0 while a triggered or signalled task waits to run.
+#if defined(UNIT_TEST) || defined(SIMULATOR_BUILD)
+typedef timeUs_t schedulerTimeSourceFn(void);
+void schedulerSetTimeSource(schedulerTimeSourceFn *timeSource);
+#endif
+timeUs_t schedulerGetTimeToNextTask(timeUs_t currentTimeUs);
+
 void schedulerInit(void);
 void scheduler(void);
 void taskSystem(timeUs_t currentTimeUs);
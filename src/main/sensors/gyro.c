@@ -61,6 +61,7 @@
 
 #include "sensors/boardalignment.h"
 #include "sensors/gyro.h"
+#include "sensors/gyroanalyse.h"
 #include "sensors/sensors.h"
 
 #ifdef USE_HARDWARE_REVISION_DETECTION
@@ -81,19 +82,17 @@ typedef struct gyroCalibration_s {
 STATIC_FASTRAM_UNIT_TESTED gyroCalibration_t gyroCalibration;
 STATIC_FASTRAM int32_t gyroADC[XYZ_AXIS_COUNT];
 
-STATIC_FASTRAM filterApplyFnPtr softLpfFilterApplyFn;
-STATIC_FASTRAM void *softLpfFilter[XYZ_AXIS_COUNT];
+// Soft LPF and notches, applied to all three axes in one go
+STATIC_FASTRAM biquadCascadeXYZ_t gyroFilterCascade;
+STATIC_FASTRAM bool gyroSoftLpfEnabled;
 
-#ifdef USE_GYRO_NOTCH_1
-STATIC_FASTRAM filterApplyFnPtr notchFilter1ApplyFn;
-STATIC_FASTRAM void *notchFilter1[XYZ_AXIS_COUNT];
-#endif
-#ifdef USE_GYRO_NOTCH_2
-STATIC_FASTRAM filterApplyFnPtr notchFilter2ApplyFn;
-STATIC_FASTRAM void *notchFilter2[XYZ_AXIS_COUNT];
+#ifdef USE_DYNAMIC_FILTERS
+// Notch per axis following the strongest noise peak found by gyroDataAnalyse()
+STATIC_FASTRAM bool dynamicNotchEnabled;
+STATIC_FASTRAM biquadFilter_t dynamicNotchFilter[XYZ_AXIS_COUNT];
 #endif
 
-PG_REGISTER_WITH_RESET_TEMPLATE(gyroConfig_t, gyroConfig, PG_GYRO_CONFIG, 2);
+PG_REGISTER_WITH_RESET_TEMPLATE(gyroConfig_t, gyroConfig, PG_GYRO_CONFIG, 3);
 
 PG_RESET_TEMPLATE(gyroConfig_t, gyroConfig,
     .gyro_lpf = GYRO_LPF_42HZ,      // 42HZ value is defined for Invensense/TDK gyros
@@ -106,7 +105,10 @@ PG_RESET_TEMPLATE(gyroConfig_t, gyroConfig,
     .gyro_soft_notch_hz_1 = 0,
     .gyro_soft_notch_cutoff_1 = 1,
     .gyro_soft_notch_hz_2 = 0,
-    .gyro_soft_notch_cutoff_2 = 1
+    .gyro_soft_notch_cutoff_2 = 1,
+    .dynamicGyroNotchEnabled = 0,
+    .dynamicGyroNotchQ = 120,
+    .dynamicGyroNotchMinHz = 150
 );
 
 STATIC_UNIT_TESTED gyroSensor_e gyroDetect(gyroDev_t *dev, gyroSensor_e gyroHardware)
@@ -258,41 +260,36 @@ bool gyroInit(void)
 
 void gyroInitFilters(void)
 {
-    STATIC_FASTRAM biquadFilter_t gyroFilterLPF[XYZ_AXIS_COUNT];
-    softLpfFilterApplyFn = nullFilterApply;
-#ifdef USE_GYRO_NOTCH_1
-    STATIC_FASTRAM biquadFilter_t gyroFilterNotch_1[XYZ_AXIS_COUNT];
-    notchFilter1ApplyFn = nullFilterApply;
-#endif
-#ifdef USE_GYRO_NOTCH_2
-    STATIC_FASTRAM biquadFilter_t gyroFilterNotch_2[XYZ_AXIS_COUNT];
-    notchFilter2ApplyFn = nullFilterApply;
-#endif
+    biquadFilter_t filter;
 
-    if (gyroConfig()->gyro_soft_lpf_hz) {
-        softLpfFilterApplyFn = (filterApplyFnPtr)biquadFilterApply;
-        for (int axis = 0; axis < 3; axis++) {
-            softLpfFilter[axis] = &gyroFilterLPF[axis];
-            biquadFilterInitLPF(softLpfFilter[axis], gyroConfig()->gyro_soft_lpf_hz, getGyroUpdateRate());
-        }
+    biquadCascadeXYZInit(&gyroFilterCascade);
+
+    gyroSoftLpfEnabled = gyroConfig()->gyro_soft_lpf_hz != 0;
+    if (gyroSoftLpfEnabled) {
+        biquadFilterInitLPF(&filter, gyroConfig()->gyro_soft_lpf_hz, getGyroUpdateRate());
+        biquadCascadeXYZAddStage(&gyroFilterCascade, &filter);
     }
 
 #ifdef USE_GYRO_NOTCH_1
     if (gyroConfig()->gyro_soft_notch_hz_1) {
-        notchFilter1ApplyFn = (filterApplyFnPtr)biquadFilterApply;
-        for (int axis = 0; axis < 3; axis++) {
-            notchFilter1[axis] = &gyroFilterNotch_1[axis];
-            biquadFilterInitNotch(notchFilter1[axis], getGyroUpdateRate(), gyroConfig()->gyro_soft_notch_hz_1, gyroConfig()->gyro_soft_notch_cutoff_1);
-        }
+        biquadFilterInitNotch(&filter, getGyroUpdateRate(), gyroConfig()->gyro_soft_notch_hz_1, gyroConfig()->gyro_soft_notch_cutoff_1);
+        biquadCascadeXYZAddStage(&gyroFilterCascade, &filter);
     }
 #endif
 
 #ifdef USE_GYRO_NOTCH_2
     if (gyroConfig()->gyro_soft_notch_hz_2) {
-        notchFilter2ApplyFn = (filterApplyFnPtr)biquadFilterApply;
-        for (int axis = 0; axis < 3; axis++) {
-            notchFilter2[axis] = &gyroFilterNotch_2[axis];
-            biquadFilterInitNotch(notchFilter2[axis], getGyroUpdateRate(), gyroConfig()->gyro_soft_notch_hz_2, gyroConfig()->gyro_soft_notch_cutoff_2);
+        biquadFilterInitNotch(&filter, getGyroUpdateRate(), gyroConfig()->gyro_soft_notch_hz_2, gyroConfig()->gyro_soft_notch_cutoff_2);
+        biquadCascadeXYZAddStage(&gyroFilterCascade, &filter);
+    }
+#endif
+
+#ifdef USE_DYNAMIC_FILTERS
+    dynamicNotchEnabled = gyroConfig()->dynamicGyroNotchEnabled;
+    if (dynamicNotchEnabled) {
+        gyroDataAnalyseInit(getGyroUpdateRate(), gyroConfig()->dynamicGyroNotchMinHz, gyroConfig()->dynamicGyroNotchQ);
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            biquadFilterInit(&dynamicNotchFilter[axis], gyroDataAnalyseCenterFrequency(axis), getGyroUpdateRate(), gyroConfig()->dynamicGyroNotchQ / 100.0f, FILTER_NOTCH);
         }
     }
 #endif
@@ -416,22 +413,36 @@ void gyroUpdate(timeDelta_t gyroUpdateDeltaUs)
         return;
     }
 
+    float gyroADCf[XYZ_AXIS_COUNT];
     for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-        float gyroADCf = (float)gyroADC[axis] * gyroDev0.scale;
+        gyroADCf[axis] = (float)gyroADC[axis] * gyroDev0.scale;
+        DEBUG_SET(DEBUG_GYRO, axis, lrintf(gyroADCf[axis]));
+        // Without a soft LPF the notches see the raw gyro value
+        DEBUG_SET(DEBUG_NOTCH, axis, lrintf(gyroADCf[axis]));
+    }
 
-        DEBUG_SET(DEBUG_GYRO, axis, lrintf(gyroADCf));
+#ifdef USE_DYNAMIC_FILTERS
+    if (dynamicNotchEnabled) {
+        // Spectrum is taken before any filtering, one analysis step per call
+        gyroDataAnalyse(gyroADCf, dynamicNotchFilter);
+    }
+#endif
 
-        gyroADCf = softLpfFilterApplyFn(softLpfFilter[axis], gyroADCf);
+    biquadCascadeXYZApply(&gyroFilterCascade, gyroADCf);
 
-        DEBUG_SET(DEBUG_NOTCH, axis, lrintf(gyroADCf));
+    DEBUG_SET(DEBUG_FFT, 3, lrintf(gyroADCf[X]));
 
-#ifdef USE_GYRO_NOTCH_1
-        gyroADCf = notchFilter1ApplyFn(notchFilter1[axis], gyroADCf);
-#endif
-#ifdef USE_GYRO_NOTCH_2
-        gyroADCf = notchFilter2ApplyFn(notchFilter2[axis], gyroADCf);
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        if (gyroSoftLpfEnabled) {
+            // Soft LPF is the first stage of the cascade
+            DEBUG_SET(DEBUG_NOTCH, axis, lrintf(biquadCascadeXYZStageOutput(&gyroFilterCascade, 0, axis)));
+        }
+#ifdef USE_DYNAMIC_FILTERS
+        if (dynamicNotchEnabled) {
+            gyroADCf[axis] = biquadFilterApply(&dynamicNotchFilter[axis], gyroADCf[axis]);
+        }
 #endif
-        gyro.gyroADCf[axis] = gyroADCf;
+        gyro.gyroADCf[axis] = gyroADCf[axis];
     }
 
 #ifdef USE_ASYNC_GYRO_PROCESSING
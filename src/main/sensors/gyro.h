@@ -57,6 +57,9 @@ typedef struct gyroConfig_s {
     uint16_t gyro_soft_notch_cutoff_1;
     uint16_t gyro_soft_notch_hz_2;
     uint16_t gyro_soft_notch_cutoff_2;
+    uint8_t  dynamicGyroNotchEnabled;
+    uint16_t dynamicGyroNotchQ;             // notch Q * 100
+    uint16_t dynamicGyroNotchMinHz;         // lowest frequency the notch follows
 } gyroConfig_t;
 
 PG_DECLARE(gyroConfig_t, gyroConfig);
@@ -0,0 +1,357 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Gyro spectrum analysis for the dynamic notch filter.
+ *
+ * Gyro samples are averaged down to about GYRO_ANALYSE_SAMPLE_RATE_HZ and
+ * kept in a ring buffer per axis. The analysis of one axis (window, real
+ * FFT, magnitudes, peak search, notch update) is split into steps and only
+ * one step runs per gyro update, so the cost added to a single gyro/PID
+ * loop stays at a few microseconds. Each axis gets a new notch frequency
+ * every GYRO_ANALYSE_STEP_COUNT * XYZ_AXIS_COUNT gyro updates.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "platform.h"
+
+#ifdef USE_ARM_MATH
+#include "arm_math.h"
+#endif
+
+#ifdef USE_DYNAMIC_FILTERS
+
+#include "build/debug.h"
+
+#include "common/axis.h"
+#include "common/filter.h"
+#include "common/maths.h"
+#include "common/utils.h"
+
+#include "sensors/gyroanalyse.h"
+
+#define GYRO_ANALYSE_SMOOTHING_HZ       10      // low pass on the detected peak frequency
+#define GYRO_ANALYSE_PEAK_THRESHOLD     2.0f    // peak must be this many times above the band average
+#define GYRO_ANALYSE_MIN_PEAK_DPS       1.0f    // and have at least this amplitude
+
+// Magnitude of a sine of amplitude 1 after the Hanning window
+#define GYRO_ANALYSE_WINDOW_GAIN        (GYRO_ANALYSE_FFT_WINDOW_SIZE / 4.0f)
+
+typedef enum {
+    GYRO_ANALYSE_STEP_WINDOW = 0,
+    GYRO_ANALYSE_STEP_FFT,
+    GYRO_ANALYSE_STEP_MAGNITUDE,
+    GYRO_ANALYSE_STEP_PEAK,
+    GYRO_ANALYSE_STEP_UPDATE_NOTCH,
+    GYRO_ANALYSE_STEP_COUNT
+} gyroAnalyseStep_e;
+
+static uint32_t gyroUpdateRateUs;
+static uint16_t notchQ;
+static uint16_t fftSampleRateHz;
+static float fftBinWidthHz;
+static uint8_t fftMinBin;
+
+static uint8_t sampleDecimation;
+static uint8_t sampleCount;
+static float sampleAccumulator[XYZ_AXIS_COUNT];
+
+static float sampleBuffer[XYZ_AXIS_COUNT][GYRO_ANALYSE_FFT_WINDOW_SIZE];
+static uint8_t sampleBufferIndex;
+
+static float hanningWindow[GYRO_ANALYSE_FFT_WINDOW_SIZE];
+static float fftData[GYRO_ANALYSE_FFT_WINDOW_SIZE];
+static float fftOutput[GYRO_ANALYSE_FFT_WINDOW_SIZE];
+static float binMagnitude[XYZ_AXIS_COUNT][GYRO_ANALYSE_FFT_BIN_COUNT];
+
+static gyroAnalyseStep_e analyseStep;
+static uint8_t analyseAxis;
+static float peakFrequencyHz;
+static pt1Filter_t centerFrequencyFilter[XYZ_AXIS_COUNT];
+static uint16_t centerFrequencyHz[XYZ_AXIS_COUNT];
+static filterCoeffTable_t notchCoeffTable;
+
+// exp(-2 * pi * i * k / N) for k = 0 .. N/2-1, shared by the complex FFT and the real split stage
+static float fftTwiddleRe[GYRO_ANALYSE_FFT_BIN_COUNT];
+static float fftTwiddleIm[GYRO_ANALYSE_FFT_BIN_COUNT];
+
+static void gyroAnalyseFftInit(void)
+{
+    for (int k = 0; k < GYRO_ANALYSE_FFT_BIN_COUNT; k++) {
+        const float angle = -2 * M_PIf * k / GYRO_ANALYSE_FFT_WINDOW_SIZE;
+        fftTwiddleRe[k] = cos_approx(angle);
+        fftTwiddleIm[k] = sin_approx(angle);
+    }
+}
+
+/*
+ * Real FFT of GYRO_ANALYSE_FFT_WINDOW_SIZE samples: the even and odd samples
+ * are packed as one complex sequence of half the length, transformed by a
+ * radix-2 FFT and split into the spectrum of the real input. The output uses
+ * the arm_rfft_fast_f32() layout: DC and Nyquist real parts first, then
+ * interleaved real/imaginary pairs of bins 1 .. N/2-1.
+ *
+ * This avoids the CMSIS real FFT, whose init function pulls in the twiddle
+ * and bit reversal tables of every supported length.
+ */
+static void gyroAnalyseFft(float *input, float *output)
+{
+    const int n = GYRO_ANALYSE_FFT_BIN_COUNT;
+    float re[GYRO_ANALYSE_FFT_BIN_COUNT];
+    float im[GYRO_ANALYSE_FFT_BIN_COUNT];
+
+    for (int i = 0, j = 0; i < n; i++) {
+        re[j] = input[2 * i];
+        im[j] = input[2 * i + 1];
+        int bit = n >> 1;
+        while (j & bit) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j |= bit;
+    }
+
+    for (int len = 2; len <= n; len <<= 1) {
+        // Twiddles of a length len FFT are every (N / len)th of the length N table
+        const int stride = GYRO_ANALYSE_FFT_WINDOW_SIZE / len;
+        for (int k = 0; k < len / 2; k++) {
+            const float wr = fftTwiddleRe[k * stride];
+            const float wi = fftTwiddleIm[k * stride];
+            for (int i = k; i < n; i += len) {
+                const int j = i + len / 2;
+                const float tr = re[j] * wr - im[j] * wi;
+                const float ti = re[j] * wi + im[j] * wr;
+                re[j] = re[i] - tr;
+                im[j] = im[i] - ti;
+                re[i] += tr;
+                im[i] += ti;
+            }
+        }
+    }
+
+    // X[k] = E[k] + W^k * O[k], E and O being the spectra of the even and odd samples
+    output[0] = re[0] + im[0];
+    output[1] = re[0] - im[0];
+    for (int k = 1; k < n; k++) {
+        const float evenRe = (re[k] + re[n - k]) / 2;
+        const float evenIm = (im[k] - im[n - k]) / 2;
+        const float oddRe = (im[k] + im[n - k]) / 2;
+        const float oddIm = (re[n - k] - re[k]) / 2;
+        output[2 * k] = evenRe + oddRe * fftTwiddleRe[k] - oddIm * fftTwiddleIm[k];
+        output[2 * k + 1] = evenIm + oddRe * fftTwiddleIm[k] + oddIm * fftTwiddleRe[k];
+    }
+}
+
+#ifdef USE_ARM_MATH
+static void gyroAnalyseMagnitude(const float *fft, float *magnitude)
+{
+    arm_cmplx_mag_f32((float *)fft, magnitude, GYRO_ANALYSE_FFT_BIN_COUNT);
+}
+#else
+static void gyroAnalyseMagnitude(const float *fft, float *magnitude)
+{
+    for (int bin = 0; bin < GYRO_ANALYSE_FFT_BIN_COUNT; bin++) {
+        magnitude[bin] = sqrtf(sq(fft[2 * bin]) + sq(fft[2 * bin + 1]));
+    }
+}
+#endif
+
+void gyroDataAnalyseInit(uint32_t updateRateUs, uint16_t minFrequencyHz, uint16_t q)
+{
+    gyroUpdateRateUs = updateRateUs;
+    notchQ = q;
+
+    sampleDecimation = MAX(1, (int)(1000000 / GYRO_ANALYSE_SAMPLE_RATE_HZ / updateRateUs));
+    fftSampleRateHz = 1000000 / (updateRateUs * sampleDecimation);
+    fftBinWidthHz = (float)fftSampleRateHz / GYRO_ANALYSE_FFT_WINDOW_SIZE;
+    fftMinBin = constrain(lrintf(minFrequencyHz / fftBinWidthHz), 1, GYRO_ANALYSE_FFT_BIN_COUNT - 2);
+
+    sampleCount = 0;
+    sampleBufferIndex = 0;
+    analyseStep = GYRO_ANALYSE_STEP_WINDOW;
+    analyseAxis = 0;
+
+    filterCoeffTableInit(&notchCoeffTable, updateRateUs);
+
+    for (int i = 0; i < GYRO_ANALYSE_FFT_WINDOW_SIZE; i++) {
+        hanningWindow[i] = 0.5f - 0.5f * cos_approx(2 * M_PIf * i / (GYRO_ANALYSE_FFT_WINDOW_SIZE - 1));
+    }
+
+    // Until a peak shows up the notches sit at the top of the analysed band
+    const uint16_t initialFrequencyHz = lrintf((GYRO_ANALYSE_FFT_BIN_COUNT - 1) * fftBinWidthHz);
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        sampleAccumulator[axis] = 0;
+        for (int i = 0; i < GYRO_ANALYSE_FFT_WINDOW_SIZE; i++) {
+            sampleBuffer[axis][i] = 0;
+        }
+        for (int bin = 0; bin < GYRO_ANALYSE_FFT_BIN_COUNT; bin++) {
+            binMagnitude[axis][bin] = 0;
+        }
+        pt1FilterReset(&centerFrequencyFilter[axis], initialFrequencyHz);
+        centerFrequencyHz[axis] = initialFrequencyHz;
+    }
+
+    gyroAnalyseFftInit();
+}
+
+static void gyroDataAnalysePush(const float sample[XYZ_AXIS_COUNT])
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        sampleAccumulator[axis] += sample[axis];
+    }
+
+    if (++sampleCount < sampleDecimation) {
+        return;
+    }
+
+    // Averaging over the decimation period doubles as the anti-aliasing filter
+    const float scale = 1.0f / sampleDecimation;
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        sampleBuffer[axis][sampleBufferIndex] = sampleAccumulator[axis] * scale;
+        sampleAccumulator[axis] = 0;
+    }
+    sampleBufferIndex = (sampleBufferIndex + 1) % GYRO_ANALYSE_FFT_WINDOW_SIZE;
+    sampleCount = 0;
+}
+
+/*
+ * Copies the ring buffer oldest sample first, without its mean and linear
+ * trend. Stick movements are far stronger than motor noise and would
+ * otherwise leak into the analysed band.
+ */
+static void gyroDataAnalyseWindow(int axis)
+{
+    const float *samples = sampleBuffer[axis];
+    const float center = (GYRO_ANALYSE_FFT_WINDOW_SIZE - 1) / 2.0f;
+
+    float sum = 0;
+    float slopeSum = 0;
+    for (int i = 0; i < GYRO_ANALYSE_FFT_WINDOW_SIZE; i++) {
+        const float sample = samples[(sampleBufferIndex + i) % GYRO_ANALYSE_FFT_WINDOW_SIZE];
+        sum += sample;
+        slopeSum += (i - center) * sample;
+        fftData[i] = sample;
+    }
+
+    // Least squares fit, sum of (i - center)^2 is N(N^2-1)/12
+    const float mean = sum / GYRO_ANALYSE_FFT_WINDOW_SIZE;
+    const float slope = slopeSum * 12 / (GYRO_ANALYSE_FFT_WINDOW_SIZE * (sq(GYRO_ANALYSE_FFT_WINDOW_SIZE) - 1));
+    for (int i = 0; i < GYRO_ANALYSE_FFT_WINDOW_SIZE; i++) {
+        fftData[i] = (fftData[i] - mean - slope * (i - center)) * hanningWindow[i];
+    }
+}
+
+static void gyroDataAnalyseFindPeak(int axis)
+{
+    const float *magnitude = binMagnitude[axis];
+
+    int peakBin = fftMinBin;
+    float bandSum = 0;
+    for (int bin = fftMinBin; bin < GYRO_ANALYSE_FFT_BIN_COUNT; bin++) {
+        bandSum += magnitude[bin];
+        if (magnitude[bin] > magnitude[peakBin]) {
+            peakBin = bin;
+        }
+    }
+
+    const float bandAverage = bandSum / (GYRO_ANALYSE_FFT_BIN_COUNT - fftMinBin);
+    const float minPeakMagnitude = MAX(bandAverage * GYRO_ANALYSE_PEAK_THRESHOLD, GYRO_ANALYSE_MIN_PEAK_DPS * GYRO_ANALYSE_WINDOW_GAIN);
+    if (magnitude[peakBin] <= minPeakMagnitude) {
+        // Nothing stands out, leave the notch where it is
+        peakFrequencyHz = 0;
+        return;
+    }
+
+    // Weighted mean of the peak and its neighbours gives sub-bin resolution
+    float weightSum = 0;
+    float weightedBinSum = 0;
+    for (int bin = MAX(peakBin - 1, fftMinBin); bin <= MIN(peakBin + 1, GYRO_ANALYSE_FFT_BIN_COUNT - 1); bin++) {
+        const float weight = sq(magnitude[bin]);
+        weightSum += weight;
+        weightedBinSum += weight * bin;
+    }
+
+    peakFrequencyHz = weightedBinSum / weightSum * fftBinWidthHz;
+}
+
+static void gyroDataAnalyseUpdateNotch(int axis, biquadFilter_t *notchFilter)
+{
+    if (peakFrequencyHz > 0) {
+        const float dT = gyroUpdateRateUs * GYRO_ANALYSE_STEP_COUNT * XYZ_AXIS_COUNT * 1e-6f;
+        centerFrequencyHz[axis] = lrintf(pt1FilterApply4(&centerFrequencyFilter[axis], peakFrequencyHz, GYRO_ANALYSE_SMOOTHING_HZ, dT));
+        biquadFilterUpdateFromTable(notchFilter, &notchCoeffTable, centerFrequencyHz[axis], notchQ / 100.0f, FILTER_NOTCH);
+    }
+
+    DEBUG_SET(DEBUG_FFT, axis, centerFrequencyHz[axis]);
+}
+
+/*
+ * Called on every gyro update with the unfiltered gyro rates. Stores the
+ * sample and runs one step of the analysis.
+ */
+void gyroDataAnalyse(const float sample[XYZ_AXIS_COUNT], biquadFilter_t notchFilter[XYZ_AXIS_COUNT])
+{
+    gyroDataAnalysePush(sample);
+
+    switch (analyseStep) {
+    case GYRO_ANALYSE_STEP_WINDOW:
+        gyroDataAnalyseWindow(analyseAxis);
+        break;
+
+    case GYRO_ANALYSE_STEP_FFT:
+        gyroAnalyseFft(fftData, fftOutput);
+        break;
+
+    case GYRO_ANALYSE_STEP_MAGNITUDE:
+        gyroAnalyseMagnitude(fftOutput, binMagnitude[analyseAxis]);
+        break;
+
+    case GYRO_ANALYSE_STEP_PEAK:
+        gyroDataAnalyseFindPeak(analyseAxis);
+        break;
+
+    case GYRO_ANALYSE_STEP_UPDATE_NOTCH:
+        gyroDataAnalyseUpdateNotch(analyseAxis, &notchFilter[analyseAxis]);
+        analyseAxis = (analyseAxis + 1) % XYZ_AXIS_COUNT;
+        break;
+
+    case GYRO_ANALYSE_STEP_COUNT:
+        break;
+    }
+
+    analyseStep = (analyseStep + 1) % GYRO_ANALYSE_STEP_COUNT;
+}
+
+uint16_t gyroDataAnalyseSampleRateHz(void)
+{
+    return fftSampleRateHz;
+}
+
+uint16_t gyroDataAnalyseCenterFrequency(int axis)
+{
+    return centerFrequencyHz[axis];
+}
+
+float gyroDataAnalyseBinMagnitude(int axis, int bin)
+{
+    return binMagnitude[axis][bin];
+}
+
+#endif // USE_DYNAMIC_FILTERS
@@ -0,0 +1,32 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/axis.h"
+#include "common/filter.h"
+
+#define GYRO_ANALYSE_FFT_WINDOW_SIZE    32
+#define GYRO_ANALYSE_FFT_BIN_COUNT      (GYRO_ANALYSE_FFT_WINDOW_SIZE / 2)
+#define GYRO_ANALYSE_SAMPLE_RATE_HZ     1000    // gyro is downsampled to about this rate before the FFT
+
+void gyroDataAnalyseInit(uint32_t gyroUpdateRateUs, uint16_t minFrequencyHz, uint16_t notchQ);
+void gyroDataAnalyse(const float sample[XYZ_AXIS_COUNT], biquadFilter_t notchFilter[XYZ_AXIS_COUNT]);
+
+uint16_t gyroDataAnalyseSampleRateHz(void);
+uint16_t gyroDataAnalyseCenterFrequency(int axis);
+float gyroDataAnalyseBinMagnitude(int axis, int bin);
@@ -0,0 +1,34 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Bounds for a single step of the virtual clock
+#define SITL_VIRTUAL_TIME_MIN_STEP_US   1U
+#define SITL_VIRTUAL_TIME_MAX_STEP_US   1000U
+
+// Parses the command line, must be called before init()
+void sitlInit(int argc, char *argv[]);
+// Called once per main loop iteration, before scheduler()
+void sitlLoop(void);
+
+// Replays a blackbox log through the gyro filters, pidController() and mixTable(), see sitl_replay.c
+void sitlReplayRun(const char *logFilename, const char *csvFilename);
+
+// Last values written to the emulated motor and servo outputs
+uint16_t sitlGetMotorOutput(uint8_t index);
+uint16_t sitlGetServoOutput(uint8_t index);
@@ -0,0 +1,354 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <platform.h>
+
+#include "blackbox/blackbox_decode.h"
+
+#include "build/debug.h"
+
+#include "common/axis.h"
+#include "common/maths.h"
+
+#include "drivers/accgyro/accgyro_fake.h"
+
+#include "fc/config.h"
+#include "fc/rc_controls.h"
+#include "fc/runtime_config.h"
+
+#include "flight/mixer.h"
+#include "flight/pid.h"
+
+#include "sensors/gyro.h"
+
+#include "target/SITL/sitl.h"
+
+/*
+ * Blackbox replay. Feeds the gyro and rcCommand of a recorded log through
+ * the gyro filters, pidController() and mixTable() as fast as the host can
+ * run them, using the configuration in eeprom.bin. Filter and PID settings
+ * can be changed through the CLI between runs and their effect compared
+ * offline on the same flight.
+ */
+
+// Lags searched for the filter delay estimate, in frames
+#define REPLAY_LATENCY_MAX_LAG      32
+
+// Fake gyro counts per deg/s, see fakeGyroDetect()
+#define REPLAY_GYRO_LSB_PER_DPS     16.4f
+
+extern float dT;
+
+typedef struct replayFields_s {
+    int time;
+    int gyroSource[XYZ_AXIS_COUNT];
+    int gyroLogged[XYZ_AXIS_COUNT];
+    int rcCommand[4];
+    int axisP[XYZ_AXIS_COUNT];
+    int axisI[XYZ_AXIS_COUNT];
+    int axisD[XYZ_AXIS_COUNT];
+    int motor[MAX_SUPPORTED_MOTORS];
+} replayFields_t;
+
+typedef struct replayStats_s {
+    uint32_t frames;
+    uint64_t gyroNs;
+    uint64_t pidNs;
+    uint64_t mixerNs;
+    uint64_t decodeNs;
+    // Cross correlation of the gyro input with the filtered gyro, per lag
+    float inputHistory[XYZ_AXIS_COUNT][REPLAY_LATENCY_MAX_LAG];
+    double correlation[XYZ_AXIS_COUNT][REPLAY_LATENCY_MAX_LAG];
+} replayStats_t;
+
+static replayStats_t replayStats;
+
+static uint64_t replayNanos(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static int replayFieldIndex(const blackboxDecoder_t *decoder, const char *name, int index)
+{
+    char fieldName[BLACKBOX_DECODE_MAX_FIELD_NAME];
+    snprintf(fieldName, sizeof(fieldName), "%s[%d]", name, index);
+    return blackboxDecodeFieldIndex(decoder, BLACKBOX_DECODE_FRAME_INTRA, fieldName);
+}
+
+static int32_t replayFieldValue(const blackboxDecoder_t *decoder, int fieldIndex)
+{
+    return fieldIndex >= 0 ? decoder->mainFrame[fieldIndex] : 0;
+}
+
+static bool replayFindFields(const blackboxDecoder_t *decoder, replayFields_t *fields)
+{
+    int32_t debugMode;
+    const bool gyroDebug = blackboxDecodeHeaderInts(decoder, "debug_mode", &debugMode, 1) && debugMode == DEBUG_GYRO
+        && replayFieldIndex(decoder, "debug", 0) >= 0;
+
+    fields->time = decoder->timeFieldIndex;
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        fields->gyroLogged[axis] = replayFieldIndex(decoder, "gyroADC", axis);
+        // gyroADC is logged after filtering, with debug_mode = GYRO the unfiltered gyro is in debug[]
+        fields->gyroSource[axis] = gyroDebug ? replayFieldIndex(decoder, "debug", axis) : fields->gyroLogged[axis];
+        fields->axisP[axis] = replayFieldIndex(decoder, "axisP", axis);
+        fields->axisI[axis] = replayFieldIndex(decoder, "axisI", axis);
+        fields->axisD[axis] = replayFieldIndex(decoder, "axisD", axis);
+        if (fields->gyroSource[axis] < 0) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        fields->rcCommand[i] = replayFieldIndex(decoder, "rcCommand", i);
+    }
+
+    for (int i = 0; i < MAX_SUPPORTED_MOTORS; i++) {
+        fields->motor[i] = replayFieldIndex(decoder, "motor", i);
+    }
+
+    fprintf(stderr, "[REPLAY] gyro input from %s\n", gyroDebug ? "debug[] (unfiltered)" : "gyroADC (already filtered)");
+
+    return fields->time >= 0;
+}
+
+static void replayCsvHeader(FILE *csv, int motorCount)
+{
+    fprintf(csv, "time,gyroInput[0],gyroInput[1],gyroInput[2],gyroFiltered[0],gyroFiltered[1],gyroFiltered[2],"
+        "gyroLogged[0],gyroLogged[1],gyroLogged[2],axisPID[0],axisPID[1],axisPID[2],axisPIDLogged[0],axisPIDLogged[1],axisPIDLogged[2]");
+    for (int i = 0; i < motorCount; i++) {
+        fprintf(csv, ",motor[%d]", i);
+    }
+    for (int i = 0; i < motorCount; i++) {
+        fprintf(csv, ",motorLogged[%d]", i);
+    }
+    fprintf(csv, "\n");
+}
+
+static void replayCsvFrame(FILE *csv, const blackboxDecoder_t *decoder, const replayFields_t *fields, const float *gyroInput, int motorCount)
+{
+    fprintf(csv, "%u", (unsigned)replayFieldValue(decoder, fields->time));
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        fprintf(csv, ",%.2f", (double)gyroInput[axis]);
+    }
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        fprintf(csv, ",%.2f", (double)gyro.gyroADCf[axis]);
+    }
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        fprintf(csv, ",%d", (int)replayFieldValue(decoder, fields->gyroLogged[axis]));
+    }
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        fprintf(csv, ",%d", axisPID[axis]);
+    }
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        fprintf(csv, ",%d", (int)(replayFieldValue(decoder, fields->axisP[axis]) + replayFieldValue(decoder, fields->axisI[axis]) + replayFieldValue(decoder, fields->axisD[axis])));
+    }
+    for (int i = 0; i < motorCount; i++) {
+        fprintf(csv, ",%d", motor[i]);
+    }
+    for (int i = 0; i < motorCount; i++) {
+        fprintf(csv, ",%d", (int)replayFieldValue(decoder, fields->motor[i]));
+    }
+    fprintf(csv, "\n");
+}
+
+static void replayUpdateLatency(const float *gyroInput)
+{
+    const int slot = replayStats.frames % REPLAY_LATENCY_MAX_LAG;
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        replayStats.inputHistory[axis][slot] = gyroInput[axis];
+        if (replayStats.frames < REPLAY_LATENCY_MAX_LAG) {
+            continue;
+        }
+        for (int lag = 0; lag < REPLAY_LATENCY_MAX_LAG; lag++) {
+            const float delayedInput = replayStats.inputHistory[axis][(slot + REPLAY_LATENCY_MAX_LAG - lag) % REPLAY_LATENCY_MAX_LAG];
+            replayStats.correlation[axis][lag] += (double)delayedInput * (double)gyro.gyroADCf[axis];
+        }
+    }
+}
+
+// Lag of the cross correlation peak, refined with a parabola through its neighbours
+static double replayLatencyFrames(int axis)
+{
+    const double *correlation = replayStats.correlation[axis];
+    int peak = 0;
+
+    for (int lag = 1; lag < REPLAY_LATENCY_MAX_LAG; lag++) {
+        if (correlation[lag] > correlation[peak]) {
+            peak = lag;
+        }
+    }
+
+    if (peak == 0 || peak == REPLAY_LATENCY_MAX_LAG - 1) {
+        return peak;
+    }
+
+    const double denominator = correlation[peak - 1] - 2 * correlation[peak] + correlation[peak + 1];
+    return denominator != 0 ? peak + (correlation[peak - 1] - correlation[peak + 1]) / (2 * denominator) : peak;
+}
+
+static uint8_t *replayLoadFile(const char *filename, size_t *size)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *data = malloc(*size);
+    if (data && fread(data, 1, *size, f) != *size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+void sitlReplayRun(const char *logFilename, const char *csvFilename)
+{
+    static blackboxDecoder_t decoder;
+    replayFields_t fields;
+    size_t size;
+
+    uint8_t *data = replayLoadFile(logFilename, &size);
+    if (!data) {
+        fprintf(stderr, "[REPLAY] unable to read %s\n", logFilename);
+        exit(1);
+    }
+
+    if (!blackboxDecodeInit(&decoder, data, size) || !replayFindFields(&decoder, &fields)) {
+        fprintf(stderr, "[REPLAY] %s is not a blackbox log with gyro data\n", logFilename);
+        exit(1);
+    }
+
+    FILE *csv = NULL;
+    if (csvFilename) {
+        csv = fopen(csvFilename, "w");
+        if (!csv) {
+            fprintf(stderr, "[REPLAY] unable to write %s\n", csvFilename);
+            exit(1);
+        }
+    }
+
+    const int motorCount = getMotorCount();
+    if (csv) {
+        replayCsvHeader(csv, motorCount);
+    }
+
+    // Logged gyro values already have the zero offset removed, skip the calibration
+    gyroSetCalibrationCycles(0);
+
+    // Acro mode, the mixer only drives the motors when armed
+    ENABLE_ARMING_FLAG(ARMED);
+
+    memset(&replayStats, 0, sizeof(replayStats));
+    uint32_t firstTimeUs = 0;
+    uint32_t lastTimeUs = 0;
+    const uint64_t startNs = replayNanos();
+    uint64_t decodeStartNs = startNs;
+
+    while (blackboxDecodeNextMainFrame(&decoder)) {
+        const uint32_t timeUs = replayFieldValue(&decoder, fields.time);
+        const timeDelta_t deltaUs = replayStats.frames ? (timeDelta_t)(timeUs - lastTimeUs) : (timeDelta_t)getGyroUpdateRate();
+        if (replayStats.frames == 0) {
+            firstTimeUs = timeUs;
+        }
+        lastTimeUs = timeUs;
+
+        float gyroInput[XYZ_AXIS_COUNT];
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            gyroInput[axis] = replayFieldValue(&decoder, fields.gyroSource[axis]);
+        }
+        fakeGyroSet(constrain(lrintf(gyroInput[X] * REPLAY_GYRO_LSB_PER_DPS), INT16_MIN, INT16_MAX),
+                    constrain(lrintf(gyroInput[Y] * REPLAY_GYRO_LSB_PER_DPS), INT16_MIN, INT16_MAX),
+                    constrain(lrintf(gyroInput[Z] * REPLAY_GYRO_LSB_PER_DPS), INT16_MIN, INT16_MAX));
+
+        for (int i = 0; i < 4; i++) {
+            if (fields.rcCommand[i] >= 0) {
+                rcCommand[i] = replayFieldValue(&decoder, fields.rcCommand[i]);
+            }
+        }
+
+        dT = deltaUs * 1e-6f;
+
+        const uint64_t gyroStartNs = replayNanos();
+        gyroUpdate(deltaUs);
+        const uint64_t pidStartNs = replayNanos();
+        updatePIDCoefficients();
+        pidController();
+        const uint64_t mixerStartNs = replayNanos();
+        mixTable();
+        const uint64_t mixerEndNs = replayNanos();
+
+        replayStats.decodeNs += gyroStartNs - decodeStartNs;
+        replayStats.gyroNs += pidStartNs - gyroStartNs;
+        replayStats.pidNs += mixerStartNs - pidStartNs;
+        replayStats.mixerNs += mixerEndNs - mixerStartNs;
+
+        replayUpdateLatency(gyroInput);
+        replayStats.frames++;
+
+        if (csv) {
+            replayCsvFrame(csv, &decoder, &fields, gyroInput, motorCount);
+        }
+
+        decodeStartNs = replayNanos();
+    }
+
+    const uint64_t elapsedNs = replayNanos() - startNs;
+
+    if (csv) {
+        fclose(csv);
+    }
+    free(data);
+
+    if (replayStats.frames < 2) {
+        fprintf(stderr, "[REPLAY] no frames decoded\n");
+        exit(1);
+    }
+
+    const double logDurationUs = lastTimeUs - firstTimeUs;
+    const double frameIntervalUs = logDurationUs / (replayStats.frames - 1);
+
+    fprintf(stderr, "[REPLAY] %u frames (%u I, %u P, %u corrupt), %.3fs of flight in %.3fs, %.0fx real time\n",
+        (unsigned)replayStats.frames, (unsigned)decoder.intraFrameCount, (unsigned)decoder.interFrameCount, (unsigned)decoder.corruptFrameCount,
+        logDurationUs / 1000000, (double)elapsedNs / 1000000000, logDurationUs * 1000 / elapsedNs);
+    if (fabs(frameIntervalUs - getGyroUpdateRate()) > getGyroUpdateRate() / 10) {
+        fprintf(stderr, "[REPLAY] warning: log frame interval %.0fus, filters are set up for %uus\n", frameIntervalUs, (unsigned)getGyroUpdateRate());
+    }
+    fprintf(stderr, "[REPLAY] per frame: decode %.0fns, gyro filters %.0fns, pid %.0fns, mixer %.0fns\n",
+        (double)replayStats.decodeNs / replayStats.frames, (double)replayStats.gyroNs / replayStats.frames,
+        (double)replayStats.pidNs / replayStats.frames, (double)replayStats.mixerNs / replayStats.frames);
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        const double latencyFrames = replayLatencyFrames(axis);
+        fprintf(stderr, "[REPLAY] gyro filter delay axis %d: %.2f frames, %.0fus\n", axis, latencyFrames, latencyFrames * frameIntervalUs);
+    }
+}
@@ -0,0 +1,614 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <platform.h>
+
+#include "build/build_config.h"
+
+#include "common/maths.h"
+#include "common/utils.h"
+
+#include "drivers/adc.h"
+#include "drivers/bus_i2c.h"
+#include "drivers/io.h"
+#include "drivers/io_impl.h"
+#include "drivers/light_led.h"
+#include "drivers/pwm_mapping.h"
+#include "drivers/pwm_output.h"
+#include "drivers/rx_pwm.h"
+#include "drivers/serial.h"
+#include "drivers/serial_tcp.h"
+#include "drivers/serial_uart.h"
+#include "drivers/sound_beeper.h"
+#include "drivers/system.h"
+#include "drivers/time.h"
+#include "drivers/stack_check.h"
+#include "drivers/timer.h"
+
+#include "scheduler/scheduler.h"
+
+#include "target/SITL/sitl.h"
+
+const timerHardware_t timerHardware[USABLE_TIMER_CHANNEL_COUNT] = {
+    { TIM1, IO_TAG(PA8),  TIM_Channel_1, 0, IOCFG_AF_PP, TIM_USE_MC_MOTOR | TIM_USE_FW_MOTOR },
+    { TIM1, IO_TAG(PA9),  TIM_Channel_2, 0, IOCFG_AF_PP, TIM_USE_MC_MOTOR | TIM_USE_FW_MOTOR },
+    { TIM1, IO_TAG(PA10), TIM_Channel_3, 0, IOCFG_AF_PP, TIM_USE_MC_MOTOR | TIM_USE_FW_SERVO },
+    { TIM1, IO_TAG(PA11), TIM_Channel_4, 0, IOCFG_AF_PP, TIM_USE_MC_MOTOR | TIM_USE_FW_SERVO },
+    { TIM2, IO_TAG(PB0),  TIM_Channel_1, 0, IOCFG_AF_PP, TIM_USE_MC_MOTOR | TIM_USE_FW_SERVO },
+    { TIM2, IO_TAG(PB1),  TIM_Channel_2, 0, IOCFG_AF_PP, TIM_USE_MC_MOTOR | TIM_USE_FW_SERVO },
+    { TIM2, IO_TAG(PB2),  TIM_Channel_3, 0, IOCFG_AF_PP, TIM_USE_MC_MOTOR | TIM_USE_FW_SERVO },
+    { TIM2, IO_TAG(PB3),  TIM_Channel_4, 0, IOCFG_AF_PP, TIM_USE_MC_MOTOR | TIM_USE_FW_SERVO },
+    { TIM3, IO_TAG(PC0),  TIM_Channel_1, 0, IOCFG_AF_PP, TIM_USE_MC_SERVO | TIM_USE_FW_SERVO },
+    { TIM3, IO_TAG(PC1),  TIM_Channel_2, 0, IOCFG_AF_PP, TIM_USE_MC_SERVO | TIM_USE_FW_SERVO },
+    { TIM4, IO_TAG(PC2),  TIM_Channel_1, 0, IOCFG_AF_PP, TIM_USE_MC_CHNFW | TIM_USE_FW_SERVO },
+    { TIM4, IO_TAG(PC3),  TIM_Channel_2, 0, IOCFG_AF_PP, TIM_USE_MC_CHNFW | TIM_USE_FW_SERVO },
+};
+
+/*
+ * Time. Either the host monotonic clock or, with --virtual-time, a virtual
+ * clock that only moves when the main loop advances it (see sitlLoop()).
+ */
+
+static struct timespec sitlStartTime;
+static bool sitlVirtualTime = false;
+static uint64_t sitlVirtualTimeUs = 0;
+static uint64_t sitlDurationUs = 0;
+static uint32_t sitlLoopCount = 0;
+static const char *sitlReplayFilename = NULL;
+static const char *sitlReplayCsvFilename = NULL;
+
+static uint64_t sitlRealTimeUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - sitlStartTime.tv_sec) * 1000000ULL + (now.tv_nsec - sitlStartTime.tv_nsec) / 1000;
+}
+
+static uint64_t sitlTimeUs(void)
+{
+    return sitlVirtualTime ? sitlVirtualTimeUs : sitlRealTimeUs();
+}
+
+timeUs_t micros(void)
+{
+    return (timeUs_t)sitlTimeUs();
+}
+
+timeUs_t microsISR(void)
+{
+    return micros();
+}
+
+timeMs_t millis(void)
+{
+    return (timeMs_t)(sitlTimeUs() / 1000);
+}
+
+uint32_t ticks(void)
+{
+    // One tick per microsecond
+    return (uint32_t)micros();
+}
+
+timeDelta_t ticks_diff_us(uint32_t begin, uint32_t end)
+{
+    return end - begin;
+}
+
+void delayMicroseconds(timeUs_t us)
+{
+    if (sitlVirtualTime) {
+        sitlVirtualTimeUs += us;
+        return;
+    }
+    const timeUs_t now = micros();
+    while (micros() - now < us);
+}
+
+void delay(timeMs_t ms)
+{
+    delayMicroseconds(ms * 1000);
+}
+
+static void sitlUsage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [--virtual-time] [--duration <seconds>] [--replay <log> [--replay-csv <file>]]\n", name);
+    fprintf(stderr, "  --virtual-time        advance time from task to task instead of following the wall clock\n");
+    fprintf(stderr, "  --duration <seconds>  exit after the given amount of (virtual) time\n");
+    fprintf(stderr, "  --replay <log>        run a blackbox log through the gyro filters, pid controller and mixer, then exit\n");
+    fprintf(stderr, "  --replay-csv <file>   write the recomputed values of each replayed frame to a CSV file\n");
+}
+
+void sitlInit(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--virtual-time")) {
+            sitlVirtualTime = true;
+        } else if (!strcmp(argv[i], "--duration") && i + 1 < argc) {
+            sitlDurationUs = strtoull(argv[++i], NULL, 10) * 1000000ULL;
+        } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+            sitlReplayFilename = argv[++i];
+        } else if (!strcmp(argv[i], "--replay-csv") && i + 1 < argc) {
+            sitlReplayCsvFilename = argv[++i];
+        } else {
+            sitlUsage(argv[0]);
+            exit(1);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &sitlStartTime);
+}
+
+void sitlLoop(void)
+{
+    if (sitlReplayFilename) {
+        // Runs after init() so the pipeline is set up from the saved config
+        sitlReplayRun(sitlReplayFilename, sitlReplayCsvFilename);
+        exit(0);
+    }
+
+    if (sitlVirtualTime) {
+        // Jump straight to the next time-driven task instead of spinning on
+        // the clock. Always step forward so the loop keeps making progress
+        // when the due task is held back by the realtime guard interval.
+        const timeUs_t timeToNextTask = schedulerGetTimeToNextTask(micros());
+        sitlVirtualTimeUs += MAX(MIN(timeToNextTask, SITL_VIRTUAL_TIME_MAX_STEP_US), SITL_VIRTUAL_TIME_MIN_STEP_US);
+    }
+
+    serTcpPoll();
+
+    sitlLoopCount++;
+    if (sitlDurationUs && sitlTimeUs() >= sitlDurationUs) {
+        fprintf(stderr, "[SITL] ran %lluus of %s time in %lluus, %u loops\n",
+            (unsigned long long)sitlTimeUs(), sitlVirtualTime ? "virtual" : "real", (unsigned long long)sitlRealTimeUs(), (unsigned)sitlLoopCount);
+        exit(0);
+    }
+}
+
+/*
+ * System
+ */
+
+uint32_t SystemCoreClock = 1000000000;
+uint32_t cachedRccCsrValue;
+extiCallbackHandlerConfig_t extiHandlerConfigs[EXTI_CALLBACK_HANDLER_COUNT];
+
+void registerExtiCallbackHandler(IRQn_Type irqn, extiCallbackHandlerFunc *fn)
+{
+    UNUSED(irqn);
+    UNUSED(fn);
+}
+
+void unregisterExtiCallbackHandler(IRQn_Type irqn, extiCallbackHandlerFunc *fn)
+{
+    UNUSED(irqn);
+    UNUSED(fn);
+}
+
+static void sitlEepromLoad(void);
+
+void systemInit(void)
+{
+    sitlEepromLoad();
+    fprintf(stderr, "[SITL] %s started\n", __TARGET__);
+}
+
+void RCC_GetClocksFreq(RCC_ClocksTypeDef *clocks)
+{
+    clocks->SYSCLK_Frequency = SystemCoreClock;
+    clocks->HCLK_Frequency = SystemCoreClock;
+    clocks->PCLK1_Frequency = SystemCoreClock;
+    clocks->PCLK2_Frequency = SystemCoreClock;
+}
+
+void systemClockSetup(uint8_t cpuUnderclock)
+{
+    UNUSED(cpuUnderclock);
+}
+
+void cycleCounterInit(void)
+{
+}
+
+void checkForBootLoaderRequest(void)
+{
+}
+
+void enableGPIOPowerUsageAndNoiseReductions(void)
+{
+}
+
+bool isMPUSoftReset(void)
+{
+    return false;
+}
+
+// The stack belongs to the host process, see drivers/stack_check.c
+uint32_t stackTotalSize(void)
+{
+    return 0;
+}
+
+uint32_t stackHighMem(void)
+{
+    return 0;
+}
+
+void systemReset(void)
+{
+    fprintf(stderr, "[SITL] system reset\n");
+    exit(0);
+}
+
+void systemResetToBootloader(void)
+{
+    fprintf(stderr, "[SITL] reset to bootloader\n");
+    exit(0);
+}
+
+void failureMode(failureMode_e mode)
+{
+    fprintf(stderr, "[SITL] failure mode %d\n", mode);
+    exit(1);
+}
+
+/*
+ * Emulated EEPROM, config is kept in RAM and written back to a file on FLASH_Lock()
+ */
+
+// Not static, the symbol is referenced from the assembler below
+uint8_t eepromData[SITL_EEPROM_SIZE] __attribute__((aligned(FLASH_PAGE_SIZE))) = { 0 };
+
+// config_eeprom.c and config_streamer.c expect these linker provided symbols
+__asm__(".globl __config_start\n"
+        ".set __config_start, eepromData\n"
+        ".globl __config_end\n"
+        ".set __config_end, eepromData + " STR(SITL_EEPROM_SIZE) "\n");
+
+static void sitlEepromLoad(void)
+{
+    FILE *f = fopen(SITL_EEPROM_FILENAME, "rb");
+    if (!f) {
+        fprintf(stderr, "[SITL] %s not found, starting with defaults\n", SITL_EEPROM_FILENAME);
+        return;
+    }
+    const size_t count = fread(eepromData, 1, sizeof(eepromData), f);
+    fclose(f);
+    fprintf(stderr, "[SITL] loaded %u bytes of config from %s\n", (unsigned)count, SITL_EEPROM_FILENAME);
+}
+
+static void sitlEepromSave(void)
+{
+    FILE *f = fopen(SITL_EEPROM_FILENAME, "wb");
+    if (!f) {
+        fprintf(stderr, "[SITL] unable to write %s\n", SITL_EEPROM_FILENAME);
+        return;
+    }
+    fwrite(eepromData, 1, sizeof(eepromData), f);
+    fclose(f);
+}
+
+static bool sitlEepromAddressValid(uintptr_t address, size_t size)
+{
+    return address >= (uintptr_t)eepromData && address + size <= (uintptr_t)eepromData + sizeof(eepromData);
+}
+
+void FLASH_Unlock(void)
+{
+}
+
+void FLASH_Lock(void)
+{
+    sitlEepromSave();
+}
+
+FLASH_Status FLASH_ErasePage(uintptr_t pageAddress)
+{
+    if (!sitlEepromAddressValid(pageAddress, FLASH_PAGE_SIZE)) {
+        return FLASH_ERROR_PG;
+    }
+    memset((void *)pageAddress, 0xFF, FLASH_PAGE_SIZE);
+    return FLASH_COMPLETE;
+}
+
+FLASH_Status FLASH_ProgramWord(uintptr_t address, uint32_t data)
+{
+    if (!sitlEepromAddressValid(address, sizeof(data))) {
+        return FLASH_ERROR_PG;
+    }
+    memcpy((void *)address, &data, sizeof(data));
+    return FLASH_COMPLETE;
+}
+
+/*
+ * IO, there is no GPIO so pins only keep their state. All ports are
+ * fully populated (see TARGET_IO_PORTx) so records are indexed directly.
+ */
+
+ioRec_t ioRecs[DEFIO_IO_USED_COUNT];
+static bool ioState[DEFIO_IO_USED_COUNT];
+
+static int ioIndex(IO_t io)
+{
+    return (ioRec_t *)io - ioRecs;
+}
+
+ioRec_t *IO_Rec(IO_t io)
+{
+    return io;
+}
+
+int IO_GPIOPortIdx(IO_t io)
+{
+    return io ? ioIndex(io) / 16 : -1;
+}
+
+int IO_GPIOPinIdx(IO_t io)
+{
+    return io ? ioIndex(io) % 16 : -1;
+}
+
+IO_t IOGetByTag(ioTag_t tag)
+{
+    const int portIdx = DEFIO_TAG_GPIOID(tag);
+    const int pinIdx = DEFIO_TAG_PIN(tag);
+
+    if (portIdx < 0 || portIdx >= DEFIO_PORT_USED_COUNT) {
+        return NULL;
+    }
+    return ioRecs + portIdx * 16 + pinIdx;
+}
+
+void IOInitGlobal(void)
+{
+    for (int i = 0; i < DEFIO_IO_USED_COUNT; i++) {
+        ioRecs[i].pin = 1 << (i % 16);
+    }
+    memset(ioState, 0, sizeof(ioState));
+}
+
+void IOInit(IO_t io, resourceOwner_e owner, resourceType_e resource, uint8_t index)
+{
+    if (!io) {
+        return;
+    }
+    ioRec_t *ioRec = IO_Rec(io);
+    ioRec->owner = owner;
+    ioRec->resource = resource;
+    ioRec->index = index;
+}
+
+void IORelease(IO_t io)
+{
+    if (!io) {
+        return;
+    }
+    IO_Rec(io)->owner = OWNER_FREE;
+}
+
+resourceOwner_e IOGetOwner(IO_t io)
+{
+    return io ? IO_Rec(io)->owner : OWNER_FREE;
+}
+
+void IOConfigGPIO(IO_t io, ioConfig_t cfg)
+{
+    UNUSED(io);
+    UNUSED(cfg);
+}
+
+bool IORead(IO_t io)
+{
+    return io ? ioState[ioIndex(io)] : false;
+}
+
+void IOWrite(IO_t io, bool hi)
+{
+    if (io) {
+        ioState[ioIndex(io)] = hi;
+    }
+}
+
+void IOHi(IO_t io)
+{
+    IOWrite(io, true);
+}
+
+void IOLo(IO_t io)
+{
+    IOWrite(io, false);
+}
+
+void IOToggle(IO_t io)
+{
+    IOWrite(io, !IORead(io));
+}
+
+/*
+ * Analog inputs, I2C and LEDs are not emulated
+ */
+
+uint16_t adcGetChannel(uint8_t channel)
+{
+    UNUSED(channel);
+    return 0;
+}
+
+bool i2cRead(I2CDevice device, uint8_t addr_, uint8_t reg, uint8_t len, uint8_t* buf)
+{
+    UNUSED(device);
+    UNUSED(addr_);
+    UNUSED(reg);
+    UNUSED(len);
+    UNUSED(buf);
+    return false;
+}
+
+void i2cSetSpeed(uint8_t speed)
+{
+    UNUSED(speed);
+}
+
+void ledInit(bool alternative_led)
+{
+    UNUSED(alternative_led);
+}
+
+void ledToggle(int led)
+{
+    UNUSED(led);
+}
+
+void ledSet(int led, bool state)
+{
+    UNUSED(led);
+    UNUSED(state);
+}
+
+void beeperInit(const beeperDevConfig_t *beeperConfig)
+{
+    UNUSED(beeperConfig);
+}
+
+void systemBeep(bool on)
+{
+    UNUSED(on);
+}
+
+void systemBeepToggle(void)
+{
+}
+
+/*
+ * Timers, motor and servo outputs
+ */
+
+static uint16_t sitlMotorValue[MAX_PWM_OUTPUT_PORTS];
+static uint16_t sitlServoValue[MAX_PWM_OUTPUT_PORTS];
+static bool sitlMotorsEnabled = false;
+
+void timerInit(void)
+{
+}
+
+void timerStart(void)
+{
+}
+
+const timerHardware_t *timerGetByTag(ioTag_t tag, timerUsageFlag_e flag)
+{
+    for (int i = 0; i < USABLE_TIMER_CHANNEL_COUNT; i++) {
+        if (timerHardware[i].tag == tag && (flag == TIM_USE_ANY || (timerHardware[i].usageFlags & flag))) {
+            return &timerHardware[i];
+        }
+    }
+    return NULL;
+}
+
+bool pwmMotorConfig(const timerHardware_t *timerHardware, uint8_t motorIndex, uint16_t motorPwmRate, uint16_t idlePulse, motorPwmProtocolTypes_e proto, bool enableOutput)
+{
+    UNUSED(timerHardware);
+    UNUSED(motorPwmRate);
+    UNUSED(proto);
+    UNUSED(enableOutput);
+    if (motorIndex >= MAX_PWM_OUTPUT_PORTS) {
+        return false;
+    }
+    sitlMotorValue[motorIndex] = idlePulse;
+    return true;
+}
+
+bool pwmServoConfig(const timerHardware_t *timerHardware, uint8_t servoIndex, uint16_t servoPwmRate, uint16_t servoCenterPulse, bool enableOutput)
+{
+    UNUSED(timerHardware);
+    UNUSED(servoPwmRate);
+    UNUSED(enableOutput);
+    if (servoIndex >= MAX_PWM_OUTPUT_PORTS) {
+        return false;
+    }
+    sitlServoValue[servoIndex] = servoCenterPulse;
+    return true;
+}
+
+void pwmWriteMotor(uint8_t index, uint16_t value)
+{
+    if (index < MAX_PWM_OUTPUT_PORTS && sitlMotorsEnabled) {
+        sitlMotorValue[index] = value;
+    }
+}
+
+void pwmShutdownPulsesForAllMotors(uint8_t motorCount)
+{
+    for (int i = 0; i < motorCount && i < MAX_PWM_OUTPUT_PORTS; i++) {
+        sitlMotorValue[i] = 0;
+    }
+}
+
+void pwmWriteServo(uint8_t index, uint16_t value)
+{
+    if (index < MAX_PWM_OUTPUT_PORTS) {
+        sitlServoValue[index] = value;
+    }
+}
+
+void pwmDisableMotors(void)
+{
+    sitlMotorsEnabled = false;
+}
+
+void pwmEnableMotors(void)
+{
+    sitlMotorsEnabled = true;
+}
+
+void pwmWriteBeeper(bool onoffBeep)
+{
+    UNUSED(onoffBeep);
+}
+
+void beeperPwmInit(ioTag_t tag, uint16_t frequency)
+{
+    UNUSED(tag);
+    UNUSED(frequency);
+}
+
+uint16_t sitlGetMotorOutput(uint8_t index)
+{
+    return index < MAX_PWM_OUTPUT_PORTS ? sitlMotorValue[index] : 0;
+}
+
+uint16_t sitlGetServoOutput(uint8_t index)
+{
+    return index < MAX_PWM_OUTPUT_PORTS ? sitlServoValue[index] : 0;
+}
+
+/*
+ * Serial ports, UARTs are emulated over TCP
+ */
+
+serialPort_t *uartOpen(USART_TypeDef *USARTx, serialReceiveCallbackPtr rxCallback, void *rxCallbackData, uint32_t baudRate, portMode_t mode, portOptions_t options)
+{
+    // USARTx are small integer handles, see target.h
+    return serTcpOpen((int)(intptr_t)USARTx - 1, rxCallback, rxCallbackData, baudRate, mode, options);
+}
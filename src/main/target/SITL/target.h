@@ -0,0 +1,173 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Software-in-the-loop target. Runs the complete firmware (scheduler, task
+// table, PID loop, navigation, blackbox) as a Linux process. Sensors are the
+// fake drivers, UARTs are TCP sockets and motor/servo outputs are recorded
+// in memory so they can be inspected by the host.
+
+#define TARGET_BOARD_IDENTIFIER "SITL"
+
+#define USE_GYRO
+#define USE_FAKE_GYRO
+
+#define USE_ACC
+#define USE_FAKE_ACC
+
+#define USE_BARO
+#define USE_FAKE_BARO
+
+#define USE_MAG
+#define USE_FAKE_MAG
+
+#define USE_UART1
+#define USE_UART2
+#define USE_UART3
+#define USE_UART4
+#define USE_UART5
+#define SERIAL_PORT_COUNT       5
+
+// UARTn is served on TCP port SITL_SERIAL_TCP_BASE_PORT + n - 1
+#define SITL_SERIAL_TCP_BASE_PORT   5760
+
+#define DEFAULT_RX_TYPE         RX_TYPE_MSP
+#define DEFAULT_FEATURES        (FEATURE_BLACKBOX)
+
+#undef USE_RX_PWM
+#undef USE_RX_PPM
+#undef USE_RX_SPI
+#undef USE_UAV_INTERCONNECT
+#undef USE_RX_UIB
+#undef USE_PMW_SERVO_DRIVER
+#undef USE_PWM_DRIVER_PCA9685
+#undef USE_OLED_UG2864
+#undef USE_DASHBOARD
+#undef USE_PITOT_ADC
+#undef USE_RCDEVICE
+#undef USE_SERIAL_4WAY_BLHELI_INTERFACE
+
+// Emulated EEPROM, persisted to SITL_EEPROM_FILENAME in the working directory
+#define FLASH_PAGE_SIZE         (0x4000)
+#define SITL_EEPROM_SIZE        (32 * 1024)
+#define SITL_EEPROM_FILENAME    "eeprom.bin"
+
+#define MAX_PWM_OUTPUT_PORTS    12
+
+#define TARGET_IO_PORTA         0xffff
+#define TARGET_IO_PORTB         0xffff
+#define TARGET_IO_PORTC         0xffff
+#define TARGET_IO_PORTD         0xffff
+
+#define USABLE_TIMER_CHANNEL_COUNT 12
+#define USED_TIMERS             (TIM_N(1) | TIM_N(2) | TIM_N(3) | TIM_N(4))
+
+// Minimal stand-ins for the MCU peripheral definitions referenced by common code
+
+#define U_ID_0 0
+#define U_ID_1 1
+#define U_ID_2 2
+
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+typedef enum {SITL_IRQ = 0} IRQn_Type;
+
+typedef struct { void *sitl; } GPIO_TypeDef;
+typedef struct { void *sitl; } TIM_TypeDef;
+typedef struct { void *sitl; } DMA_TypeDef;
+typedef struct { void *sitl; } DMA_Channel_TypeDef;
+typedef struct { void *sitl; } SPI_TypeDef;
+typedef struct { void *sitl; } I2C_TypeDef;
+typedef struct { void *sitl; } USART_TypeDef;
+typedef struct { void *sitl; } ADC_TypeDef;
+
+#define GPIOA_BASE              ((intptr_t)0x0001)
+
+#define TIM1                    ((TIM_TypeDef *)0x0001)
+#define TIM2                    ((TIM_TypeDef *)0x0002)
+#define TIM3                    ((TIM_TypeDef *)0x0003)
+#define TIM4                    ((TIM_TypeDef *)0x0004)
+
+#define USART1                  ((USART_TypeDef *)0x0001)
+#define USART2                  ((USART_TypeDef *)0x0002)
+#define USART3                  ((USART_TypeDef *)0x0003)
+#define UART4                   ((USART_TypeDef *)0x0004)
+#define UART5                   ((USART_TypeDef *)0x0005)
+
+#define TIM_Channel_1           0x0000
+#define TIM_Channel_2           0x0004
+#define TIM_Channel_3           0x0008
+#define TIM_Channel_4           0x000C
+
+#define NVIC_PriorityGroup_2    0x500
+
+#define __ASM                   __asm
+
+extern uint32_t SystemCoreClock;
+
+typedef struct {
+    uint32_t SYSCLK_Frequency;
+    uint32_t HCLK_Frequency;
+    uint32_t PCLK1_Frequency;
+    uint32_t PCLK2_Frequency;
+} RCC_ClocksTypeDef;
+
+void RCC_GetClocksFreq(RCC_ClocksTypeDef *clocks);
+
+typedef struct { void *sitl; } TIM_OCInitTypeDef;
+
+typedef enum {
+    Mode_AIN = 0x0,
+    Mode_IN_FLOATING = 0x04,
+    Mode_IPD = 0x28,
+    Mode_IPU = 0x48,
+    Mode_Out_OD = 0x14,
+    Mode_Out_PP = 0x10,
+    Mode_AF_OD = 0x1C,
+    Mode_AF_PP = 0x18
+} GPIO_Mode;
+
+static inline void __set_BASEPRI(uint32_t basePri) { (void)basePri; }
+static inline void __set_BASEPRI_MAX(uint32_t basePri) { (void)basePri; }
+static inline uint32_t __get_BASEPRI(void) { return 0; }
+static inline void __enable_irq(void) {}
+static inline void __disable_irq(void) {}
+static inline void __DSB(void) { __sync_synchronize(); }
+static inline void __ISB(void) { __sync_synchronize(); }
+
+typedef enum {
+    FLASH_BUSY = 1,
+    FLASH_ERROR_PG,
+    FLASH_ERROR_WRP,
+    FLASH_COMPLETE,
+    FLASH_TIMEOUT
+} FLASH_Status;
+
+void FLASH_Unlock(void);
+void FLASH_Lock(void);
+FLASH_Status FLASH_ErasePage(uintptr_t pageAddress);
+FLASH_Status FLASH_ProgramWord(uintptr_t address, uint32_t data);
+
+typedef enum {
+    EXTI_Trigger_Rising = 0x08,
+    EXTI_Trigger_Falling = 0x0C,
+    EXTI_Trigger_Rising_Falling = 0x10
+} EXTITrigger_TypeDef;
@@ -0,0 +1,9 @@
+SITL_TARGETS   += $(TARGET)
+FEATURES       += HIGHEND
+
+TARGET_SRC = \
+            blackbox/blackbox_decode.c \
+            drivers/accgyro/accgyro_fake.c \
+            drivers/barometer/barometer_fake.c \
+            drivers/compass/compass_fake.c \
+            drivers/serial_tcp.c
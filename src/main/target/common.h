@@ -56,6 +56,11 @@
 #define SCHEDULER_DELAY_LIMIT           100
 #endif
 
+// Execution time and start jitter histograms take about 128 bytes of RAM per task
+#if defined(STM32F4) || defined(STM32F7) || defined(SITL)
+#define USE_TASK_HISTOGRAMS
+#endif
+
 #if (FLASH_SIZE > 256)
 #define USE_UAV_INTERCONNECT
 #define USE_RX_UIB
@@ -68,10 +73,12 @@
 #define USE_DEBUG_TRACE
 #define USE_BOOTLOG
 #define BOOTLOG_DESCRIPTIONS
+#define USE_BLACKBOX_ENCODER_VARIANTS
 #define USE_STATS
 #define USE_64BIT_TIME
 #define USE_GYRO_NOTCH_1
 #define USE_GYRO_NOTCH_2
+#define USE_DYNAMIC_FILTERS
 #define USE_DTERM_NOTCH
 #define USE_ACC_NOTCH
 #define USE_CMS
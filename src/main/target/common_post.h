@@ -29,3 +29,12 @@
 # undef USE_DASHBOARD
 # undef USE_OLED_UG2864
 #endif
+
+// Number of 512 byte sectors in the SD card filesystem cache, targets may override this in target.h
+#if defined(USE_SDCARD) && !defined(AFATFS_NUM_CACHE_SECTORS)
+# if defined(STM32F7)
+#  define AFATFS_NUM_CACHE_SECTORS 32
+# else
+#  define AFATFS_NUM_CACHE_SECTORS 8
+# endif
+#endif
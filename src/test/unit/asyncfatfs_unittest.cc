@@ -0,0 +1,811 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+    #include "common/time.h"
+    #include "drivers/sdcard.h"
+    #include "io/asyncfatfs/asyncfatfs.h"
+    #include "io/asyncfatfs/fat_standard.h"
+
+    // Exposed by asyncfatfs.c when built with AFATFS_DEBUG
+    uint32_t afatfs_superClusterSize(void);
+    void afatfs_getCacheStatistics(uint32_t *hits, uint32_t *misses);
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define SECTOR_SIZE             512
+
+// A FAT32 volume with one sector per cluster, just big enough to not be FAT16
+#define PARTITION_START         64
+#define PARTITION_SECTORS       80000
+#define RESERVED_SECTORS        32
+#define FAT_SECTORS             ((((PARTITION_SECTORS - RESERVED_SECTORS) + 2) * 4 + SECTOR_SIZE - 1) / SECTOR_SIZE)
+#define FAT_START               (PARTITION_START + RESERVED_SECTORS)
+#define CLUSTER_START           (FAT_START + 2 * FAT_SECTORS)
+#define ROOT_CLUSTER            2
+#define CARD_SECTORS            (PARTITION_START + PARTITION_SECTORS)
+
+#define FAT32_END_OF_CHAIN      0x0FFFFFF8
+
+#define POLL_LIMIT              2000000
+
+/*
+ * File backed stand-in for the SD card driver. Each operation keeps the card busy for a configurable number of
+ * sdcard_poll() calls, and reads and writes can be made to fail.
+ */
+typedef struct sdcardSim_s {
+    FILE *image;
+
+    int readLatency;
+    int writeLatency;
+
+    // Every n'th read or write fails, 0 to never fail
+    int failEveryRead;
+    int failEveryWrite;
+
+    int busyPolls;
+    bool pending;
+    sdcardBlockOperation_e pendingOperation;
+    uint32_t pendingBlock;
+    uint8_t *pendingBuffer;
+    bool pendingFails;
+    sdcard_operationCompleteCallback_c pendingCallback;
+    uint32_t pendingCallbackData;
+
+    // Multi-block write in progress
+    bool streaming;
+    uint32_t streamNextBlock;
+    uint32_t streamBlocksRemain;
+
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t failedReads;
+    uint32_t failedWrites;
+    uint32_t streamsStarted;
+    uint32_t streamedWrites;
+} sdcardSim_t;
+
+static sdcardSim_t sim;
+
+static void simReset(int readLatency, int writeLatency)
+{
+    if (sim.image) {
+        fclose(sim.image);
+    }
+
+    memset(&sim, 0, sizeof(sim));
+    sim.image = tmpfile();
+    sim.readLatency = readLatency;
+    sim.writeLatency = writeLatency;
+}
+
+static void simReadSector(uint32_t block, uint8_t *buffer)
+{
+    memset(buffer, 0, SECTOR_SIZE);
+    fseek(sim.image, (long) block * SECTOR_SIZE, SEEK_SET);
+    // Sectors past the end of the sparse image read back as zeros
+    size_t bytesRead = fread(buffer, 1, SECTOR_SIZE, sim.image);
+    (void) bytesRead;
+}
+
+static void simWriteSector(uint32_t block, const uint8_t *buffer)
+{
+    fseek(sim.image, (long) block * SECTOR_SIZE, SEEK_SET);
+    fwrite(buffer, 1, SECTOR_SIZE, sim.image);
+}
+
+static uint32_t simReadFAT(uint32_t cluster)
+{
+    uint32_t sector[SECTOR_SIZE / sizeof(uint32_t)];
+
+    simReadSector(FAT_START + cluster / (SECTOR_SIZE / sizeof(uint32_t)), (uint8_t *) sector);
+
+    return sector[cluster % (SECTOR_SIZE / sizeof(uint32_t))] & 0x0FFFFFFF;
+}
+
+static void simWriteFAT(uint32_t cluster, uint32_t value)
+{
+    uint32_t sector[SECTOR_SIZE / sizeof(uint32_t)];
+
+    for (int fat = 0; fat < 2; fat++) {
+        uint32_t sectorIndex = FAT_START + fat * FAT_SECTORS + cluster / (SECTOR_SIZE / sizeof(uint32_t));
+
+        simReadSector(sectorIndex, (uint8_t *) sector);
+        sector[cluster % (SECTOR_SIZE / sizeof(uint32_t))] = value;
+        simWriteSector(sectorIndex, (uint8_t *) sector);
+    }
+}
+
+static void simFormat(void)
+{
+    uint8_t sector[SECTOR_SIZE] = {};
+
+    mbrPartitionEntry_t *partition = (mbrPartitionEntry_t *) (sector + 446);
+    partition->type = MBR_PARTITION_TYPE_FAT32_LBA;
+    partition->lbaBegin = PARTITION_START;
+    partition->numSectors = PARTITION_SECTORS;
+    sector[510] = 0x55;
+    sector[511] = 0xAA;
+    simWriteSector(0, sector);
+
+    memset(sector, 0, sizeof(sector));
+    fatVolumeID_t *volume = (fatVolumeID_t *) sector;
+    volume->bytesPerSector = SECTOR_SIZE;
+    volume->sectorsPerCluster = 1;
+    volume->reservedSectorCount = RESERVED_SECTORS;
+    volume->numFATs = 2;
+    volume->media = 0xF8;
+    volume->totalSectors32 = PARTITION_SECTORS;
+    volume->fatDescriptor.fat32.FATSize32 = FAT_SECTORS;
+    volume->fatDescriptor.fat32.rootCluster = ROOT_CLUSTER;
+    sector[510] = FAT_VOLUME_ID_SIGNATURE_1;
+    sector[511] = FAT_VOLUME_ID_SIGNATURE_2;
+    simWriteSector(PARTITION_START, sector);
+
+    simWriteFAT(0, 0x0FFFFFF8);
+    simWriteFAT(1, 0x0FFFFFFF);
+    simWriteFAT(ROOT_CLUSTER, 0x0FFFFFFF);
+}
+
+/*
+ * Find the directory entry with the given 8.3 name in the root directory of the image, following the root directory's
+ * cluster chain through the FAT.
+ */
+static bool simFindRootEntry(const char *name, fatDirectoryEntry_t *result)
+{
+    uint8_t fatName[FAT_FILENAME_LENGTH];
+    uint8_t sector[SECTOR_SIZE];
+
+    fat_convertFilenameToFATStyle(name, fatName);
+
+    for (uint32_t cluster = ROOT_CLUSTER; cluster >= 2 && cluster < FAT32_END_OF_CHAIN; cluster = simReadFAT(cluster)) {
+        simReadSector(CLUSTER_START + cluster - 2, sector);
+
+        const fatDirectoryEntry_t *entries = (const fatDirectoryEntry_t *) sector;
+
+        for (unsigned i = 0; i < SECTOR_SIZE / sizeof(fatDirectoryEntry_t); i++) {
+            if (entries[i].filename[0] == 0) {
+                return false;
+            }
+            if (memcmp(entries[i].filename, fatName, FAT_FILENAME_LENGTH) == 0) {
+                *result = entries[i];
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static uint32_t entryFirstCluster(const fatDirectoryEntry_t *entry)
+{
+    return ((uint32_t) entry->firstClusterHigh << 16) | entry->firstClusterLow;
+}
+
+// Returns the number of clusters in the chain, or 0 if it runs into free space or is not contiguous
+static uint32_t simContiguousChainLength(uint32_t firstCluster)
+{
+    uint32_t length = 1;
+
+    for (uint32_t cluster = firstCluster; ; cluster++, length++) {
+        uint32_t next = simReadFAT(cluster);
+
+        if (next >= FAT32_END_OF_CHAIN) {
+            return length;
+        }
+        if (next != cluster + 1) {
+            return 0;
+        }
+    }
+}
+
+extern "C" {
+    bool rtcGetDateTime(dateTime_t *dt)
+    {
+        UNUSED(dt);
+        return false;
+    }
+
+    static void simStartOperation(sdcardBlockOperation_e operation, uint32_t block, uint8_t *buffer, bool fails,
+        sdcard_operationCompleteCallback_c callback, uint32_t callbackData, int latency)
+    {
+        sim.pending = true;
+        sim.pendingOperation = operation;
+        sim.pendingBlock = block;
+        sim.pendingBuffer = buffer;
+        sim.pendingFails = fails;
+        sim.pendingCallback = callback;
+        sim.pendingCallbackData = callbackData;
+        sim.busyPolls = latency;
+    }
+
+    bool sdcard_poll(void)
+    {
+        if (sim.busyPolls > 0) {
+            sim.busyPolls--;
+        }
+
+        if (sim.pending && sim.busyPolls == 0) {
+            sim.pending = false;
+
+            if (sim.pendingOperation == SDCARD_BLOCK_OPERATION_READ && !sim.pendingFails) {
+                simReadSector(sim.pendingBlock, sim.pendingBuffer);
+            }
+            if (sim.pendingCallback) {
+                sim.pendingCallback(sim.pendingOperation, sim.pendingBlock, sim.pendingFails ? NULL : sim.pendingBuffer, sim.pendingCallbackData);
+            }
+        }
+
+        return !sim.pending;
+    }
+
+    bool sdcard_readBlock(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+    {
+        if (sim.pending) {
+            return false;
+        }
+
+        // A read ends any multi-block write in progress
+        sim.streaming = false;
+
+        sim.reads++;
+        bool fails = sim.failEveryRead > 0 && sim.reads % sim.failEveryRead == 0;
+        if (fails) {
+            sim.failedReads++;
+        }
+
+        simStartOperation(SDCARD_BLOCK_OPERATION_READ, blockIndex, buffer, fails, callback, callbackData, sim.readLatency + 1);
+
+        return true;
+    }
+
+    sdcardOperationStatus_e sdcard_beginWriteBlocks(uint32_t blockIndex, uint32_t blockCount)
+    {
+        if (sim.pending) {
+            return SDCARD_OPERATION_BUSY;
+        }
+
+        if (sim.streaming && blockIndex == sim.streamNextBlock) {
+            return SDCARD_OPERATION_SUCCESS;
+        }
+
+        sim.streaming = true;
+        sim.streamNextBlock = blockIndex;
+        sim.streamBlocksRemain = blockCount;
+        sim.streamsStarted++;
+
+        return SDCARD_OPERATION_SUCCESS;
+    }
+
+    sdcardOperationStatus_e sdcard_writeBlock(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+    {
+        if (sim.pending) {
+            return SDCARD_OPERATION_BUSY;
+        }
+
+        if (sim.streaming && blockIndex == sim.streamNextBlock) {
+            sim.streamedWrites++;
+            sim.streamNextBlock++;
+
+            if (--sim.streamBlocksRemain == 0) {
+                sim.streaming = false;
+            }
+        } else {
+            sim.streaming = false;
+        }
+
+        sim.writes++;
+        bool fails = sim.failEveryWrite > 0 && sim.writes % sim.failEveryWrite == 0;
+        if (fails) {
+            sim.failedWrites++;
+        } else {
+            simWriteSector(blockIndex, buffer);
+        }
+
+        simStartOperation(SDCARD_BLOCK_OPERATION_WRITE, blockIndex, buffer, fails, callback, callbackData, sim.writeLatency + 1);
+
+        return SDCARD_OPERATION_IN_PROGRESS;
+    }
+}
+
+static afatfsFilePtr_t openedFile;
+static bool fileOpenComplete;
+static bool fileCloseComplete;
+
+static void fileOpened(afatfsFilePtr_t file)
+{
+    openedFile = file;
+    fileOpenComplete = true;
+}
+
+static void fileClosed(void)
+{
+    fileCloseComplete = true;
+}
+
+static bool pollUntil(bool *flag)
+{
+    for (int i = 0; i < POLL_LIMIT && !*flag; i++) {
+        afatfs_poll();
+    }
+
+    return *flag;
+}
+
+static bool mountFilesystem(void)
+{
+    afatfs_init();
+
+    for (int i = 0; i < POLL_LIMIT && afatfs_getFilesystemState() == AFATFS_FILESYSTEM_STATE_INITIALIZATION; i++) {
+        afatfs_poll();
+    }
+
+    return afatfs_getFilesystemState() == AFATFS_FILESYSTEM_STATE_READY;
+}
+
+static bool unmountFilesystem(void)
+{
+    for (int i = 0; i < POLL_LIMIT; i++) {
+        if (afatfs_destroy(false)) {
+            return true;
+        }
+        sdcard_poll();
+    }
+
+    return false;
+}
+
+static afatfsFilePtr_t openFile(const char *name, const char *mode)
+{
+    openedFile = NULL;
+    fileOpenComplete = false;
+
+    if (!afatfs_fopen(name, mode, fileOpened) || !pollUntil(&fileOpenComplete)) {
+        return NULL;
+    }
+
+    return openedFile;
+}
+
+static bool closeFile(afatfsFilePtr_t file)
+{
+    fileCloseComplete = false;
+
+    for (int i = 0; i < POLL_LIMIT && !afatfs_fclose(file, fileClosed); i++) {
+        afatfs_poll();
+    }
+
+    return pollUntil(&fileCloseComplete);
+}
+
+static uint8_t testPattern(uint32_t offset)
+{
+    return (offset * 7 + (offset >> 9) * 13) & 0xFF;
+}
+
+// Write `length` bytes of test pattern in chunks of `chunkSize`, polling the filesystem whenever the cache is full
+static bool writePattern(afatfsFilePtr_t file, uint32_t length, uint32_t chunkSize)
+{
+    std::vector<uint8_t> chunk(chunkSize);
+    uint32_t offset = 0;
+
+    for (int polls = 0; offset < length && polls < POLL_LIMIT; polls++) {
+        uint32_t thisChunk = std::min(chunkSize, length - offset);
+
+        for (uint32_t i = 0; i < thisChunk; i++) {
+            chunk[i] = testPattern(offset + i);
+        }
+
+        offset += afatfs_fwrite(file, chunk.data(), thisChunk);
+
+        afatfs_poll();
+    }
+
+    return offset == length;
+}
+
+static bool readBackPattern(const char *name, uint32_t length)
+{
+    afatfsFilePtr_t file = openFile(name, "r");
+
+    if (!file) {
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[SECTOR_SIZE];
+
+    for (int polls = 0; !afatfs_feof(file) && polls < POLL_LIMIT; polls++) {
+        uint32_t bytesRead = afatfs_fread(file, buffer, sizeof(buffer));
+
+        data.insert(data.end(), buffer, buffer + bytesRead);
+
+        if (bytesRead == 0) {
+            afatfs_poll();
+        }
+    }
+
+    closeFile(file);
+
+    if (data.size() != length) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+        if (data[i] != testPattern(i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+class AsyncFatfsTest : public ::testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        simReset(1, 2);
+        simFormat();
+    }
+
+    virtual void TearDown()
+    {
+        afatfs_destroy(true);
+    }
+};
+
+TEST_F(AsyncFatfsTest, TestMountCreatesFreefile)
+{
+    ASSERT_TRUE(mountFilesystem());
+
+    EXPECT_GT(afatfs_getContiguousFreeSpace(), (uint32_t) PARTITION_SECTORS / 2 * SECTOR_SIZE);
+
+    ASSERT_TRUE(unmountFilesystem());
+
+    fatDirectoryEntry_t freefile;
+    ASSERT_TRUE(simFindRootEntry("FREESPAC.E", &freefile));
+    EXPECT_GT(simContiguousChainLength(entryFirstCluster(&freefile)), 0u);
+}
+
+TEST_F(AsyncFatfsTest, TestRegularFileRoundTrip)
+{
+    const uint32_t length = 5000;
+
+    ASSERT_TRUE(mountFilesystem());
+
+    afatfsFilePtr_t file = openFile("TEST.TXT", "w");
+    ASSERT_TRUE(file != NULL);
+    ASSERT_TRUE(writePattern(file, length, 100));
+    ASSERT_TRUE(closeFile(file));
+
+    ASSERT_TRUE(unmountFilesystem());
+
+    fatDirectoryEntry_t entry;
+    ASSERT_TRUE(simFindRootEntry("TEST.TXT", &entry));
+    EXPECT_EQ(length, entry.fileSize);
+
+    ASSERT_TRUE(mountFilesystem());
+    EXPECT_TRUE(readBackPattern("TEST.TXT", length));
+}
+
+TEST_F(AsyncFatfsTest, TestContiguousFileRoundTrip)
+{
+    ASSERT_TRUE(mountFilesystem());
+
+    const uint32_t length = afatfs_superClusterSize() * 2 + 1234;
+
+    afatfsFilePtr_t file = openFile("LOG.TXT", "as");
+    ASSERT_TRUE(file != NULL);
+    ASSERT_TRUE(writePattern(file, length, 64));
+    ASSERT_TRUE(closeFile(file));
+
+    ASSERT_TRUE(unmountFilesystem());
+
+    fatDirectoryEntry_t entry;
+    ASSERT_TRUE(simFindRootEntry("LOG.TXT", &entry));
+    EXPECT_EQ(length, entry.fileSize);
+    EXPECT_GE(simContiguousChainLength(entryFirstCluster(&entry)) * SECTOR_SIZE, length);
+
+    ASSERT_TRUE(mountFilesystem());
+    EXPECT_TRUE(readBackPattern("LOG.TXT", length));
+}
+
+TEST_F(AsyncFatfsTest, TestPreallocatedLogReturnsUnusedClusters)
+{
+    ASSERT_TRUE(mountFilesystem());
+
+    const uint32_t superClusterSize = afatfs_superClusterSize();
+    const uint32_t freeSpaceBefore = afatfs_getContiguousFreeSpace();
+    const uint32_t length = superClusterSize + 100;
+
+    afatfsFilePtr_t file = openFile("LOG.TXT", "al");
+    ASSERT_TRUE(file != NULL);
+    ASSERT_TRUE(writePattern(file, length, 64));
+
+    // The whole preallocated run is taken from the freefile while the log is open
+    EXPECT_GT(freeSpaceBefore - afatfs_getContiguousFreeSpace(), 2 * superClusterSize);
+
+    ASSERT_TRUE(closeFile(file));
+
+    // ...and the superclusters that weren't needed are given back on close
+    EXPECT_EQ(freeSpaceBefore - 2 * superClusterSize, afatfs_getContiguousFreeSpace());
+
+    ASSERT_TRUE(unmountFilesystem());
+
+    fatDirectoryEntry_t entry, freefile;
+    ASSERT_TRUE(simFindRootEntry("LOG.TXT", &entry));
+    ASSERT_TRUE(simFindRootEntry("FREESPAC.E", &freefile));
+
+    EXPECT_EQ(length, entry.fileSize);
+    EXPECT_EQ(2 * superClusterSize / SECTOR_SIZE, simContiguousChainLength(entryFirstCluster(&entry)));
+
+    // The freefile starts right after the log and its chain is intact
+    EXPECT_EQ(entryFirstCluster(&entry) + 2 * superClusterSize / SECTOR_SIZE, entryFirstCluster(&freefile));
+    EXPECT_GE(simContiguousChainLength(entryFirstCluster(&freefile)) * SECTOR_SIZE, freefile.fileSize);
+
+    ASSERT_TRUE(mountFilesystem());
+    EXPECT_EQ(freeSpaceBefore - 2 * superClusterSize, afatfs_getContiguousFreeSpace());
+    EXPECT_TRUE(readBackPattern("LOG.TXT", length));
+}
+
+TEST_F(AsyncFatfsTest, TestPreallocatedLogStreamsAsOneMultiBlockWrite)
+{
+    ASSERT_TRUE(mountFilesystem());
+
+    const uint32_t length = afatfs_superClusterSize() * 3;
+
+    afatfsFilePtr_t file = openFile("LOG.TXT", "al");
+    ASSERT_TRUE(file != NULL);
+
+    // Let the preallocation's metadata writes go out first
+    ASSERT_TRUE(writePattern(file, SECTOR_SIZE, 64));
+    while (!afatfs_flush()) {
+        afatfs_poll();
+    }
+
+    const uint32_t streamsBefore = sim.streamsStarted;
+    const uint32_t writesBefore = sim.writes;
+    const uint32_t streamedBefore = sim.streamedWrites;
+
+    std::vector<uint8_t> chunk(64);
+    uint32_t offset = SECTOR_SIZE;
+    while (offset < length) {
+        for (uint32_t i = 0; i < chunk.size(); i++) {
+            chunk[i] = testPattern(offset + i);
+        }
+        offset += afatfs_fwrite(file, chunk.data(), chunk.size());
+        afatfs_poll();
+    }
+
+    // Every data sector went out as part of the multi-block write that began with the log
+    EXPECT_EQ(streamsBefore, sim.streamsStarted);
+    EXPECT_EQ(sim.writes - writesBefore, sim.streamedWrites - streamedBefore);
+
+    ASSERT_TRUE(closeFile(file));
+    ASSERT_TRUE(unmountFilesystem());
+    ASSERT_TRUE(mountFilesystem());
+    EXPECT_TRUE(readBackPattern("LOG.TXT", length));
+}
+
+static afatfsFilePtr_t secondOpenedFile;
+
+static void secondFileOpened(afatfsFilePtr_t file)
+{
+    secondOpenedFile = file;
+}
+
+TEST_F(AsyncFatfsTest, TestTwoPreallocatedLogsOpenAtOnce)
+{
+    ASSERT_TRUE(mountFilesystem());
+
+    const uint32_t superClusterSize = afatfs_superClusterSize();
+    const uint32_t clustersPerSupercluster = superClusterSize / SECTOR_SIZE;
+    // Long enough that the first log needs a second preallocated run
+    const uint32_t firstLength = superClusterSize * 5 + 100;
+    const uint32_t secondLength = superClusterSize + 200;
+
+    afatfsFilePtr_t first = openFile("LOG1.TXT", "al");
+    ASSERT_TRUE(first != NULL);
+
+    secondOpenedFile = NULL;
+    ASSERT_TRUE(afatfs_fopen("LOG2.TXT", "al", secondFileOpened));
+
+    // The second log can't take any of the freefile while the first one is still growing into it
+    ASSERT_TRUE(writePattern(first, firstLength, 64));
+    EXPECT_TRUE(secondOpenedFile == NULL);
+
+    ASSERT_TRUE(closeFile(first));
+
+    for (int i = 0; i < POLL_LIMIT && secondOpenedFile == NULL; i++) {
+        afatfs_poll();
+    }
+    ASSERT_TRUE(secondOpenedFile != NULL);
+    ASSERT_TRUE(writePattern(secondOpenedFile, secondLength, 64));
+    ASSERT_TRUE(closeFile(secondOpenedFile));
+
+    ASSERT_TRUE(unmountFilesystem());
+
+    fatDirectoryEntry_t firstEntry, secondEntry, freefile;
+    ASSERT_TRUE(simFindRootEntry("LOG1.TXT", &firstEntry));
+    ASSERT_TRUE(simFindRootEntry("LOG2.TXT", &secondEntry));
+    ASSERT_TRUE(simFindRootEntry("FREESPAC.E", &freefile));
+
+    // Each chain is terminated right where the next file begins, so nothing is cross-linked
+    EXPECT_EQ(6 * clustersPerSupercluster, simContiguousChainLength(entryFirstCluster(&firstEntry)));
+    EXPECT_EQ(2 * clustersPerSupercluster, simContiguousChainLength(entryFirstCluster(&secondEntry)));
+    EXPECT_EQ(entryFirstCluster(&firstEntry) + 6 * clustersPerSupercluster, entryFirstCluster(&secondEntry));
+    EXPECT_EQ(entryFirstCluster(&secondEntry) + 2 * clustersPerSupercluster, entryFirstCluster(&freefile));
+    EXPECT_GE(simContiguousChainLength(entryFirstCluster(&freefile)) * SECTOR_SIZE, freefile.fileSize);
+
+    ASSERT_TRUE(mountFilesystem());
+    EXPECT_TRUE(readBackPattern("LOG1.TXT", firstLength));
+    EXPECT_TRUE(readBackPattern("LOG2.TXT", secondLength));
+}
+
+TEST_F(AsyncFatfsTest, TestSubdirectoryFile)
+{
+    ASSERT_TRUE(mountFilesystem());
+
+    fileOpenComplete = false;
+    ASSERT_TRUE(afatfs_mkdir("LOGS", fileOpened));
+    ASSERT_TRUE(pollUntil(&fileOpenComplete));
+    ASSERT_TRUE(openedFile != NULL);
+    afatfs_chdir(openedFile);
+
+    afatfsFilePtr_t file = openFile("A.TXT", "w");
+    ASSERT_TRUE(file != NULL);
+    ASSERT_TRUE(writePattern(file, 3000, 512));
+    ASSERT_TRUE(closeFile(file));
+
+    EXPECT_TRUE(readBackPattern("A.TXT", 3000));
+
+    fatDirectoryEntry_t entry;
+    ASSERT_TRUE(unmountFilesystem());
+    ASSERT_TRUE(simFindRootEntry("LOGS", &entry));
+    EXPECT_TRUE((entry.attrib & FAT_FILE_ATTRIBUTE_DIRECTORY) != 0);
+}
+
+TEST_F(AsyncFatfsTest, TestSurvivesReadAndWriteFailures)
+{
+    sim.failEveryRead = 5;
+    sim.failEveryWrite = 7;
+
+    ASSERT_TRUE(mountFilesystem());
+
+    const uint32_t length = afatfs_superClusterSize() + 4321;
+
+    afatfsFilePtr_t file = openFile("LOG.TXT", "al");
+    ASSERT_TRUE(file != NULL);
+    ASSERT_TRUE(writePattern(file, length, 100));
+    ASSERT_TRUE(closeFile(file));
+    ASSERT_TRUE(unmountFilesystem());
+
+    EXPECT_GT(sim.failedReads, 0u);
+    EXPECT_GT(sim.failedWrites, 0u);
+
+    sim.failEveryRead = 0;
+    sim.failEveryWrite = 0;
+
+    ASSERT_TRUE(mountFilesystem());
+    EXPECT_TRUE(readBackPattern("LOG.TXT", length));
+}
+
+typedef struct blackboxBenchmarkResult_s {
+    uint64_t bytesDropped;
+    // Longest run of consecutive loops that had to drop data
+    int longestStallLoops;
+} blackboxBenchmarkResult_t;
+
+/*
+ * Blackbox shaped workload: one frame per loop iteration (an intra frame every 32 frames, inter frames otherwise) with
+ * afatfs_poll() called once per iteration, like the firmware does.
+ */
+static void runBlackboxBenchmark(const char *mode, int readLatency, int writeLatency, blackboxBenchmarkResult_t *result)
+{
+    const int loops = 100000;
+    const uint32_t intraFrameSize = 120, interFrameSize = 45;
+
+    simReset(readLatency, writeLatency);
+    simFormat();
+    ASSERT_TRUE(mountFilesystem());
+
+    afatfsFilePtr_t file = openFile("LOG00001.TXT", mode);
+    ASSERT_TRUE(file != NULL);
+
+    uint32_t hitsBefore, missesBefore;
+    afatfs_getCacheStatistics(&hitsBefore, &missesBefore);
+
+    uint8_t frame[intraFrameSize];
+    memset(frame, 0x5A, sizeof(frame));
+
+    uint64_t bytesAccepted = 0, bytesDropped = 0;
+    double worstPollUs = 0, totalPollUs = 0;
+    int stallLoops = 0, longestStallLoops = 0;
+
+    const auto begin = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < loops; i++) {
+        const uint32_t frameSize = (i % 32) == 0 ? intraFrameSize : interFrameSize;
+        const uint32_t written = afatfs_fwrite(file, frame, frameSize);
+
+        bytesAccepted += written;
+        bytesDropped += frameSize - written;
+
+        stallLoops = written < frameSize ? stallLoops + 1 : 0;
+        longestStallLoops = std::max(longestStallLoops, stallLoops);
+
+        const auto pollBegin = std::chrono::steady_clock::now();
+        afatfs_poll();
+        const double pollUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - pollBegin).count();
+
+        worstPollUs = std::max(worstPollUs, pollUs);
+        totalPollUs += pollUs;
+    }
+
+    const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    uint32_t hits, misses;
+    afatfs_getCacheStatistics(&hits, &misses);
+    hits -= hitsBefore;
+    misses -= missesBefore;
+
+    ASSERT_TRUE(closeFile(file));
+    // Start the next run from a fresh mount, a stale one doesn't find the new freefile
+    ASSERT_TRUE(unmountFilesystem());
+
+    printf("[ BENCHMARK] mode %-2s latency r%d/w%d: %6.1f KB per 1000 loops, %5.2f%% dropped, longest stall %4d loops, "
+        "%6.1f MB/s wall, afatfs_poll worst %6.1f us mean %5.2f us, cache hit rate %5.1f%%, %u multi-block writes\n",
+        mode, readLatency, writeLatency,
+        bytesAccepted / 1024.0 / (loops / 1000.0), 100.0 * bytesDropped / (bytesAccepted + bytesDropped),
+        longestStallLoops, bytesAccepted / wallSeconds / (1024 * 1024),
+        worstPollUs, totalPollUs / loops,
+        100.0 * hits / std::max(hits + misses, 1u), sim.streamsStarted);
+
+    EXPECT_GT(bytesAccepted, 0u);
+
+    result->bytesDropped = bytesDropped;
+    result->longestStallLoops = longestStallLoops;
+}
+
+TEST(AsyncFatfsBenchmark, BenchmarkBlackboxWorkload)
+{
+    const int latencies[][2] = { { 1, 2 }, { 2, 8 } };
+
+    for (const auto &latency : latencies) {
+        blackboxBenchmarkResult_t contiguous, preallocated;
+
+        runBlackboxBenchmark("as", latency[0], latency[1], &contiguous);
+        runBlackboxBenchmark("al", latency[0], latency[1], &preallocated);
+
+        // Preallocating must not make blackbox drop more data than plain contiguous files
+        EXPECT_LE(preallocated.bytesDropped, contiguous.bytesDropped);
+        EXPECT_LE(preallocated.longestStallLoops, contiguous.longestStallLoops);
+    }
+
+    afatfs_destroy(true);
+}
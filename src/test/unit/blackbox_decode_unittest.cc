@@ -0,0 +1,707 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+    #include "blackbox/blackbox_decode.h"
+    #include "blackbox/blackbox_encoding.h"
+    #include "blackbox/blackbox_fielddefs.h"
+    #include "blackbox/blackbox_io.h"
+    #include "common/utils.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// The log is written with the firmware encoders in blackbox_encoding.c
+static std::vector<uint8_t> logData;
+
+extern "C" {
+    int32_t blackboxHeaderBudget;
+
+    void blackboxWrite(uint8_t value)
+    {
+        logData.push_back(value);
+    }
+
+    int blackboxPrint(const char *s)
+    {
+        const size_t length = strlen(s);
+        logData.insert(logData.end(), s, s + length);
+        return length;
+    }
+
+    int tfp_format(void *putp, void (*putf) (void *, char), const char *fmt, va_list va)
+    {
+        char buf[128];
+        const int length = vsnprintf(buf, sizeof(buf), fmt, va);
+        for (int i = 0; i < length; i++) {
+            putf(putp, buf[i]);
+        }
+        return length;
+    }
+}
+
+static void writeString(const std::string &s)
+{
+    logData.insert(logData.end(), s.begin(), s.end());
+}
+
+static void writeFieldHeader(char frame, const char *property, const std::vector<int> &values)
+{
+    std::string line = std::string("H Field ") + frame + " " + property + ":";
+    for (size_t i = 0; i < values.size(); i++) {
+        line += (i ? "," : "") + std::to_string(values[i]);
+    }
+    writeString(line + "\n");
+}
+
+static void writeLogEnd(void)
+{
+    blackboxWrite('E');
+    blackboxWrite(FLIGHT_LOG_EVENT_LOG_END);
+    blackboxPrintf("End of log (disarm reason:%d)", 1);
+    blackboxWrite(0);
+}
+
+/*
+ * Encodings: P frames use every grouped encoding with no predictor, so the decoded
+ * values are the written ones.
+ */
+
+#define ENCODING_FIELD_COUNT 15
+
+static void writeEncodingHeader(void)
+{
+    logData.clear();
+    writeString("H Product:Blackbox flight data recorder by Nicholas Sherlock\n");
+    std::string names = "H Field I name:";
+    for (int i = 0; i < ENCODING_FIELD_COUNT; i++) {
+        names += (i ? ",f[" : "f[") + std::to_string(i) + "]";
+    }
+    writeString(names + "\n");
+    writeFieldHeader('I', "signed", std::vector<int>(ENCODING_FIELD_COUNT, 1));
+    writeFieldHeader('I', "predictor", std::vector<int>(ENCODING_FIELD_COUNT, FLIGHT_LOG_FIELD_PREDICTOR_0));
+    writeFieldHeader('I', "encoding", std::vector<int>(ENCODING_FIELD_COUNT, FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB));
+    writeFieldHeader('P', "predictor", std::vector<int>(ENCODING_FIELD_COUNT, FLIGHT_LOG_FIELD_PREDICTOR_0));
+    writeFieldHeader('P', "encoding", {
+        FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32, FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32, FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32,
+        FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16, FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16, FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16, FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16,
+        FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB, FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB, FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB, FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB, FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB,
+        FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB,
+        FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB,
+        FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB
+    });
+}
+
+static void writeEncodingFrames(const std::vector<std::vector<int32_t>> &frames)
+{
+    blackboxWrite('I');
+    for (int i = 0; i < ENCODING_FIELD_COUNT; i++) {
+        blackboxWriteSignedVB(0);
+    }
+
+    for (std::vector<int32_t> values : frames) {
+        blackboxWrite('P');
+        blackboxWriteTag2_3S32(&values[0]);
+        blackboxWriteTag8_4S16(&values[3]);
+        blackboxWriteTag8_8SVB(&values[7], 5);
+        blackboxWriteSignedVB(values[12]);
+        // Single field groups are written without the header byte
+        blackboxWriteTag8_8SVB(&values[13], 1);
+        blackboxWriteUnsignedVB(values[14]);
+    }
+}
+
+static int32_t randomValue(int bits)
+{
+    const int32_t value = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+    if (bits >= 32) {
+        return value;
+    }
+    // Sign extend from the requested width
+    const int shift = 32 - bits;
+    return (int32_t)((uint32_t)value << shift) >> shift;
+}
+
+TEST(BlackboxDecodeTest, TestEncodingsRoundTrip)
+{
+    static const int tag2Bits[] = { 2, 4, 6, 8, 16, 24, 32 };
+    static const int tag8Bits[] = { 1, 4, 8, 16 };
+    std::vector<std::vector<int32_t>> frames;
+
+    srand(1);
+    for (int n = 0; n < 2000; n++) {
+        std::vector<int32_t> values(ENCODING_FIELD_COUNT);
+        for (int i = 0; i < 3; i++) {
+            values[i] = randomValue(tag2Bits[rand() % ARRAYLEN(tag2Bits)]);
+        }
+        for (int i = 3; i < 7; i++) {
+            values[i] = randomValue(tag8Bits[rand() % ARRAYLEN(tag8Bits)]);
+        }
+        for (int i = 7; i < 14; i++) {
+            values[i] = (rand() % 3) ? 0 : randomValue(1 + rand() % 32);
+        }
+        values[14] = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+        frames.push_back(values);
+    }
+    // Extremes of every encoding
+    frames.push_back({ INT32_MIN, INT32_MAX, -32, -32768, 32767, -8, 7, INT32_MIN, INT32_MAX, 1, -1, 0, INT32_MIN, INT32_MAX, -1 });
+
+    writeEncodingHeader();
+    writeEncodingFrames(frames);
+
+    static blackboxDecoder_t decoder;
+    ASSERT_TRUE(blackboxDecodeInit(&decoder, logData.data(), logData.size()));
+    ASSERT_TRUE(blackboxDecodeNextMainFrame(&decoder));
+    EXPECT_EQ('I', decoder.mainFrameType);
+
+    for (size_t n = 0; n < frames.size(); n++) {
+        ASSERT_TRUE(blackboxDecodeNextMainFrame(&decoder));
+        EXPECT_EQ('P', decoder.mainFrameType);
+        for (int i = 0; i < ENCODING_FIELD_COUNT; i++) {
+            ASSERT_EQ(frames[n][i], decoder.mainFrame[i]) << "frame " << n << " field " << i;
+        }
+    }
+    EXPECT_FALSE(blackboxDecodeNextMainFrame(&decoder));
+    EXPECT_EQ(0u, decoder.corruptFrameCount);
+}
+
+/*
+ * Rice groups: 11 consecutive fields split in groups of 8 and 3, a variable-byte
+ * field and a single field group.
+ */
+
+#define RICE_FIELD_COUNT 13
+
+static void writeRiceHeader(void)
+{
+    logData.clear();
+    writeString("H Product:Blackbox flight data recorder by Nicholas Sherlock\n");
+    std::string names = "H Field I name:";
+    for (int i = 0; i < RICE_FIELD_COUNT; i++) {
+        names += (i ? ",f[" : "f[") + std::to_string(i) + "]";
+    }
+    writeString(names + "\n");
+    writeFieldHeader('I', "signed", std::vector<int>(RICE_FIELD_COUNT, 1));
+    writeFieldHeader('I', "predictor", std::vector<int>(RICE_FIELD_COUNT, FLIGHT_LOG_FIELD_PREDICTOR_0));
+    writeFieldHeader('I', "encoding", std::vector<int>(RICE_FIELD_COUNT, FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB));
+    writeFieldHeader('P', "predictor", std::vector<int>(RICE_FIELD_COUNT, FLIGHT_LOG_FIELD_PREDICTOR_0));
+    std::vector<int> encodings(RICE_FIELD_COUNT, FLIGHT_LOG_FIELD_ENCODING_RICE_GROUP);
+    encodings[11] = FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB;
+    writeFieldHeader('P', "encoding", encodings);
+}
+
+TEST(BlackboxDecodeTest, TestRiceGroupRoundTrip)
+{
+    std::vector<std::vector<int32_t>> frames;
+
+    srand(2);
+    for (int n = 0; n < 2000; n++) {
+        // Values of one group share their magnitude most of the time, like predictor residuals do
+        const int bits = 1 + rand() % 20;
+        std::vector<int32_t> values(RICE_FIELD_COUNT);
+        for (int i = 0; i < RICE_FIELD_COUNT; i++) {
+            values[i] = (rand() % 8) ? randomValue(bits) : randomValue(1 + rand() % 32);
+        }
+        frames.push_back(values);
+    }
+    // Zeros and the extremes, which need the escape code
+    frames.push_back(std::vector<int32_t>(RICE_FIELD_COUNT, 0));
+    frames.push_back({ INT32_MIN, INT32_MAX, 0, -1, 1, INT32_MIN, INT32_MAX, 0, INT32_MAX, 0, INT32_MIN, -1, INT32_MIN });
+
+    writeRiceHeader();
+    blackboxWrite('I');
+    for (int i = 0; i < RICE_FIELD_COUNT; i++) {
+        blackboxWriteSignedVB(0);
+    }
+    for (const std::vector<int32_t> &values : frames) {
+        blackboxWrite('P');
+        blackboxWriteRiceGroup(&values[0], 8);
+        blackboxWriteRiceGroup(&values[8], 3);
+        blackboxWriteSignedVB(values[11]);
+        blackboxWriteRiceGroup(&values[12], 1);
+    }
+
+    static blackboxDecoder_t decoder;
+    ASSERT_TRUE(blackboxDecodeInit(&decoder, logData.data(), logData.size()));
+    ASSERT_TRUE(blackboxDecodeNextMainFrame(&decoder));
+
+    for (size_t n = 0; n < frames.size(); n++) {
+        ASSERT_TRUE(blackboxDecodeNextMainFrame(&decoder));
+        EXPECT_EQ('P', decoder.mainFrameType);
+        for (int i = 0; i < RICE_FIELD_COUNT; i++) {
+            ASSERT_EQ(frames[n][i], decoder.mainFrame[i]) << "frame " << n << " field " << i;
+        }
+    }
+    EXPECT_FALSE(blackboxDecodeNextMainFrame(&decoder));
+    EXPECT_EQ(0u, decoder.corruptFrameCount);
+}
+
+TEST(BlackboxDecodeTest, TestRiceGroupIsSmallerForSmallResiduals)
+{
+    // Three residuals of a few counts, as a well predicted gyro axis produces
+    const int32_t values[3] = { 3, -2, 5 };
+
+    logData.clear();
+    blackboxWriteRiceGroup(values, 3);
+    const size_t riceSize = logData.size();
+
+    logData.clear();
+    for (int32_t value : values) {
+        blackboxWriteSignedVB(value);
+    }
+    EXPECT_LT(riceSize, logData.size());
+}
+
+/*
+ * Predictors: a main frame laid out like the firmware one, written the way
+ * writeIntraframe() and writeInterframe() do it.
+ */
+
+#define TEST_MINTHROTTLE    1150
+#define TEST_VBATREF        4095
+#define TEST_I_INTERVAL     32
+
+enum {
+    FIELD_ITERATION,
+    FIELD_TIME,
+    FIELD_GYRO,
+    FIELD_MOTOR_0,
+    FIELD_MOTOR_1,
+    FIELD_VBAT,
+    FIELD_COUNT
+};
+
+typedef struct {
+    uint32_t iteration;
+    uint32_t time;
+    int16_t gyro;
+    int16_t motor[2];
+    uint16_t vbat;
+} testState_t;
+
+static void writePredictorHeader(int pNum, int pDenom)
+{
+    logData.clear();
+    writeString("H Product:Blackbox flight data recorder by Nicholas Sherlock\n");
+    writeString("H Field I name:loopIteration,time,gyroADC[0],motor[0],motor[1],vbatLatest\n");
+    writeFieldHeader('I', "signed", { 0, 0, 1, 0, 0, 0 });
+    writeFieldHeader('I', "predictor", {
+        FLIGHT_LOG_FIELD_PREDICTOR_0, FLIGHT_LOG_FIELD_PREDICTOR_0, FLIGHT_LOG_FIELD_PREDICTOR_0,
+        FLIGHT_LOG_FIELD_PREDICTOR_MINTHROTTLE, FLIGHT_LOG_FIELD_PREDICTOR_MOTOR_0, FLIGHT_LOG_FIELD_PREDICTOR_VBATREF
+    });
+    writeFieldHeader('I', "encoding", {
+        FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB,
+        FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_NEG_14BIT
+    });
+    writeFieldHeader('P', "predictor", {
+        FLIGHT_LOG_FIELD_PREDICTOR_INC, FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE, FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2,
+        FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2, FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2, FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS
+    });
+    writeFieldHeader('P', "encoding", {
+        FLIGHT_LOG_FIELD_ENCODING_NULL, FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB,
+        FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB
+    });
+    blackboxPrintfHeaderLine("P interval", "%d/%d", pNum, pDenom);
+    blackboxPrintfHeaderLine("minthrottle", "%d", TEST_MINTHROTTLE);
+    blackboxPrintfHeaderLine("vbatref", "%u", TEST_VBATREF);
+}
+
+static testState_t testState(uint32_t iteration)
+{
+    testState_t state;
+    state.iteration = iteration;
+    state.time = 100000 + iteration * 500 + (iteration % 3);
+    state.gyro = (int16_t)(((int32_t)(iteration * 2654435761U) >> 16) % 2000);
+    state.motor[0] = 1150 + (iteration * 7) % 700;
+    state.motor[1] = 1150 + (iteration * 13) % 700;
+    state.vbat = 4095 - iteration / 50;
+    return state;
+}
+
+static void writeIntra(const testState_t *s)
+{
+    blackboxWrite('I');
+    blackboxWriteUnsignedVB(s->iteration);
+    blackboxWriteUnsignedVB(s->time);
+    blackboxWriteSignedVB(s->gyro);
+    blackboxWriteUnsignedVB(s->motor[0] - TEST_MINTHROTTLE);
+    blackboxWriteSignedVB(s->motor[1] - s->motor[0]);
+    blackboxWriteUnsignedVB((TEST_VBATREF - s->vbat) & 0x3FFF);
+}
+
+static void writeInter(const testState_t *s, const testState_t *prev, const testState_t *prev2)
+{
+    blackboxWrite('P');
+    blackboxWriteSignedVB((int32_t)(s->time - (2 * prev->time - prev2->time)));
+    blackboxWriteSignedVB(s->gyro - (prev->gyro + prev2->gyro) / 2);
+    for (int i = 0; i < 2; i++) {
+        blackboxWriteSignedVB(s->motor[i] - (prev->motor[i] + prev2->motor[i]) / 2);
+    }
+    int32_t vbatDelta = (int32_t)s->vbat - prev->vbat;
+    blackboxWriteTag8_8SVB(&vbatDelta, 1);
+}
+
+static bool shouldLogPFrame(int iteration, int pNum, int pDenom)
+{
+    return (iteration % TEST_I_INTERVAL + pNum - 1) % pDenom < pNum;
+}
+
+// Logs iterations like blackboxLogIteration(), returns the logged iterations
+static std::vector<uint32_t> writePredictorLog(int iterations, int pNum, int pDenom)
+{
+    std::vector<uint32_t> logged;
+    testState_t prev, prev2;
+
+    writePredictorHeader(pNum, pDenom);
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        const testState_t s = testState(iteration);
+        if (iteration % TEST_I_INTERVAL == 0) {
+            writeIntra(&s);
+            prev = prev2 = s;
+        } else if (shouldLogPFrame(iteration, pNum, pDenom)) {
+            writeInter(&s, &prev, &prev2);
+            prev2 = prev;
+            prev = s;
+        } else {
+            continue;
+        }
+        logged.push_back(iteration);
+    }
+    writeLogEnd();
+    return logged;
+}
+
+static void expectFrameMatches(const blackboxDecoder_t *decoder, uint32_t iteration)
+{
+    const testState_t s = testState(iteration);
+    EXPECT_EQ(s.iteration, (uint32_t)decoder->mainFrame[FIELD_ITERATION]);
+    EXPECT_EQ(s.time, (uint32_t)decoder->mainFrame[FIELD_TIME]);
+    EXPECT_EQ(s.gyro, decoder->mainFrame[FIELD_GYRO]);
+    EXPECT_EQ(s.motor[0], decoder->mainFrame[FIELD_MOTOR_0]);
+    EXPECT_EQ(s.motor[1], decoder->mainFrame[FIELD_MOTOR_1]);
+    EXPECT_EQ(s.vbat, decoder->mainFrame[FIELD_VBAT]);
+}
+
+TEST(BlackboxDecodeTest, TestPredictors)
+{
+    static const int pIntervals[][2] = { { 1, 1 }, { 1, 2 }, { 2, 3 }, { 1, 32 } };
+
+    for (const auto &pInterval : pIntervals) {
+        const std::vector<uint32_t> logged = writePredictorLog(1000, pInterval[0], pInterval[1]);
+
+        static blackboxDecoder_t decoder;
+        ASSERT_TRUE(blackboxDecodeInit(&decoder, logData.data(), logData.size()));
+        EXPECT_EQ(TEST_MINTHROTTLE, decoder.minthrottle);
+        EXPECT_EQ((uint32_t)TEST_I_INTERVAL, decoder.frameIntervalI);
+
+        for (uint32_t iteration : logged) {
+            ASSERT_TRUE(blackboxDecodeNextMainFrame(&decoder));
+            expectFrameMatches(&decoder, iteration);
+        }
+        EXPECT_FALSE(blackboxDecodeNextMainFrame(&decoder));
+        EXPECT_TRUE(decoder.logEnded);
+        EXPECT_EQ(0u, decoder.corruptFrameCount);
+    }
+}
+
+TEST(BlackboxDecodeTest, TestEventsAreSkipped)
+{
+    writePredictorHeader(1, 1);
+    const testState_t s0 = testState(0), s1 = testState(1), s2 = testState(2);
+    writeIntra(&s0);
+    blackboxWrite('E');
+    blackboxWrite(FLIGHT_LOG_EVENT_SYNC_BEEP);
+    blackboxWriteUnsignedVB(123456789);
+    writeInter(&s1, &s0, &s0);
+    blackboxWrite('E');
+    blackboxWrite(FLIGHT_LOG_EVENT_INFLIGHT_ADJUSTMENT);
+    blackboxWrite(3 + FLIGHT_LOG_EVENT_INFLIGHT_ADJUSTMENT_FUNCTION_FLOAT_VALUE_FLAG);
+    blackboxWriteFloat(1.5f);
+    blackboxWrite('E');
+    blackboxWrite(FLIGHT_LOG_EVENT_FLIGHTMODE);
+    blackboxWriteUnsignedVB(5);
+    blackboxWriteUnsignedVB(1);
+    writeInter(&s2, &s1, &s0);
+    writeLogEnd();
+    // Anything after the end of the log is not decoded
+    writeIntra(&s0);
+
+    static blackboxDecoder_t decoder;
+    ASSERT_TRUE(blackboxDecodeInit(&decoder, logData.data(), logData.size()));
+    for (uint32_t iteration = 0; iteration < 3; iteration++) {
+        ASSERT_TRUE(blackboxDecodeNextMainFrame(&decoder));
+        expectFrameMatches(&decoder, iteration);
+    }
+    EXPECT_FALSE(blackboxDecodeNextMainFrame(&decoder));
+    // Three events and the end of log
+    EXPECT_EQ(4u, decoder.eventCount);
+    EXPECT_EQ(0u, decoder.corruptFrameCount);
+}
+
+TEST(BlackboxDecodeTest, TestCorruptFrameResyncsOnNextIntraFrame)
+{
+    const std::vector<uint32_t> logged = writePredictorLog(200, 1, 1);
+
+    // Damage a byte in the middle of the second group of frames, as a dropped byte on a serial log would
+    static blackboxDecoder_t decoder;
+    ASSERT_TRUE(blackboxDecodeInit(&decoder, logData.data(), logData.size()));
+    const size_t frameDataSize = logData.size() - decoder.headerSize;
+    logData[decoder.headerSize + frameDataSize * 45 / 200] = 0xFF;
+
+    ASSERT_TRUE(blackboxDecodeInit(&decoder, logData.data(), logData.size()));
+    std::vector<uint32_t> decoded;
+    while (blackboxDecodeNextMainFrame(&decoder)) {
+        decoded.push_back(decoder.mainFrame[FIELD_ITERATION]);
+        expectFrameMatches(&decoder, decoder.mainFrame[FIELD_ITERATION]);
+    }
+
+    EXPECT_GT(decoder.corruptFrameCount, 0u);
+    EXPECT_LT(decoded.size(), logged.size());
+    // Frames from the next I frame on are decoded again
+    EXPECT_EQ(logged.back(), decoded.back());
+    EXPECT_NE(decoded.end(), std::find(decoded.begin(), decoded.end(), 64u));
+}
+
+/*
+ * S, G and H frames, laid out like the firmware ones. The G frame time is relative to the last main frame
+ * and the coordinates are relative to the home position of the last H frame.
+ */
+
+#define TEST_HOME_LAT   473977418
+#define TEST_HOME_LON   85455939
+
+static void writeOtherFrameHeaders(void)
+{
+    writeString("H Field S name:flightModeFlags,stateFlags,failsafePhase,rxSignalReceived,rxFlightChannelsValid\n");
+    writeFieldHeader('S', "signed", { 0, 0, 0, 0, 0 });
+    writeFieldHeader('S', "predictor", std::vector<int>(5, FLIGHT_LOG_FIELD_PREDICTOR_0));
+    writeFieldHeader('S', "encoding", {
+        FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB,
+        FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32, FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32, FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32
+    });
+    writeString("H Field G name:time,GPS_numSat,GPS_coord[0],GPS_coord[1]\n");
+    writeFieldHeader('G', "signed", { 0, 0, 1, 1 });
+    writeFieldHeader('G', "predictor", {
+        FLIGHT_LOG_FIELD_PREDICTOR_LAST_MAIN_FRAME_TIME, FLIGHT_LOG_FIELD_PREDICTOR_0,
+        FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD, FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD
+    });
+    writeFieldHeader('G', "encoding", {
+        FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB,
+        FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB
+    });
+    writeString("H Field H name:GPS_home[0],GPS_home[1]\n");
+    writeFieldHeader('H', "signed", { 1, 1 });
+    writeFieldHeader('H', "predictor", { FLIGHT_LOG_FIELD_PREDICTOR_0, FLIGHT_LOG_FIELD_PREDICTOR_0 });
+    writeFieldHeader('H', "encoding", { FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB, FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB });
+}
+
+static void writeGpsFrame(uint32_t time, uint32_t lastMainTime, int numSat, int32_t lat, int32_t lon)
+{
+    blackboxWrite('G');
+    blackboxWriteUnsignedVB(time - lastMainTime);
+    blackboxWriteUnsignedVB(numSat);
+    blackboxWriteSignedVB(lat - TEST_HOME_LAT);
+    blackboxWriteSignedVB(lon - TEST_HOME_LON);
+}
+
+TEST(BlackboxDecodeTest, TestSlowGpsAndHomeFrames)
+{
+    writePredictorHeader(1, 1);
+    writeOtherFrameHeaders();
+
+    const testState_t s0 = testState(0), s1 = testState(1);
+    writeIntra(&s0);
+    blackboxWrite('S');
+    blackboxWriteUnsignedVB(0x10004);
+    blackboxWriteUnsignedVB(3);
+    int32_t slowValues[3] = { 2, 1, 0 };
+    blackboxWriteTag2_3S32(slowValues);
+    blackboxWrite('H');
+    blackboxWriteSignedVB(TEST_HOME_LAT);
+    blackboxWriteSignedVB(TEST_HOME_LON);
+    writeGpsFrame(s0.time + 250, s0.time, 11, TEST_HOME_LAT + 1234, TEST_HOME_LON - 5678);
+    writeInter(&s1, &s0, &s0);
+    blackboxWrite('E');
+    blackboxWrite(FLIGHT_LOG_EVENT_FLIGHTMODE);
+    blackboxWriteUnsignedVB(5);
+    blackboxWriteUnsignedVB(1);
+    writeGpsFrame(s1.time + 100, s1.time, 12, TEST_HOME_LAT - 99999, TEST_HOME_LON + 99999);
+    writeLogEnd();
+
+    static blackboxDecoder_t decoder;
+    ASSERT_TRUE(blackboxDecodeInit(&decoder, logData.data(), logData.size()));
+
+    ASSERT_EQ('I', blackboxDecodeNextFrame(&decoder));
+    EXPECT_EQ(FIELD_COUNT, decoder.frameFieldCount);
+    EXPECT_EQ(s0.time, (uint32_t)decoder.frame[FIELD_TIME]);
+
+    ASSERT_EQ('S', blackboxDecodeNextFrame(&decoder));
+    ASSERT_EQ(5, decoder.frameFieldCount);
+    EXPECT_EQ(0x10004, decoder.frame[0]);
+    EXPECT_EQ(3, decoder.frame[1]);
+    EXPECT_EQ(2, decoder.frame[2]);
+    EXPECT_EQ(1, decoder.frame[3]);
+    EXPECT_EQ(0, decoder.frame[4]);
+
+    ASSERT_EQ('H', blackboxDecodeNextFrame(&decoder));
+    EXPECT_EQ(TEST_HOME_LAT, decoder.frame[0]);
+    EXPECT_EQ(TEST_HOME_LON, decoder.frame[1]);
+    EXPECT_TRUE(decoder.gpsHomeValid);
+
+    ASSERT_EQ('G', blackboxDecodeNextFrame(&decoder));
+    ASSERT_EQ(4, decoder.frameFieldCount);
+    EXPECT_EQ(s0.time + 250, (uint32_t)decoder.frame[0]);
+    EXPECT_EQ(11, decoder.frame[1]);
+    EXPECT_EQ(TEST_HOME_LAT + 1234, decoder.frame[2]);
+    EXPECT_EQ(TEST_HOME_LON - 5678, decoder.frame[3]);
+
+    ASSERT_EQ('P', blackboxDecodeNextFrame(&decoder));
+    EXPECT_EQ(s1.time, (uint32_t)decoder.frame[FIELD_TIME]);
+
+    ASSERT_EQ('E', blackboxDecodeNextFrame(&decoder));
+    EXPECT_EQ(FLIGHT_LOG_EVENT_FLIGHTMODE, decoder.event);
+    EXPECT_EQ(5, decoder.eventData[0]);
+    EXPECT_EQ(1, decoder.eventData[1]);
+
+    ASSERT_EQ('G', blackboxDecodeNextFrame(&decoder));
+    EXPECT_EQ(s1.time + 100, (uint32_t)decoder.frame[0]);
+    EXPECT_EQ(12, decoder.frame[1]);
+    EXPECT_EQ(TEST_HOME_LAT - 99999, decoder.frame[2]);
+    EXPECT_EQ(TEST_HOME_LON + 99999, decoder.frame[3]);
+
+    ASSERT_EQ('E', blackboxDecodeNextFrame(&decoder));
+    EXPECT_EQ(FLIGHT_LOG_EVENT_LOG_END, decoder.event);
+    EXPECT_EQ(1, decoder.eventData[0]);
+
+    EXPECT_EQ(BLACKBOX_DECODE_END_OF_LOG, blackboxDecodeNextFrame(&decoder));
+    EXPECT_EQ(1u, decoder.slowFrameCount);
+    EXPECT_EQ(2u, decoder.gpsFrameCount);
+    EXPECT_EQ(1u, decoder.gpsHomeFrameCount);
+    EXPECT_EQ(0u, decoder.corruptFrameCount);
+}
+
+TEST(BlackboxDecodeTest, TestMultipleLogs)
+{
+    // Three logs back to back like in a flash dump, the second one was cut off by a power loss
+    std::vector<uint8_t> dump;
+    std::vector<size_t> loggedCounts;
+    for (int i = 0; i < 3; i++) {
+        loggedCounts.push_back(writePredictorLog(100 + i * 50, 1, 1 + i).size());
+        if (i == 1) {
+            // No LOG_END event
+            logData.resize(logData.size() - (2 + strlen("End of log (disarm reason:1)") + 1));
+        }
+        dump.insert(dump.end(), logData.begin(), logData.end());
+    }
+
+    static blackboxDecoder_t decoder;
+    size_t offset = blackboxDecodeFindLog(dump.data(), dump.size(), 0);
+    EXPECT_EQ(0u, offset);
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT_LT(offset, dump.size());
+        ASSERT_TRUE(blackboxDecodeInit(&decoder, dump.data() + offset, dump.size() - offset));
+        EXPECT_EQ((uint32_t)(1 + i), decoder.frameIntervalPDenom);
+
+        size_t decoded = 0;
+        while (blackboxDecodeNextMainFrame(&decoder)) {
+            expectFrameMatches(&decoder, decoder.mainFrame[FIELD_ITERATION]);
+            decoded++;
+        }
+        EXPECT_EQ(loggedCounts[i], decoded) << "log " << i;
+        EXPECT_EQ(i == 1 ? 0u : 1u, decoder.eventCount) << "log " << i;
+
+        offset = blackboxDecodeFindLog(dump.data(), dump.size(), offset + decoder.pos);
+    }
+    EXPECT_EQ(dump.size(), offset);
+}
+
+/*
+ * Decode throughput over a memory mapped 100 MB log
+ */
+
+#define BENCHMARK_LOG_SIZE  (100 * 1024 * 1024)
+
+TEST(BlackboxDecodeTest, BenchmarkDecode)
+{
+    testState_t prev, prev2;
+    uint32_t iteration = 0;
+
+    logData.clear();
+    logData.reserve(BENCHMARK_LOG_SIZE + 1024);
+    writePredictorHeader(1, 2);
+    while (logData.size() < BENCHMARK_LOG_SIZE) {
+        const testState_t s = testState(iteration);
+        if (iteration % TEST_I_INTERVAL == 0) {
+            writeIntra(&s);
+            prev = prev2 = s;
+        } else if (shouldLogPFrame(iteration, 1, 2)) {
+            writeInter(&s, &prev, &prev2);
+            prev2 = prev;
+            prev = s;
+        }
+        iteration++;
+    }
+    writeLogEnd();
+
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(logData.size(), fwrite(logData.data(), 1, logData.size(), file));
+    fflush(file);
+    const size_t size = logData.size();
+    std::vector<uint8_t>().swap(logData);
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    ASSERT_NE(MAP_FAILED, map);
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    static blackboxDecoder_t decoder;
+    const auto begin = std::chrono::steady_clock::now();
+    ASSERT_TRUE(blackboxDecodeInit(&decoder, (const uint8_t *)map, size));
+    uint32_t lastIteration = 0;
+    while (blackboxDecodeNextMainFrame(&decoder)) {
+        lastIteration = decoder.mainFrame[FIELD_ITERATION];
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double seconds = std::chrono::duration<double>(end - begin).count();
+    const uint32_t frames = decoder.intraFrameCount + decoder.interFrameCount;
+    printf("[ BENCHMARK] %.1f MB, %u frames: %.1f MB/s, %.1f ns/frame\n",
+        size / 1e6, (unsigned)frames, size / 1e6 / seconds, seconds * 1e9 / frames);
+
+    EXPECT_TRUE(decoder.logEnded);
+    EXPECT_EQ(0u, decoder.corruptFrameCount);
+    EXPECT_EQ(iteration - 1 - (shouldLogPFrame(iteration - 1, 1, 2) ? 0 : 1), lastIteration);
+
+    munmap(map, size);
+    fclose(file);
+}
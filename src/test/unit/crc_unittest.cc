@@ -0,0 +1,214 @@
+/*
+ * This file is part of INAV.
+ *
+ * INAV is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * INAV is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with INAV.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+    #include "common/crc.h"
+    #include "common/streambuf.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define RANDOM_DATA_SIZE    1024
+
+// Size of the buffer checksummed by the benchmark, and how many times
+#define BENCHMARK_SIZE      4096
+#define BENCHMARK_ROUNDS    2000
+
+// The bitwise implementations the tables replaced
+static uint16_t referenceCrc16Ccitt(uint16_t crc, uint8_t a)
+{
+    crc ^= (uint16_t)a << 8;
+    for (int ii = 0; ii < 8; ++ii) {
+        if (crc & 0x8000) {
+            crc = (crc << 1) ^ 0x1021;
+        } else {
+            crc = crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint8_t referenceCrc8DvbS2(uint8_t crc, uint8_t a)
+{
+    crc ^= a;
+    for (int ii = 0; ii < 8; ++ii) {
+        if (crc & 0x80) {
+            crc = (crc << 1) ^ 0xD5;
+        } else {
+            crc = crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t referenceCrc16CcittUpdate(uint16_t crc, const uint8_t *data, uint32_t length)
+{
+    for (uint32_t ii = 0; ii < length; ii++) {
+        crc = referenceCrc16Ccitt(crc, data[ii]);
+    }
+    return crc;
+}
+
+static uint8_t referenceCrc8DvbS2Update(uint8_t crc, const uint8_t *data, uint32_t length)
+{
+    for (uint32_t ii = 0; ii < length; ii++) {
+        crc = referenceCrc8DvbS2(crc, data[ii]);
+    }
+    return crc;
+}
+
+static uint8_t referenceCrc8XorUpdate(uint8_t crc, const uint8_t *data, uint32_t length)
+{
+    for (uint32_t ii = 0; ii < length; ii++) {
+        crc ^= data[ii];
+    }
+    return crc;
+}
+
+static std::vector<uint8_t> randomData(uint32_t size)
+{
+    std::vector<uint8_t> data(size);
+    srand(size);
+    for (uint8_t &b : data) {
+        b = rand();
+    }
+    return data;
+}
+
+TEST(CrcUnittest, CheckValues)
+{
+    const char *check = "123456789";
+
+    // CRC-16/XMODEM and CRC-8/DVB-S2 check values
+    EXPECT_EQ(0x31C3, crc16_ccitt_update(0, check, strlen(check)));
+    EXPECT_EQ(0xBC, crc8_dvb_s2_update(0, check, strlen(check)));
+    EXPECT_EQ('1' ^ '2' ^ '3' ^ '4' ^ '5' ^ '6' ^ '7' ^ '8' ^ '9', crc8_xor_update(0, check, strlen(check)));
+}
+
+TEST(CrcUnittest, SingleByteMatchesBitwise)
+{
+    for (int crc = 0; crc <= 0xFFFF; crc += 0x0101) {
+        for (int a = 0; a <= 0xFF; a++) {
+            EXPECT_EQ(referenceCrc16Ccitt(crc, a), crc16_ccitt(crc, a));
+            EXPECT_EQ(referenceCrc8DvbS2(crc & 0xFF, a), crc8_dvb_s2(crc & 0xFF, a));
+        }
+    }
+}
+
+TEST(CrcUnittest, UpdateMatchesBitwise)
+{
+    const std::vector<uint8_t> data = randomData(RANDOM_DATA_SIZE);
+
+    // Every alignment and length, including the odd bytes around the words crc8_xor_update() reads
+    for (uint32_t offset = 0; offset < 8; offset++) {
+        for (uint32_t length = 0; offset + length <= 64; length++) {
+            const uint8_t *p = &data[offset];
+            EXPECT_EQ(referenceCrc16CcittUpdate(0x1234, p, length), crc16_ccitt_update(0x1234, p, length));
+            EXPECT_EQ(referenceCrc8DvbS2Update(0x5A, p, length), crc8_dvb_s2_update(0x5A, p, length));
+            EXPECT_EQ(referenceCrc8XorUpdate(0xA5, p, length), crc8_xor_update(0xA5, p, length));
+        }
+    }
+
+    EXPECT_EQ(referenceCrc16CcittUpdate(0, &data[1], RANDOM_DATA_SIZE - 1), crc16_ccitt_update(0, &data[1], RANDOM_DATA_SIZE - 1));
+    EXPECT_EQ(referenceCrc8DvbS2Update(0, &data[1], RANDOM_DATA_SIZE - 1), crc8_dvb_s2_update(0, &data[1], RANDOM_DATA_SIZE - 1));
+    EXPECT_EQ(referenceCrc8XorUpdate(0, &data[1], RANDOM_DATA_SIZE - 1), crc8_xor_update(0, &data[1], RANDOM_DATA_SIZE - 1));
+}
+
+TEST(CrcUnittest, SbufAppend)
+{
+    const std::vector<uint8_t> data = randomData(64);
+    uint8_t buf[80];
+    sbuf_t sbuf;
+
+    sbuf.ptr = buf;
+    sbuf.end = buf + sizeof(buf);
+    sbufWriteData(&sbuf, data.data(), data.size());
+    crc16_ccitt_sbuf_append(&sbuf, buf);
+    const uint16_t crc16 = referenceCrc16CcittUpdate(0, data.data(), data.size());
+    EXPECT_EQ(crc16 & 0xFF, buf[64]);
+    EXPECT_EQ(crc16 >> 8, buf[65]);
+
+    sbuf.ptr = buf;
+    sbufWriteData(&sbuf, data.data(), data.size());
+    crc8_dvb_s2_sbuf_append(&sbuf, buf);
+    EXPECT_EQ(referenceCrc8DvbS2Update(0, data.data(), data.size()), buf[64]);
+
+    sbuf.ptr = buf;
+    sbufWriteData(&sbuf, data.data(), data.size());
+    crc8_xor_sbuf_append(&sbuf, buf);
+    EXPECT_EQ(referenceCrc8XorUpdate(0, data.data(), data.size()), buf[64]);
+}
+
+template <typename T, typename F>
+static double benchmarkMBps(F fn, const uint8_t *data, T *result)
+{
+    T crc = 0;
+    const auto begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCHMARK_ROUNDS; round++) {
+        crc = fn(crc, data, BENCHMARK_SIZE);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    *result = crc;
+    return (double)BENCHMARK_SIZE * BENCHMARK_ROUNDS / seconds / (1024 * 1024);
+}
+
+static uint16_t crc16CcittUpdate(uint16_t crc, const uint8_t *data, uint32_t length)
+{
+    return crc16_ccitt_update(crc, data, length);
+}
+
+static uint8_t crc8DvbS2Update(uint8_t crc, const uint8_t *data, uint32_t length)
+{
+    return crc8_dvb_s2_update(crc, data, length);
+}
+
+static uint8_t crc8XorUpdate(uint8_t crc, const uint8_t *data, uint32_t length)
+{
+    return crc8_xor_update(crc, data, length);
+}
+
+TEST(CrcBenchmark, BenchmarkThroughput)
+{
+    const std::vector<uint8_t> data = randomData(BENCHMARK_SIZE);
+    uint16_t crc16Reference, crc16;
+    uint8_t crc8Reference, crc8;
+
+    double reference = benchmarkMBps(referenceCrc16CcittUpdate, data.data(), &crc16Reference);
+    double current = benchmarkMBps(crc16CcittUpdate, data.data(), &crc16);
+    EXPECT_EQ(crc16Reference, crc16);
+    printf("[ BENCHMARK] crc16_ccitt:  bitwise %7.1f MB/s, current %7.1f MB/s (%.1fx)\n", reference, current, current / reference);
+
+    reference = benchmarkMBps(referenceCrc8DvbS2Update, data.data(), &crc8Reference);
+    current = benchmarkMBps(crc8DvbS2Update, data.data(), &crc8);
+    EXPECT_EQ(crc8Reference, crc8);
+    printf("[ BENCHMARK] crc8_dvb_s2:  bitwise %7.1f MB/s, current %7.1f MB/s (%.1fx)\n", reference, current, current / reference);
+
+    reference = benchmarkMBps(referenceCrc8XorUpdate, data.data(), &crc8Reference);
+    current = benchmarkMBps(crc8XorUpdate, data.data(), &crc8);
+    EXPECT_EQ(crc8Reference, crc8);
+    printf("[ BENCHMARK] crc8_xor:     bytewise %6.1f MB/s, current %7.1f MB/s (%.1fx)\n", reference, current, current / reference);
+}
@@ -0,0 +1,192 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+    #include "common/crc.h"
+    #include "common/maths.h"
+    #include "common/streambuf.h"
+    #include "drivers/serial.h"
+    #include "fc/fc_msp_dataflash.h"
+    #include "io/flashfs.h"
+    #include "msp/msp.h"
+    #include "msp/msp_protocol_v2_inav.h"
+    #include "msp/msp_serial.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define LOG_SIZE 5000
+
+static uint8_t flashData[LOG_SIZE];
+static bool ringMode;
+
+static serialPort_t *streamPort;
+static uint16_t streamCmd;
+static mspStreamFnPtr streamFn;
+
+extern "C" {
+    uint32_t flashfsGetOffset(void)
+    {
+        return LOG_SIZE;
+    }
+
+    int flashfsReadAbs(uint32_t address, uint8_t *buffer, unsigned int len)
+    {
+        len = MIN(len, LOG_SIZE - address);
+        memcpy(buffer, &flashData[address], len);
+
+        return len;
+    }
+
+    bool flashfsIsRingMode(void)
+    {
+        return ringMode;
+    }
+
+    bool mspSerialStartStream(const serialPort_t *serialPort, uint16_t cmd, mspStreamFnPtr fn)
+    {
+        streamPort = (serialPort_t *) serialPort;
+        streamCmd = cmd;
+        streamFn = fn;
+
+        return serialPort != NULL;
+    }
+}
+
+class DataflashStreamTest : public ::testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        for (int i = 0; i < LOG_SIZE; i++) {
+            flashData[i] = i * 7 + (i >> 8);
+        }
+
+        ringMode = false;
+        streamPort = NULL;
+        streamCmd = 0;
+        streamFn = NULL;
+        postProcessFn = NULL;
+    }
+
+    // Run the command with the given request, returns its result like mspFcProcessCommand() would
+    mspResult_e runCommand(const std::vector<uint8_t> &request, uint8_t cmdFlags)
+    {
+        std::vector<uint8_t> in(request);
+        sbuf_t src = { .ptr = in.data(), .end = in.data() + in.size() };
+        sbuf_t dst = { .ptr = reply, .end = reply + sizeof(reply) };
+
+        const bool ok = mspFcDataflashStreamCommand(&dst, &src, cmdFlags, &postProcessFn);
+        replyLength = dst.ptr - reply;
+
+        return ok ? MSP_RESULT_ACK : MSP_RESULT_ERROR;
+    }
+
+    uint8_t reply[64];
+    int replyLength;
+    mspPostProcessFnPtr postProcessFn;
+};
+
+static std::vector<uint8_t> streamRequest(uint32_t address, uint32_t length, uint16_t chunkSize, uint8_t flags)
+{
+    std::vector<uint8_t> request(11);
+
+    memcpy(&request[0], &address, sizeof(address));
+    memcpy(&request[4], &length, sizeof(length));
+    memcpy(&request[8], &chunkSize, sizeof(chunkSize));
+    request[10] = flags;
+
+    return request;
+}
+
+TEST_F(DataflashStreamTest, TestStreamsChunksWithCrcToTheEndOfTheLog)
+{
+    ASSERT_EQ(MSP_RESULT_ACK, runCommand(streamRequest(1000, 0, 512, DATAFLASH_STREAM_FLAG_CRC), MSP_FLAG_CAN_STREAM));
+
+    // The reply says what will be sent
+    ASSERT_EQ(11, replyLength);
+    uint32_t address, endAddress;
+    memcpy(&address, &reply[0], sizeof(address));
+    memcpy(&endAddress, &reply[4], sizeof(endAddress));
+    EXPECT_EQ(1000u, address);
+    EXPECT_EQ((uint32_t) LOG_SIZE, endAddress);
+
+    // The stream is attached to the port once the reply has gone out
+    ASSERT_TRUE(postProcessFn != NULL);
+    serialPort_t port;
+    postProcessFn(&port);
+    EXPECT_EQ(&port, streamPort);
+    EXPECT_EQ(MSP2_INAV_DATAFLASH_STREAM, streamCmd);
+    ASSERT_TRUE(streamFn != NULL);
+
+    uint32_t expectedAddress = 1000;
+    uint8_t frame[600];
+
+    for (int chunks = 0; chunks < 100; chunks++) {
+        mspPacket_t packet;
+        sbufInit(&packet.buf, frame, frame + sizeof(frame));
+
+        const bool more = streamFn(&packet);
+        const int frameLength = packet.buf.ptr - frame;
+
+        uint32_t chunkAddress;
+        memcpy(&chunkAddress, &frame[0], sizeof(chunkAddress));
+        EXPECT_EQ(expectedAddress, chunkAddress);
+
+        const int dataLength = frameLength - 4 - 2;
+        ASSERT_GE(dataLength, 0);
+        EXPECT_LE(dataLength, 512);
+        EXPECT_EQ(0, memcmp(&frame[4], &flashData[chunkAddress], dataLength));
+
+        uint16_t crc;
+        memcpy(&crc, &frame[4 + dataLength], sizeof(crc));
+        EXPECT_EQ(crc16_ccitt_update(0, &flashData[chunkAddress], dataLength), crc);
+
+        expectedAddress += dataLength;
+
+        if (!more) {
+            // An empty chunk marks the end
+            EXPECT_EQ(0, dataLength);
+            break;
+        }
+    }
+
+    EXPECT_EQ((uint32_t) LOG_SIZE, expectedAddress);
+}
+
+TEST_F(DataflashStreamTest, TestRefusesWhenTheStreamCantStart)
+{
+    // MSP over telemetry has no port to stream on
+    EXPECT_EQ(MSP_RESULT_ERROR, runCommand(streamRequest(0, 0, 512, 0), 0));
+    EXPECT_TRUE(postProcessFn == NULL);
+    EXPECT_EQ(0, replyLength);
+
+    // After a wrap, the flash from the start up to the tail isn't in the order it was logged
+    ringMode = true;
+    EXPECT_EQ(MSP_RESULT_ERROR, runCommand(streamRequest(0, 0, 512, 0), MSP_FLAG_CAN_STREAM));
+    EXPECT_TRUE(postProcessFn == NULL);
+    EXPECT_EQ(0, replyLength);
+
+    // An empty request only stops a running stream, which always works
+    EXPECT_EQ(MSP_RESULT_ACK, runCommand(std::vector<uint8_t>(), 0));
+}
@@ -0,0 +1,304 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// platform.h comes from the SITL target here, not from the test dir, matching the generated settings
+extern "C" {
+    #include "../../main/platform.h"
+    #include "common/streambuf.h"
+    #include "config/parameter_group.h"
+    #include "fc/config.h"
+    #include "fc/fc_msp_settings.h"
+    #include "fc/settings.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// Big enough for any parameter group, including every profile of the profile groups
+#define PG_STORAGE_SIZE 0x10000
+
+// Zeroed storage for each parameter group a test touches
+static std::map<pgn_t, std::vector<uint8_t> > pgStorage;
+static std::map<pgn_t, pgRegistry_t> pgRegistry;
+
+static mspResult_e commandResult(bool ok)
+{
+    return ok ? MSP_RESULT_ACK : MSP_RESULT_ERROR;
+}
+
+static mspResult_e commandResult(mspResult_e result)
+{
+    return result;
+}
+
+class MspSettingsTest : public ::testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        pgStorage.clear();
+        pgRegistry.clear();
+    }
+
+    // Run the command with the given request, returns its result like mspFcProcessCommand() would
+    template <typename T>
+    mspResult_e runCommand(T (*fn)(sbuf_t *dst, sbuf_t *src), const std::vector<uint8_t> &request, size_t replySize = sizeof(reply))
+    {
+        std::vector<uint8_t> in(request);
+        sbuf_t src = { .ptr = in.data(), .end = in.data() + in.size() };
+        sbuf_t dst = { .ptr = reply, .end = reply + replySize };
+
+        const mspResult_e result = commandResult(fn(&dst, &src));
+        replyLength = dst.ptr - reply;
+
+        return result;
+    }
+
+    uint8_t reply[1024];
+    int replyLength;
+};
+
+// Returns the index of the first directly valued setting of the given type with room above its maximum
+static uint16_t findSetting(setting_type_e type, setting_max_t below)
+{
+    for (unsigned ii = 0; ii < SETTINGS_TABLE_COUNT; ii++) {
+        const setting_t *setting = setting_get_by_index(ii);
+        if (SETTING_TYPE(setting) == type && SETTING_MODE(setting) == MODE_DIRECT &&
+            setting_get_max(setting) > 0 && setting_get_max(setting) < below) {
+            return ii;
+        }
+    }
+    ADD_FAILURE() << "No setting of type " << type;
+    return 0;
+}
+
+template <typename T>
+static void appendValue(std::vector<uint8_t> &request, T value)
+{
+    const uint8_t *bytes = (const uint8_t *)&value;
+    request.insert(request.end(), bytes, bytes + sizeof(value));
+}
+
+template <typename T>
+static T &settingValue(uint16_t index)
+{
+    return *(T *)setting_get_value_pointer(setting_get_by_index(index));
+}
+
+TEST_F(MspSettingsTest, TestSetSettingsAppliesEveryValue)
+{
+    const uint16_t u8 = findSetting(VAR_UINT8, UINT8_MAX);
+    const uint16_t i16 = findSetting(VAR_INT16, INT16_MAX);
+    const uint16_t f = findSetting(VAR_FLOAT, 1e6);
+
+    const setting_t *i16Setting = setting_get_by_index(i16);
+    const setting_t *fSetting = setting_get_by_index(f);
+    const int16_t i16Value = setting_get_min(i16Setting);
+    const float fValue = ((float)setting_get_min(fSetting) + setting_get_max(fSetting)) / 2;
+
+    std::vector<uint8_t> request;
+    appendValue(request, u8);
+    appendValue(request, (uint8_t)setting_get_max(setting_get_by_index(u8)));
+    appendValue(request, i16);
+    appendValue(request, i16Value);
+    appendValue(request, f);
+    appendValue(request, fValue);
+
+    EXPECT_EQ(MSP_RESULT_ACK, runCommand(mspFcSetSettingsCommand, request));
+    EXPECT_EQ(0, replyLength);
+
+    EXPECT_EQ(setting_get_max(setting_get_by_index(u8)), settingValue<uint8_t>(u8));
+    EXPECT_EQ(i16Value, settingValue<int16_t>(i16));
+    EXPECT_EQ(fValue, settingValue<float>(f));
+
+    // The values read back with MSP2_COMMON_SETTINGS in the requested order
+    std::vector<uint8_t> indexes;
+    appendValue(indexes, f);
+    appendValue(indexes, u8);
+    EXPECT_EQ(MSP_RESULT_ACK, runCommand(mspFcSettingsCommand, indexes));
+    ASSERT_EQ((int)(sizeof(float) + sizeof(uint8_t)), replyLength);
+    EXPECT_EQ(0, memcmp(reply, &fValue, sizeof(fValue)));
+    EXPECT_EQ(setting_get_max(setting_get_by_index(u8)), reply[sizeof(float)]);
+}
+
+TEST_F(MspSettingsTest, TestSetSettingsChangesNothingUnlessEveryValueIsValid)
+{
+    const uint16_t u8 = findSetting(VAR_UINT8, UINT8_MAX);
+    const uint16_t i16 = findSetting(VAR_INT16, INT16_MAX);
+    const uint8_t u8Max = setting_get_max(setting_get_by_index(u8));
+    const int16_t i16Max = setting_get_max(setting_get_by_index(i16));
+
+    settingValue<uint8_t>(u8) = 0;
+    settingValue<int16_t>(i16) = 0;
+
+    // Only the last value is out of range
+    std::vector<uint8_t> request;
+    appendValue(request, u8);
+    appendValue(request, u8Max);
+    appendValue(request, i16);
+    appendValue(request, (int16_t)(i16Max + 1));
+
+    EXPECT_EQ(MSP_RESULT_ERROR, runCommand(mspFcSetSettingsCommand, request));
+    EXPECT_EQ(0, settingValue<uint8_t>(u8));
+    EXPECT_EQ(0, settingValue<int16_t>(i16));
+
+    // The last value is cut short
+    request.resize(request.size() - 1);
+    EXPECT_EQ(MSP_RESULT_ERROR, runCommand(mspFcSetSettingsCommand, request));
+    EXPECT_EQ(0, settingValue<uint8_t>(u8));
+    EXPECT_EQ(0, settingValue<int16_t>(i16));
+
+    // The last index doesn't exist
+    request.resize(3);
+    appendValue(request, (uint16_t)SETTINGS_TABLE_COUNT);
+    appendValue(request, (uint8_t)0);
+    EXPECT_EQ(MSP_RESULT_ERROR, runCommand(mspFcSetSettingsCommand, request));
+    EXPECT_EQ(0, settingValue<uint8_t>(u8));
+}
+
+TEST_F(MspSettingsTest, TestSettingsRefusesWhatItCantReturn)
+{
+    std::vector<uint8_t> request;
+    appendValue(request, (uint16_t)0);
+    appendValue(request, (uint16_t)SETTINGS_TABLE_COUNT);
+    EXPECT_EQ(MSP_RESULT_ERROR, runCommand(mspFcSettingsCommand, request));
+
+    // Every value must fit in the reply
+    request.resize(2);
+    EXPECT_EQ(MSP_RESULT_ACK, runCommand(mspFcSettingsCommand, request));
+    const int size = replyLength;
+    appendValue(request, (uint16_t)0);
+    EXPECT_EQ(MSP_RESULT_RETRY, runCommand(mspFcSettingsCommand, request, size * 2 - 1));
+}
+
+TEST_F(MspSettingsTest, TestAsksForALargerBufferWhenTheReplyDoesntFit)
+{
+    // The direct MSP path replies into the free TX space, which can be as small as 32 bytes
+    const size_t smallReply = 32;
+
+    // 64 floats, more than a UART TX buffer holds
+    const uint16_t f = findSetting(VAR_FLOAT, 1e6);
+    std::vector<uint8_t> request;
+    for (int ii = 0; ii < 64; ii++) {
+        appendValue(request, f);
+    }
+
+    EXPECT_EQ(MSP_RESULT_RETRY, runCommand(mspFcSettingsCommand, request, smallReply));
+    EXPECT_EQ(MSP_RESULT_ACK, runCommand(mspFcSettingsCommand, request));
+    EXPECT_EQ(64 * (int)sizeof(float), replyLength);
+
+    // Setting info only needs room for one setting, clients ask again for the rest
+    std::vector<uint8_t> first;
+    appendValue(first, (uint16_t)0);
+    EXPECT_EQ(MSP_RESULT_ACK, runCommand(mspFcSettingInfoCommand, first, smallReply));
+    EXPECT_EQ(MSP_RESULT_RETRY, runCommand(mspFcSettingInfoCommand, first, sizeof(uint16_t) + 4));
+}
+
+TEST_F(MspSettingsTest, TestSettingInfoEnumeratesEverySetting)
+{
+    uint16_t index = 0;
+    int requests = 0;
+
+    while (index < SETTINGS_TABLE_COUNT) {
+        std::vector<uint8_t> request;
+        appendValue(request, index);
+        ASSERT_EQ(MSP_RESULT_ACK, runCommand(mspFcSettingInfoCommand, request, 256));
+        requests++;
+
+        sbuf_t buf = { .ptr = reply, .end = reply + replyLength };
+        EXPECT_EQ(SETTINGS_TABLE_COUNT, sbufReadU16(&buf));
+        ASSERT_GT(sbufBytesRemaining(&buf), 0) << "No room for setting " << index;
+
+        while (sbufBytesRemaining(&buf) > 0) {
+            const setting_t *setting = setting_get_by_index(index);
+            char name[SETTING_MAX_NAME_LENGTH];
+            setting_get_name(setting, name);
+
+            EXPECT_EQ(index, sbufReadU16(&buf));
+            EXPECT_STREQ(name, (const char *)sbufPtr(&buf));
+            sbufAdvance(&buf, strlen(name) + 1);
+            EXPECT_EQ(setting->type, sbufReadU8(&buf));
+            EXPECT_EQ((int32_t)setting_get_min(setting), (int32_t)sbufReadU32(&buf));
+            EXPECT_EQ(setting_get_max(setting), sbufReadU32(&buf));
+            index++;
+        }
+    }
+
+    EXPECT_EQ(SETTINGS_TABLE_COUNT, index);
+    EXPECT_GT(requests, 1);
+
+    // Past the end there's only the count
+    std::vector<uint8_t> request;
+    appendValue(request, index);
+    EXPECT_EQ(MSP_RESULT_ACK, runCommand(mspFcSettingInfoCommand, request));
+    EXPECT_EQ((int)sizeof(uint16_t), replyLength);
+}
+
+TEST_F(MspSettingsTest, TestSettingByName)
+{
+    const uint16_t u8 = findSetting(VAR_UINT8, UINT8_MAX);
+    const uint8_t u8Max = setting_get_max(setting_get_by_index(u8));
+
+    char name[SETTING_MAX_NAME_LENGTH];
+    setting_get_name(setting_get_by_index(u8), name);
+
+    std::vector<uint8_t> request(name, name + strlen(name) + 1);
+    request.push_back(u8Max + 1);
+    EXPECT_EQ(MSP_RESULT_ERROR, runCommand(mspFcSetSettingCommand, request));
+    EXPECT_EQ(0, settingValue<uint8_t>(u8));
+
+    request.back() = u8Max;
+    EXPECT_EQ(MSP_RESULT_ACK, runCommand(mspFcSetSettingCommand, request));
+
+    request.pop_back();
+    EXPECT_EQ(MSP_RESULT_ACK, runCommand(mspFcSettingCommand, request));
+    ASSERT_EQ(1, replyLength);
+    EXPECT_EQ(u8Max, reply[0]);
+
+    const std::vector<uint8_t> unknown = { 'x', '\0' };
+    EXPECT_EQ(MSP_RESULT_ERROR, runCommand(mspFcSettingCommand, unknown));
+}
+
+// STUBS
+
+extern "C" {
+
+const pgRegistry_t *pgFind(pgn_t pgn)
+{
+    std::vector<uint8_t> &storage = pgStorage[pgn];
+    storage.resize(PG_STORAGE_SIZE);
+
+    pgRegistry_t &reg = pgRegistry[pgn];
+    reg.pgn = pgn;
+    reg.address = storage.data();
+    reg.copy = storage.data();
+
+    return &reg;
+}
+
+uint8_t getConfigProfile(void)
+{
+    return 0;
+}
+
+}
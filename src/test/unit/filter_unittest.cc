@@ -0,0 +1,306 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+#include <chrono>
+
+extern "C" {
+    #include "platform.h"
+    #include "common/axis.h"
+    #include "common/filter.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// 1kHz gyro loop, 90Hz soft LPF and two notches as in the default gyro setup
+#define TEST_SAMPLING_INTERVAL_US   1000
+
+static void initReferenceFilters(biquadFilter_t filters[3][XYZ_AXIS_COUNT])
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        biquadFilterInitLPF(&filters[0][axis], 90, TEST_SAMPLING_INTERVAL_US);
+        biquadFilterInitNotch(&filters[1][axis], TEST_SAMPLING_INTERVAL_US, 200, 150);
+        biquadFilterInitNotch(&filters[2][axis], TEST_SAMPLING_INTERVAL_US, 320, 250);
+    }
+}
+
+static void initCascade(biquadCascadeXYZ_t *cascade, biquadFilter_t filters[3][XYZ_AXIS_COUNT], int stageCount)
+{
+    biquadCascadeXYZInit(cascade);
+    for (int stage = 0; stage < stageCount; stage++) {
+        EXPECT_TRUE(biquadCascadeXYZAddStage(cascade, &filters[stage][0]));
+    }
+}
+
+// Gyro like input: a slow stick movement plus motor noise, different per axis
+static float testSample(int n, int axis)
+{
+    const float t = n * TEST_SAMPLING_INTERVAL_US * 1e-6f;
+    return 200.0f * sinf(2 * M_PIf * 3 * t + axis) + 40.0f * sinf(2 * M_PIf * (180 + 70 * axis) * t) + 10.0f * cosf(2 * M_PIf * 410 * t);
+}
+
+TEST(FilterUnittest, TestBiquadCascadeMatchesBiquadFilters)
+{
+    for (int stageCount = 1; stageCount <= 3; stageCount++) {
+        biquadFilter_t reference[3][XYZ_AXIS_COUNT];
+        biquadCascadeXYZ_t cascade;
+        initReferenceFilters(reference);
+        initCascade(&cascade, reference, stageCount);
+
+        for (int n = 0; n < 5000; n++) {
+            float values[XYZ_AXIS_COUNT];
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                values[axis] = testSample(n, axis);
+            }
+
+            float expected[XYZ_AXIS_COUNT];
+            float expectedFirstStage[XYZ_AXIS_COUNT];
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                expected[axis] = values[axis];
+                for (int stage = 0; stage < stageCount; stage++) {
+                    expected[axis] = biquadFilterApply(&reference[stage][axis], expected[axis]);
+                    if (stage == 0) {
+                        expectedFirstStage[axis] = expected[axis];
+                    }
+                }
+            }
+
+            biquadCascadeXYZApply(&cascade, values);
+
+            // Direct form I vs transposed direct form II, only rounding differs
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                ASSERT_NEAR(expected[axis], values[axis], 1e-2f) << "stages " << stageCount << " sample " << n;
+                ASSERT_NEAR(expectedFirstStage[axis], biquadCascadeXYZStageOutput(&cascade, 0, axis), 1e-2f);
+            }
+        }
+    }
+}
+
+TEST(FilterUnittest, TestBiquadCascadeWithoutStagesPassesThrough)
+{
+    biquadCascadeXYZ_t cascade;
+    biquadCascadeXYZInit(&cascade);
+
+    float values[XYZ_AXIS_COUNT] = { 1.5f, -2.0f, 300.0f };
+    biquadCascadeXYZApply(&cascade, values);
+
+    EXPECT_FLOAT_EQ(1.5f, values[X]);
+    EXPECT_FLOAT_EQ(-2.0f, values[Y]);
+    EXPECT_FLOAT_EQ(300.0f, values[Z]);
+}
+
+TEST(FilterUnittest, TestBiquadCascadeRejectsExtraStages)
+{
+    biquadFilter_t reference[3][XYZ_AXIS_COUNT];
+    biquadCascadeXYZ_t cascade;
+    initReferenceFilters(reference);
+    initCascade(&cascade, reference, BIQUAD_CASCADE_MAX_STAGES);
+
+    EXPECT_FALSE(biquadCascadeXYZAddStage(&cascade, &reference[0][0]));
+    EXPECT_EQ(BIQUAD_CASCADE_MAX_STAGES, cascade.stageCount);
+}
+
+// Coefficients straight from the RBJ cookbook in double precision
+static void referenceBiquadCoefficients(double coeffs[5], double filterFreq, uint32_t samplingIntervalUs, double Q, biquadFilterType_e filterType)
+{
+    const double omega = 2 * M_PI * filterFreq * samplingIntervalUs * 1e-6;
+    const double sn = sin(omega);
+    const double cs = cos(omega);
+    const double alpha = sn / (2 * Q);
+    const double a0 = 1 + alpha;
+
+    if (filterType == FILTER_LPF) {
+        coeffs[0] = (1 - cs) / 2 / a0;
+        coeffs[1] = (1 - cs) / a0;
+        coeffs[2] = (1 - cs) / 2 / a0;
+    } else {
+        coeffs[0] = 1 / a0;
+        coeffs[1] = -2 * cs / a0;
+        coeffs[2] = 1 / a0;
+    }
+    coeffs[3] = -2 * cs / a0;
+    coeffs[4] = (1 - alpha) / a0;
+}
+
+// Numerator of a low pass is tiny at low cutoffs and checked relative, everything else absolute
+static void expectCoefficientsNear(const double expected[5], const biquadFilter_t *filter, bool relativeNumerator)
+{
+    const float actual[5] = { filter->b0, filter->b1, filter->b2, filter->a1, filter->a2 };
+    for (int i = 0; i < 5; i++) {
+        const double tolerance = (relativeNumerator && i < 3) ? fabs(expected[i]) * 1e-3 : 2.5e-4;
+        EXPECT_NEAR(expected[i], actual[i], tolerance) << "coefficient " << i;
+    }
+}
+
+TEST(FilterUnittest, TestCoeffTableMatchesTrigonometry)
+{
+    static const uint32_t samplingIntervals[] = { 125, 250, 500, 1000, 2000 };
+    filterCoeffTable_t table;
+
+    for (uint32_t samplingIntervalUs : samplingIntervals) {
+        filterCoeffTableInit(&table, samplingIntervalUs);
+        const int nyquist = 1000000 / samplingIntervalUs / 2;
+
+        for (int filterFreq = 1; filterFreq < nyquist; filterFreq += 7) {
+            double expected[5];
+            biquadFilter_t filter;
+
+            referenceBiquadCoefficients(expected, filterFreq, samplingIntervalUs, 0.7071, FILTER_LPF);
+            biquadFilterUpdateFromTable(&filter, &table, filterFreq, 0.7071f, FILTER_LPF);
+            expectCoefficientsNear(expected, &filter, true);
+
+            referenceBiquadCoefficients(expected, filterFreq, samplingIntervalUs, 1.2, FILTER_NOTCH);
+            biquadFilterUpdateFromTable(&filter, &table, filterFreq, 1.2f, FILTER_NOTCH);
+            expectCoefficientsNear(expected, &filter, false);
+        }
+    }
+}
+
+TEST(FilterUnittest, TestCoeffTablePassesThroughAboveNyquist)
+{
+    filterCoeffTable_t table;
+    biquadFilter_t filter;
+    filterCoeffTableInit(&table, 1000);
+
+    biquadFilterUpdateFromTable(&filter, &table, 500, 1.0f, FILTER_NOTCH);
+    EXPECT_FLOAT_EQ(1.0f, filter.b0);
+    EXPECT_FLOAT_EQ(0.0f, filter.b1);
+    EXPECT_FLOAT_EQ(0.0f, filter.a1);
+}
+
+TEST(FilterUnittest, TestCoeffTableUpdateKeepsState)
+{
+    filterCoeffTable_t table;
+    biquadFilter_t filter;
+    filterCoeffTableInit(&table, 1000);
+    biquadFilterInit(&filter, 200, 1000, 1.0f, FILTER_NOTCH);
+
+    for (int n = 0; n < 10; n++) {
+        biquadFilterApply(&filter, 10.0f);
+    }
+    const float d1 = filter.d1;
+    const float d2 = filter.d2;
+
+    biquadFilterUpdateFromTable(&filter, &table, 210, 1.0f, FILTER_NOTCH);
+    EXPECT_FLOAT_EQ(d1, filter.d1);
+    EXPECT_FLOAT_EQ(d2, filter.d2);
+}
+
+TEST(FilterUnittest, TestPt1FollowsCutoffChanges)
+{
+    const float dT = 0.001f;
+    pt1Filter_t filter;
+    memset(&filter, 0, sizeof(filter));
+
+    pt1FilterApply4(&filter, 1.0f, 10, dT);
+    EXPECT_NEAR(pt1FilterGain(10, dT), filter.state, 1e-6f);
+
+    // A changed cutoff takes effect on the next call
+    pt1FilterReset(&filter, 0);
+    pt1FilterApply4(&filter, 1.0f, 50, dT);
+    EXPECT_NEAR(pt1FilterGain(50, dT), filter.state, 1e-6f);
+
+    // Same gain as the RC form
+    const float RC = 1.0f / (2.0f * M_PIf * 50);
+    EXPECT_NEAR(dT / (RC + dT), pt1FilterGain(50, dT), 1e-6f);
+}
+
+TEST(FilterUnittest, TestPt1FollowsMeasuredDt)
+{
+    const float RC = 1.0f / (2.0f * M_PIf * 20);
+    pt1Filter_t filter;
+    memset(&filter, 0, sizeof(filter));
+    float expected = 0;
+
+    // Callers pass a measured dT which jitters from call to call
+    for (int n = 0; n < 100; n++) {
+        const float dT = 0.001f + (n % 7) * 0.0001f;
+        const float input = (n & 1) ? 1.0f : -1.0f;
+
+        expected = expected + dT / (RC + dT) * (input - expected);
+        EXPECT_NEAR(expected, pt1FilterApply4(&filter, input, 20, dT), 1e-5f);
+    }
+}
+
+TEST(FilterUnittest, BenchmarkCoefficientUpdate)
+{
+    const int loops = 1000000;
+    filterCoeffTable_t table;
+    biquadFilter_t filter;
+    biquadFilterInit(&filter, 200, 1000, 1.0f, FILTER_NOTCH);
+    filterCoeffTableInit(&table, 1000);
+    volatile float sink = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int n = 0; n < loops; n++) {
+        biquadFilterUpdate(&filter, 100 + (n & 0xFF), 1000, 1.0f, FILTER_NOTCH);
+        sink = filter.b1;
+    }
+    const double trigNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / loops;
+
+    begin = std::chrono::steady_clock::now();
+    for (int n = 0; n < loops; n++) {
+        biquadFilterUpdateFromTable(&filter, &table, 100 + (n & 0xFF), 1.0f, FILTER_NOTCH);
+        sink = filter.b1;
+    }
+    const double tableNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / loops;
+
+    UNUSED(sink);
+    printf("[ BENCHMARK] biquad coefficient update: trigonometry %6.1f ns, table %6.1f ns\n", trigNs, tableNs);
+}
+
+TEST(FilterUnittest, BenchmarkGyroFilterChain)
+{
+    const int loops = 1000000;
+    biquadFilter_t reference[3][XYZ_AXIS_COUNT];
+    biquadCascadeXYZ_t cascade;
+    initReferenceFilters(reference);
+    initCascade(&cascade, reference, 3);
+
+    // Per axis function pointer calls, the way gyroUpdate() used to filter
+    filterApplyFnPtr applyFn[3] = { (filterApplyFnPtr)biquadFilterApply, (filterApplyFnPtr)biquadFilterApply, (filterApplyFnPtr)biquadFilterApply };
+    volatile float sink = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int n = 0; n < loops; n++) {
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            float value = (float)(n & 0xFF) + axis;
+            for (int stage = 0; stage < 3; stage++) {
+                value = applyFn[stage](&reference[stage][axis], value);
+            }
+            sink = value;
+        }
+    }
+    const double referenceNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / loops;
+
+    begin = std::chrono::steady_clock::now();
+    for (int n = 0; n < loops; n++) {
+        float values[XYZ_AXIS_COUNT] = { (float)(n & 0xFF), (float)(n & 0xFF) + 1, (float)(n & 0xFF) + 2 };
+        biquadCascadeXYZApply(&cascade, values);
+        sink = values[Z];
+    }
+    const double cascadeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / loops;
+
+    UNUSED(sink);
+    printf("[ BENCHMARK] 3 axis, 3 stages: function pointers %6.1f ns/sample, cascade %6.1f ns/sample\n", referenceNs, cascadeNs);
+}
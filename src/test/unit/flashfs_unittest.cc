@@ -0,0 +1,589 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+    #include "drivers/flash.h"
+    #include "drivers/flash_m25p16.h"
+    #include "io/flashfs.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define SIM_SECTOR_SIZE     (64 * 1024)
+#define SIM_SECTORS         32
+#define SIM_TOTAL_SIZE      (SIM_SECTOR_SIZE * SIM_SECTORS)
+
+// The last sector holds the journal
+#define SIM_LOG_SIZE        (SIM_TOTAL_SIZE - SIM_SECTOR_SIZE)
+
+// How many times the chip reports busy after a sector erase is started
+#define SIM_ERASE_BUSY_POLLS 3
+
+/*
+ * Simulated m25p16, holding the flash contents in memory. Programming can only clear bits, like the real chip, and
+ * programming over bytes that haven't been erased, or while the chip is busy, is counted as a violation.
+ */
+static struct {
+    std::vector<uint8_t> data;
+    int busyPolls;
+
+    uint32_t reads;
+    uint32_t sectorErases;
+    uint32_t programViolations;
+} sim;
+
+static flashGeometry_t simGeometry = {
+    .sectors = SIM_SECTORS,
+    .pagesPerSector = SIM_SECTOR_SIZE / M25P16_PAGESIZE,
+    .pageSize = M25P16_PAGESIZE,
+    .sectorSize = SIM_SECTOR_SIZE,
+    .totalSize = SIM_TOTAL_SIZE,
+};
+
+static void simReset(uint8_t fill, int sectors = SIM_SECTORS)
+{
+    simGeometry.sectors = sectors;
+    simGeometry.totalSize = sectors * SIM_SECTOR_SIZE;
+
+    sim.data.assign(simGeometry.totalSize, fill);
+    sim.busyPolls = 0;
+    sim.reads = 0;
+    sim.sectorErases = 0;
+    sim.programViolations = 0;
+}
+
+static uint8_t testPattern(uint32_t offset)
+{
+    // Never produces a run of 0xFF that could be mistaken for erased space
+    return (offset * 7 + (offset >> 8)) % 251;
+}
+
+static void simFillPattern(uint32_t start, uint32_t end)
+{
+    for (uint32_t i = start; i < end; i++) {
+        sim.data[i] = testPattern(i);
+    }
+}
+
+extern "C" {
+    bool m25p16_isReady(void)
+    {
+        if (sim.busyPolls > 0) {
+            sim.busyPolls--;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool m25p16_waitForReady(uint32_t timeoutMillis)
+    {
+        UNUSED(timeoutMillis);
+
+        sim.busyPolls = 0;
+
+        return true;
+    }
+
+    const flashGeometry_t* m25p16_getGeometry(void)
+    {
+        return &simGeometry;
+    }
+
+    void m25p16_eraseSector(uint32_t address)
+    {
+        m25p16_waitForReady(M25P16_SECTOR_ERASE_TIMEOUT_MILLIS);
+
+        address -= address % SIM_SECTOR_SIZE;
+        memset(&sim.data[address], 0xFF, SIM_SECTOR_SIZE);
+
+        sim.sectorErases++;
+        sim.busyPolls = SIM_ERASE_BUSY_POLLS;
+    }
+
+    void m25p16_eraseCompletely(void)
+    {
+        sim.data.assign(simGeometry.totalSize, 0xFF);
+    }
+
+    uint32_t m25p16_pageProgramBuffers(uint32_t address, const uint8_t **buffers, const uint32_t *bufferSizes, int bufferCount)
+    {
+        const uint32_t pageStart = address - address % M25P16_PAGESIZE;
+
+        if (sim.busyPolls > 0) {
+            sim.programViolations++;
+        }
+
+        for (int i = 0; i < bufferCount; i++) {
+            for (uint32_t j = 0; j < bufferSizes[i]; j++, address++) {
+                if (address - pageStart >= M25P16_PAGESIZE || sim.data[address] != 0xFF) {
+                    sim.programViolations++;
+                }
+                sim.data[address] &= buffers[i][j];
+            }
+        }
+
+        return address;
+    }
+
+    uint32_t m25p16_pageProgram(uint32_t address, const uint8_t *data, int length)
+    {
+        const uint32_t bufferSize = length;
+
+        return m25p16_pageProgramBuffers(address, &data, &bufferSize, 1);
+    }
+
+    int m25p16_readBytes(uint32_t address, uint8_t *buffer, int length)
+    {
+        if (!m25p16_isReady()) {
+            return 0;
+        }
+
+        sim.reads++;
+        memcpy(buffer, &sim.data[address], length);
+
+        return length;
+    }
+}
+
+static void writePattern(uint32_t start, uint32_t length)
+{
+    uint8_t chunk[100];
+
+    for (uint32_t offset = 0; offset < length; offset += sizeof(chunk)) {
+        const uint32_t chunkSize = std::min((uint32_t) sizeof(chunk), length - offset);
+
+        for (uint32_t i = 0; i < chunkSize; i++) {
+            chunk[i] = testPattern((start + offset + i) % flashfsGetSize());
+        }
+
+        flashfsWrite(chunk, chunkSize, true);
+    }
+
+    flashfsFlushSync();
+}
+
+static bool patternMatches(uint32_t start, uint32_t end)
+{
+    for (uint32_t i = start; i < end; i++) {
+        if (sim.data[i] != testPattern(i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static timeUs_t currentTimeUs = 0;
+
+// Run the idle task at 20Hz
+static void runUpdates(int count)
+{
+    for (int i = 0; i < count; i++) {
+        currentTimeUs += 50000;
+        flashfsUpdate(currentTimeUs);
+    }
+}
+
+class FlashfsTest : public ::testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        flashfsSetRingMode(false);
+    }
+};
+
+TEST_F(FlashfsTest, TestIdentifyEndOfLogOnErasedChip)
+{
+    simReset(0xFF);
+    flashfsInit();
+    EXPECT_EQ(0u, flashfsGetOffset());
+
+    simReset(0xFF);
+    simFillPattern(0, 3 * SIM_SECTOR_SIZE + 5000);
+    flashfsInit();
+
+    // Free space is found at the next block boundary after the data
+    EXPECT_EQ(3 * SIM_SECTOR_SIZE + 6144u, flashfsGetOffset());
+}
+
+TEST_F(FlashfsTest, TestIdentifyEndOfLogWithOldDataBeyondErasedSpace)
+{
+    // A log, then erased space that was erased ahead of it, then old logs that were never wiped
+    flashfsSetRingMode(true);
+    simReset(0xFF);
+    simFillPattern(0, SIM_TOTAL_SIZE);
+    memset(&sim.data[5 * SIM_SECTOR_SIZE + 2048], 0xFF, 5 * SIM_SECTOR_SIZE - 2048);
+
+    flashfsInit();
+
+    EXPECT_EQ(5 * SIM_SECTOR_SIZE + 2048u, flashfsGetOffset());
+    EXPECT_FALSE(flashfsIsEOF());
+}
+
+TEST_F(FlashfsTest, TestFullChipStopsUnlessRingMode)
+{
+    simReset(0x00);
+    flashfsInit();
+    EXPECT_TRUE(flashfsIsEOF());
+
+    flashfsSetRingMode(true);
+    flashfsInit();
+    EXPECT_FALSE(flashfsIsEOF());
+    EXPECT_EQ(0u, flashfsGetOffset());
+}
+
+TEST_F(FlashfsTest, TestEraseAheadWhileIdle)
+{
+    // The chip was never wiped, the old data ahead of the log has to be erased before it can be written to
+    flashfsSetRingMode(true);
+    simReset(0x00);
+    simFillPattern(0, SIM_SECTOR_SIZE + 100);
+    memset(&sim.data[SIM_SECTOR_SIZE + 2048], 0xFF, SIM_SECTOR_SIZE - 2048);
+    memset(&sim.data[SIM_LOG_SIZE], 0xFF, SIM_SECTOR_SIZE);
+
+    flashfsInit();
+    ASSERT_EQ(SIM_SECTOR_SIZE + 2048u, flashfsGetOffset());
+
+    runUpdates(100);
+
+    // The target is a quarter of the log area (7.75 sectors) ahead of the tail, and the rest of the sector the tail is
+    // in was already erased
+    EXPECT_EQ(7u, sim.sectorErases);
+
+    const uint32_t erasesBefore = sim.sectorErases;
+
+    writePattern(SIM_SECTOR_SIZE + 2048, 3 * SIM_SECTOR_SIZE);
+
+    EXPECT_EQ(erasesBefore, sim.sectorErases);
+    EXPECT_EQ(0u, sim.programViolations);
+    EXPECT_TRUE(patternMatches(SIM_SECTOR_SIZE + 2048, 4 * SIM_SECTOR_SIZE + 2048));
+}
+
+TEST_F(FlashfsTest, TestWritesEraseWhenErasedSpaceRunsOut)
+{
+    flashfsSetRingMode(true);
+    simReset(0x00);
+    memset(&sim.data[0], 0xFF, SIM_SECTOR_SIZE);
+
+    flashfsInit();
+    ASSERT_EQ(0u, flashfsGetOffset());
+
+    writePattern(0, 2 * SIM_SECTOR_SIZE + 1000);
+
+    EXPECT_EQ(2u, sim.sectorErases);
+    EXPECT_EQ(0u, sim.programViolations);
+    EXPECT_TRUE(patternMatches(0, 2 * SIM_SECTOR_SIZE + 1000));
+}
+
+TEST_F(FlashfsTest, TestAsyncLoggingOnlyKeepsOneSectorAhead)
+{
+    flashfsSetRingMode(true);
+    simReset(0x00);
+    memset(&sim.data[0], 0xFF, SIM_SECTOR_SIZE);
+
+    flashfsInit();
+
+    uint8_t frame[64];
+    uint32_t offset = 0;
+    int maxErasesAhead = 0;
+
+    // Log a frame each millisecond like blackbox does, with the idle task getting a chance to run between frames
+    while (offset < 6 * SIM_SECTOR_SIZE) {
+        if (flashfsGetWriteBufferFreeSpace() >= sizeof(frame)) {
+            for (uint32_t i = 0; i < sizeof(frame); i++) {
+                frame[i] = testPattern(offset + i);
+            }
+            flashfsWrite(frame, sizeof(frame), false);
+            offset += sizeof(frame);
+        }
+        flashfsFlushPageAsync();
+
+        currentTimeUs += 1000;
+        flashfsUpdate(currentTimeUs);
+
+        maxErasesAhead = std::max(maxErasesAhead, (int) sim.sectorErases - (int) (offset / SIM_SECTOR_SIZE));
+    }
+    flashfsFlushSync();
+
+    EXPECT_EQ(0u, sim.programViolations);
+    EXPECT_LE(maxErasesAhead, 1);
+    EXPECT_TRUE(patternMatches(0, offset));
+}
+
+TEST_F(FlashfsTest, TestRingModeWrapsAround)
+{
+    simReset(0xFF);
+    flashfsSetRingMode(true);
+    flashfsInit();
+
+    const uint32_t start = SIM_LOG_SIZE - 2 * SIM_SECTOR_SIZE;
+    flashfsSeekAbs(start);
+
+    const uint32_t length = 4 * SIM_SECTOR_SIZE + 300;
+    writePattern(start, length);
+
+    EXPECT_FALSE(flashfsIsEOF());
+    EXPECT_EQ((start + length) % SIM_LOG_SIZE, flashfsGetOffset());
+    EXPECT_EQ(0u, sim.programViolations);
+    EXPECT_TRUE(patternMatches(start, SIM_LOG_SIZE));
+    EXPECT_TRUE(patternMatches(0, (start + length) % SIM_LOG_SIZE));
+
+    // The erase ahead never wraps around into the sector the tail is in
+    runUpdates(1000);
+    EXPECT_TRUE(patternMatches(2 * SIM_SECTOR_SIZE, 2 * SIM_SECTOR_SIZE + 300));
+
+    // After a reboot, logging resumes after the wrapped data
+    flashfsInit();
+    EXPECT_EQ(2 * SIM_SECTOR_SIZE + 2048u, flashfsGetOffset());
+}
+
+// Fill the journal sector with entries for the given sectors, oldest first
+static void simWriteJournal(const std::vector<uint32_t> &sectors)
+{
+    memset(&sim.data[SIM_LOG_SIZE], 0xFF, SIM_SECTOR_SIZE);
+
+    for (size_t i = 0; i < sectors.size(); i++) {
+        const uint32_t address = sectors[i] * SIM_SECTOR_SIZE;
+        const uint32_t complement = ~address;
+
+        memcpy(&sim.data[SIM_LOG_SIZE + i * 8], &address, sizeof(address));
+        memcpy(&sim.data[SIM_LOG_SIZE + i * 8 + 4], &complement, sizeof(complement));
+    }
+}
+
+TEST_F(FlashfsTest, TestRingModeResumesAfterNewestDataWithoutErasedGap)
+{
+    flashfsSetRingMode(true);
+
+    // The log wrapped around and power was lost right as the tail reached sector 5, before it was erased
+    simReset(0xFF);
+    simFillPattern(0, SIM_LOG_SIZE);
+    simWriteJournal({ 3, 4, 5 });
+
+    flashfsInit();
+    EXPECT_EQ(6 * SIM_SECTOR_SIZE + 0u, flashfsGetOffset());
+
+    // Same again but the journal hadn't caught up with the tail
+    simWriteJournal({ 3, 4 });
+
+    flashfsInit();
+    EXPECT_EQ(5 * SIM_SECTOR_SIZE + 0u, flashfsGetOffset());
+
+    // The next log goes into the oldest data
+    writePattern(5 * SIM_SECTOR_SIZE, 100);
+    EXPECT_TRUE(patternMatches(0, 5 * SIM_SECTOR_SIZE));
+    EXPECT_EQ(0u, sim.programViolations);
+
+    // At the end of the device, the journal wraps around to the start
+    simFillPattern(0, SIM_LOG_SIZE);
+    simWriteJournal({ SIM_SECTORS - 2 });
+
+    flashfsInit();
+    EXPECT_EQ(0u, flashfsGetOffset());
+}
+
+TEST_F(FlashfsTest, TestReadsPauseEraseAhead)
+{
+    flashfsSetRingMode(true);
+    simReset(0x00);
+    memset(&sim.data[0], 0xFF, SIM_SECTOR_SIZE);
+    memset(&sim.data[SIM_LOG_SIZE], 0xFF, SIM_SECTOR_SIZE);
+
+    flashfsInit();
+    ASSERT_EQ(0u, flashfsGetOffset());
+
+    // A log being downloaded over MSP, reading a chunk on every run of the idle task
+    uint8_t buffer[128];
+    sim.sectorErases = 0;
+
+    for (int i = 0; i < 100; i++) {
+        flashfsReadAbs(i * sizeof(buffer), buffer, sizeof(buffer));
+        runUpdates(1);
+    }
+
+    EXPECT_EQ(0u, sim.sectorErases);
+
+    // Erasing ahead resumes once the reads have stopped
+    runUpdates(100);
+    EXPECT_GT(sim.sectorErases, 0u);
+}
+
+// A search of the journal, plus a search of the sector it points to, regardless of the chip size
+#define JOURNAL_BOOT_READS_MAX 32u
+
+/*
+ * Reboot and count the SPI reads needed to find the end of the data. Returns the number of reads.
+ */
+static uint32_t bootReads(void)
+{
+    // Any erase that was running has finished by the time the chip powers up again
+    sim.busyPolls = 0;
+    sim.reads = 0;
+    flashfsInit();
+
+    return sim.reads;
+}
+
+/*
+ * The number of reads the binary search over the whole chip took at boot before the journal existed, at most.
+ */
+static uint32_t binarySearchReads(int sectors)
+{
+    uint32_t reads = 0;
+
+    for (uint32_t blocks = sectors * SIM_SECTOR_SIZE / 2048; blocks > 0; blocks /= 2) {
+        reads++;
+    }
+
+    return reads;
+}
+
+TEST_F(FlashfsTest, TestBootReadsStayWithinTheBinarySearch)
+{
+    const int chipSectors[] = { 32, 256, 512 };
+
+    for (int sectors : chipSectors) {
+        // Logs ending most of the way through the chip
+        const uint32_t end = (sectors - 10) * SIM_SECTOR_SIZE + 5000;
+
+        simReset(0xFF, sectors);
+        simFillPattern(0, end);
+
+        flashfsSetRingMode(false);
+        const uint32_t searchReads = bootReads();
+        ASSERT_EQ(end - end % 2048 + 2048, flashfsGetOffset());
+
+        // Outside ring mode, no journal is kept
+        runUpdates(10);
+        EXPECT_EQ(searchReads, bootReads());
+        EXPECT_TRUE(std::all_of(sim.data.end() - SIM_SECTOR_SIZE, sim.data.end(), [](uint8_t b) { return b == 0xFF; }));
+
+        // In ring mode the binary search can't be used, every sector is walked until the journal has been started
+        flashfsSetRingMode(true);
+        const uint32_t walkReads = bootReads();
+        ASSERT_EQ(end - end % 2048 + 2048, flashfsGetOffset());
+
+        runUpdates(10);
+
+        const uint32_t journalReads = bootReads();
+        ASSERT_EQ(end - end % 2048 + 2048, flashfsGetOffset());
+
+        printf("[ BENCHMARK] %2d MB chip: %2u SPI reads at boot (at most %2u before), ring mode %2u using the journal, %4u without\n",
+            sectors / 16, searchReads, binarySearchReads(sectors), journalReads, walkReads);
+
+        EXPECT_LE(searchReads, binarySearchReads(sectors));
+        EXPECT_LE(journalReads, JOURNAL_BOOT_READS_MAX);
+        EXPECT_EQ(0u, sim.programViolations);
+    }
+}
+
+TEST_F(FlashfsTest, TestJournalFollowsTheTail)
+{
+    flashfsSetRingMode(true);
+    simReset(0xFF);
+    flashfsInit();
+
+    writePattern(0, SIM_SECTOR_SIZE + 100);
+    runUpdates(10);
+
+    // The journal only hears about the sector the tail has moved into when the idle task next runs
+    writePattern(SIM_SECTOR_SIZE + 100, 3 * SIM_SECTOR_SIZE);
+
+    EXPECT_GT(bootReads(), 0u);
+    EXPECT_EQ(4 * SIM_SECTOR_SIZE + 2048u, flashfsGetOffset());
+
+    // Booting brought the journal up to date
+    runUpdates(10);
+    EXPECT_LE(bootReads(), JOURNAL_BOOT_READS_MAX);
+    EXPECT_EQ(4 * SIM_SECTOR_SIZE + 2048u, flashfsGetOffset());
+
+    // A log that stopped right at the end of a sector
+    writePattern(4 * SIM_SECTOR_SIZE + 2048, SIM_SECTOR_SIZE - 2048);
+    runUpdates(10);
+    EXPECT_LE(bootReads(), JOURNAL_BOOT_READS_MAX);
+    EXPECT_EQ(5 * SIM_SECTOR_SIZE + 0u, flashfsGetOffset());
+    EXPECT_EQ(0u, sim.programViolations);
+}
+
+TEST_F(FlashfsTest, TestOldDataInJournalSectorIsKept)
+{
+    // A log written before the journal existed, running into the last sector
+    flashfsSetRingMode(true);
+    simReset(0xFF);
+    simFillPattern(0, SIM_TOTAL_SIZE);
+    memset(&sim.data[3 * SIM_SECTOR_SIZE], 0xFF, 10 * SIM_SECTOR_SIZE);
+
+    flashfsInit();
+    EXPECT_EQ(3 * SIM_SECTOR_SIZE + 0u, flashfsGetOffset());
+
+    // It isn't mistaken for a journal, and the idle task doesn't erase it
+    runUpdates(100);
+    EXPECT_TRUE(patternMatches(SIM_LOG_SIZE, SIM_TOTAL_SIZE));
+
+    // Booting falls back to walking every sector
+    bootReads();
+    EXPECT_EQ(3 * SIM_SECTOR_SIZE + 0u, flashfsGetOffset());
+    runUpdates(100);
+    EXPECT_TRUE(patternMatches(SIM_LOG_SIZE, SIM_TOTAL_SIZE));
+
+    // Until the user erases the flash
+    flashfsEraseCompletely();
+    writePattern(0, SIM_SECTOR_SIZE + 10);
+    runUpdates(10);
+
+    EXPECT_LE(bootReads(), JOURNAL_BOOT_READS_MAX);
+    EXPECT_EQ(SIM_SECTOR_SIZE + 2048u, flashfsGetOffset());
+    EXPECT_EQ(0u, sim.programViolations);
+}
+
+TEST_F(FlashfsTest, TestJournalIsErasedWhenFull)
+{
+    flashfsSetRingMode(true);
+    simReset(0xFF);
+    simFillPattern(0, 3 * SIM_SECTOR_SIZE);
+
+    for (uint32_t i = 0; i < SIM_SECTOR_SIZE; i += 8) {
+        const uint32_t address = 2 * SIM_SECTOR_SIZE;
+        const uint32_t complement = ~address;
+
+        memcpy(&sim.data[SIM_LOG_SIZE + i], &address, sizeof(address));
+        memcpy(&sim.data[SIM_LOG_SIZE + i + 4], &complement, sizeof(complement));
+    }
+
+    EXPECT_LE(bootReads(), JOURNAL_BOOT_READS_MAX);
+    EXPECT_EQ(3 * SIM_SECTOR_SIZE + 0u, flashfsGetOffset());
+
+    writePattern(3 * SIM_SECTOR_SIZE, SIM_SECTOR_SIZE + 10);
+    sim.sectorErases = 0;
+    runUpdates(100);
+
+    // Only the journal needed erasing, the rest of the chip ahead of the tail already was
+    EXPECT_EQ(1u, sim.sectorErases);
+    EXPECT_LE(bootReads(), JOURNAL_BOOT_READS_MAX);
+    EXPECT_EQ(4 * SIM_SECTOR_SIZE + 2048u, flashfsGetOffset());
+    EXPECT_EQ(0u, sim.programViolations);
+}
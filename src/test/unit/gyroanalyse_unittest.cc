@@ -0,0 +1,144 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+extern "C" {
+    #include "platform.h"
+    #include "build/debug.h"
+    #include "common/axis.h"
+    #include "common/filter.h"
+    #include "common/maths.h"
+    #include "sensors/gyroanalyse.h"
+
+    int16_t debug[DEBUG16_VALUE_COUNT];
+    uint8_t debugMode;
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define TEST_NOTCH_Q    120
+
+static biquadFilter_t notchFilter[XYZ_AXIS_COUNT];
+
+static void initAnalyse(uint32_t gyroUpdateRateUs)
+{
+    gyroDataAnalyseInit(gyroUpdateRateUs, 150, TEST_NOTCH_Q);
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        biquadFilterInit(&notchFilter[axis], gyroDataAnalyseCenterFrequency(axis), gyroUpdateRateUs, TEST_NOTCH_Q / 100.0f, FILTER_NOTCH);
+    }
+}
+
+// Motor noise on roll and pitch at different frequencies, yaw only has a slow movement
+static void runAnalyse(uint32_t gyroUpdateRateUs, float rollHz, float pitchHz, int samples)
+{
+    for (int n = 0; n < samples; n++) {
+        const float t = n * gyroUpdateRateUs * 1e-6f;
+        const float sample[XYZ_AXIS_COUNT] = {
+            100.0f * sinf(2 * M_PIf * 2 * t) + 30.0f * sinf(2 * M_PIf * rollHz * t),
+            30.0f * sinf(2 * M_PIf * pitchHz * t),
+            100.0f * sinf(2 * M_PIf * 2 * t)
+        };
+        gyroDataAnalyse(sample, notchFilter);
+    }
+}
+
+TEST(GyroAnalyseUnittest, TestDownsampling)
+{
+    initAnalyse(1000);
+    EXPECT_EQ(1000, gyroDataAnalyseSampleRateHz());
+
+    initAnalyse(125);
+    EXPECT_EQ(1000, gyroDataAnalyseSampleRateHz());
+
+    initAnalyse(2000);
+    EXPECT_EQ(500, gyroDataAnalyseSampleRateHz());
+}
+
+TEST(GyroAnalyseUnittest, TestCenterFrequencyFollowsPeak)
+{
+    const uint32_t gyroUpdateRateUs = 1000;
+    initAnalyse(gyroUpdateRateUs);
+    const uint16_t initialFrequencyHz = gyroDataAnalyseCenterFrequency(FD_YAW);
+
+    runAnalyse(gyroUpdateRateUs, 250, 330, 4000);
+
+    EXPECT_NEAR(250, gyroDataAnalyseCenterFrequency(FD_ROLL), 15);
+    EXPECT_NEAR(330, gyroDataAnalyseCenterFrequency(FD_PITCH), 15);
+    // No noise peak on yaw, the notch stays where it was
+    EXPECT_EQ(initialFrequencyHz, gyroDataAnalyseCenterFrequency(FD_YAW));
+
+    // Peak moves with throttle
+    runAnalyse(gyroUpdateRateUs, 180, 330, 4000);
+    EXPECT_NEAR(180, gyroDataAnalyseCenterFrequency(FD_ROLL), 15);
+}
+
+TEST(GyroAnalyseUnittest, TestNotchIsRetuned)
+{
+    const uint32_t gyroUpdateRateUs = 500;
+    initAnalyse(gyroUpdateRateUs);
+    runAnalyse(gyroUpdateRateUs, 220, 300, 8000);
+
+    // A tone at the detected frequency is strongly attenuated by the retuned notch
+    biquadFilter_t filter = notchFilter[FD_ROLL];
+    filter.d1 = filter.d2 = 0;
+    float peak = 0;
+    for (int n = 0; n < 2000; n++) {
+        const float output = biquadFilterApply(&filter, sinf(2 * M_PIf * 220 * n * gyroUpdateRateUs * 1e-6f));
+        if (n > 1000) {
+            peak = MAX(peak, fabsf(output));
+        }
+    }
+    EXPECT_LT(peak, 0.2f);
+}
+
+TEST(GyroAnalyseUnittest, TestSpectrumIsExposed)
+{
+    const uint32_t gyroUpdateRateUs = 1000;
+    initAnalyse(gyroUpdateRateUs);
+    runAnalyse(gyroUpdateRateUs, 250, 330, 1000);
+
+    // 250Hz is bin 8 at 1kHz and 32 points, look above the 150Hz lower limit
+    int peakBin = 5;
+    for (int bin = 5; bin < GYRO_ANALYSE_FFT_BIN_COUNT; bin++) {
+        if (gyroDataAnalyseBinMagnitude(FD_ROLL, bin) > gyroDataAnalyseBinMagnitude(FD_ROLL, peakBin)) {
+            peakBin = bin;
+        }
+    }
+    EXPECT_EQ(8, peakBin);
+}
+
+TEST(GyroAnalyseUnittest, TestSpectrumMagnitude)
+{
+    const uint32_t gyroUpdateRateUs = 1000;
+    initAnalyse(gyroUpdateRateUs);
+    runAnalyse(gyroUpdateRateUs, 250, 187.5f, 1000);
+
+    // Pitch only has a tone of amplitude 30 right on bin 6, the Hanning window spreads it to the neighbour bins
+    const float windowGain = GYRO_ANALYSE_FFT_WINDOW_SIZE / 4.0f;
+    EXPECT_NEAR(30 * windowGain, gyroDataAnalyseBinMagnitude(FD_PITCH, 6), 30 * windowGain * 0.05f);
+    EXPECT_NEAR(15 * windowGain, gyroDataAnalyseBinMagnitude(FD_PITCH, 5), 30 * windowGain * 0.05f);
+    EXPECT_NEAR(15 * windowGain, gyroDataAnalyseBinMagnitude(FD_PITCH, 7), 30 * windowGain * 0.05f);
+    for (int bin = 0; bin < GYRO_ANALYSE_FFT_BIN_COUNT; bin++) {
+        if (bin < 5 || bin > 7) {
+            EXPECT_LT(gyroDataAnalyseBinMagnitude(FD_PITCH, bin), 30 * windowGain * 0.05f) << bin;
+        }
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of INAV.
+ *
+ * INAV is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * INAV is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with INAV.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+extern "C" {
+    #include "common/histogram.h"
+}
+
+#include "gtest/gtest.h"
+
+TEST(HistogramTest, TestBinBoundsAreContiguous)
+{
+    EXPECT_EQ(0u, histogramBinLowerBound(0));
+    for (int bin = 0; bin < HISTOGRAM_BIN_COUNT - 1; bin++) {
+        EXPECT_LE(histogramBinLowerBound(bin), histogramBinUpperBound(bin));
+        EXPECT_EQ(histogramBinUpperBound(bin) + 1, histogramBinLowerBound(bin + 1));
+    }
+    EXPECT_EQ(49152u, histogramBinLowerBound(HISTOGRAM_BIN_COUNT - 1));
+}
+
+TEST(HistogramTest, TestSmallValuesAreExact)
+{
+    histogram_t histogram;
+    histogramReset(&histogram);
+
+    for (uint32_t value = 0; value < 4; value++) {
+        histogramAdd(&histogram, value);
+        EXPECT_EQ(1, histogram.bins[value]);
+    }
+    EXPECT_EQ(4u, histogramSampleCount(&histogram));
+}
+
+TEST(HistogramTest, TestValuesLandInTheirBin)
+{
+    for (uint32_t value = 0; value < 70000; value += 7) {
+        histogram_t histogram;
+        histogramReset(&histogram);
+        histogramAdd(&histogram, value);
+
+        int bin = 0;
+        while (histogram.bins[bin] == 0) {
+            bin++;
+        }
+        EXPECT_GE(value, histogramBinLowerBound(bin));
+        if (bin < HISTOGRAM_BIN_COUNT - 1) {
+            EXPECT_LE(value, histogramBinUpperBound(bin));
+        }
+    }
+}
+
+TEST(HistogramTest, TestPercentiles)
+{
+    histogram_t histogram;
+    histogramReset(&histogram);
+    EXPECT_EQ(0u, histogramPercentile(&histogram, 500));
+
+    // 1000 samples: 989 at 2us, 10 at 100us and a single one at 5000us
+    for (int i = 0; i < 989; i++) {
+        histogramAdd(&histogram, 2);
+    }
+    for (int i = 0; i < 10; i++) {
+        histogramAdd(&histogram, 100);
+    }
+    histogramAdd(&histogram, 5000);
+
+    EXPECT_EQ(2u, histogramPercentile(&histogram, 500));
+    EXPECT_EQ(127u, histogramPercentile(&histogram, 990));
+    EXPECT_EQ(127u, histogramPercentile(&histogram, 999));
+    EXPECT_EQ(6143u, histogramPercentile(&histogram, 1000));
+}
+
+TEST(HistogramTest, TestSaturationKeepsDistribution)
+{
+    histogram_t histogram;
+    histogramReset(&histogram);
+
+    for (int i = 0; i < 200000; i++) {
+        histogramAdd(&histogram, (i % 4 == 0) ? 1000 : 10);
+    }
+
+    const uint32_t large = histogram.bins[19];
+    const uint32_t small = histogram.bins[6];
+    EXPECT_GT(small, 0u);
+    EXPECT_NEAR(3.0, (double)small / large, 0.1);
+    EXPECT_EQ(11u, histogramPercentile(&histogram, 500));
+    EXPECT_EQ(1023u, histogramPercentile(&histogram, 990));
+}
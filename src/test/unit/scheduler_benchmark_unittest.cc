@@ -0,0 +1,285 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <utility>
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+    #include "common/time.h"
+    #include "common/utils.h"
+    #include "scheduler/scheduler.h"
+
+    extern void queueClear(void);
+    extern bool queueAdd(cfTask_t *task);
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// Built against a scheduler.o with SCHEDULER_MAX_TASKS=32
+#define BENCHMARK_MAX_TASKS     32
+#define BENCHMARK_TIME_STEP_US  20
+
+extern "C" {
+    timeUs_t micros(void) { return 0; }
+
+    static timeUs_t fakeTimeUs;
+    static timeUs_t fakeMicros(void) { return fakeTimeUs; }
+
+    cfTask_t cfTasks[TASK_COUNT] = {};
+}
+
+// cfTask_t has const members, the task table is constructed in place
+alignas(cfTask_t) static uint8_t benchmarkTaskStorage[sizeof(cfTask_t) * BENCHMARK_MAX_TASKS];
+static cfTask_t * const benchmarkTasks = reinterpret_cast<cfTask_t *>(benchmarkTaskStorage);
+static int benchmarkTaskCount;
+static std::vector<std::pair<int, timeUs_t>> executedTasks;
+static bool traceExecutedTasks;
+
+// Both schedulers stamp lastExecutedAt before calling the task, which tells which one runs
+static void benchmarkTaskFunc(timeUs_t currentTimeUs)
+{
+    if (!traceExecutedTasks) {
+        return;
+    }
+    for (int i = 0; i < benchmarkTaskCount; i++) {
+        if (benchmarkTasks[i].lastExecutedAt == currentTimeUs) {
+            executedTasks.push_back(std::make_pair(i, currentTimeUs));
+            return;
+        }
+    }
+}
+
+// Event driven tasks get signalled on a fixed pattern so both schedulers see the same events
+static bool benchmarkCheckFunc(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs)
+{
+    UNUSED(currentDeltaTimeUs);
+    return (currentTimeUs % 700) < BENCHMARK_TIME_STEP_US;
+}
+
+/*
+ * Builds a task table resembling a flight controller: one realtime gyro/pid
+ * task, the remaining ones spread over priorities and periods with every
+ * fourth one event driven.
+ */
+static void initBenchmarkTasks(cfTask_t *tasks, int taskCount)
+{
+    static const cfTaskPriority_e priorities[] = { TASK_PRIORITY_HIGH, TASK_PRIORITY_MEDIUM, TASK_PRIORITY_LOW, TASK_PRIORITY_MEDIUM_HIGH, TASK_PRIORITY_IDLE };
+    static const timeDelta_t periods[] = { TASK_PERIOD_HZ(500), TASK_PERIOD_HZ(100), TASK_PERIOD_HZ(50), TASK_PERIOD_HZ(10), TASK_PERIOD_HZ(200), TASK_PERIOD_HZ(1) };
+
+    for (int i = 0; i < taskCount; i++) {
+        if (i == 0) {
+            new (&tasks[i]) cfTask_t { "BENCH", NULL, benchmarkTaskFunc, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME };
+        } else {
+            new (&tasks[i]) cfTask_t {
+                "BENCH",
+                (i % 4 == 3) ? benchmarkCheckFunc : NULL,
+                benchmarkTaskFunc,
+                periods[i % ARRAYLEN(periods)],
+                (uint8_t)priorities[i % ARRAYLEN(priorities)]
+            };
+        }
+    }
+}
+
+/*
+ * The scheduler as it was before the deadline heaps: every task is aged and
+ * considered on every call. Kept here as the reference for dispatch order
+ * and cost.
+ */
+static cfTask_t *legacyQueue[BENCHMARK_MAX_TASKS + 1];
+
+static void legacyQueueInit(cfTask_t *tasks, int taskCount)
+{
+    int size = 0;
+    memset(legacyQueue, 0, sizeof(legacyQueue));
+    for (int i = 0; i < taskCount; i++) {
+        int pos = 0;
+        while (pos < size && legacyQueue[pos]->staticPriority >= tasks[i].staticPriority) {
+            pos++;
+        }
+        memmove(&legacyQueue[pos + 1], &legacyQueue[pos], sizeof(cfTask_t *) * (size - pos));
+        legacyQueue[pos] = &tasks[i];
+        size++;
+    }
+}
+
+static void legacyScheduler(void)
+{
+    const timeUs_t currentTimeUs = fakeMicros();
+
+    timeUs_t timeToNextRealtimeTask = TIMEUS_MAX;
+    for (cfTask_t **q = legacyQueue; *q != NULL && (*q)->staticPriority >= TASK_PRIORITY_REALTIME; q++) {
+        const cfTask_t *task = *q;
+        const timeUs_t nextExecuteAt = task->lastExecutedAt + task->desiredPeriod;
+        if ((int32_t)(currentTimeUs - nextExecuteAt) >= 0) {
+            timeToNextRealtimeTask = 0;
+        } else {
+            const timeUs_t newTimeInterval = nextExecuteAt - currentTimeUs;
+            timeToNextRealtimeTask = std::min(timeToNextRealtimeTask, newTimeInterval);
+        }
+    }
+    const bool outsideRealtimeGuardInterval = (timeToNextRealtimeTask > 0);
+
+    cfTask_t *selectedTask = NULL;
+    uint16_t selectedTaskDynamicPriority = 0;
+
+    for (cfTask_t **q = legacyQueue; *q != NULL; q++) {
+        cfTask_t *task = *q;
+        if (task->checkFunc) {
+            const timeUs_t currentTimeBeforeCheckFuncCallUs = fakeMicros();
+            if (task->dynamicPriority > 0) {
+                task->taskAgeCycles = 1 + ((timeDelta_t)(currentTimeUs - task->lastSignaledAt)) / task->desiredPeriod;
+                task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+            } else if (task->checkFunc(currentTimeBeforeCheckFuncCallUs, currentTimeBeforeCheckFuncCallUs - task->lastExecutedAt)) {
+                task->lastSignaledAt = currentTimeBeforeCheckFuncCallUs;
+                task->taskAgeCycles = 1;
+                task->dynamicPriority = 1 + task->staticPriority;
+            } else {
+                task->taskAgeCycles = 0;
+            }
+        } else {
+            task->taskAgeCycles = ((timeDelta_t)(currentTimeUs - task->lastExecutedAt)) / task->desiredPeriod;
+            if (task->taskAgeCycles > 0) {
+                task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+            }
+        }
+
+        if (task->dynamicPriority > selectedTaskDynamicPriority) {
+            const bool taskCanBeChosenForScheduling =
+                (outsideRealtimeGuardInterval) ||
+                (task->taskAgeCycles > 1) ||
+                (task->staticPriority == TASK_PRIORITY_REALTIME);
+            if (taskCanBeChosenForScheduling) {
+                selectedTaskDynamicPriority = task->dynamicPriority;
+                selectedTask = task;
+            }
+        }
+    }
+
+    if (selectedTask) {
+        selectedTask->taskLatestDeltaTime = (timeDelta_t)(currentTimeUs - selectedTask->lastExecutedAt);
+        selectedTask->lastExecutedAt = currentTimeUs;
+        selectedTask->dynamicPriority = 0;
+        selectedTask->taskFunc(fakeMicros());
+    }
+}
+
+static void benchmarkStart(int taskCount)
+{
+    // Start past zero so that only the dispatched task has lastExecutedAt == now
+    fakeTimeUs = 1;
+    executedTasks.clear();
+    benchmarkTaskCount = taskCount;
+    initBenchmarkTasks(benchmarkTasks, taskCount);
+}
+
+static void schedulerStart(int taskCount)
+{
+    benchmarkStart(taskCount);
+    schedulerSetTimeSource(fakeMicros);
+    queueClear();
+    for (int i = 0; i < taskCount; i++) {
+        queueAdd(&benchmarkTasks[i]);
+    }
+}
+
+static void legacySchedulerStart(int taskCount)
+{
+    benchmarkStart(taskCount);
+    legacyQueueInit(benchmarkTasks, taskCount);
+}
+
+static void runLoops(void (*schedulerFn)(void), int loops)
+{
+    for (int i = 0; i < loops; i++) {
+        schedulerFn();
+        fakeTimeUs += BENCHMARK_TIME_STEP_US;
+    }
+}
+
+static const int benchmarkTaskCounts[] = { 10, 20, 32 };
+
+TEST(SchedulerBenchmarkUnittest, TestDispatchOrderMatchesLinearScan)
+{
+    traceExecutedTasks = true;
+    for (int taskCount : benchmarkTaskCounts) {
+        legacySchedulerStart(taskCount);
+        runLoops(legacyScheduler, 100000);
+        const std::vector<std::pair<int, timeUs_t>> expected = executedTasks;
+
+        schedulerStart(taskCount);
+        runLoops(scheduler, 100000);
+
+        EXPECT_GT(expected.size(), 0u);
+        EXPECT_TRUE(expected == executedTasks) << "dispatch differs with " << taskCount << " tasks";
+    }
+}
+
+TEST(SchedulerBenchmarkUnittest, TestTimeToNextTaskMatchesLinearScan)
+{
+    for (int taskCount : benchmarkTaskCounts) {
+        schedulerStart(taskCount);
+        for (int i = 0; i < 10000; i++) {
+            scheduler();
+            timeUs_t expected = TIMEUS_MAX;
+            for (int t = 0; t < taskCount; t++) {
+                const cfTask_t *task = &benchmarkTasks[t];
+                if (task->checkFunc && task->dynamicPriority > 0) {
+                    // Triggered event driven task is waiting to run
+                    expected = 0;
+                } else if (!task->checkFunc) {
+                    const timeUs_t nextExecuteAt = task->lastExecutedAt + task->desiredPeriod;
+                    expected = std::min(expected, nextExecuteAt > fakeTimeUs ? nextExecuteAt - fakeTimeUs : 0);
+                }
+            }
+            ASSERT_EQ(expected, schedulerGetTimeToNextTask(fakeTimeUs));
+            fakeTimeUs += BENCHMARK_TIME_STEP_US;
+        }
+    }
+}
+
+static double nanosecondsPerDispatch(void (*start)(int), void (*schedulerFn)(void), int taskCount)
+{
+    const int loops = 200000;
+
+    start(taskCount);
+    const auto begin = std::chrono::steady_clock::now();
+    runLoops(schedulerFn, loops);
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - begin).count() / loops;
+}
+
+TEST(SchedulerBenchmarkUnittest, BenchmarkDispatch)
+{
+    traceExecutedTasks = false;
+    for (int taskCount : benchmarkTaskCounts) {
+        const double legacyNs = nanosecondsPerDispatch(legacySchedulerStart, legacyScheduler, taskCount);
+        const double heapNs = nanosecondsPerDispatch(schedulerStart, scheduler, taskCount);
+        printf("[ BENCHMARK] %2d tasks: linear scan %7.1f ns/call, deadline heap %7.1f ns/call\n", taskCount, legacyNs, heapNs);
+    }
+}
@@ -0,0 +1,183 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+    #include "common/time.h"
+    #include "scheduler/scheduler.h"
+
+    extern bool queueAdd(cfTask_t *task);
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+extern "C" {
+    // The scheduler must not fall back to the wall clock when a time source is set
+    timeUs_t micros(void) { ADD_FAILURE() << "micros() called"; return 0; }
+
+    static timeUs_t virtualTimeUs;
+    static timeUs_t virtualMicros(void) { return virtualTimeUs; }
+
+    static std::vector<timeUs_t> gyroRuns;
+    static int rxRuns;
+    static int rxChecks;
+    static bool rxPending;
+
+    static void taskGyro(timeUs_t currentTimeUs) { gyroRuns.push_back(currentTimeUs); }
+    static bool taskRxCheck(timeUs_t currentTimeUs, timeDelta_t currentDeltaTimeUs) { UNUSED(currentTimeUs); UNUSED(currentDeltaTimeUs); rxChecks++; return rxPending; }
+    static void taskRx(timeUs_t currentTimeUs) { UNUSED(currentTimeUs); rxPending = false; rxRuns++; }
+    static void taskSerial(timeUs_t currentTimeUs) { UNUSED(currentTimeUs); }
+
+    cfTask_t cfTasks[TASK_COUNT] = {
+        { "SYSTEM", NULL, taskSystem, TASK_PERIOD_HZ(10), TASK_PRIORITY_HIGH },
+        { "GYRO/PID", NULL, taskGyro, TASK_PERIOD_US(1000), TASK_PRIORITY_REALTIME },
+        { "RX", taskRxCheck, taskRx, TASK_PERIOD_HZ(50), TASK_PRIORITY_HIGH },
+        { "SERIAL", NULL, taskSerial, TASK_PERIOD_HZ(100), TASK_PRIORITY_LOW },
+    };
+}
+
+static void resetTasks(void)
+{
+    for (int i = 0; i < TASK_COUNT; i++) {
+        cfTasks[i].lastExecutedAt = 0;
+        cfTasks[i].lastSignaledAt = 0;
+        cfTasks[i].dynamicPriority = 0;
+        cfTasks[i].taskAgeCycles = 0;
+        cfTasks[i].lastCheckedAt = 0;
+        cfTasks[i].signalDriven = false;
+    }
+    gyroRuns.clear();
+    rxRuns = 0;
+    rxChecks = 0;
+    rxPending = false;
+    virtualTimeUs = 0;
+
+    schedulerSetTimeSource(virtualMicros);
+    schedulerInit();
+    setTaskEnabled(TASK_GYROPID, true);
+    setTaskEnabled(TASK_RX, true);
+    setTaskEnabled(TASK_SERIAL, true);
+}
+
+// Advance the virtual clock event to event, the way the SITL main loop does
+static int runFor(timeUs_t durationUs)
+{
+    int loops = 0;
+    while (virtualTimeUs < durationUs) {
+        scheduler();
+        const timeUs_t timeToNextTask = schedulerGetTimeToNextTask(virtualTimeUs);
+        virtualTimeUs += std::max(std::min(timeToNextTask, (timeUs_t)1000), (timeUs_t)1);
+        loops++;
+    }
+    return loops;
+}
+
+TEST(SchedulerTimeUnittest, TestTimeToNextTask)
+{
+    resetTasks();
+
+    virtualTimeUs = 0;
+    cfTasks[TASK_SYSTEM].lastExecutedAt = 0;
+    cfTasks[TASK_GYROPID].lastExecutedAt = 0;
+    cfTasks[TASK_SERIAL].lastExecutedAt = 0;
+    EXPECT_EQ(1000, schedulerGetTimeToNextTask(0));
+    EXPECT_EQ(400, schedulerGetTimeToNextTask(600));
+    EXPECT_EQ(0, schedulerGetTimeToNextTask(1000));
+    EXPECT_EQ(0, schedulerGetTimeToNextTask(5000));
+
+    // Event driven tasks are polled, they have no deadline
+    setTaskEnabled(TASK_SYSTEM, false);
+    setTaskEnabled(TASK_GYROPID, false);
+    setTaskEnabled(TASK_SERIAL, false);
+    EXPECT_EQ(TIMEUS_MAX, schedulerGetTimeToNextTask(0));
+}
+
+TEST(SchedulerTimeUnittest, TestVirtualTimeJumpsToDeadlines)
+{
+    resetTasks();
+
+    const int loops = runFor(1000000);
+
+    // One loop per deadline rather than one per microsecond
+    EXPECT_LT(loops, 3000);
+    ASSERT_GE(gyroRuns.size(), 999u);
+    EXPECT_LE(gyroRuns.size(), 1000u);
+    for (size_t i = 1; i < gyroRuns.size(); i++) {
+        EXPECT_EQ(1000, gyroRuns[i] - gyroRuns[i - 1]);
+    }
+}
+
+TEST(SchedulerTimeUnittest, TestVirtualTimeIsDeterministic)
+{
+    resetTasks();
+    const int loops1 = runFor(200000);
+    const std::vector<timeUs_t> runs1 = gyroRuns;
+
+    resetTasks();
+    const int loops2 = runFor(200000);
+
+    EXPECT_EQ(loops1, loops2);
+    EXPECT_EQ(runs1, gyroRuns);
+}
+
+TEST(SchedulerTimeUnittest, TestEventTaskRunsOnNextStep)
+{
+    resetTasks();
+    runFor(10000);
+    EXPECT_EQ(0, rxRuns);
+
+    rxPending = true;
+    runFor(20000);
+    EXPECT_EQ(1, rxRuns);
+}
+
+TEST(SchedulerTimeUnittest, TestSignalDrivenTaskIsOnlyCheckedWhenSignalled)
+{
+    resetTasks();
+    setTaskSignalDriven(TASK_RX, true);
+
+    runFor(10000);
+    EXPECT_EQ(0, rxChecks);
+
+    // Data without a signal is only noticed by the once per period fallback check
+    rxPending = true;
+    runFor(19000);
+    EXPECT_EQ(0, rxRuns);
+    runFor(20100);
+    EXPECT_EQ(1, rxChecks);
+    EXPECT_EQ(1, rxRuns);
+
+    // A signal gets the task checked on the next pass
+    rxPending = true;
+    schedulerSignalTask(TASK_RX);
+    runFor(virtualTimeUs + 2000);
+    EXPECT_EQ(2, rxChecks);
+    EXPECT_EQ(2, rxRuns);
+
+    // Polled tasks are checked on every pass
+    setTaskSignalDriven(TASK_RX, false);
+    runFor(virtualTimeUs + 2000);
+    EXPECT_GT(rxChecks, 2);
+    EXPECT_EQ(2, rxRuns);
+}
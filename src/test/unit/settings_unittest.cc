@@ -0,0 +1,190 @@
+/*
+ * This file is part of INAV.
+ *
+ * INAV is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * INAV is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with INAV.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// platform.h comes from the SITL target here, not from the test dir, matching the generated settings
+extern "C" {
+    #include "../../main/platform.h"
+    #include "common/string_light.h"
+    #include "config/parameter_group.h"
+    #include "fc/config.h"
+    #include "fc/settings.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// How many times the benchmark replays a full "diff all"
+#define BENCHMARK_REPLAYS 200
+
+static std::string settingName(int index)
+{
+    char name[SETTING_MAX_NAME_LENGTH];
+    setting_get_name(&settingsTable[index], name);
+    return name;
+}
+
+// The linear lookup setting_find() and cliSet() used before the name hash
+static const setting_t *linearFind(const char *name, size_t length)
+{
+    char buf[SETTING_MAX_NAME_LENGTH];
+    for (int ii = 0; ii < SETTINGS_TABLE_COUNT; ii++) {
+        const setting_t *setting = &settingsTable[ii];
+        setting_get_name(setting, buf);
+        if (sl_strncasecmp(name, buf, strlen(buf)) == 0 && length == strlen(buf)) {
+            return setting;
+        }
+    }
+    return NULL;
+}
+
+// Returns the length of the name in a "name = value" line, like cliSet() does
+static size_t lineNameLength(const char *line)
+{
+    const char *eqptr = strstr(line, "=");
+    while (*(eqptr - 1) == ' ') {
+        eqptr--;
+    }
+    return eqptr - line;
+}
+
+TEST(SettingsUnittest, FindsEverySetting)
+{
+    for (int ii = 0; ii < SETTINGS_TABLE_COUNT; ii++) {
+        const std::string name = settingName(ii);
+        EXPECT_EQ(&settingsTable[ii], setting_find(name.c_str())) << name;
+    }
+}
+
+TEST(SettingsUnittest, RejectsUnknownNames)
+{
+    EXPECT_EQ(NULL, setting_find(""));
+    EXPECT_EQ(NULL, setting_find("no_such_setting"));
+
+    const std::string tooLong(SETTING_MAX_NAME_LENGTH, 'a');
+    EXPECT_EQ(NULL, setting_find(tooLong.c_str()));
+
+    for (int ii = 0; ii < SETTINGS_TABLE_COUNT; ii++) {
+        const std::string name = settingName(ii);
+        const std::string shorter = name.substr(0, name.length() - 1);
+        const setting_t *found = setting_find(shorter.c_str());
+        // Some names are prefixes of others, e.g. "foo" and "foo_bar"
+        if (found) {
+            EXPECT_EQ(shorter, settingName(found - settingsTable));
+        }
+        EXPECT_EQ(NULL, setting_find((name + "x").c_str())) << name;
+        EXPECT_EQ(NULL, setting_find((name + "_").c_str())) << name;
+    }
+}
+
+TEST(SettingsUnittest, FindIsCaseSensitive)
+{
+    for (int ii = 0; ii < SETTINGS_TABLE_COUNT; ii++) {
+        std::string name = settingName(ii);
+        for (char &c : name) {
+            c = sl_toupper(c);
+        }
+        EXPECT_EQ(NULL, setting_find(name.c_str())) << name;
+    }
+}
+
+TEST(SettingsUnittest, FindCaseInsensitive)
+{
+    char buf[SETTING_MAX_NAME_LENGTH];
+
+    for (int ii = 0; ii < SETTINGS_TABLE_COUNT; ii++) {
+        const std::string name = settingName(ii);
+        std::string upper = name;
+        for (char &c : upper) {
+            c = sl_toupper(c);
+        }
+
+        const std::string line = upper + " = 1";
+        EXPECT_EQ(&settingsTable[ii], setting_find_case_insensitive(line.c_str(), name.length(), buf)) << name;
+        EXPECT_STREQ(name.c_str(), buf);
+
+        // Only an exact match sets a value, a prefix of the name isn't enough
+        const setting_t *found = setting_find_case_insensitive(line.c_str(), name.length() - 1, buf);
+        if (found) {
+            EXPECT_EQ(name.substr(0, name.length() - 1), settingName(found - settingsTable));
+        }
+    }
+
+    EXPECT_EQ(NULL, setting_find_case_insensitive("anything", 0, buf));
+}
+
+/*
+ * Replays the name lookups of restoring a full "diff all" through the CLI, which has a "set name = value" line
+ * for every setting, and compares the time taken by the linear lookup with the hashed one.
+ */
+TEST(SettingsBenchmark, BenchmarkDiffAllRestore)
+{
+    std::vector<std::string> lines;
+    for (int ii = 0; ii < SETTINGS_TABLE_COUNT; ii++) {
+        lines.push_back(settingName(ii) + " = 0");
+    }
+
+    char buf[SETTING_MAX_NAME_LENGTH];
+    uint32_t linearFound = 0;
+    uint32_t hashedFound = 0;
+
+    const auto linearBegin = std::chrono::steady_clock::now();
+    for (int replay = 0; replay < BENCHMARK_REPLAYS; replay++) {
+        for (const std::string &line : lines) {
+            linearFound += linearFind(line.c_str(), lineNameLength(line.c_str())) != NULL;
+        }
+    }
+    const double linearUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - linearBegin).count();
+
+    const auto hashedBegin = std::chrono::steady_clock::now();
+    for (int replay = 0; replay < BENCHMARK_REPLAYS; replay++) {
+        for (const std::string &line : lines) {
+            hashedFound += setting_find_case_insensitive(line.c_str(), lineNameLength(line.c_str()), buf) != NULL;
+        }
+    }
+    const double hashedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - hashedBegin).count();
+
+    EXPECT_EQ((uint32_t)(SETTINGS_TABLE_COUNT * BENCHMARK_REPLAYS), linearFound);
+    EXPECT_EQ(linearFound, hashedFound);
+
+    printf("[ BENCHMARK] %d settings: linear %8.1f us per diff all, hashed %6.1f us per diff all (%.1fx)\n",
+        SETTINGS_TABLE_COUNT, linearUs / BENCHMARK_REPLAYS, hashedUs / BENCHMARK_REPLAYS, linearUs / hashedUs);
+}
+
+// STUBS
+
+extern "C" {
+
+const pgRegistry_t *pgFind(pgn_t pgn)
+{
+    UNUSED(pgn);
+    return NULL;
+}
+
+uint8_t getConfigProfile(void)
+{
+    return 0;
+}
+
+}
@@ -58,3 +58,5 @@
 #define TARGET_IO_PORTB         0xffff
 #define TARGET_IO_PORTC         0xffff
 
+
+#define SCHEDULER_DELAY_LIMIT   100
@@ -0,0 +1,503 @@
+#!/usr/bin/env ruby
+
+# This file is part of INAV.
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this file,
+# You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# Alternatively, the contents of this file may be used under the terms
+# of the GNU General Public License Version 3, as described below:
+#
+# This file is free software: you may copy, redistribute and/or modify
+# it under the terms of the GNU General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# This file is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+# Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see http://www.gnu.org/licenses/.
+
+# Reads the blackboxMainFields table from blackbox.c and emits straight-line
+# I and P frame encoders that write exactly the fields promised by the log
+# header. The output is included by blackbox.c, which picks the encoder
+# matching its condition cache once in blackboxStart().
+
+require 'getoptlong'
+require 'stringio'
+
+# Maps the field names used in the log header to the members of
+# blackboxMainState_t holding their values.
+FIELD_SOURCES = {
+    "loopIteration" => nil, # Not stored in the history, see blackboxIteration
+    "time" => "time",
+    "axisRate" => "axisPID_Setpoint",
+    "axisP" => "axisPID_P",
+    "axisI" => "axisPID_I",
+    "axisD" => "axisPID_D",
+    "rcData" => "rcData",
+    "rcCommand" => "rcCommand",
+    "vbatLatest" => "vbatLatest",
+    "amperageLatest" => "amperageLatest",
+    "magADC" => "magADC",
+    "BaroAlt" => "BaroAlt",
+    "AirSpeed" => "airSpeed",
+    "surfaceRaw" => "surfaceRaw",
+    "rssi" => "rssi",
+    "gyroADC" => "gyroADC",
+    "accSmooth" => "accADC",
+    "attitude" => "attitude",
+    "debug" => "debug",
+    "motor" => "motor",
+    "servo" => "servo",
+    "navState" => "navState",
+    "navFlags" => "navFlags",
+    "navEPH" => "navEPH",
+    "navEPV" => "navEPV",
+    "navPos" => "navPos",
+    "navVel" => "navRealVel",
+    "navAcc" => "navAccNEU",
+    "navTgtVel" => "navTargetVel",
+    "navTgtPos" => "navTargetPos",
+    "navSurf" => "navSurface",
+    "navTgtSurf" => "navTargetSurface",
+}
+
+# Conditions which depend on the aircraft layout rather than on the
+# sensors or the logging rate. Specialized encoders are emitted for the
+# most common layouts, with these conditions folded at compile time.
+STRUCTURAL_CONDITIONS = (1..8).map { |n| "AT_LEAST_MOTORS_#{n}" } +
+    ["TRICOPTER", "NONZERO_PID_D_0", "NONZERO_PID_D_1", "NONZERO_PID_D_2"]
+
+def motors(n)
+    (1..n).map { |m| "AT_LEAST_MOTORS_#{m}" }
+end
+
+ENCODER_VARIANTS = [
+    ["Quad", motors(4) + ["NONZERO_PID_D_0", "NONZERO_PID_D_1"]],
+    ["Hex", motors(6) + ["NONZERO_PID_D_0", "NONZERO_PID_D_1"]],
+    ["Airplane", motors(1) + ["NONZERO_PID_D_0", "NONZERO_PID_D_1", "NONZERO_PID_D_2"]],
+]
+
+# Number of values packed by each group encoding
+GROUP_SIZES = {
+    "TAG2_3S32" => 3,
+    "TAG8_4S16" => 4,
+}
+
+# Encodings of optional fields, which are gathered at runtime and written in
+# groups of up to 8, the same way decoders group them
+GATHERED_ENCODINGS = {
+    "TAG8_8SVB" => "blackboxWriteTag8_8SVB",
+    "RICE_GROUP" => "blackboxWriteRiceGroup",
+}
+
+GATHERED_MAX_GROUP = 8
+
+FIELD_RE = /^\{"(\w+)",\s*(-?\d+),\s*(SIGNED|UNSIGNED),\s*\.Ipredict\s*=\s*PREDICT\((\w+)\),\s*\.Iencode\s*=\s*ENCODING\((\w+)\),\s*\.Ppredict\s*=\s*PREDICT\((\w+)\),\s*\.Pencode\s*=\s*(?:ENCODING\((\w+)\)|FLIGHT_LOG_FIELD_ENCODING_(NULL)),\s*(?:CONDITION\((\w+)\)|FLIGHT_LOG_FIELD_CONDITION_(\w+))(?:,\s*COMPRESSED\((\w+),\s*(\w+)\))?\},?$/
+
+class Field
+    attr_reader :name, :index, :ipredict, :iencode, :ppredict, :pencode, :condition
+
+    def initialize(m)
+        @name = m[1]
+        @index = m[2].to_i
+        @ipredict = m[4]
+        @iencode = m[5]
+        @ppredict = m[6]
+        @pencode = m[7] || m[8]
+        @condition = m[9] || m[10]
+        @compressed_predict = m[11]
+        @compressed_encode = m[12]
+        if !FIELD_SOURCES.has_key?(@name)
+            raise "Unknown blackbox field #{@name}, add it to FIELD_SOURCES"
+        end
+    end
+
+    def to_s
+        @index < 0 ? @name : "#{@name}[#{@index}]"
+    end
+
+    def member
+        FIELD_SOURCES[@name]
+    end
+
+    def value(state, members)
+        if @name == "loopIteration"
+            return "blackboxIteration"
+        end
+        type, is_array = members[member]
+        raise "#{member} is not a member of blackboxMainState_t" if !type
+        expr = "#{state}->#{member}"
+        is_array ? "#{expr}[#{@index}]" : expr
+    end
+
+    def unsigned_member?(members)
+        type, _ = members[member]
+        type.start_with?("u")
+    end
+
+    def in_pframe?
+        @pencode != "NULL" && @ppredict != "INC"
+    end
+
+    def compressible?
+        !@compressed_predict.nil?
+    end
+
+    # The same field with the P-frame predictor and encoding used in compressed logs
+    def compressed
+        f = dup
+        f.instance_variable_set(:@ppredict, @compressed_predict)
+        f.instance_variable_set(:@pencode, @compressed_encode)
+        f
+    end
+end
+
+class Generator
+    def initialize(src_file, output_file)
+        @src_file = src_file
+        @output_file = output_file
+    end
+
+    def write_files
+        load_fields
+        buf = StringIO.new
+        write_file_header(buf)
+        buf << "#pragma once\n\n"
+        write_intraframe_encoder(buf)
+        write_interframe_encoder(buf)
+        write_encoder_table(buf)
+        File.write(@output_file, buf.string)
+    end
+
+    private
+
+    def load_fields
+        src = File.read(@src_file)
+        load_state_members(src)
+        m = src.match(/blackboxMainFields\[\]\s*=\s*\{\n(.*?)\n\};/m)
+        raise "Could not find blackboxMainFields in #{@src_file}" if !m
+        # Items are either fields or preprocessor lines, which are
+        # copied verbatim to the output.
+        @items = []
+        in_comment = false
+        m[1].each_line do |line|
+            line = line.strip
+            if in_comment
+                in_comment = !line.include?("*/")
+                next
+            end
+            next if line.empty? || line.start_with?("//")
+            if line.start_with?("/*")
+                in_comment = !line.include?("*/")
+                next
+            end
+            if line =~ /^#\s*(ifdef|ifndef|if|endif)\b/
+                @items << line
+                next
+            end
+            fm = line.match(FIELD_RE)
+            raise "Can't parse blackbox field definition: #{line}" if !fm
+            field = Field.new(fm)
+            @items << field if field.condition != "NEVER"
+        end
+    end
+
+    # Collects the type of each blackboxMainState_t member and whether
+    # it's an array, since some header fields use [0] for scalars
+    def load_state_members(src)
+        m = src.match(/typedef struct blackboxMainState_s \{\n(.*?)\n\} blackboxMainState_t;/m)
+        raise "Could not find blackboxMainState_t in #{@src_file}" if !m
+        @members = {}
+        m[1].scan(/^\s*(\w+)\s+(\w+)(\[[^\]]+\])?;/) do |type, name, dims|
+            @members[name] = [type, !dims.nil?]
+        end
+    end
+
+    def write_file_header(buf)
+        buf << "// This file has been automatically generated by utils/blackbox_encoders.rb\n"
+        buf << "// Don't make any modifications to it. They will be lost.\n\n"
+    end
+
+    def condition_test(cond)
+        "conditions & (1 << FLIGHT_LOG_FIELD_CONDITION_#{cond})"
+    end
+
+    # Writes a list of statements, each one being either a preprocessor
+    # line or a [condition, [lines]] pair. Consecutive statements sharing
+    # a condition are written inside the same if().
+    def write_statements(buf, stmts, indent)
+        pad = " " * indent
+        i = 0
+        while i < stmts.length
+            stmt = stmts[i]
+            if stmt.is_a?(String)
+                buf << stmt << "\n"
+                i += 1
+                next
+            end
+            cond = stmt[0]
+            lines = []
+            while i < stmts.length && stmts[i].is_a?(Array) && stmts[i][0] == cond
+                lines.concat(stmts[i][1])
+                i += 1
+            end
+            if cond == "ALWAYS"
+                lines.each { |l| buf << pad << l << "\n" }
+            else
+                buf << pad << "if (#{condition_test(cond)}) {\n"
+                lines.each { |l| buf << pad << "    " << l << "\n" }
+                buf << pad << "}\n"
+            end
+        end
+    end
+
+    def intraframe_statement(f)
+        v = f.value("blackboxCurrent", @members)
+        predictor = case f.ipredict
+            when "0" then nil
+            when "MINTHROTTLE" then "motorConfig()->minthrottle"
+            when "MOTOR_0" then "blackboxCurrent->motor[0]"
+            when "1500" then "1500"
+            when "VBATREF" then "vbatReference"
+            else raise "Unsupported I-frame predictor #{f.ipredict} for #{f}"
+        end
+        expr = predictor ? "#{v} - #{predictor}" : v
+        line = case f.iencode
+            when "UNSIGNED_VB" then "blackboxWriteUnsignedVB(#{expr});"
+            when "SIGNED_VB" then "blackboxWriteSignedVB(#{expr});"
+            when "NEG_14BIT"
+                raise "NEG_14BIT requires a predictor for #{f}" if !predictor
+                "blackboxWriteUnsignedVB((#{predictor} - #{v}) & 0x3FFF);"
+            else raise "Unsupported I-frame encoding #{f.iencode} for #{f}"
+        end
+        [f.condition, [line]]
+    end
+
+    def write_intraframe_encoder(buf)
+        buf << "static inline __attribute__((always_inline)) void blackboxEncodeIntraframeFields(const uint32_t conditions)\n"
+        buf << "{\n"
+        buf << "    const blackboxMainState_t *blackboxCurrent = blackboxHistory[0];\n\n"
+        stmts = @items.map { |item| item.is_a?(String) ? item : intraframe_statement(item) }
+        write_statements(buf, stmts, 4)
+        buf << "}\n\n"
+    end
+
+    def pframe_delta(f)
+        cur = f.value("blackboxCurrent", @members)
+        last = f.value("blackboxLast", @members)
+        last2 = f.value("blackboxLast2", @members)
+        cast = f.unsigned_member?(@members) ? "(int32_t) " : ""
+        case f.ppredict
+        when "PREVIOUS" then "#{cast}#{cur} - #{last}"
+        when "STRAIGHT_LINE" then "(int32_t) (#{cur} - 2 * #{last} + #{last2})"
+        when "AVERAGE_2" then "#{cast}#{cur} - (#{last} + #{last2}) / 2"
+        else raise "Unsupported P-frame predictor #{f.ppredict} for #{f}"
+        end
+    end
+
+    def pframe_statements(items)
+        stmts = []
+        i = 0
+        while i < items.length
+            item = items[i]
+            if item.is_a?(String)
+                stmts << item
+                i += 1
+                next
+            end
+            case item.pencode
+            when "SIGNED_VB"
+                stmts << [item.condition, ["blackboxWriteSignedVB(#{pframe_delta(item)});"]]
+                i += 1
+            when *GROUP_SIZES.keys
+                size = GROUP_SIZES[item.pencode]
+                group = []
+                while group.length < size && i < items.length && items[i].is_a?(Field) && items[i].pencode == item.pencode
+                    if items[i].condition != item.condition
+                        raise "Fields packed with #{item.pencode} must share a condition (#{items[i]})"
+                    end
+                    group << items[i]
+                    i += 1
+                end
+                lines = group.each_with_index.map { |f, n| "values[#{n}] = #{pframe_delta(f)};" }
+                (group.length...size).each { |n| lines << "values[#{n}] = 0;" }
+                lines << "blackboxWrite#{item.pencode.capitalize.sub(/s(\d+)$/) { "S#{$1}" }}(values);"
+                stmts << [item.condition, lines]
+                @values_size = [@values_size, size].max
+            when *GATHERED_ENCODINGS.keys
+                # Fields in this run are optional, so the packing depends on
+                # which conditions hold. Gather the present values and let the
+                # encoder split them in groups of up to 8, like decoders do.
+                stmts << ["ALWAYS", ["valueCount = 0;"]]
+                count = 0
+                while i < items.length && (items[i].is_a?(String) || items[i].pencode == item.pencode)
+                    if items[i].is_a?(String)
+                        stmts << items[i]
+                    else
+                        stmts << [items[i].condition, ["values[valueCount++] = #{pframe_delta(items[i])};"]]
+                        count += 1
+                    end
+                    i += 1
+                end
+                # Any trailing preprocessor lines belong after the write
+                trailing = []
+                while stmts.last.is_a?(String) && stmts.last !~ /^#\s*endif/
+                    trailing.unshift(stmts.pop)
+                end
+                stmts << ["ALWAYS", [
+                    "for (int i = 0; i < valueCount; i += #{GATHERED_MAX_GROUP}) {",
+                    "    #{GATHERED_ENCODINGS[item.pencode]}(values + i, MIN(valueCount - i, #{GATHERED_MAX_GROUP}));",
+                    "}",
+                ]]
+                stmts.concat(trailing)
+                @values_size = [@values_size, count].max
+                @uses_value_count = true
+            else
+                raise "Unsupported P-frame encoding #{item.pencode} for #{item}"
+            end
+        end
+        stmts
+    end
+
+    def statement_lines(stmts)
+        buf = StringIO.new
+        write_statements(buf, stmts, 4)
+        buf.string.lines.map(&:chomp)
+    end
+
+    def write_interframe_encoder(buf)
+        items = @items.select { |item| item.is_a?(String) || item.in_pframe? }
+        @values_size = 0
+        @uses_value_count = false
+
+        # Runs of fields with a compressed alternative are written either way,
+        # depending on FLIGHT_LOG_FIELD_CONDITION_COMPRESSED
+        stmts = []
+        i = 0
+        while i < items.length
+            if !items[i].is_a?(Field) || !items[i].compressible?
+                start = i
+                i += 1 while i < items.length && !(items[i].is_a?(Field) && items[i].compressible?)
+                stmts.concat(pframe_statements(items[start...i]))
+                next
+            end
+            start = i
+            i += 1 while i < items.length && items[i].is_a?(Field) && items[i].compressible?
+            run = items[start...i]
+            [start - 1, i].each do |n|
+                edge = n < start ? run.first : run.last
+                next if n < 0 || !items[n].is_a?(Field)
+                [edge.pencode, edge.compressed.pencode].each do |encoding|
+                    if items[n].pencode == encoding && encoding != "SIGNED_VB"
+                        raise "Compressed field #{edge} would join or split a #{encoding} group"
+                    end
+                end
+            end
+            lines = ["if (#{condition_test("COMPRESSED")}) {"]
+            lines.concat(statement_lines(pframe_statements(run.map(&:compressed))))
+            lines << "} else {"
+            lines.concat(statement_lines(pframe_statements(run)))
+            lines << "}"
+            stmts << ["ALWAYS", lines]
+        end
+
+        buf << "static inline __attribute__((always_inline)) void blackboxEncodeInterframeFields(const uint32_t conditions)\n"
+        buf << "{\n"
+        buf << "    const blackboxMainState_t *blackboxCurrent = blackboxHistory[0];\n"
+        buf << "    const blackboxMainState_t *blackboxLast = blackboxHistory[1];\n"
+        buf << "    const blackboxMainState_t *blackboxLast2 = blackboxHistory[2];\n"
+        buf << "    int32_t values[#{@values_size}];\n" if @values_size > 0
+        buf << "    int valueCount;\n" if @uses_value_count
+        buf << "\n"
+        write_statements(buf, stmts, 4)
+        buf << "}\n\n"
+    end
+
+    def conditions_mask(conds)
+        conds.map { |c| "(1 << FLIGHT_LOG_FIELD_CONDITION_#{c})" }.join(" | \\\n    ")
+    end
+
+    def write_encoder(buf, name, conditions)
+        ["Intraframe", "Interframe"].each do |frame|
+            buf << "static void blackboxEncode#{frame}#{name}(void)\n"
+            buf << "{\n"
+            buf << "    blackboxEncode#{frame}Fields(#{conditions});\n"
+            buf << "}\n\n"
+        end
+        buf << "static const blackboxFrameEncoder_t blackboxFrameEncoder#{name} = {\n"
+        buf << "    .writeIntraframe = blackboxEncodeIntraframe#{name},\n"
+        buf << "    .writeInterframe = blackboxEncodeInterframe#{name},\n"
+        buf << "};\n\n"
+    end
+
+    def write_encoder_table(buf)
+        buf << "typedef struct blackboxFrameEncoder_s {\n"
+        buf << "    void (*writeIntraframe)(void);\n"
+        buf << "    void (*writeInterframe)(void);\n"
+        buf << "} blackboxFrameEncoder_t;\n\n"
+
+        write_encoder(buf, "Generic", "blackboxConditionCache")
+
+        buf << "#ifdef USE_BLACKBOX_ENCODER_VARIANTS\n"
+        buf << "#define BLACKBOX_ENCODER_STRUCTURAL_CONDITIONS ( \\\n    #{conditions_mask(STRUCTURAL_CONDITIONS)})\n\n"
+        ENCODER_VARIANTS.each do |name, conds|
+            buf << "#define BLACKBOX_ENCODER_CONDITIONS_#{name.upcase} ( \\\n    #{conditions_mask(conds)})\n\n"
+        end
+        ENCODER_VARIANTS.each do |name, conds|
+            write_encoder(buf, name, "BLACKBOX_ENCODER_CONDITIONS_#{name.upcase} | (blackboxConditionCache & ~BLACKBOX_ENCODER_STRUCTURAL_CONDITIONS)")
+        end
+        buf << "#endif\n\n"
+
+        buf << "static const blackboxFrameEncoder_t *blackboxSelectFrameEncoder(uint32_t conditions)\n"
+        buf << "{\n"
+        buf << "#ifdef USE_BLACKBOX_ENCODER_VARIANTS\n"
+        buf << "    switch (conditions & BLACKBOX_ENCODER_STRUCTURAL_CONDITIONS) {\n"
+        ENCODER_VARIANTS.each do |name, conds|
+            buf << "    case BLACKBOX_ENCODER_CONDITIONS_#{name.upcase}:\n"
+            buf << "        return &blackboxFrameEncoder#{name};\n"
+        end
+        buf << "    default:\n"
+        buf << "        break;\n"
+        buf << "    }\n"
+        buf << "#else\n"
+        buf << "    UNUSED(conditions);\n"
+        buf << "#endif\n"
+        buf << "    return &blackboxFrameEncoderGeneric;\n"
+        buf << "}\n"
+    end
+end
+
+def usage
+    puts "Usage: ruby #{__FILE__} <blackbox_c_file> <output_file>"
+end
+
+if __FILE__ == $0
+
+    opts = GetoptLong.new(
+        [ "--help", "-h", GetoptLong::NO_ARGUMENT ],
+    )
+
+    opts.each do |opt, arg|
+        case opt
+        when "--help"
+            usage()
+            exit(0)
+        end
+    end
+
+    src_file = ARGV[0]
+    output_file = ARGV[1]
+    if src_file.nil? || output_file.nil?
+        usage()
+        exit(1)
+    end
+
+    gen = Generator.new(src_file, output_file)
+    gen.write_files()
+end
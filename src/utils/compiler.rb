@@ -35,7 +35,8 @@ class Compiler
         # are some issues with the built-in search by spawn()
         # on Windows if PATH contains spaces.
         dirs = (ENV["PATH"] || "").split(File::PATH_SEPARATOR)
-        bin = "arm-none-eabi-g++"
+        # SETTINGS_CXX allows host targets (SITL) to use the native compiler.
+        bin = ENV["SETTINGS_CXX"] || "arm-none-eabi-g++"
         dirs.each do |dir|
             p = File.join(dir, bin)
             ['', '.exe'].each do |suffix|
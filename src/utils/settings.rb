@@ -257,13 +257,88 @@ class ValueEncoder
     end
 end
 
+class NameHasher
+    # Hash and displace minimal-ish perfect hash of the setting names. The
+    # functions below must match setting_name_hash() and
+    # setting_name_hash_slot() in fc/settings.c
+    FNV_OFFSET_BASIS = 2166136261
+    FNV_PRIME = 16777619
+    DISPLACEMENT_MULTIPLIER = 0x9E3779B9
+    MAX_DISPLACEMENT = 255
+
+    attr_reader :displacements
+    attr_reader :slots
+
+    def self.hash_name(name)
+        h = FNV_OFFSET_BASIS
+        name.downcase.each_byte do |b|
+            h = ((h ^ b) * FNV_PRIME) & 0xFFFFFFFF
+        end
+        return h
+    end
+
+    def self.slot(hash, displacement, slots_count)
+        k = (hash + displacement * DISPLACEMENT_MULTIPLIER) & 0xFFFFFFFF
+        k ^= k >> 16
+        k = (k * 0x85EBCA6B) & 0xFFFFFFFF
+        k ^= k >> 13
+        k = (k * 0xC2B2AE35) & 0xFFFFFFFF
+        k ^= k >> 16
+        return k % slots_count
+    end
+
+    def initialize(names)
+        @hashes = names.map { |name| NameHasher.hash_name(name) }
+        # Leave some empty slots, so the last buckets to be
+        # placed can still find a free one
+        slots_count = names.length + names.length / 8 + 1
+        # Around 4 names per bucket
+        ((names.length + 3) / 4..names.length).each do |buckets_count|
+            if place(buckets_count, slots_count)
+                return
+            end
+        end
+        raise "could not build a perfect hash for #{names.length} setting names"
+    end
+
+    private
+    def place(buckets_count, slots_count)
+        buckets = Array.new(buckets_count) { [] }
+        @hashes.each_with_index do |h, ii|
+            buckets[h % buckets_count] << ii
+        end
+        slots = Array.new(slots_count)
+        displacements = Array.new(buckets_count, 0)
+        # Place the biggest buckets first, while there's plenty of free slots
+        order = (0...buckets_count).sort_by { |b| [-buckets[b].length, b] }
+        order.each do |b|
+            members = buckets[b]
+            next if members.empty?
+            found = (0..MAX_DISPLACEMENT).find do |d|
+                s = members.map { |ii| NameHasher.slot(@hashes[ii], d, slots_count) }
+                s.uniq.length == s.length && s.all? { |x| slots[x] == nil }
+            end
+            return false if found == nil
+            displacements[b] = found
+            members.each do |ii|
+                slots[NameHasher.slot(@hashes[ii], found, slots_count)] = ii
+            end
+        end
+        @displacements = displacements
+        # Empty slots are never matched, since the lookup always
+        # compares the name of the setting it finds
+        @slots = slots.map { |x| x || 0 }
+        return true
+    end
+end
+
 OFF_ON_TABLE = Hash["name" => "off_on", "values" => ["OFF", "ON"]]
 
 class Generator
-    def initialize(src_root, settings_file)
+    def initialize(src_root, settings_file, output_dir = nil)
         @src_root = src_root
         @settings_file = settings_file
-        @output_dir = File.dirname(settings_file)
+        @output_dir = output_dir || File.dirname(settings_file)
 
         @compiler = Compiler.new
 
@@ -285,8 +360,11 @@ class Generator
 
         load_data
 
+        FileUtils.mkdir_p(@output_dir)
+
         sanitize_fields
         initialize_name_encoder
+        initialize_name_hasher
         initialize_value_encoder
 
         write_header_file(header_file)
@@ -323,6 +401,8 @@ class Generator
         puts "name encoder uses #{word_idx} word indexing"
         puts "each setting name uses #{@name_encoder.max_length} bytes"
         puts "#{@name_encoder.estimated_size(@count)} bytes estimated for setting name storage"
+        hash_size = @name_hasher.displacements.length + @name_hasher.slots.length * (@count > 255 ? 2 : 1)
+        puts "name hash uses #{@name_hasher.displacements.length} buckets, #{@name_hasher.slots.length} slots, #{hash_size} bytes"
         values_size = @value_encoder.values.length * 4
         puts "value storage uses #{values_size} bytes"
         value_idx_size = @value_encoder.index_bytes * 2
@@ -457,6 +537,19 @@ class Generator
         end
         buf << "};\n"
 
+        # Write the name hash tables, used by setting_find()
+        buf << "static const uint8_t settingNamesHashDisplacements[] = {\n"
+        @name_hasher.displacements.each_slice(16) do |s|
+            buf << "\t#{s.join(", ")},\n"
+        end
+        buf << "};\n"
+        slot_type = @count > 255 ? "uint16_t" : "uint8_t"
+        buf << "static const #{slot_type} settingNamesHashSlots[] = {\n"
+        @name_hasher.slots.each_slice(16) do |s|
+            buf << "\t#{s.join(", ")},\n"
+        end
+        buf << "};\n"
+
         # Write the tables
         table_names = ordered_table_names()
         table_names.each do |name|
@@ -749,19 +842,12 @@ class Generator
         stderr = compile_test_file(prog)
         stderr.scan(/var_(\d+).*?', which is of non-class type '(.*)'/).each do |m|
             member = members[m[0].to_i]
-            case m[1]
-            when "int8_t {aka signed char}"
-                typ = "int8_t"
-            when "uint8_t {aka unsigned char}"
-                typ = "uint8_t"
-            when "int16_t {aka short int}"
-                typ = "int16_t"
-            when "uint16_t {aka short unsigned int}"
-                typ = "uint16_t"
-            when "uint32_t {aka long unsigned int}"
-                typ = "uint32_t"
-            when "float"
-                typ = "float"
+            # Newer compilers quote both the typedef and its expansion,
+            # e.g. 'uint16_t' {aka 'short unsigned int'}, and the expansion
+            # depends on the host ABI. Only the typedef name matters.
+            typ = m[1].delete("'").sub(/ \{aka .*$/, "")
+            case typ
+            when "int8_t", "uint8_t", "int16_t", "uint16_t", "uint32_t", "float"
             else
                 raise "Unknown type #{m[1]} when resolving type for setting #{member["name"]}"
             end
@@ -792,6 +878,14 @@ class Generator
         @name_encoder = best
     end
 
+    def initialize_name_hasher
+        names = []
+        foreach_enabled_member do |group, member|
+            names << member["name"]
+        end
+        @name_hasher = NameHasher.new(names)
+    end
+
     def initialize_value_encoder
         values = []
         constants = []
@@ -868,7 +962,7 @@ class Generator
 end
 
 def usage
-    puts "Usage: ruby #{__FILE__} <source_dir> <settings_file> [--json <json_file>]"
+    puts "Usage: ruby #{__FILE__} <source_dir> <settings_file> [--json <json_file>] [--output-dir <dir>]"
 end
 
 if __FILE__ == $0
@@ -882,14 +976,14 @@ if __FILE__ == $0
         exit(1)
     end
 
-    gen = Generator.new(src_root, settings_file)
-
     opts = GetoptLong.new(
         [ "--help", "-h", GetoptLong::NO_ARGUMENT ],
         [ "--json", "-j", GetoptLong::REQUIRED_ARGUMENT ],
+        [ "--output-dir", "-o", GetoptLong::REQUIRED_ARGUMENT ],
     )
 
     jsonFile = nil
+    outputDir = nil
 
     opts.each do |opt, arg|
         case opt
@@ -898,9 +992,13 @@ if __FILE__ == $0
             exit(0)
         when "--json"
             jsonFile = arg
+        when "--output-dir"
+            outputDir = arg
         end
     end
 
+    gen = Generator.new(src_root, settings_file, outputDir)
+
     if jsonFile
         gen.write_json(jsonFile)
     else